@@ -16,6 +16,33 @@ namespace GlobalRootSignatureParamsWithPrimitives
     };
 }
 
+namespace CausticRootSignatureParams
+{
+    enum Value
+    {
+        ProjectionMapSlot = GlobalRootSignatureParamsWithPrimitives::Count,
+        Count
+    };
+}
+
+namespace ImportanceRootSignatureParams
+{
+    enum Value
+    {
+        EmissionCDFSlot = GlobalRootSignatureParamsWithPrimitives::Count,
+        Count
+    };
+}
+
+namespace IrradianceCacheRootSignatureParams
+{
+    enum Value
+    {
+        PassConstantSlot = GlobalRootSignatureParamsWithPrimitives::Count,
+        Count
+    };
+}
+
 namespace LocalRootSignatureParams 
 {
     enum Value 
@@ -34,3 +61,12 @@ namespace ComputeRootSignatureParams
 		Count
 	};
 }
+
+namespace ReprojectionRootSignatureParams
+{
+    enum Value
+    {
+        PrevCameraSlot = ComputeRootSignatureParams::Count,
+        Count
+    };
+}
@@ -0,0 +1,90 @@
+#ifndef FLUXACCUMULATION_H
+#define FLUXACCUMULATION_H
+
+// Staging buffers of the atomic splatting path, shared by the splat pass, the clear and the resolve.
+// Every channel is a 64 bit fixed point sum with FLUX_FIXED_POINT_SCALE steps per unit of flux,
+// slice 0 holds the low word and slice 1 the high word. A counts the photons that landed in the pixel.
+RWTexture2DArray<uint> StagedRenderTarget_R : register(u1);
+RWTexture2DArray<uint> StagedRenderTarget_G : register(u2);
+RWTexture2DArray<uint> StagedRenderTarget_B : register(u3);
+RWTexture2DArray<uint> StagedRenderTarget_A : register(u4);
+
+// The low word wraps in exactly one of the adds that cross 2^32, and that add sees the wrap in its own original value
+inline void AtomicAddFixedPoint(RWTexture2DArray<uint> target, uint2 pixel, uint value)
+{
+    uint previous;
+    InterlockedAdd(target[uint3(pixel, 0)], value, previous);
+    if (previous + value < previous)
+    {
+        InterlockedAdd(target[uint3(pixel, 1)], 1);
+    }
+}
+
+inline float LoadFixedPoint(RWTexture2DArray<uint> target, uint2 pixel)
+{
+    return target[uint3(pixel, 1)] * (4294967296.0f / FLUX_FIXED_POINT_SCALE) + target[uint3(pixel, 0)] / FLUX_FIXED_POINT_SCALE;
+}
+
+inline void AddFlux(uint2 pixel, float3 flux)
+{
+    uint3 fixedFlux = uint3(min(max(flux, 0.0f), FLUX_MAX_PHOTON) * FLUX_FIXED_POINT_SCALE + 0.5f);
+    AtomicAddFixedPoint(StagedRenderTarget_R, pixel, fixedFlux.r);
+    AtomicAddFixedPoint(StagedRenderTarget_G, pixel, fixedFlux.g);
+    AtomicAddFixedPoint(StagedRenderTarget_B, pixel, fixedFlux.b);
+    AtomicAddFixedPoint(StagedRenderTarget_A, pixel, 1);
+}
+
+inline void ClearFlux(uint2 pixel)
+{
+    for (uint word = 0; word < 2; ++word)
+    {
+        StagedRenderTarget_R[uint3(pixel, word)] = 0;
+        StagedRenderTarget_G[uint3(pixel, word)] = 0;
+        StagedRenderTarget_B[uint3(pixel, word)] = 0;
+        StagedRenderTarget_A[uint3(pixel, word)] = 0;
+    }
+}
+
+inline float3 CameraRayDirection(float2 screenPos, float2 screenDims, float4x4 projectionToWorld, float3 cameraPosition)
+{
+    float2 ndc = screenPos / screenDims * 2.0 - 1.0;
+    ndc.y = -ndc.y;
+    float4 world = mul(float4(ndc, 0, 1), projectionToWorld);
+    return normalize(world.xyz / world.w - cameraPosition);
+}
+
+// Surface area a pixel sees: its solid angle spread over the hit distance, stretched by the surface's tilt
+inline float PixelFootprintArea(uint2 pixel, float2 screenDims, float4x4 projectionToWorld, float3 cameraPosition, float distance, float3 normal)
+{
+    float3 center = CameraRayDirection(pixel + float2(0.5f, 0.5f), screenDims, projectionToWorld, cameraPosition);
+    float3 right = CameraRayDirection(pixel + float2(1.5f, 0.5f), screenDims, projectionToWorld, cameraPosition);
+    float3 down = CameraRayDirection(pixel + float2(0.5f, 1.5f), screenDims, projectionToWorld, cameraPosition);
+    float solidAngle = length(cross(right - center, down - center));
+
+    float cosTheta = max(abs(dot(normal, center)), DENSITY_MIN_COSINE);
+    return solidAngle * distance * distance / cosTheta;
+}
+
+// Density estimate over the pixel footprint, fluxToRadiance folds in the photon count, 1 / pi and the exposure
+inline float3 ResolveFlux(uint2 pixel, float2 screenDims, float4x4 projectionToWorld, float3 cameraPosition, float distance, float3 normal, float fluxToRadiance)
+{
+    float3 flux = float3(LoadFixedPoint(StagedRenderTarget_R, pixel), LoadFixedPoint(StagedRenderTarget_G, pixel), LoadFixedPoint(StagedRenderTarget_B, pixel));
+    return flux * fluxToRadiance / PixelFootprintArea(pixel, screenDims, projectionToWorld, cameraPosition, distance, normal);
+}
+
+// Weight of a neighbour's flux and footprint in the density gather, only pixels on the same surface as the center count.
+// The depth step is measured relative to the center's distance and per pixel of offset, so slanted surfaces keep their weight.
+inline float DensityGatherWeight(int2 offset, float4 centerNormalDistance, float centerInstance, float4 normalDistance, float instance)
+{
+    if (instance != centerInstance)
+    {
+        return 0.0f;
+    }
+
+    float kernel = max(1.0f - dot(offset, offset) / float((DENSITY_GATHER_RADIUS + 1) * (DENSITY_GATHER_RADIUS + 1)), 0.0f);
+    float depthStep = abs(normalDistance.w - centerNormalDistance.w) / (centerNormalDistance.w * DENSITY_GATHER_SIGMA_DEPTH * max(length(float2(offset)), 1.0f));
+    float normalWeight = pow(saturate(dot(centerNormalDistance.xyz, normalDistance.xyz)), DENSITY_GATHER_NORMAL_POWER);
+    return kernel * exp(-depthStep) * normalWeight;
+}
+
+#endif // FLUXACCUMULATION_H
@@ -12,6 +12,7 @@
 #ifndef HLSLCOMPAT_H
 #define HLSLCOMPAT_H
 
+typedef float2 XMFLOAT2;
 typedef float3 XMFLOAT3;
 typedef float4 XMFLOAT4;
 typedef float4 XMVECTOR;
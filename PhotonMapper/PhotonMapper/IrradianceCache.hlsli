@@ -0,0 +1,96 @@
+#ifndef IRRADIANCECACHE_H
+#define IRRADIANCECACHE_H
+
+// Irradiance cache records and their spatial hash, shared by the population pass and the final pass
+RWStructuredBuffer<IrradianceCacheRecord> IrradianceCacheRecords : register(u9);
+RWStructuredBuffer<uint> IrradianceCacheHeads : register(u10);
+RWStructuredBuffer<uint> IrradianceCacheCounter : register(u11);
+
+inline int3 IrradianceCacheCell(float3 position)
+{
+    return int3(floor(position / IRRADIANCE_CACHE_CELL_SIZE));
+}
+
+inline uint IrradianceCacheBucket(int3 cell)
+{
+    // Spatial hash from Teschner et al.
+    uint hash = (uint(cell.x) * 73856093) ^ (uint(cell.y) * 19349663) ^ (uint(cell.z) * 83492791);
+    return hash % IRRADIANCE_CACHE_HASH_SIZE;
+}
+
+// Ward's interpolation over the records around a point.
+// Records created by skipPass are ignored, they may still be written by other threads of the same dispatch.
+inline bool LookupIrradiance(float3 position, float3 normal, uint skipPass, out float3 irradiance)
+{
+    int3 cell = IrradianceCacheCell(position);
+    float3 weightedIrradiance = float3(0.0f, 0.0f, 0.0f);
+    float totalWeight = 0.0f;
+
+    for (int z = -1; z <= 1; ++z)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                int3 currCell = cell + int3(x, y, z);
+                uint recordIndex = IrradianceCacheHeads[IrradianceCacheBucket(currCell)];
+
+                for (uint walked = 0; recordIndex < IRRADIANCE_CACHE_MAX_RECORDS && walked < IRRADIANCE_CACHE_MAX_BUCKET_WALK; ++walked)
+                {
+                    IrradianceCacheRecord record = IrradianceCacheRecords[recordIndex];
+                    recordIndex = record.next;
+
+                    // Cleared or in flight records, and records of other cells sharing the bucket
+                    if (record.passIndex == skipPass || record.passIndex == IRRADIANCE_CACHE_INVALID || any(IrradianceCacheCell(record.position) != currCell))
+                    {
+                        continue;
+                    }
+
+                    // Ward's test for records in front of the point
+                    float3 toPoint = position - record.position;
+                    if (dot(toPoint, normal + record.normal) < -0.02f)
+                    {
+                        continue;
+                    }
+
+                    float normalTerm = sqrt(max(0.0f, 1.0f - dot(normal, record.normal)));
+                    float weight = 1.0f / (length(toPoint) / record.radius + normalTerm + 0.0001f);
+                    if (weight > 1.0f / IRRADIANCE_CACHE_ERROR)
+                    {
+                        weightedIrradiance += weight * record.irradiance;
+                        totalWeight += weight;
+                    }
+                }
+            }
+        }
+    }
+
+    irradiance = (totalWeight > 0.0f) ? weightedIrradiance / totalWeight : float3(0.0f, 0.0f, 0.0f);
+    return totalWeight > 0.0f;
+}
+
+// Lock free insert: claim a slot, fill it, then publish it as the new head of its bucket
+inline void InsertIrradianceRecord(float3 position, float3 normal, float radius, float3 irradiance, uint passIndex)
+{
+    uint recordIndex;
+    InterlockedAdd(IrradianceCacheCounter[0], 1, recordIndex);
+    if (recordIndex >= IRRADIANCE_CACHE_MAX_RECORDS)
+    {
+        return;
+    }
+
+    IrradianceCacheRecord record;
+    record.position = position;
+    record.radius = clamp(radius, IRRADIANCE_CACHE_MIN_RADIUS, IRRADIANCE_CACHE_MAX_RADIUS);
+    record.normal = normal;
+    record.next = IRRADIANCE_CACHE_INVALID;
+    record.irradiance = irradiance;
+    record.passIndex = passIndex;
+    IrradianceCacheRecords[recordIndex] = record;
+
+    uint previousHead;
+    InterlockedExchange(IrradianceCacheHeads[IrradianceCacheBucket(IrradianceCacheCell(position))], recordIndex, previousHead);
+    IrradianceCacheRecords[recordIndex].next = previousHead;
+}
+
+#endif // IRRADIANCECACHE_H
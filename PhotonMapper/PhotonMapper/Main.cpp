@@ -13,10 +13,20 @@
 #include "PixelMajorRenderer.h"
 #include "PhotonMajorRenderer.h"
 #include "PMScene.h"
+#include "PMSelfTest.h"
 
 //#define USE_PHOTON_MAJOR_RENDERER
 #define USE_PIXEL_MAJOR_RENDERER
 
+// Times scene loading on a synthetic scene of 1M primitives before starting up
+//#define BENCHMARK_SCENE_LOADING
+
+// Compiles the loaded scene into a .pmsb next to it, point filePath at that file to map it on later runs
+//#define COMPILE_BINARY_SCENE
+
+// Runs the CPU self tests, the flux resolve and the scene tables the shaders read, before starting up and quits if one fails
+//#define SELF_TEST
+
 #define SCREEN_WIDTH 1280
 #define SCREEN_HEIGHT 720
 
@@ -24,12 +34,27 @@ _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
 
+#ifdef BENCHMARK_SCENE_LOADING
+    DXRPhotonMapper::PMScene::BenchmarkJSONLoading(1000000, 10000);
+#endif
+
+#ifdef SELF_TEST
+    if (!DXRPhotonMapper::RunSelfTests())
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
     // 1. Load Scene from file
     OutputDebugString(L"DXRPhotonMapper - Loading Scene File\n");
     const std::string filePath = "E:/Git/DXR-PhotonMapper/Scene/sample.json";
 
     DXRPhotonMapper::PMScene scene(SCREEN_WIDTH, SCREEN_HEIGHT);
-    scene.LoadJSONScene(filePath);
+    scene.LoadScene(filePath);
+
+#ifdef COMPILE_BINARY_SCENE
+    scene.SaveBinaryScene(filePath.substr(0, filePath.find_last_of('.')) + ".pmsb");
+#endif
 
 
     // 2. Create a renderer
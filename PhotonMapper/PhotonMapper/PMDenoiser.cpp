@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "PMDenoiser.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        // B3 spline, the a-trous scaling function
+        const float c_kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+        inline XMVECTOR LoadPixels(const std::vector<float>& plane, size_t index)
+        {
+            return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(plane.data() + index));
+        }
+
+        inline void StorePixels(std::vector<float>& plane, size_t index, FXMVECTOR pixels)
+        {
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(plane.data() + index), pixels);
+        }
+
+        template <typename T>
+        inline const T* Row(const T* image, UINT rowPitch, UINT y)
+        {
+            return reinterpret_cast<const T*>(reinterpret_cast<const UINT8*>(image) + size_t(y) * rowPitch);
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMDenoiser::PMDenoiser() : m_width(0), m_height(0), m_border(0), m_stride(0), m_lastFilterMilliseconds(0.0f)
+    {
+    }
+
+    //------------------------------------------------------
+    // Resize
+    // The border is as wide as the furthest tap, plus three columns on the right for the lanes past the last pixel.
+    // Border pixels have no normal, so the normal term drops their weight to zero.
+    //------------------------------------------------------
+    void PMDenoiser::Resize(UINT width, UINT height, UINT border)
+    {
+        if (width == m_width && height == m_height && border == m_border)
+        {
+            return;
+        }
+
+        m_width = width;
+        m_height = height;
+        m_border = border;
+        m_stride = width + 2 * border + 4;
+
+        const size_t planeSize = size_t(m_stride) * (height + 2 * border);
+        for (UINT c = 0; c < 3; ++c)
+        {
+            m_lighting[0][c].assign(planeSize, 0.0f);
+            m_lighting[1][c].assign(planeSize, 0.0f);
+            m_albedo[c].assign(planeSize, 0.0f);
+            m_normal[c].assign(planeSize, 0.0f);
+        }
+        m_depth.assign(planeSize, CAMERA_DEPTH_MISS);
+    }
+
+    //------------------------------------------------------
+    // ForEachRowBlock
+    //------------------------------------------------------
+    void PMDenoiser::ForEachRowBlock(const std::function<void(UINT, UINT)>& filterRows)
+    {
+        const UINT numThreads = m_workerPool.GetNumThreads();
+        const UINT rowsPerThread = (m_height + numThreads - 1) / numThreads;
+        const UINT numBlocks = (rowsPerThread > 0) ? (m_height + rowsPerThread - 1) / rowsPerThread : 0;
+
+        m_workerPool.ParallelFor(numBlocks, [&](size_t block)
+        {
+            const UINT rowBegin = UINT(block) * rowsPerThread;
+            filterRows(rowBegin, (std::min)(rowBegin + rowsPerThread, m_height));
+        });
+    }
+
+    //------------------------------------------------------
+    // FilterRows
+    //------------------------------------------------------
+    void PMDenoiser::FilterRows(UINT iteration, UINT source, UINT rowBegin, UINT rowEnd)
+    {
+        const std::vector<float>* input = m_lighting[source];
+        std::vector<float>* output = m_lighting[source ^ 1];
+
+        const int step = 1 << iteration;
+        const ptrdiff_t rowStep = ptrdiff_t(step) * m_stride;
+
+        // 1 / (sigma * 2^-i)^2
+        const XMVECTOR luminanceScale = XMVectorReplicate(float(1 << (2 * iteration)) / (DENOISE_SIGMA_LUMINANCE * DENOISE_SIGMA_LUMINANCE));
+        const XMVECTOR lumaR = XMVectorReplicate(0.2126f);
+        const XMVECTOR lumaG = XMVectorReplicate(0.7152f);
+        const XMVECTOR lumaB = XMVectorReplicate(0.0722f);
+        const XMVECTOR zero = XMVectorZero();
+
+        for (UINT y = rowBegin; y < rowEnd; ++y)
+        {
+            for (UINT x = 0; x < m_width; x += 4)
+            {
+                const size_t center = PlaneIndex(x, y);
+
+                const XMVECTOR centerR = LoadPixels(input[0], center);
+                const XMVECTOR centerG = LoadPixels(input[1], center);
+                const XMVECTOR centerB = LoadPixels(input[2], center);
+                const XMVECTOR centerLuminance = XMVectorMultiplyAdd(centerR, lumaR, XMVectorMultiplyAdd(centerG, lumaG, XMVectorMultiply(centerB, lumaB)));
+                const XMVECTOR centerNormalX = LoadPixels(m_normal[0], center);
+                const XMVECTOR centerNormalY = LoadPixels(m_normal[1], center);
+                const XMVECTOR centerNormalZ = LoadPixels(m_normal[2], center);
+
+                // Depth steps are measured relative to the center's distance
+                const XMVECTOR centerDepth = LoadPixels(m_depth, center);
+                const XMVECTOR depthScale = XMVectorReciprocal(XMVectorScale(centerDepth, DENOISE_SIGMA_DEPTH));
+
+                // The center tap is always kept, so pixels alone on their surface keep their own value
+                const float centerWeight = c_kernel[2] * c_kernel[2];
+                XMVECTOR weightSum = XMVectorReplicate(centerWeight);
+                XMVECTOR sumR = XMVectorScale(centerR, centerWeight);
+                XMVECTOR sumG = XMVectorScale(centerG, centerWeight);
+                XMVECTOR sumB = XMVectorScale(centerB, centerWeight);
+
+                for (int dy = -2; dy <= 2; ++dy)
+                {
+                    for (int dx = -2; dx <= 2; ++dx)
+                    {
+                        if (dx == 0 && dy == 0)
+                        {
+                            continue;
+                        }
+
+                        const size_t tap = size_t(ptrdiff_t(center) + dy * rowStep + dx * step);
+                        const float tapLength = step * sqrtf(float(dx * dx + dy * dy));
+
+                        const XMVECTOR tapR = LoadPixels(input[0], tap);
+                        const XMVECTOR tapG = LoadPixels(input[1], tap);
+                        const XMVECTOR tapB = LoadPixels(input[2], tap);
+
+                        // cos^DENOISE_NORMAL_POWER by repeated squaring
+                        XMVECTOR normalWeight = XMVectorMultiply(centerNormalX, LoadPixels(m_normal[0], tap));
+                        normalWeight = XMVectorMultiplyAdd(centerNormalY, LoadPixels(m_normal[1], tap), normalWeight);
+                        normalWeight = XMVectorMultiplyAdd(centerNormalZ, LoadPixels(m_normal[2], tap), normalWeight);
+                        normalWeight = XMVectorMax(normalWeight, zero);
+                        for (UINT power = 1; power < DENOISE_NORMAL_POWER; power *= 2)
+                        {
+                            normalWeight = XMVectorMultiply(normalWeight, normalWeight);
+                        }
+
+                        XMVECTOR depthTerm = XMVectorAbs(XMVectorSubtract(centerDepth, LoadPixels(m_depth, tap)));
+                        depthTerm = XMVectorScale(XMVectorMultiply(depthTerm, depthScale), 1.0f / tapLength);
+
+                        XMVECTOR luminanceStep = XMVectorSubtract(centerLuminance,
+                            XMVectorMultiplyAdd(tapR, lumaR, XMVectorMultiplyAdd(tapG, lumaG, XMVectorMultiply(tapB, lumaB))));
+                        XMVECTOR luminanceTerm = XMVectorMultiply(XMVectorMultiply(luminanceStep, luminanceStep), luminanceScale);
+
+                        XMVECTOR weight = XMVectorExpE(XMVectorNegate(XMVectorAdd(depthTerm, luminanceTerm)));
+                        weight = XMVectorScale(XMVectorMultiply(weight, normalWeight), c_kernel[dy + 2] * c_kernel[dx + 2]);
+
+                        weightSum = XMVectorAdd(weightSum, weight);
+                        sumR = XMVectorMultiplyAdd(tapR, weight, sumR);
+                        sumG = XMVectorMultiplyAdd(tapG, weight, sumG);
+                        sumB = XMVectorMultiplyAdd(tapB, weight, sumB);
+                    }
+                }
+
+                const XMVECTOR invWeightSum = XMVectorReciprocal(weightSum);
+                StorePixels(output[0], center, XMVectorMultiply(sumR, invWeightSum));
+                StorePixels(output[1], center, XMVectorMultiply(sumG, invWeightSum));
+                StorePixels(output[2], center, XMVectorMultiply(sumB, invWeightSum));
+            }
+        }
+    }
+
+    //------------------------------------------------------
+    // Denoise
+    //------------------------------------------------------
+    void PMDenoiser::Denoise(const Input& input, UINT width, UINT height, UINT iterations, UINT8* output, UINT outputRowPitch)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        iterations = (std::min)((std::max)(iterations, 1u), UINT(DENOISE_MAX_ITERATIONS));
+        Resize(width, height, 1u << iterations);
+
+        // Unpack into planes and divide the albedo out
+        ForEachRowBlock([&](UINT rowBegin, UINT rowEnd)
+        {
+            for (UINT y = rowBegin; y < rowEnd; ++y)
+            {
+                const UINT8* color = Row(input.color, input.colorRowPitch, y);
+                const XMFLOAT2* depth = Row(input.depth, input.depthRowPitch, y);
+                const XMFLOAT4* normal = Row(input.normal, input.normalRowPitch, y);
+                const XMFLOAT4* albedo = Row(input.albedo, input.albedoRowPitch, y);
+
+                for (UINT x = 0; x < width; ++x)
+                {
+                    const size_t index = PlaneIndex(x, y);
+                    const float pixelAlbedo[3] = { albedo[x].x, albedo[x].y, albedo[x].z };
+                    for (UINT c = 0; c < 3; ++c)
+                    {
+                        m_albedo[c][index] = (std::max)(pixelAlbedo[c], DENOISE_MIN_ALBEDO);
+                        m_lighting[0][c][index] = color[4 * x + c] / (255.0f * m_albedo[c][index]);
+                    }
+
+                    m_depth[index] = depth[x].x;
+                    m_normal[0][index] = normal[x].x;
+                    m_normal[1][index] = normal[x].y;
+                    m_normal[2][index] = normal[x].z;
+                }
+            }
+        });
+
+        UINT source = 0;
+        for (UINT iteration = 0; iteration < iterations; ++iteration)
+        {
+            ForEachRowBlock([&](UINT rowBegin, UINT rowEnd) { FilterRows(iteration, source, rowBegin, rowEnd); });
+            source ^= 1;
+        }
+
+        // Multiply the albedo back in and pack
+        ForEachRowBlock([&](UINT rowBegin, UINT rowEnd)
+        {
+            for (UINT y = rowBegin; y < rowEnd; ++y)
+            {
+                UINT8* row = output + size_t(y) * outputRowPitch;
+                for (UINT x = 0; x < width; ++x)
+                {
+                    const size_t index = PlaneIndex(x, y);
+                    for (UINT c = 0; c < 3; ++c)
+                    {
+                        float value = (std::min)((std::max)(m_lighting[source][c][index] * m_albedo[c][index], 0.0f), 1.0f);
+                        row[4 * x + c] = static_cast<UINT8>(value * 255.0f + 0.5f);
+                    }
+                    row[4 * x + 3] = 255;
+                }
+            }
+        });
+
+        auto end = std::chrono::high_resolution_clock::now();
+        m_lastFilterMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "RaytracingHlslCompat.h"
+#include "PMWorkerPool.h"
+
+namespace DXRPhotonMapper
+{
+    // Edge avoiding a-trous wavelet denoiser (Dammertz et al. 2010) for the photon major output.
+    // Runs on the CPU over the read back render target, guided by the camera depth, normal and albedo of the depth pass.
+    // Every image is kept as one float plane per channel, framed by a border of pixels no tap can take weight from,
+    // so four neighbouring pixels are filtered at once in an XMVECTOR without any bounds checks.
+    class PMDenoiser
+    {
+
+    public:
+        // Read back images, row pitches are in bytes
+        struct Input
+        {
+            const UINT8* color;         // R8G8B8A8_UNORM
+            UINT colorRowPitch;
+            const XMFLOAT2* depth;      // distance to the camera, instance ID + 1
+            UINT depthRowPitch;
+            const XMFLOAT4* normal;     // xyz, zero where the camera ray missed
+            UINT normalRowPitch;
+            const XMFLOAT4* albedo;     // rgb
+            UINT albedoRowPitch;
+        };
+
+    private:
+        UINT m_width;
+        UINT m_height;
+        UINT m_border;
+        UINT m_stride;
+
+        // Lighting with the albedo divided out, ping ponged between iterations
+        std::vector<float> m_lighting[2][3];
+        std::vector<float> m_albedo[3];
+        std::vector<float> m_depth;
+        std::vector<float> m_normal[3];
+
+        float m_lastFilterMilliseconds;
+
+        // Every pass of every frame is split over the same threads
+        PMWorkerPool m_workerPool;
+
+        void Resize(UINT width, UINT height, UINT border);
+        size_t PlaneIndex(UINT x, UINT y) const { return size_t(y + m_border) * m_stride + x + m_border; }
+
+        // Splits the image rows over the worker pool
+        void ForEachRowBlock(const std::function<void(UINT, UINT)>& filterRows);
+
+        // One a-trous level from m_lighting[source] into the other lighting planes
+        void FilterRows(UINT iteration, UINT source, UINT rowBegin, UINT rowEnd);
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMDenoiser();
+
+        //------------------------------------------------------
+        // Denoise
+        // Filters width x height pixels with the given number of a-trous levels (clamped to DENOISE_MAX_ITERATIONS)
+        // and writes the result as R8G8B8A8_UNORM rows, outputRowPitch bytes apart
+        //------------------------------------------------------
+        void Denoise(const Input& input, UINT width, UINT height, UINT iterations, UINT8* output, UINT outputRowPitch);
+
+        float GetLastFilterMilliseconds() const { return m_lastFilterMilliseconds; }
+    };
+}
@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "PMFluxResolve.h"
+#include "PMSelfTest.h"
+
+#include <algorithm>
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        template <typename T>
+        inline const T* Row(const T* image, UINT rowPitch, UINT y)
+        {
+            return reinterpret_cast<const T*>(reinterpret_cast<const UINT8*>(image) + size_t(y) * rowPitch);
+        }
+
+        // CameraRayDirection in FluxAccumulation.hlsli
+        inline XMVECTOR CameraRayDirection(float x, float y, UINT width, UINT height, FXMMATRIX projectionToWorld, FXMVECTOR cameraPosition)
+        {
+            XMVECTOR ndc = XMVectorSet(x / width * 2.0f - 1.0f, -(y / height * 2.0f - 1.0f), 0.0f, 1.0f);
+            XMVECTOR world = XMVector4Transform(ndc, projectionToWorld);
+            world = XMVectorDivide(world, XMVectorSplatW(world));
+            return XMVector3Normalize(XMVectorSubtract(world, cameraPosition));
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMFluxResolve::PMFluxResolve() : m_width(0), m_height(0)
+    {
+    }
+
+    //------------------------------------------------------
+    // LoadFixedPoint
+    //------------------------------------------------------
+    float PMFluxResolve::LoadFixedPoint(UINT low, UINT high)
+    {
+        return high * (4294967296.0f / FLUX_FIXED_POINT_SCALE) + low / FLUX_FIXED_POINT_SCALE;
+    }
+
+    //------------------------------------------------------
+    // AddFixedPoint
+    //------------------------------------------------------
+    void PMFluxResolve::AddFixedPoint(UINT& low, UINT& high, float flux)
+    {
+        UINT value = static_cast<UINT>((std::min)((std::max)(flux, 0.0f), FLUX_MAX_PHOTON) * FLUX_FIXED_POINT_SCALE + 0.5f);
+        UINT previous = low;
+        low += value;
+        if (low < previous)
+        {
+            ++high;
+        }
+    }
+
+    //------------------------------------------------------
+    // PixelFootprintArea
+    //------------------------------------------------------
+    float PMFluxResolve::PixelFootprintArea(UINT x, UINT y, UINT width, UINT height, FXMMATRIX projectionToWorld, FXMVECTOR cameraPosition, float distance, const XMFLOAT3& normal)
+    {
+        XMVECTOR center = CameraRayDirection(x + 0.5f, y + 0.5f, width, height, projectionToWorld, cameraPosition);
+        XMVECTOR right = CameraRayDirection(x + 1.5f, y + 0.5f, width, height, projectionToWorld, cameraPosition);
+        XMVECTOR down = CameraRayDirection(x + 0.5f, y + 1.5f, width, height, projectionToWorld, cameraPosition);
+        float solidAngle = XMVectorGetX(XMVector3Length(XMVector3Cross(XMVectorSubtract(right, center), XMVectorSubtract(down, center))));
+
+        float cosTheta = (std::max)(fabsf(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), center))), DENSITY_MIN_COSINE);
+        return solidAngle * distance * distance / cosTheta;
+    }
+
+    //------------------------------------------------------
+    // DensityGatherWeight
+    //------------------------------------------------------
+    float PMFluxResolve::DensityGatherWeight(int offsetX, int offsetY, const XMFLOAT4& centerNormalDistance, float centerInstance, const XMFLOAT4& normalDistance, float instance)
+    {
+        if (instance != centerInstance)
+        {
+            return 0.0f;
+        }
+
+        const float offsetLengthSq = float(offsetX * offsetX + offsetY * offsetY);
+        float kernel = (std::max)(1.0f - offsetLengthSq / float((DENSITY_GATHER_RADIUS + 1) * (DENSITY_GATHER_RADIUS + 1)), 0.0f);
+        float depthStep = fabsf(normalDistance.w - centerNormalDistance.w) / (centerNormalDistance.w * DENSITY_GATHER_SIGMA_DEPTH * (std::max)(sqrtf(offsetLengthSq), 1.0f));
+        float cosNormal = centerNormalDistance.x * normalDistance.x + centerNormalDistance.y * normalDistance.y + centerNormalDistance.z * normalDistance.z;
+        float normalWeight = powf((std::min)((std::max)(cosNormal, 0.0f), 1.0f), float(DENSITY_GATHER_NORMAL_POWER));
+        return kernel * expf(-depthStep) * normalWeight;
+    }
+
+    //------------------------------------------------------
+    // Resolve
+    //------------------------------------------------------
+    void PMFluxResolve::Resolve(const Input& input, UINT width, UINT height, FXMMATRIX projectionToWorld, FXMVECTOR cameraPosition, float fluxToRadiance, int gatherRadius)
+    {
+        m_width = width;
+        m_height = height;
+
+        const size_t numPixels = size_t(width) * height;
+        m_radiance.assign(numPixels, XMFLOAT3(0.0f, 0.0f, 0.0f));
+        m_fluxArea.assign(numPixels, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+        m_normalDistance.assign(numPixels, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+        m_instance.assign(numPixels, 0.0f);
+
+        // Decode the staged flux and work out the footprints, as the gather pass does for its tile and apron
+        for (UINT y = 0; y < height; ++y)
+        {
+            const XMFLOAT2* depth = Row(input.depth, input.depthRowPitch, y);
+            const XMFLOAT4* normal = Row(input.normal, input.normalRowPitch, y);
+
+            for (UINT x = 0; x < width; ++x)
+            {
+                const size_t index = size_t(y) * width + x;
+                m_instance[index] = depth[x].y;
+                if (depth[x].y == 0.0f)
+                {
+                    continue;
+                }
+
+                float flux[3];
+                for (UINT c = 0; c < 3; ++c)
+                {
+                    flux[c] = LoadFixedPoint(Row(input.flux[c][0], input.fluxRowPitch, y)[x], Row(input.flux[c][1], input.fluxRowPitch, y)[x]);
+                }
+
+                XMFLOAT3 pixelNormal(normal[x].x, normal[x].y, normal[x].z);
+                float area = PixelFootprintArea(x, y, width, height, projectionToWorld, cameraPosition, depth[x].x, pixelNormal);
+                m_fluxArea[index] = XMFLOAT4(flux[0], flux[1], flux[2], area);
+                m_normalDistance[index] = XMFLOAT4(normal[x].x, normal[x].y, normal[x].z, depth[x].x);
+            }
+        }
+
+        for (int y = 0; y < int(height); ++y)
+        {
+            for (int x = 0; x < int(width); ++x)
+            {
+                const size_t center = size_t(y) * width + x;
+                if (m_instance[center] == 0.0f)
+                {
+                    continue;
+                }
+
+                float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (int dy = -gatherRadius; dy <= gatherRadius; ++dy)
+                {
+                    for (int dx = -gatherRadius; dx <= gatherRadius; ++dx)
+                    {
+                        if (x + dx < 0 || x + dx >= int(width) || y + dy < 0 || y + dy >= int(height))
+                        {
+                            continue;
+                        }
+
+                        const size_t tap = size_t(ptrdiff_t(center) + dy * ptrdiff_t(width) + dx);
+                        float weight = DensityGatherWeight(dx, dy, m_normalDistance[center], m_instance[center], m_normalDistance[tap], m_instance[tap]);
+                        sum[0] += weight * m_fluxArea[tap].x;
+                        sum[1] += weight * m_fluxArea[tap].y;
+                        sum[2] += weight * m_fluxArea[tap].z;
+                        sum[3] += weight * m_fluxArea[tap].w;
+                    }
+                }
+
+                float scale = fluxToRadiance / sum[3];
+                m_radiance[center] = XMFLOAT3(sum[0] * scale, sum[1] * scale, sum[2] * scale);
+            }
+        }
+    }
+
+    //------------------------------------------------------
+    // Compare
+    //------------------------------------------------------
+    UINT PMFluxResolve::Compare(const UINT8* image, UINT rowPitch, UINT tolerance, UINT& mismatchedPixels) const
+    {
+        UINT maxError = 0;
+        mismatchedPixels = 0;
+
+        for (UINT y = 0; y < m_height; ++y)
+        {
+            const UINT8* row = image + size_t(y) * rowPitch;
+            for (UINT x = 0; x < m_width; ++x)
+            {
+                const XMFLOAT3& radiance = m_radiance[size_t(y) * m_width + x];
+                const float expected[3] = { radiance.x, radiance.y, radiance.z };
+
+                UINT pixelError = 0;
+                for (UINT c = 0; c < 3; ++c)
+                {
+                    int quantized = static_cast<int>((std::min)((std::max)(expected[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+                    pixelError = (std::max)(pixelError, static_cast<UINT>(abs(quantized - row[4 * x + c])));
+                }
+
+                maxError = (std::max)(maxError, pixelError);
+                mismatchedPixels += (pixelError > tolerance) ? 1 : 0;
+            }
+        }
+
+        return maxError;
+    }
+
+    //------------------------------------------------------
+    // SelfTest
+    //------------------------------------------------------
+    bool PMFluxResolve::SelfTest()
+    {
+        SelfTestReport report(L"Flux resolve");
+
+        // Clamping and the carry into the high word are exact
+        {
+            UINT low = 0, high = 0;
+            AddFixedPoint(low, high, -3.0f);
+            report.Check(L"negative flux adds nothing", low == 0 && high == 0);
+
+            AddFixedPoint(low, high, 1.0e9f);
+            report.Check(L"flux clamps to FLUX_MAX_PHOTON", LoadFixedPoint(low, high) == FLUX_MAX_PHOTON);
+
+            AddFixedPoint(low, high, 1.0f);
+            report.Check(L"low word carries into the high word", low == 0 && high == 1 && LoadFixedPoint(low, high) == FLUX_MAX_PHOTON + 1.0f);
+        }
+
+        // Many photons summed far past the low word, against the same sum in double. Every add is off by at most
+        // half a step, and the float the sum is loaded into by at most one unit in its last place
+        {
+            const UINT numPhotons = 200000;
+            UINT low = 0, high = 0;
+            double expected = 0.0;
+            UINT seed = 1;
+            for (UINT i = 0; i < numPhotons; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                const float flux = float(seed >> 8) * (64.0f / 16777216.0f);
+                AddFixedPoint(low, high, flux);
+                expected += flux;
+            }
+
+            const double tolerance = numPhotons * 0.5 / FLUX_FIXED_POINT_SCALE + expected / 8388608.0;
+            const double error = fabs(double(LoadFixedPoint(low, high)) - expected);
+            report.Log() << L" " << numPhotons << L" photons, sum " << expected << L", error " << error << L", tolerance " << tolerance << std::endl;
+            report.Check(L"fixed point sum matches the float sum", high > 0 && error <= tolerance);
+        }
+
+        // A plane facing the camera whose pixels get flux in proportion to their footprints has the same radiance
+        // everywhere, whatever weights the gather gives its taps. Each pixel's flux arrives as several photons.
+        // One pixel sees nothing and has to stay black. Radiance has to match within 1e-4 of its value
+        {
+            const UINT width = 16, height = 12;
+            const UINT numPixels = width * height;
+            const UINT photonsPerPixel = 8;
+            const UINT holeX = 5, holeY = 7;
+            const float planeDistance = 5.0f;
+            const float fluxToRadiance = 0.01f;
+            const XMFLOAT3 expected(0.2f, 0.4f, 0.6f);
+
+            const XMVECTOR cameraPosition = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+            const XMMATRIX view = XMMatrixLookAtLH(cameraPosition, XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+            const XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), float(width) / height, 1.0f, 125.0f);
+            const XMMATRIX projectionToWorld = XMMatrixInverse(nullptr, view * proj);
+
+            std::vector<UINT> flux[3][2];
+            for (UINT c = 0; c < 3; ++c)
+            {
+                flux[c][0].assign(numPixels, 0);
+                flux[c][1].assign(numPixels, 0);
+            }
+            const std::vector<UINT> photonCount(numPixels, photonsPerPixel);
+            std::vector<XMFLOAT2> depth(numPixels, XMFLOAT2(0.0f, 0.0f));
+            const std::vector<XMFLOAT4> normal(numPixels, XMFLOAT4(0.0f, 0.0f, -1.0f, 0.0f));
+            const XMFLOAT3 planeNormal(0.0f, 0.0f, -1.0f);
+
+            for (UINT y = 0; y < height; ++y)
+            {
+                for (UINT x = 0; x < width; ++x)
+                {
+                    if (x == holeX && y == holeY)
+                    {
+                        continue;
+                    }
+
+                    const size_t index = size_t(y) * width + x;
+                    XMVECTOR direction = CameraRayDirection(x + 0.5f, y + 0.5f, width, height, projectionToWorld, cameraPosition);
+                    depth[index] = XMFLOAT2(planeDistance / XMVectorGetZ(direction), 1.0f);
+
+                    const float area = PixelFootprintArea(x, y, width, height, projectionToWorld, cameraPosition, depth[index].x, planeNormal);
+                    const float radiance[3] = { expected.x, expected.y, expected.z };
+                    for (UINT c = 0; c < 3; ++c)
+                    {
+                        const float photonFlux = radiance[c] * area / (fluxToRadiance * photonsPerPixel);
+                        for (UINT i = 0; i < photonsPerPixel; ++i)
+                        {
+                            AddFixedPoint(flux[c][0][index], flux[c][1][index], photonFlux);
+                        }
+                    }
+                }
+            }
+
+            Input input = {};
+            for (UINT c = 0; c < 3; ++c)
+            {
+                input.flux[c][0] = flux[c][0].data();
+                input.flux[c][1] = flux[c][1].data();
+            }
+            input.flux[3][0] = photonCount.data();
+            input.flux[3][1] = photonCount.data();
+            input.fluxRowPitch = width * sizeof(UINT);
+            input.depth = depth.data();
+            input.depthRowPitch = width * sizeof(XMFLOAT2);
+            input.normal = normal.data();
+            input.normalRowPitch = width * sizeof(XMFLOAT4);
+
+            const int gatherRadii[2] = { 0, DENSITY_GATHER_RADIUS };
+            for (int gatherRadius : gatherRadii)
+            {
+                PMFluxResolve resolve;
+                resolve.Resolve(input, width, height, projectionToWorld, cameraPosition, fluxToRadiance, gatherRadius);
+
+                float maxError = 0.0f;
+                bool holeBlack = true;
+                for (UINT y = 0; y < height; ++y)
+                {
+                    for (UINT x = 0; x < width; ++x)
+                    {
+                        const XMFLOAT3& radiance = resolve.GetRadiance()[size_t(y) * width + x];
+                        if (x == holeX && y == holeY)
+                        {
+                            holeBlack = radiance.x == 0.0f && radiance.y == 0.0f && radiance.z == 0.0f;
+                            continue;
+                        }
+                        maxError = (std::max)(maxError, fabsf(radiance.x - expected.x) / expected.x);
+                        maxError = (std::max)(maxError, fabsf(radiance.y - expected.y) / expected.y);
+                        maxError = (std::max)(maxError, fabsf(radiance.z - expected.z) / expected.z);
+                    }
+                }
+
+                report.Log() << L" Gather radius " << gatherRadius << L", largest relative radiance error " << maxError << std::endl;
+                report.Check(gatherRadius == 0 ? L"per pixel resolve matches the float radiance" : L"density gather matches the float radiance", maxError <= 1e-4f);
+                report.Check(L"pixel without a surface stays black", holeBlack);
+            }
+        }
+
+        return report.Finish();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include "RaytracingHlslCompat.h"
+
+namespace DXRPhotonMapper
+{
+    // CPU reference of the photon major density resolve in FluxAccumulation.hlsli.
+    // Resolves read back staging buffers the same way the third pass, or the density gather pass, does,
+    // so the GPU output can be checked against it.
+    class PMFluxResolve
+    {
+
+    public:
+        // Read back images, row pitches are in bytes
+        struct Input
+        {
+            const UINT* flux[4][2];     // low and high words of R, G, B and the photon count
+            UINT fluxRowPitch;          // all staging buffers share one layout
+            const XMFLOAT2* depth;      // distance to the camera, instance ID + 1
+            UINT depthRowPitch;
+            const XMFLOAT4* normal;
+            UINT normalRowPitch;
+        };
+
+    private:
+        UINT m_width;
+        UINT m_height;
+        std::vector<XMFLOAT3> m_radiance;
+
+        // Staged flux and footprint area, normal and distance of every pixel
+        std::vector<XMFLOAT4> m_fluxArea;
+        std::vector<XMFLOAT4> m_normalDistance;
+        std::vector<float> m_instance;
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMFluxResolve();
+
+        //------------------------------------------------------
+        // LoadFixedPoint
+        // Value of a 64 bit fixed point sum, FLUX_FIXED_POINT_SCALE steps per unit
+        //------------------------------------------------------
+        static float LoadFixedPoint(UINT low, UINT high);
+
+        //------------------------------------------------------
+        // AddFixedPoint
+        // Same quantization and carry as AtomicAddFixedPoint
+        //------------------------------------------------------
+        static void AddFixedPoint(UINT& low, UINT& high, float flux);
+
+        //------------------------------------------------------
+        // PixelFootprintArea
+        // Surface area pixel (x, y) sees at the given distance, tilted by the surface normal
+        //------------------------------------------------------
+        static float PixelFootprintArea(UINT x, UINT y, UINT width, UINT height, FXMMATRIX projectionToWorld, FXMVECTOR cameraPosition, float distance, const XMFLOAT3& normal);
+
+        //------------------------------------------------------
+        // DensityGatherWeight
+        // Same weight as DensityGatherWeight in FluxAccumulation.hlsli
+        //------------------------------------------------------
+        static float DensityGatherWeight(int offsetX, int offsetY, const XMFLOAT4& centerNormalDistance, float centerInstance, const XMFLOAT4& normalDistance, float instance);
+
+        //------------------------------------------------------
+        // Resolve
+        // Radiance of every pixel, black where the camera sees nothing. A gather radius of 0 is the third pass's
+        // per pixel resolve, DENSITY_GATHER_RADIUS the density gather pass
+        //------------------------------------------------------
+        void Resolve(const Input& input, UINT width, UINT height, FXMMATRIX projectionToWorld, FXMVECTOR cameraPosition, float fluxToRadiance, int gatherRadius);
+
+        //------------------------------------------------------
+        // Compare
+        // Largest difference to an R8G8B8A8_UNORM image in 8 bit steps, and how many pixels are off by more than tolerance
+        //------------------------------------------------------
+        UINT Compare(const UINT8* image, UINT rowPitch, UINT tolerance, UINT& mismatchedPixels) const;
+
+        const std::vector<XMFLOAT3>& GetRadiance() const { return m_radiance; }
+
+        //------------------------------------------------------
+        // SelfTest
+        // Resolves fixed point sums of known inputs and checks them against float references, see the tolerances
+        // in the definition. Returns whether all of them passed, see RunSelfTests
+        //------------------------------------------------------
+        static bool SelfTest();
+    };
+}
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "PMImportanceMap.h"
+
+namespace DXRPhotonMapper
+{
+    //------------------------------------------------------
+    // Constructor
+    // Starts out uniform, so emission is unchanged until importons have been traced
+    //------------------------------------------------------
+    PMImportanceMap::PMImportanceMap() : m_emissionCDF(PROJECTION_MAP_NUM_CELLS), m_totalImportons(0), m_visibleCells(0), m_uniformPdf(1.0f / PROJECTION_MAP_NUM_CELLS)
+    {
+        for (UINT i = 0; i < PROJECTION_MAP_NUM_CELLS; ++i)
+        {
+            m_emissionCDF[i] = XMFLOAT2(static_cast<float>(i + 1) / PROJECTION_MAP_NUM_CELLS, m_uniformPdf);
+        }
+    }
+
+    //------------------------------------------------------
+    // Build
+    //------------------------------------------------------
+    void PMImportanceMap::Build(const UINT* importonCounts, UINT rowPitch, float uniformMix)
+    {
+        m_totalImportons = 0;
+        m_visibleCells = 0;
+
+        for (UINT phiIndex = 0; phiIndex < PROJECTION_MAP_PHI_RES; ++phiIndex)
+        {
+            const UINT* row = importonCounts + phiIndex * rowPitch;
+            for (UINT thetaIndex = 0; thetaIndex < PROJECTION_MAP_THETA_RES; ++thetaIndex)
+            {
+                m_totalImportons += row[thetaIndex];
+                m_visibleCells += (row[thetaIndex] > 0) ? 1 : 0;
+            }
+        }
+
+        // Nothing seen by the camera, fall back to uniform emission
+        const double mix = (m_totalImportons > 0) ? uniformMix : 1.0;
+        const double uniformPdf = mix / PROJECTION_MAP_NUM_CELLS;
+        m_uniformPdf = static_cast<float>(uniformPdf);
+        const double importanceScale = (m_totalImportons > 0) ? (1.0 - mix) / m_totalImportons : 0.0;
+
+        double cdf = 0.0;
+        for (UINT phiIndex = 0; phiIndex < PROJECTION_MAP_PHI_RES; ++phiIndex)
+        {
+            const UINT* row = importonCounts + phiIndex * rowPitch;
+            for (UINT thetaIndex = 0; thetaIndex < PROJECTION_MAP_THETA_RES; ++thetaIndex)
+            {
+                double pdf = uniformPdf + importanceScale * row[thetaIndex];
+                cdf += pdf;
+                m_emissionCDF[phiIndex * PROJECTION_MAP_THETA_RES + thetaIndex] = XMFLOAT2(static_cast<float>(cdf), static_cast<float>(pdf));
+            }
+        }
+
+        // Guard the search in the shader against the sum drifting below 1
+        m_emissionCDF[PROJECTION_MAP_NUM_CELLS - 1].x = 1.0f;
+    }
+
+    //------------------------------------------------------
+    // GetSteeredShare
+    //------------------------------------------------------
+    float PMImportanceMap::GetSteeredShare() const
+    {
+        // Cells the camera sees get more than the uniform share of the pdf
+        float share = 0.0f;
+        for (const XMFLOAT2& cell : m_emissionCDF)
+        {
+            if (cell.y > m_uniformPdf)
+            {
+                share += cell.y;
+            }
+        }
+        return share;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "RaytracingHlslCompat.h"
+
+namespace DXRPhotonMapper
+{
+    // Visual importance around a light.
+    // Importons traced from the camera are binned into the same angular cells as the projection map,
+    // and the counts are turned into an emission distribution over those cells.
+    // A fixed share of the distribution stays uniform, so every direction keeps a non zero pdf
+    // and weighting each photon by uniformPdf / cellPdf keeps the photon map unbiased.
+    class PMImportanceMap
+    {
+
+    private:
+        // x is the cdf up to and including the cell, y is the pdf of picking the cell
+        std::vector<XMFLOAT2> m_emissionCDF;
+        UINT64 m_totalImportons;
+        UINT m_visibleCells;
+        float m_uniformPdf;
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMImportanceMap();
+
+        //------------------------------------------------------
+        // Build
+        // importonCounts is a PROJECTION_MAP_THETA_RES x PROJECTION_MAP_PHI_RES grid, rows are rowPitch UINTs apart
+        //------------------------------------------------------
+        void Build(const UINT* importonCounts, UINT rowPitch, float uniformMix);
+
+        //------------------------------------------------------
+        // GetEmissionCDF
+        // One entry per cell, in flat cell order (phiIndex * PROJECTION_MAP_THETA_RES + thetaIndex)
+        //------------------------------------------------------
+        const std::vector<XMFLOAT2>& GetEmissionCDF() const { return m_emissionCDF; }
+
+        UINT64 GetTotalImportons() const { return m_totalImportons; }
+        UINT GetVisibleCells() const { return m_visibleCells; }
+
+        //------------------------------------------------------
+        // GetSteeredShare
+        // Expected fraction of the photons that leave through cells the camera sees
+        //------------------------------------------------------
+        float GetSteeredShare() const;
+    };
+}
@@ -0,0 +1,669 @@
+#include "stdafx.h"
+#include "PMJSONReader.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        inline bool IsDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        inline int HexValue(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        void AppendUTF8(std::string& out, UINT codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                out += static_cast<char>(codePoint);
+            }
+            else if (codePoint < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (codePoint >> 6));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (codePoint >> 12));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (codePoint >> 18));
+                out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        // 10^exponent without pow, exact up to 10^22
+        double PowerOfTen(int exponent)
+        {
+            static const double exact[] =
+            {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            const int numExact = sizeof(exact) / sizeof(exact[0]);
+
+            int magnitude = (exponent < 0) ? -exponent : exponent;
+            double power = (magnitude < numExact) ? exact[magnitude] : std::pow(10.0, magnitude);
+            return (exponent < 0) ? 1.0 / power : power;
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMJSONReader::PMJSONReader(const char* begin, const char* end) :
+        m_begin(begin),
+        m_end(end),
+        m_cursor(begin),
+        m_depth(0),
+        m_key(begin),
+        m_keyLength(0),
+        m_errorPosition(nullptr)
+    {
+        // UTF-8 byte order mark, as the editors on Windows like to write it
+        if (end - begin >= 3 && begin[0] == '\xEF' && begin[1] == '\xBB' && begin[2] == '\xBF')
+        {
+            m_cursor += 3;
+        }
+    }
+
+    //------------------------------------------------------
+    // SkipWhitespace
+    //------------------------------------------------------
+    void PMJSONReader::SkipWhitespace()
+    {
+        while (m_cursor < m_end && (*m_cursor == ' ' || *m_cursor == '\n' || *m_cursor == '\r' || *m_cursor == '\t'))
+        {
+            ++m_cursor;
+        }
+    }
+
+    //------------------------------------------------------
+    // Fail
+    //------------------------------------------------------
+    bool PMJSONReader::Fail(const char* message)
+    {
+        if (HasError())
+        {
+            return false;
+        }
+
+        // Line and column are only worked out here, so reading does not have to count newlines
+        m_errorPosition = m_cursor;
+        UINT line = 1;
+        UINT column = 1;
+        for (const char* c = m_begin; c < m_errorPosition; ++c)
+        {
+            if (*c == '\n')
+            {
+                ++line;
+                column = 1;
+            }
+            else
+            {
+                ++column;
+            }
+        }
+
+        m_error = "line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message;
+
+        // Stop everything that comes after
+        m_cursor = m_end;
+        m_depth = 0;
+        return false;
+    }
+
+    //------------------------------------------------------
+    // SetError
+    //------------------------------------------------------
+    bool PMJSONReader::SetError(const std::string& message)
+    {
+        return Fail(message.c_str());
+    }
+
+    //------------------------------------------------------
+    // Expect
+    //------------------------------------------------------
+    bool PMJSONReader::Expect(char c, const char* message)
+    {
+        SkipWhitespace();
+        if (m_cursor >= m_end || *m_cursor != c)
+        {
+            return Fail(message);
+        }
+        ++m_cursor;
+        return true;
+    }
+
+    //------------------------------------------------------
+    // ReadLiteral
+    //------------------------------------------------------
+    bool PMJSONReader::ReadLiteral(const char* literal, size_t length)
+    {
+        if (size_t(m_end - m_cursor) < length || memcmp(m_cursor, literal, length) != 0)
+        {
+            return Fail("invalid literal");
+        }
+        m_cursor += length;
+        return true;
+    }
+
+    //------------------------------------------------------
+    // ReadStringContents
+    //------------------------------------------------------
+    bool PMJSONReader::ReadStringContents(std::string& scratch, const char*& begin, size_t& length)
+    {
+        if (!Expect('"', "expected a string"))
+        {
+            return false;
+        }
+
+        // Fast path, nothing to decode
+        const char* start = m_cursor;
+        while (m_cursor < m_end && *m_cursor != '"' && *m_cursor != '\\')
+        {
+            if (static_cast<unsigned char>(*m_cursor) < 0x20)
+            {
+                return Fail("control character in string");
+            }
+            ++m_cursor;
+        }
+        if (m_cursor >= m_end)
+        {
+            return Fail("unterminated string");
+        }
+        if (*m_cursor == '"')
+        {
+            begin = start;
+            length = size_t(m_cursor - start);
+            ++m_cursor;
+            return true;
+        }
+
+        // Escapes, decode into scratch
+        scratch.assign(start, m_cursor);
+        while (m_cursor < m_end && *m_cursor != '"')
+        {
+            char c = *m_cursor;
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                return Fail("control character in string");
+            }
+            if (c != '\\')
+            {
+                scratch += c;
+                ++m_cursor;
+                continue;
+            }
+
+            if (m_end - m_cursor < 2)
+            {
+                return Fail("unterminated string");
+            }
+            char escape = m_cursor[1];
+            m_cursor += 2;
+            switch (escape)
+            {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u':
+            {
+                UINT codePoint = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    int digit = (m_cursor < m_end) ? HexValue(*m_cursor) : -1;
+                    if (digit < 0)
+                    {
+                        return Fail("invalid \\u escape");
+                    }
+                    codePoint = (codePoint << 4) | UINT(digit);
+                    ++m_cursor;
+                }
+
+                // Surrogate pair
+                if (codePoint >= 0xD800 && codePoint < 0xDC00)
+                {
+                    UINT low = 0;
+                    if (m_end - m_cursor < 6 || m_cursor[0] != '\\' || m_cursor[1] != 'u')
+                    {
+                        return Fail("unpaired surrogate in \\u escape");
+                    }
+                    m_cursor += 2;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int digit = HexValue(*m_cursor);
+                        if (digit < 0)
+                        {
+                            return Fail("invalid \\u escape");
+                        }
+                        low = (low << 4) | UINT(digit);
+                        ++m_cursor;
+                    }
+                    if (low < 0xDC00 || low >= 0xE000)
+                    {
+                        return Fail("unpaired surrogate in \\u escape");
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (codePoint >= 0xDC00 && codePoint < 0xE000)
+                {
+                    return Fail("unpaired surrogate in \\u escape");
+                }
+                AppendUTF8(scratch, codePoint);
+                break;
+            }
+            default:
+                m_cursor -= 1;
+                return Fail("invalid escape in string");
+            }
+        }
+        if (m_cursor >= m_end)
+        {
+            return Fail("unterminated string");
+        }
+
+        ++m_cursor;
+        begin = scratch.data();
+        length = scratch.size();
+        return true;
+    }
+
+    //------------------------------------------------------
+    // NextInContainer
+    //------------------------------------------------------
+    bool PMJSONReader::NextInContainer(char close)
+    {
+        if (HasError() || m_depth == 0)
+        {
+            return false;
+        }
+
+        SkipWhitespace();
+        if (m_cursor < m_end && *m_cursor == close)
+        {
+            ++m_cursor;
+            --m_depth;
+            return false;
+        }
+
+        if (m_first[m_depth - 1])
+        {
+            m_first[m_depth - 1] = false;
+            return true;
+        }
+
+        return Expect(',', (close == '}') ? "expected ',' or '}'" : "expected ',' or ']'");
+    }
+
+    //------------------------------------------------------
+    // BeginObject
+    //------------------------------------------------------
+    bool PMJSONReader::BeginObject()
+    {
+        if (!Expect('{', "expected an object"))
+        {
+            return false;
+        }
+        if (m_depth == MaxDepth)
+        {
+            return Fail("nested too deeply");
+        }
+        m_first[m_depth++] = true;
+        return true;
+    }
+
+    //------------------------------------------------------
+    // NextMember
+    //------------------------------------------------------
+    bool PMJSONReader::NextMember()
+    {
+        if (!NextInContainer('}'))
+        {
+            return false;
+        }
+        if (!ReadStringContents(m_keyScratch, m_key, m_keyLength))
+        {
+            return false;
+        }
+        return Expect(':', "expected ':' after key");
+    }
+
+    //------------------------------------------------------
+    // BeginArray
+    //------------------------------------------------------
+    bool PMJSONReader::BeginArray()
+    {
+        if (!Expect('[', "expected an array"))
+        {
+            return false;
+        }
+        if (m_depth == MaxDepth)
+        {
+            return Fail("nested too deeply");
+        }
+        m_first[m_depth++] = true;
+        return true;
+    }
+
+    //------------------------------------------------------
+    // NextElement
+    //------------------------------------------------------
+    bool PMJSONReader::NextElement()
+    {
+        return NextInContainer(']');
+    }
+
+    //------------------------------------------------------
+    // KeyIs
+    //------------------------------------------------------
+    bool PMJSONReader::KeyIs(const char* key) const
+    {
+        return strncmp(m_key, key, m_keyLength) == 0 && key[m_keyLength] == '\0';
+    }
+
+    //------------------------------------------------------
+    // PeekValueType
+    //------------------------------------------------------
+    PMJSONReader::ValueType PMJSONReader::PeekValueType()
+    {
+        SkipWhitespace();
+        if (m_cursor >= m_end)
+        {
+            return ValueType::Invalid;
+        }
+
+        switch (*m_cursor)
+        {
+        case '{': return ValueType::Object;
+        case '[': return ValueType::Array;
+        case '"': return ValueType::String;
+        case 't':
+        case 'f': return ValueType::Boolean;
+        case 'n': return ValueType::Null;
+        default:
+            return (*m_cursor == '-' || IsDigit(*m_cursor)) ? ValueType::Number : ValueType::Invalid;
+        }
+    }
+
+    //------------------------------------------------------
+    // ReadNumber
+    //------------------------------------------------------
+    bool PMJSONReader::ReadNumber(double& value)
+    {
+        SkipWhitespace();
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        const char* c = m_cursor;
+        bool negative = false;
+        if (c < m_end && *c == '-')
+        {
+            negative = true;
+            ++c;
+        }
+        if (c >= m_end || !IsDigit(*c))
+        {
+            return Fail("expected a number");
+        }
+
+        // The first 19 significant digits are exact in 64 bits, the rest only move the exponent
+        UINT64 mantissa = 0;
+        int significantDigits = 0;
+        int exponent = 0;
+
+        if (*c == '0')
+        {
+            ++c;
+        }
+        else
+        {
+            for (; c < m_end && IsDigit(*c); ++c)
+            {
+                if (significantDigits < 19)
+                {
+                    mantissa = mantissa * 10 + UINT64(*c - '0');
+                    ++significantDigits;
+                }
+                else
+                {
+                    ++exponent;
+                }
+            }
+        }
+
+        if (c < m_end && *c == '.')
+        {
+            ++c;
+            if (c >= m_end || !IsDigit(*c))
+            {
+                m_cursor = c;
+                return Fail("expected a digit after the decimal point");
+            }
+            for (; c < m_end && IsDigit(*c); ++c)
+            {
+                if (significantDigits < 19)
+                {
+                    if (mantissa != 0 || *c != '0')
+                    {
+                        ++significantDigits;
+                    }
+                    mantissa = mantissa * 10 + UINT64(*c - '0');
+                    --exponent;
+                }
+            }
+        }
+
+        if (c < m_end && (*c == 'e' || *c == 'E'))
+        {
+            ++c;
+            bool negativeExponent = false;
+            if (c < m_end && (*c == '+' || *c == '-'))
+            {
+                negativeExponent = (*c == '-');
+                ++c;
+            }
+            if (c >= m_end || !IsDigit(*c))
+            {
+                m_cursor = c;
+                return Fail("expected a digit in the exponent");
+            }
+            int explicitExponent = 0;
+            for (; c < m_end && IsDigit(*c); ++c)
+            {
+                if (explicitExponent < 100000)
+                {
+                    explicitExponent = explicitExponent * 10 + (*c - '0');
+                }
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        }
+
+        m_cursor = c;
+        value = (mantissa == 0) ? 0.0 : double(mantissa) * PowerOfTen(exponent);
+        if (negative)
+        {
+            value = -value;
+        }
+        return true;
+    }
+
+    bool PMJSONReader::ReadNumber(float& value)
+    {
+        double number = 0.0;
+        if (!ReadNumber(number))
+        {
+            return false;
+        }
+        value = static_cast<float>(number);
+        return true;
+    }
+
+    //------------------------------------------------------
+    // ReadString
+    //------------------------------------------------------
+    bool PMJSONReader::ReadString(std::string& value)
+    {
+        const char* begin = nullptr;
+        size_t length = 0;
+        if (!ReadStringContents(value, begin, length))
+        {
+            return false;
+        }
+
+        // Escaped strings are decoded into value already
+        if (begin != value.data())
+        {
+            value.assign(begin, length);
+        }
+        return true;
+    }
+
+    //------------------------------------------------------
+    // ReadBoolean
+    //------------------------------------------------------
+    bool PMJSONReader::ReadBoolean(bool& value)
+    {
+        SkipWhitespace();
+        if (m_cursor < m_end && *m_cursor == 't')
+        {
+            value = true;
+            return ReadLiteral("true", 4);
+        }
+        if (m_cursor < m_end && *m_cursor == 'f')
+        {
+            value = false;
+            return ReadLiteral("false", 5);
+        }
+        return Fail("expected true or false");
+    }
+
+    //------------------------------------------------------
+    // ReadFloat3
+    //------------------------------------------------------
+    bool PMJSONReader::ReadFloat3(XMFLOAT3& value)
+    {
+        float* components[3] = { &value.x, &value.y, &value.z };
+
+        if (!BeginArray())
+        {
+            return false;
+        }
+        for (UINT i = 0; i < 3; ++i)
+        {
+            if (!NextElement())
+            {
+                return HasError() ? false : Fail("expected 3 numbers");
+            }
+            if (!ReadNumber(*components[i]))
+            {
+                return false;
+            }
+        }
+        if (NextElement())
+        {
+            return Fail("expected 3 numbers");
+        }
+        return !HasError();
+    }
+
+    //------------------------------------------------------
+    // SkipValue
+    //------------------------------------------------------
+    bool PMJSONReader::SkipValue()
+    {
+        switch (PeekValueType())
+        {
+        case ValueType::Object:
+            if (!BeginObject())
+            {
+                return false;
+            }
+            while (NextMember())
+            {
+                if (!SkipValue())
+                {
+                    return false;
+                }
+            }
+            return !HasError();
+
+        case ValueType::Array:
+            if (!BeginArray())
+            {
+                return false;
+            }
+            while (NextElement())
+            {
+                if (!SkipValue())
+                {
+                    return false;
+                }
+            }
+            return !HasError();
+
+        case ValueType::String:
+        {
+            // Only strings with escapes need the scratch, and it must not be the current key's
+            std::string scratch;
+            const char* begin = nullptr;
+            size_t length = 0;
+            return ReadStringContents(scratch, begin, length);
+        }
+
+        case ValueType::Number:
+        {
+            double number = 0.0;
+            return ReadNumber(number);
+        }
+
+        case ValueType::Boolean:
+        {
+            bool boolean = false;
+            return ReadBoolean(boolean);
+        }
+
+        case ValueType::Null:
+            return ReadLiteral("null", 4);
+
+        default:
+            return Fail("expected a value");
+        }
+    }
+
+    //------------------------------------------------------
+    // ExpectEnd
+    //------------------------------------------------------
+    bool PMJSONReader::ExpectEnd()
+    {
+        if (HasError())
+        {
+            return false;
+        }
+        SkipWhitespace();
+        if (m_cursor != m_end)
+        {
+            return Fail("unexpected data after the document");
+        }
+        return true;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+
+#include "RaytracingHlslCompat.h"
+
+namespace DXRPhotonMapper
+{
+    // Streaming pull reader over a JSON text in memory.
+    // Values are read in document order straight into the caller's variables, nothing is built on the side:
+    // keys without escapes point into the input, and strings are assigned into the caller's std::string.
+    // The first error stops the reader, every later call fails, and GetError reports it with its line and column.
+    class PMJSONReader
+    {
+    public:
+        enum class ValueType
+        {
+            Object,
+            Array,
+            String,
+            Number,
+            Boolean,
+            Null,
+            Invalid
+        };
+
+    private:
+        static const UINT MaxDepth = 64;
+
+        const char* m_begin;
+        const char* m_end;
+        const char* m_cursor;
+
+        // Whether the object or array at each nesting level is still before its first member
+        bool m_first[MaxDepth];
+        UINT m_depth;
+
+        // Key of the current member, decoded into m_keyScratch only when it has escapes
+        const char* m_key;
+        size_t m_keyLength;
+        std::string m_keyScratch;
+
+        const char* m_errorPosition;
+        std::string m_error;
+
+        void SkipWhitespace();
+        bool Fail(const char* message);
+        bool Expect(char c, const char* message);
+        bool ReadLiteral(const char* literal, size_t length);
+
+        // Reads a string's contents, pointing straight into the input when there is nothing to decode
+        bool ReadStringContents(std::string& scratch, const char*& begin, size_t& length);
+
+        // Separator before the next member or element, false at the closing bracket
+        bool NextInContainer(char close);
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMJSONReader(const char* begin, const char* end);
+
+        //------------------------------------------------------
+        // Structure
+        // BeginObject / BeginArray consume the opening bracket. NextMember / NextElement move to the next entry
+        // and return false once the closing bracket is consumed, or on an error.
+        //------------------------------------------------------
+        bool BeginObject();
+        bool NextMember();
+        bool BeginArray();
+        bool NextElement();
+
+        //------------------------------------------------------
+        // Current member key
+        //------------------------------------------------------
+        bool KeyIs(const char* key) const;
+        std::string GetKey() const { return std::string(m_key, m_keyLength); }
+
+        //------------------------------------------------------
+        // Values
+        //------------------------------------------------------
+        ValueType PeekValueType();
+        bool ReadNumber(double& value);
+        bool ReadNumber(float& value);
+        bool ReadString(std::string& value);
+        bool ReadBoolean(bool& value);
+
+        // A [x, y, z] array
+        bool ReadFloat3(DirectX::XMFLOAT3& value);
+
+        // Skips the next value, however deeply nested
+        bool SkipValue();
+
+        // Only whitespace may follow the document
+        bool ExpectEnd();
+
+        //------------------------------------------------------
+        // Errors
+        //------------------------------------------------------
+        bool HasError() const { return !m_error.empty(); }
+        const std::string& GetError() const { return m_error; }
+
+        // Reports a problem with a value the reader parsed fine, at the current position
+        bool SetError(const std::string& message);
+    };
+}
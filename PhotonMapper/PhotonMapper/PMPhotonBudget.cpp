@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "PMPhotonBudget.h"
+
+#include <algorithm>
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        inline float Smooth(float average, float sample)
+        {
+            return (average > 0.0f) ? average + PHOTON_BUDGET_SMOOTHING * (sample - average) : sample;
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMPhotonBudget::PMPhotonBudget() :
+        m_enabled(true),
+        m_maxRows(0),
+        m_minRows(0),
+        m_rows(0),
+        m_targetMilliseconds(PHOTON_BUDGET_TARGET_MS),
+        m_emissionRowMilliseconds(0.0f),
+        m_splatRowMilliseconds(0.0f),
+        m_lastTiming()
+    {
+    }
+
+    //------------------------------------------------------
+    // Reset
+    //------------------------------------------------------
+    void PMPhotonBudget::Reset(UINT maxRows, UINT minRows)
+    {
+        m_maxRows = maxRows;
+        m_minRows = (std::min)(minRows, maxRows);
+        m_rows = maxRows;
+        m_emissionRowMilliseconds = 0.0f;
+        m_splatRowMilliseconds = 0.0f;
+        m_lastTiming = FrameTiming();
+    }
+
+    //------------------------------------------------------
+    // Update
+    //------------------------------------------------------
+    void PMPhotonBudget::Update(const FrameTiming& timing, bool tracesNextFrame)
+    {
+        m_lastTiming = timing;
+
+        if (timing.tracedRows > 0)
+        {
+            m_emissionRowMilliseconds = Smooth(m_emissionRowMilliseconds, timing.passMilliseconds[PassEmission] / timing.tracedRows);
+        }
+        if (timing.splattedRows > 0)
+        {
+            m_splatRowMilliseconds = Smooth(m_splatRowMilliseconds, timing.passMilliseconds[PassSplat] / timing.splattedRows);
+        }
+
+        if (!m_enabled)
+        {
+            return;
+        }
+
+        // Everything that does not scale with the photons is taken from this frame as is, so a spike is answered right away
+        float scaledMilliseconds = timing.passMilliseconds[PassSplat] + (timing.tracedRows > 0 ? timing.passMilliseconds[PassEmission] : 0.0f);
+        float fixedMilliseconds = (std::max)(timing.frameMilliseconds - scaledMilliseconds, 0.0f);
+        float availableMilliseconds = m_targetMilliseconds * PHOTON_BUDGET_HEADROOM - fixedMilliseconds;
+
+        float rowMilliseconds = m_splatRowMilliseconds + (tracesNextFrame ? m_emissionRowMilliseconds : 0.0f);
+        float affordableRows = (rowMilliseconds > 0.0f) ? (std::max)(availableMilliseconds, 0.0f) / rowMilliseconds : float(m_maxRows);
+
+        // Cut to what fits at once, grow back a few percent per frame
+        float rows = (std::min)(affordableRows, m_rows * PHOTON_BUDGET_GROWTH + 1.0f);
+        m_rows = (std::min)((std::max)(static_cast<UINT>(rows), m_minRows), m_maxRows);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "RaytracingHlslCompat.h"
+
+namespace DXRPhotonMapper
+{
+    // Picks how many rows of the photon G buffer are traced and splatted each frame, so the GPU frame time stays
+    // under a fixed target. The cost of a row is learnt from the GPU timestamps of earlier frames, the rest of
+    // the frame is taken as fixed. Over the target the rows are cut at once, under it they only grow back slowly.
+    class PMPhotonBudget
+    {
+
+    public:
+        enum Pass
+        {
+            PassEmission = 0,
+            PassSplat,
+            PassResolve,
+            NumPasses
+        };
+
+        // GPU times of one frame and the photon rows it worked on
+        struct FrameTiming
+        {
+            float passMilliseconds[NumPasses];
+            float frameMilliseconds;
+            UINT tracedRows;        // 0 when the frame did not trace photons
+            UINT splattedRows;
+        };
+
+    private:
+        bool m_enabled;
+        UINT m_maxRows;
+        UINT m_minRows;
+        UINT m_rows;
+        float m_targetMilliseconds;
+
+        // Smoothed GPU milliseconds per photon row
+        float m_emissionRowMilliseconds;
+        float m_splatRowMilliseconds;
+
+        FrameTiming m_lastTiming;
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMPhotonBudget();
+
+        //------------------------------------------------------
+        // Reset
+        // Starts over at the full photon buffer, whenever the buffer is recreated
+        //------------------------------------------------------
+        void Reset(UINT maxRows, UINT minRows);
+
+        //------------------------------------------------------
+        // Update
+        // Learns from the timing of a finished frame and picks the rows for the next one,
+        // which only pays for emission when it traces new photons
+        //------------------------------------------------------
+        void Update(const FrameTiming& timing, bool tracesNextFrame);
+
+        void SetEnabled(bool enabled) { m_enabled = enabled; }
+        bool IsEnabled() const { return m_enabled; }
+        void SetTargetMilliseconds(float targetMilliseconds) { m_targetMilliseconds = targetMilliseconds; }
+
+        UINT GetRows() const { return m_enabled ? m_rows : m_maxRows; }
+        const FrameTiming& GetLastTiming() const { return m_lastTiming; }
+    };
+}
@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "PMProjectionMap.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace DXRPhotonMapper
+{
+    static const float PM_PI = 3.14159265358979f;
+    static const float PM_TWO_PI = 6.28318530717958f;
+
+    //------------------------------------------------------
+    // Direction at the given sample point, same mapping as SquareToSphereUniform in the shaders
+    //------------------------------------------------------
+    static XMVECTOR SampleToDirection(float theta, float phi)
+    {
+        return XMVectorSet(cos(theta) * sin(phi), cos(phi), sin(theta) * sin(phi), 0.0f);
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMProjectionMap::PMProjectionMap() : m_cells(PROJECTION_MAP_NUM_CELLS, false)
+    {
+    }
+
+    //------------------------------------------------------
+    // IsSpecularPrimitive
+    //------------------------------------------------------
+    bool PMProjectionMap::IsSpecularPrimitive(const PMScene& scene, const Primitive& primitive) const
+    {
+        if (primitive.m_materialID < 0 || primitive.m_materialID >= static_cast<int>(scene.m_materials.size()))
+        {
+            return false;
+        }
+        return HasMaterialFlag(scene.m_materials[primitive.m_materialID].m_materialFlags, MaterialFlag::BSDF_SPECULAR);
+    }
+
+    //------------------------------------------------------
+    // Build
+    //------------------------------------------------------
+    void PMProjectionMap::Build(const PMScene& scene, const XMFLOAT3& lightPosition)
+    {
+        std::fill(m_cells.begin(), m_cells.end(), false);
+        m_activeCells.clear();
+
+        const float cellTheta = PM_TWO_PI / PROJECTION_MAP_THETA_RES;
+        const float cellPhi = PM_PI / PROJECTION_MAP_PHI_RES;
+        const XMVECTOR lightPos = XMLoadFloat3(&lightPosition);
+
+        for (size_t primitiveIndex = 0; primitiveIndex < scene.m_primitives.size(); ++primitiveIndex)
+        {
+            const Primitive& primitive = scene.m_primitives[primitiveIndex];
+            if (!IsSpecularPrimitive(scene, primitive))
+            {
+                continue;
+            }
+
+            // Bounding sphere of the preprocessed world bounds
+            const PrimitiveWorld& world = scene.m_primitiveWorlds[primitiveIndex];
+            XMVECTOR boundsMin = XMLoadFloat3(&world.m_boundsMin);
+            XMVECTOR boundsMax = XMLoadFloat3(&world.m_boundsMax);
+            XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+            float radius = XMVectorGetX(XMVector3Length(XMVectorScale(XMVectorSubtract(boundsMax, boundsMin), 0.5f)));
+
+            XMVECTOR toCenter = XMVectorSubtract(center, lightPos);
+            float distance = XMVectorGetX(XMVector3Length(toCenter));
+
+            // Light sits inside the bounding sphere, every direction can reach the object
+            if (distance <= radius)
+            {
+                std::fill(m_cells.begin(), m_cells.end(), true);
+                break;
+            }
+
+            XMVECTOR centerDir = XMVector3Normalize(toCenter);
+            float sphereHalfAngle = asin(radius / distance);
+
+            for (UINT phiIndex = 0; phiIndex < PROJECTION_MAP_PHI_RES; ++phiIndex)
+            {
+                float phiMin = phiIndex * cellPhi;
+                float phiMax = phiMin + cellPhi;
+                float phi = phiMin + 0.5f * cellPhi;
+
+                // Widest ring of this band decides how large the cell is along theta
+                float maxSinPhi = (phiMin <= 0.5f * PM_PI && phiMax >= 0.5f * PM_PI) ? 1.0f : max(sin(phiMin), sin(phiMax));
+                float halfTheta = 0.5f * cellTheta * maxSinPhi;
+                float halfPhi = 0.5f * cellPhi;
+                float cellHalfAngle = sqrt(halfTheta * halfTheta + halfPhi * halfPhi);
+
+                for (UINT thetaIndex = 0; thetaIndex < PROJECTION_MAP_THETA_RES; ++thetaIndex)
+                {
+                    float theta = (thetaIndex + 0.5f) * cellTheta;
+                    float cosAngle = XMVectorGetX(XMVector3Dot(SampleToDirection(theta, phi), centerDir));
+                    float angle = acos(max(-1.0f, min(1.0f, cosAngle)));
+
+                    if (angle <= sphereHalfAngle + cellHalfAngle)
+                    {
+                        m_cells[phiIndex * PROJECTION_MAP_THETA_RES + thetaIndex] = true;
+                    }
+                }
+            }
+        }
+
+        for (UINT i = 0; i < PROJECTION_MAP_NUM_CELLS; ++i)
+        {
+            if (m_cells[i])
+            {
+                m_activeCells.push_back(i);
+            }
+        }
+    }
+
+    //------------------------------------------------------
+    // GetCoverage
+    // Emission picks cells uniformly in sample space, so the coverage is a plain cell ratio
+    //------------------------------------------------------
+    float PMProjectionMap::GetCoverage() const
+    {
+        return static_cast<float>(m_activeCells.size()) / PROJECTION_MAP_NUM_CELLS;
+    }
+
+    //------------------------------------------------------
+    // IsCellActive
+    //------------------------------------------------------
+    bool PMProjectionMap::IsCellActive(UINT thetaIndex, UINT phiIndex) const
+    {
+        return m_cells[phiIndex * PROJECTION_MAP_THETA_RES + thetaIndex];
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "PMScene.h"
+
+namespace DXRPhotonMapper
+{
+    // Jensen style projection map.
+    // A coarse angular bitmap around a light, where each cell marks whether photons
+    // emitted through it can reach specular (reflective or transmissive) geometry.
+    // The caustic pass only emits photons through the flagged cells.
+    class PMProjectionMap
+    {
+
+    private:
+        std::vector<bool> m_cells;
+        std::vector<UINT> m_activeCells;
+
+        bool IsSpecularPrimitive(const PMScene& scene, const Primitive& primitive) const;
+
+    public:
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMProjectionMap();
+
+        //------------------------------------------------------
+        // Build
+        // Rasterizes the bounding sphere of every specular primitive into the map as seen from lightPosition
+        //------------------------------------------------------
+        void Build(const PMScene& scene, const DirectX::XMFLOAT3& lightPosition);
+
+        //------------------------------------------------------
+        // GetActiveCells
+        // Flat cell indices (phiIndex * PROJECTION_MAP_THETA_RES + thetaIndex) of the flagged cells
+        //------------------------------------------------------
+        const std::vector<UINT>& GetActiveCells() const { return m_activeCells; }
+
+        //------------------------------------------------------
+        // GetCoverage
+        // Fraction of the sphere of directions that is flagged, used to scale the caustic photon power
+        //------------------------------------------------------
+        float GetCoverage() const;
+
+        bool IsCellActive(UINT thetaIndex, UINT phiIndex) const;
+    };
+}
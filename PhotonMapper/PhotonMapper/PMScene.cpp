@@ -1,8 +1,17 @@
 #include "stdafx.h"
 #include "PMScene.h"
 #include "PMUtilities.h"
+#include "PMJSONReader.h"
+#include "PMSceneBinary.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <thread>
 
+// Textures are decoded on several threads at once, stb_image keeps its failure reasons in globals
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #define TINYGLTF_LOADER_IMPLEMENTATION
 #include "tiny_gltf_loader.h"
@@ -13,7 +22,7 @@ namespace DXRPhotonMapper
     //------------------------------------------------------
     // Constructor
     //------------------------------------------------------
-    PMScene::PMScene(UINT width, UINT height) : m_screenSize{ width, height }
+    PMScene::PMScene(UINT width, UINT height) : m_screenSize{ width, height }, m_textureCache(std::make_shared<PMTextureCache>())
     {
     }
 
@@ -42,52 +51,177 @@ namespace DXRPhotonMapper
         }
     }
 
-    PrimitiveType StringToPrimitiveType(const std::string& primTypeString)
+    //------------------------------------------------------
+    // GetPrimitiveGeometry
+    //------------------------------------------------------
+    void GetPrimitiveGeometry(PrimitiveType type, Geometry& geometry)
     {
-        if (primTypeString.compare("SquarePlane") == 0)
+        switch (type)
         {
-            return PrimitiveType::SquarePlane;
-        }
-        else if (primTypeString.compare("Cube") == 0)
+        case PrimitiveType::Cube:
         {
-            return PrimitiveType::Cube;
+            geometry.m_vertices = 
+            {
+                // Top Face
+                { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+                { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+                { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+                { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+
+                // Bottom Face
+                { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+                { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+                { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+                { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+
+                // Left Face
+                { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+
+                // Right Face
+                { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+                { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+
+                // Back Face
+                { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+                { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+                { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+                { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+
+                // Front Face
+                { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+            };
         }
-        else
+        break;
+        case PrimitiveType::SquarePlane:
         {
-            return PrimitiveType::Error;
+            geometry.m_vertices =
+            {
+                { XMFLOAT3(-0.5f, -0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(0.5f, -0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(0.5f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+                { XMFLOAT3(-0.5f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0) },
+            };
+        }
+        break;
+        case PrimitiveType::Error:
+        default:
+            break;
         }
-    }
 
-    LightType StringToLightType(const std::string& lightTypeString)
-    {
-        if (lightTypeString.compare("PointLight") == 0)
+        switch (type)
         {
-            return LightType::PointLight;
-        }
-        else if (lightTypeString.compare("AreaLight") == 0)
+        case PrimitiveType::Cube:
         {
-            return LightType::AreaLight;
+            geometry.m_indices = {
+                3,1,0,
+                2,1,3,
+
+                6,4,5,
+                7,4,6,
+
+                11,9,8,
+                10,9,11,
+
+                14,12,13,
+                15,12,14,
+
+                19,17,16,
+                18,17,19,
+
+                22,20,21,
+                23,20,22,
+            };
         }
-        else if (lightTypeString.compare("SpotLight") == 0)
+        break;
+        case PrimitiveType::SquarePlane:
         {
-            return LightType::SpotLight;
+            geometry.m_indices =
+            {
+                3,1,0,
+                2,1,3,
+            };
         }
-        else
-        {
-            return LightType::Error;
+        break;
+        case PrimitiveType::Error:
+        default:
+            break;
         }
     }
 
-    int StringToMaterialIndex(const std::string& materialName, const std::vector<Material>& m_materials)
+    // Looks a name up in a table of the names a scene file may use, fallback for any other name
+    template <typename T>
+    T LookupName(const std::unordered_map<std::string, T>& names, const std::string& name, T fallback)
+    {
+        auto it = names.find(name);
+        return (it == names.end()) ? fallback : it->second;
+    }
+
+    PrimitiveType StringToPrimitiveType(const std::string& primTypeString)
     {
-        for (size_t i = 0; i < m_materials.size(); ++i)
+        static const std::unordered_map<std::string, PrimitiveType> primitiveTypes =
         {
-            if (m_materials[i].m_name.compare(materialName) == 0)
-            {
-                return int(i);
-            }
+            { "SquarePlane", PrimitiveType::SquarePlane },
+            { "Cube", PrimitiveType::Cube },
+        };
+        return LookupName(primitiveTypes, primTypeString, PrimitiveType::Error);
+    }
+
+    LightType StringToLightType(const std::string& lightTypeString)
+    {
+        static const std::unordered_map<std::string, LightType> lightTypes =
+        {
+            { "PointLight", LightType::PointLight },
+            { "AreaLight", LightType::AreaLight },
+            { "SpotLight", LightType::SpotLight },
+        };
+        return LookupName(lightTypes, lightTypeString, LightType::Error);
+    }
+
+    // Material types a scene file may name, each sets up its own BSDF flags and base material
+    enum class MaterialType
+    {
+        Matte = 0,
+        Mirror,
+        Glass,
+        Error,
+    };
+
+    MaterialType StringToMaterialType(const std::string& materialTypeString)
+    {
+        static const std::unordered_map<std::string, MaterialType> materialTypes =
+        {
+            { "MatteMaterial", MaterialType::Matte },
+            { "MirrorMaterial", MaterialType::Mirror },
+            { "GlassMaterial", MaterialType::Glass },
+        };
+        return LookupName(materialTypes, materialTypeString, MaterialType::Error);
+    }
+
+    // Material index of every material name, built once per load so primitives resolve their material without
+    // searching the material list. With duplicate names the first material wins, as a search from the front would
+    typedef std::unordered_map<std::string, int> MaterialIndexTable;
+
+    void BuildMaterialIndexTable(const std::vector<Material>& materials, MaterialIndexTable& materialIndices)
+    {
+        materialIndices.clear();
+        materialIndices.reserve(materials.size());
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            materialIndices.emplace(materials[i].m_name, int(i));
         }
-        return -1;
+    }
+
+    int StringToMaterialIndex(const std::string& materialName, const MaterialIndexTable& materialIndices)
+    {
+        return LookupName(materialIndices, materialName, -1);
     }
 
 
@@ -154,7 +288,7 @@ namespace DXRPhotonMapper
         return true;
     }
 
-    bool LoadJSONPrimitives(picojson::value& root, std::vector<Primitive>& primitives, const std::vector<Material>& m_materials)
+    bool LoadJSONPrimitives(picojson::value& root, std::vector<Primitive>& primitives, const MaterialIndexTable& materialIndices, bool listItems)
     {
         std::string err = "";
         const picojson::array& primitiveArray = root.get("primitives").get<picojson::array>();
@@ -188,7 +322,7 @@ namespace DXRPhotonMapper
             {
                 OutputDebugString(L"Error Parsing material");
             }
-            primitive.m_materialID = StringToMaterialIndex(matName, m_materials);
+            primitive.m_materialID = StringToMaterialIndex(matName, materialIndices);
 
             // Primitive Transform
             picojson::object::const_iterator transformIt = primitiveObj.find("transform");
@@ -224,7 +358,7 @@ namespace DXRPhotonMapper
         }
 
         // For Debug Purpose only
-        for (size_t i = 0; i < primitives.size(); ++i)
+        for (size_t i = 0; listItems && i < primitives.size(); ++i)
         {
             std::wstringstream wstr;
             wstr << "Found Primitive " << i << std::endl;
@@ -238,7 +372,7 @@ namespace DXRPhotonMapper
         return true;
     }
 
-    bool LoadJSONMaterials(picojson::value& root, std::vector<Material>& materials)
+    bool LoadJSONMaterials(picojson::value& root, std::vector<Material>& materials, bool listItems)
     {
         std::string err = "";
         const picojson::array& materialArray = root.get("materials").get<picojson::array>();
@@ -257,6 +391,9 @@ namespace DXRPhotonMapper
             }
             material.m_name = matName;
 
+            // Material albedo texture
+            ParseStringProperty(&material.m_albedoTextureFile, &err, materialObj, "albedoTexture", false);
+
             // Material albedo
             std::vector<double> albedo(3);
             if (!ParseNumberArrayProperty(&albedo, &err, materialObj, "albedo", false))
@@ -271,7 +408,9 @@ namespace DXRPhotonMapper
                 OutputDebugString(L"Error Parsing type");
             }
 
-            if (matType.compare("MatteMaterial") == 0)
+            switch (StringToMaterialType(matType))
+            {
+            case MaterialType::Matte:
             {
                 material.m_materialFlags = MaterialFlag::BSDF_DIFFUSE;
 
@@ -283,14 +422,54 @@ namespace DXRPhotonMapper
 
                 materials.push_back(material);
             }
-            else
+            break;
+            case MaterialType::Mirror:
+            {
+                material.m_materialFlags = MaterialFlag::BSDF_SPECULAR | MaterialFlag::BSDF_REFLECTION;
+
+                double roughness = 0.0;
+                ParseNumberProperty(&roughness, &err, materialObj, "roughness", false);
+
+                ReflectiveMat reflectiveMat = {};
+                reflectiveMat.m_albedo = { float(albedo[0]), float(albedo[1]), float(albedo[2]) };
+                reflectiveMat.m_matIdentifier = material.m_materialFlags;
+                reflectiveMat.roughness = float(roughness);
+
+                material.m_baseMaterials.push_back(reflectiveMat);
+
+                materials.push_back(material);
+            }
+            break;
+            case MaterialType::Glass:
             {
+                material.m_materialFlags = MaterialFlag::BSDF_SPECULAR | MaterialFlag::BSDF_TRANSMISSION;
+
+                double refractiveIndex = 1.5;
+                if (!ParseNumberProperty(&refractiveIndex, &err, materialObj, "eta", false))
+                {
+                    OutputDebugString(L"Glass material without eta, using 1.5\n");
+                }
+
+                TransmissiveMat transmissiveMat = {};
+                transmissiveMat.m_albedo = { float(albedo[0]), float(albedo[1]), float(albedo[2]) };
+                transmissiveMat.m_matIdentifier = material.m_materialFlags;
+                transmissiveMat.refractiveIndex = float(refractiveIndex);
+
+                material.m_baseMaterials.push_back(transmissiveMat);
+                material.m_refractiveIndex = float(refractiveIndex);
+
+                materials.push_back(material);
+            }
+            break;
+            case MaterialType::Error:
+            default:
                 OutputDebugString(L"Unrecognized Material");
+                break;
             }
         }
 
         // For Debug Purpose only
-        for (size_t i = 0; i < materials.size(); ++i)
+        for (size_t i = 0; listItems && i < materials.size(); ++i)
         {
             std::wstringstream wstr;
             wstr << "Found Material " << i << std::endl;
@@ -301,7 +480,7 @@ namespace DXRPhotonMapper
 
     }
 
-    bool LoadJSONLights(picojson::value& root, std::vector<Light>& lights)
+    bool LoadJSONLights(picojson::value& root, std::vector<Light>& lights, bool listItems)
     {
         std::string err = "";
         const picojson::array& lightArray = root.get("lights").get<picojson::array>();
@@ -438,7 +617,7 @@ namespace DXRPhotonMapper
         }
 
         // For Debug Purpose only
-        for (size_t i = 0; i < lights.size(); ++i)
+        for (size_t i = 0; listItems && i < lights.size(); ++i)
         {
             std::wstringstream wstr;
             wstr << "Found Light " << i << std::endl;
@@ -453,10 +632,275 @@ namespace DXRPhotonMapper
         return true;
     }
 
+    //------------------------------------------------------
+    // Streaming loaders
+    // Fill the scene straight from a PMJSONReader, one member at a time. Members may come in any order and
+    // unknown members are skipped, so everything is collected first and interpreted at the end of each object.
+    //------------------------------------------------------
+    bool ReadJSONTransform(PMJSONReader& reader, XMFLOAT3& translate, XMFLOAT3& rotate, XMFLOAT3& scale)
+    {
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = reader.KeyIs("translate") ? reader.ReadFloat3(translate) :
+                        reader.KeyIs("rotate") ? reader.ReadFloat3(rotate) :
+                        reader.KeyIs("scale") ? reader.ReadFloat3(scale) :
+                        reader.SkipValue();
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    bool ReadJSONCamera(PMJSONReader& reader, Camera& camera)
+    {
+        float width = 0.0f;
+        float height = 0.0f;
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = reader.KeyIs("width") ? reader.ReadNumber(width) :
+                        reader.KeyIs("height") ? reader.ReadNumber(height) :
+                        reader.KeyIs("fov") ? reader.ReadNumber(camera.m_fov) :
+                        reader.KeyIs("eye") ? reader.ReadFloat3(camera.m_eye) :
+                        reader.KeyIs("ref") ? reader.ReadFloat3(camera.m_ref) :
+                        reader.KeyIs("worldUp") ? reader.ReadFloat3(camera.m_up) :
+                        reader.SkipValue();
+            if (!read)
+            {
+                return false;
+            }
+        }
+
+        camera.m_width = UINT(width);
+        camera.m_height = UINT(height);
+        return !reader.HasError();
+    }
+
+    // Primitives only name their material, and materials may come later in the file. Each distinct name gets an
+    // ID in materialNames, which stands in for the material index until all materials are read.
+    bool ReadJSONPrimitive(PMJSONReader& reader, Primitive& primitive, std::string& scratch, std::unordered_map<std::string, int>& materialNames)
+    {
+        primitive.m_primitiveType = PrimitiveType::Error;
+        primitive.m_materialID = -1;
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("shape"))
+            {
+                read = reader.ReadString(scratch);
+                primitive.m_primitiveType = StringToPrimitiveType(scratch);
+            }
+            else if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(primitive.m_name);
+            }
+            else if (reader.KeyIs("material"))
+            {
+                read = reader.ReadString(scratch);
+                auto it = materialNames.find(scratch);
+                if (it == materialNames.end())
+                {
+                    it = materialNames.emplace(scratch, int(materialNames.size())).first;
+                }
+                primitive.m_materialID = it->second;
+            }
+            else if (reader.KeyIs("transform"))
+            {
+                read = ReadJSONTransform(reader, primitive.m_translate, primitive.m_rotate, primitive.m_scale);
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    bool ReadJSONMaterial(PMJSONReader& reader, std::vector<Material>& materials, std::string& scratch)
+    {
+        Material material = {};
+        XMFLOAT3 albedo(0.0f, 0.0f, 0.0f);
+        float roughness = 0.0f;
+        float refractiveIndex = 1.5f;
+        bool hasRefractiveIndex = false;
+        scratch.clear();
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(material.m_name);
+            }
+            else if (reader.KeyIs("albedo"))
+            {
+                read = reader.ReadFloat3(albedo);
+            }
+            else if (reader.KeyIs("albedoTexture"))
+            {
+                read = reader.ReadString(material.m_albedoTextureFile);
+            }
+            else if (reader.KeyIs("type"))
+            {
+                read = reader.ReadString(scratch);
+            }
+            else if (reader.KeyIs("roughness"))
+            {
+                read = reader.ReadNumber(roughness);
+            }
+            else if (reader.KeyIs("eta"))
+            {
+                read = reader.ReadNumber(refractiveIndex);
+                hasRefractiveIndex = true;
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        if (reader.HasError())
+        {
+            return false;
+        }
+
+        switch (StringToMaterialType(scratch))
+        {
+        case MaterialType::Matte:
+        {
+            material.m_materialFlags = MaterialFlag::BSDF_DIFFUSE;
+
+            DiffuseMat diffuseMat = {};
+            diffuseMat.m_albedo = albedo;
+            diffuseMat.m_matIdentifier = MaterialFlag::BSDF_DIFFUSE;
+            material.m_baseMaterials.push_back(diffuseMat);
+        }
+        break;
+        case MaterialType::Mirror:
+        {
+            material.m_materialFlags = MaterialFlag::BSDF_SPECULAR | MaterialFlag::BSDF_REFLECTION;
+
+            ReflectiveMat reflectiveMat = {};
+            reflectiveMat.m_albedo = albedo;
+            reflectiveMat.m_matIdentifier = material.m_materialFlags;
+            reflectiveMat.roughness = roughness;
+            material.m_baseMaterials.push_back(reflectiveMat);
+        }
+        break;
+        case MaterialType::Glass:
+        {
+            material.m_materialFlags = MaterialFlag::BSDF_SPECULAR | MaterialFlag::BSDF_TRANSMISSION;
+            if (!hasRefractiveIndex)
+            {
+                OutputDebugString(L"Glass material without eta, using 1.5\n");
+            }
+
+            TransmissiveMat transmissiveMat = {};
+            transmissiveMat.m_albedo = albedo;
+            transmissiveMat.m_matIdentifier = material.m_materialFlags;
+            transmissiveMat.refractiveIndex = refractiveIndex;
+            material.m_baseMaterials.push_back(transmissiveMat);
+            material.m_refractiveIndex = refractiveIndex;
+        }
+        break;
+        case MaterialType::Error:
+        default:
+            OutputDebugString(L"Unrecognized Material\n");
+            return true;
+        }
+
+        materials.push_back(std::move(material));
+        return true;
+    }
+
+    bool ReadJSONLight(PMJSONReader& reader, std::vector<Light>& lights, std::string& scratch)
+    {
+        Light light = {};
+        float dropOff = 0.0f;
+        float coneAngle = 0.0f;
+        bool twoSided = false;
+        scratch.clear();
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = reader.KeyIs("name") ? reader.ReadString(light.m_name) :
+                        reader.KeyIs("intensity") ? reader.ReadNumber(light.m_lightIntensity) :
+                        reader.KeyIs("lightColor") ? reader.ReadFloat3(light.m_lightColor) :
+                        reader.KeyIs("transform") ? ReadJSONTransform(reader, light.m_translate, light.m_rotate, light.m_scale) :
+                        reader.KeyIs("type") ? reader.ReadString(scratch) :
+                        reader.KeyIs("dropOff") ? reader.ReadNumber(dropOff) :
+                        reader.KeyIs("coneAngle") ? reader.ReadNumber(coneAngle) :
+                        reader.KeyIs("twoSided") ? reader.ReadBoolean(twoSided) :
+                        reader.SkipValue();
+            if (!read)
+            {
+                return false;
+            }
+        }
+        if (reader.HasError())
+        {
+            return false;
+        }
+
+        light.m_lightType = StringToLightType(scratch);
+        switch (light.m_lightType)
+        {
+        case LightType::PointLight:
+            light.LightDesc.pointLight.dropOff = dropOff;
+            break;
+        case LightType::AreaLight:
+            light.LightDesc.areaLight.isTwoSided = twoSided;
+            break;
+        case LightType::SpotLight:
+            light.LightDesc.spotLight.dropOff = dropOff;
+            light.LightDesc.spotLight.coneAngle = coneAngle;
+            break;
+        case LightType::Error:
+        default:
+            OutputDebugString(L"Unknown Light Type\n");
+            break;
+        }
+
+        lights.push_back(std::move(light));
+        return true;
+    }
+
     //------------------------------------------------------
     // LoadPicoScene
     //------------------------------------------------------
-    bool PMScene::LoadPicoScene(const char *str, unsigned int length)
+    bool PMScene::LoadPicoScene(const char *str, unsigned int length, bool listItems)
     {
         std::wstringstream wstr;
         picojson::value v;
@@ -497,17 +941,19 @@ namespace DXRPhotonMapper
             OutputDebugString(L"Error Parsing Camera\n");
         }
 
-        if (!LoadJSONMaterials(v, m_materials))
+        if (!LoadJSONMaterials(v, m_materials, listItems))
         {
             OutputDebugString(L"Error Parsing Materials\n");
         }
 
-        if (!LoadJSONPrimitives(v, m_primitives, m_materials))
+        MaterialIndexTable materialIndices;
+        BuildMaterialIndexTable(m_materials, materialIndices);
+        if (!LoadJSONPrimitives(v, m_primitives, materialIndices, listItems))
         {
             OutputDebugString(L"Error Parsing Primitives\n");
         }
 
-        if (!LoadJSONLights(v, m_lights))
+        if (!LoadJSONLights(v, m_lights, listItems))
         {
             OutputDebugString(L"Error Parsing Lights\n");
         }
@@ -543,62 +989,1109 @@ namespace DXRPhotonMapper
     }
 
     //------------------------------------------------------
-    // LoadGLTFBufferViews
+    // LoadStreamingScene
     //------------------------------------------------------
-    void LoadGLTFBufferViews(tinygltf::Scene& m_gltfScene, std::map<std::string, BufferHolder>& m_gltfBufferHolders)
+    bool PMScene::LoadStreamingScene(const char* str, size_t length)
     {
-        std::map<std::string, tinygltf::BufferView>::const_iterator it(m_gltfScene.bufferViews.begin());
-        std::map<std::string, tinygltf::BufferView>::const_iterator itEnd(m_gltfScene.bufferViews.end());
-
-        for (; it != itEnd; it++)
+        PMJSONReader reader(str, str + length);
+        std::string scratch;
+        std::unordered_map<std::string, int> materialNames;
+        bool hasCamera = false, hasPrimitives = false, hasLights = false, hasMaterials = false;
+
+        m_primitives.clear();
+        m_materials.clear();
+        m_lights.clear();
+        m_meshViews.clear();
+        m_primitiveMeshes.clear();
+        m_binarySceneFile.reset();
+
+        if (reader.BeginObject())
         {
-            const std::string key = it->first;
-            const tinygltf::BufferView &bufferView = it->second;
-
-            if (bufferView.target == 0)
+            while (reader.NextMember())
             {
-                continue; // Unsupported bufferView.
+                bool read = true;
+                if (reader.KeyIs("camera"))
+                {
+                    hasCamera = true;
+                    read = ReadJSONCamera(reader, m_camera);
+                }
+                else if (reader.KeyIs("primitives"))
+                {
+                    hasPrimitives = true;
+                    read = reader.BeginArray();
+                    while (read && reader.NextElement())
+                    {
+                        m_primitives.emplace_back();
+                        read = ReadJSONPrimitive(reader, m_primitives.back(), scratch, materialNames);
+                    }
+                }
+                else if (reader.KeyIs("materials"))
+                {
+                    hasMaterials = true;
+                    read = reader.BeginArray();
+                    while (read && reader.NextElement())
+                    {
+                        read = ReadJSONMaterial(reader, m_materials, scratch);
+                    }
+                }
+                else if (reader.KeyIs("lights"))
+                {
+                    hasLights = true;
+                    read = reader.BeginArray();
+                    while (read && reader.NextElement())
+                    {
+                        read = ReadJSONLight(reader, m_lights, scratch);
+                    }
+                }
+                else
+                {
+                    read = reader.SkipValue();
+                }
+
+                if (!read)
+                {
+                    break;
+                }
             }
+        }
+        reader.ExpectEnd();
 
-            const tinygltf::Buffer &buffer = m_gltfScene.buffers.at(bufferView.buffer);
+        if (!reader.HasError())
+        {
+            if (!hasCamera) reader.SetError("JSON File Does not contain camera");
+            else if (!hasPrimitives) reader.SetError("JSON File Does not contain primitives");
+            else if (!hasLights) reader.SetError("JSON File Does not contain lights");
+            else if (!hasMaterials) reader.SetError("JSON File Does not contain materials");
+        }
 
-            BufferHolder bufferHolder = {};
-            bufferHolder.m_bufferStart = &buffer.data.front() + bufferView.byteOffset;
-            bufferHolder.m_length = bufferView.byteLength;
+        if (reader.HasError())
+        {
+            std::wstringstream wstr;
+            wstr << L"Could not parse JSON file, " << reader.GetError().c_str() << std::endl;
+            OutputDebugStringW(wstr.str().c_str());
+            return false;
+        }
 
-            m_gltfBufferHolders.insert(std::make_pair(key, bufferHolder));
+        // Name IDs to material indices, -1 for names no material has
+        MaterialIndexTable materialIndexTable;
+        BuildMaterialIndexTable(m_materials, materialIndexTable);
+        std::vector<int> materialIndices(materialNames.size(), -1);
+        for (const auto& materialName : materialNames)
+        {
+            materialIndices[materialName.second] = StringToMaterialIndex(materialName.first, materialIndexTable);
         }
-    }
 
-    //------------------------------------------------------
-    // LoadGLTFMeshes
-    //------------------------------------------------------
-    void LoadGLTFMeshes()
-    {
+        m_sceneBufferDesc.clear();
+        m_sceneBufferDesc.reserve(m_primitives.size());
+        for (size_t i = 0; i < m_primitives.size(); ++i)
+        {
+            Primitive& primitive = m_primitives[i];
+            primitive.m_materialID = (primitive.m_materialID < 0) ? -1 : materialIndices[primitive.m_materialID];
 
-    }
+            SceneBufferDesc sceneBufferDesc = {};
+            sceneBufferDesc.vbIndex = UINT(i);
+            m_sceneBufferDesc.push_back(sceneBufferDesc);
+        }
 
+        std::wstringstream wstr;
+        wstr << L"Loaded scene: " << m_primitives.size() << L" primitives, " << m_materials.size() << L" materials, " << m_lights.size() << L" lights" << std::endl;
+        OutputDebugStringW(wstr.str().c_str());
+        return true;
+    }
 
     //------------------------------------------------------
-    // LoadJSONScene
+    // BenchmarkJSONLoading
     //------------------------------------------------------
-    bool PMScene::LoadJSONScene(const std::string& fileName)
+    void PMScene::BenchmarkJSONLoading(size_t numPrimitives, size_t numMaterials)
     {
-        // 1.Read Data from file
-        std::ifstream file(fileName.c_str());
-        if (!file)
+        // Synthetic scene in the layout of Scene/sample.json, primitives before the materials they name
+        static const char* materialTypes[] = { "MatteMaterial", "MirrorMaterial", "GlassMaterial" };
+        numMaterials = (std::max)(numMaterials, size_t(1));
+
+        std::ostringstream json;
+        json << "{\n  \"camera\": { \"ref\": [ 0, 2.5, 0 ], \"eye\": [ 0, 6.5, -30 ], \"worldUp\": [ 0, 1, 0 ], \"fov\": 19.5, \"width\": 512, \"height\": 512 },\n";
+        json << "  \"primitives\": [\n";
+        for (size_t i = 0; i < numPrimitives; ++i)
         {
-            OutputDebugString(L"Failed to open file\n");
-            return false;
+            json << "    { \"shape\": \"" << ((i & 1) ? "Cube" : "SquarePlane") << "\", \"name\": \"primitive" << i
+                 << "\", \"material\": \"material" << (i % numMaterials)
+                 << "\", \"transform\": { \"translate\": [ " << (i % 100) * 0.25 << ", " << (i / 100 % 100) * -0.5 << ", " << (i % 7) + 0.125
+                 << " ], \"rotate\": [ 0, " << (i % 360) << ", 0 ], \"scale\": [ 1, 1.5, 1e-1 ] } }" << ((i + 1 < numPrimitives) ? ",\n" : "\n");
         }
-
-        file.seekg(0, file.end);
-        const size_t sz = static_cast<size_t>(file.tellg());
-        std::vector<char> buf(sz);
-
-        if (sz == 0)
+        json << "  ],\n  \"lights\": [\n";
+        json << "    { \"name\": \"Light Source1\", \"type\": \"PointLight\", \"lightColor\": [ 204, 176, 255 ], \"intensity\": 1.0, \"dropOff\": 5.0,\n";
+        json << "      \"transform\": { \"translate\": [ 3, 7.45, -20 ], \"rotate\": [ 60, 0, 0 ], \"scale\": [ 3, 3, 1 ] } }\n";
+        json << "  ],\n  \"materials\": [\n";
+        for (size_t i = 0; i < numMaterials; ++i)
         {
-            OutputDebugString(L"Empty JSON file\n");
+            json << "    { \"type\": \"" << materialTypes[i % 3] << "\", \"name\": \"material" << i
+                 << "\", \"albedo\": [ " << (i % 10) * 0.1 << ", 0.5, 0.5 ], \"roughness\": 0.0, \"eta\": 1.55 }" << ((i + 1 < numMaterials) ? ",\n" : "\n");
+        }
+        json << "  ]\n}\n";
+        const std::string text = json.str();
+
+        // The picojson loader as LoadJSONScene ran it before, DOM parse and walk. Its debug listing of every item is
+        // left out, the streaming loader has none and the times would mostly measure the debug output
+        PMScene picoScene(0, 0);
+        auto start = std::chrono::high_resolution_clock::now();
+        bool picoLoaded = picoScene.LoadPicoScene(text.data(), UINT(text.size()), false);
+        auto end = std::chrono::high_resolution_clock::now();
+        float picoMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+        PMScene scene(0, 0);
+        start = std::chrono::high_resolution_clock::now();
+        bool loaded = scene.LoadStreamingScene(text.data(), text.size());
+        end = std::chrono::high_resolution_clock::now();
+        float streamingMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+        // Both loaders have to fill in the same scene for the times to compare, down to every parsed number
+        auto sameFloat3 = [](const XMFLOAT3& a, const XMFLOAT3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+        bool sameScene = picoScene.m_primitives.size() == scene.m_primitives.size() && picoScene.m_materials.size() == scene.m_materials.size() &&
+            picoScene.m_lights.size() == scene.m_lights.size() && sameFloat3(picoScene.m_camera.m_eye, scene.m_camera.m_eye) &&
+            sameFloat3(picoScene.m_camera.m_ref, scene.m_camera.m_ref) && picoScene.m_camera.m_fov == scene.m_camera.m_fov;
+        for (size_t i = 0; sameScene && i < scene.m_primitives.size(); ++i)
+        {
+            const Primitive& a = picoScene.m_primitives[i];
+            const Primitive& b = scene.m_primitives[i];
+            sameScene = a.m_primitiveType == b.m_primitiveType && a.m_materialID == b.m_materialID && a.m_name == b.m_name &&
+                sameFloat3(a.m_translate, b.m_translate) && sameFloat3(a.m_rotate, b.m_rotate) && sameFloat3(a.m_scale, b.m_scale);
+        }
+        for (size_t i = 0; sameScene && i < scene.m_materials.size(); ++i)
+        {
+            const Material& a = picoScene.m_materials[i];
+            const Material& b = scene.m_materials[i];
+            sameScene = a.m_name == b.m_name && a.m_materialFlags == b.m_materialFlags && a.m_refractiveIndex == b.m_refractiveIndex &&
+                a.m_baseMaterials.size() == b.m_baseMaterials.size() &&
+                (a.m_baseMaterials.empty() || sameFloat3(a.m_baseMaterials[0].m_albedo, b.m_baseMaterials[0].m_albedo));
+        }
+        for (size_t i = 0; sameScene && i < scene.m_lights.size(); ++i)
+        {
+            const Light& a = picoScene.m_lights[i];
+            const Light& b = scene.m_lights[i];
+            sameScene = a.m_lightType == b.m_lightType && a.m_lightIntensity == b.m_lightIntensity && sameFloat3(a.m_lightColor, b.m_lightColor) &&
+                sameFloat3(a.m_translate, b.m_translate) && sameFloat3(a.m_rotate, b.m_rotate) && sameFloat3(a.m_scale, b.m_scale);
+        }
+
+        // Resolving every material name once, through the name table and with a search of the material list
+        size_t found = 0;
+        start = std::chrono::high_resolution_clock::now();
+        {
+            MaterialIndexTable materialIndices;
+            BuildMaterialIndexTable(scene.m_materials, materialIndices);
+            for (const Material& material : scene.m_materials)
+            {
+                found += (StringToMaterialIndex(material.m_name, materialIndices) >= 0) ? 1 : 0;
+            }
+        }
+        end = std::chrono::high_resolution_clock::now();
+        float tableMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const Material& material : scene.m_materials)
+        {
+            auto it = std::find_if(scene.m_materials.begin(), scene.m_materials.end(),
+                [&material](const Material& other) { return other.m_name == material.m_name; });
+            found += (it != scene.m_materials.end()) ? 1 : 0;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        float searchMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+        std::wstringstream wstr;
+        wstr << L"JSON loading benchmark, " << numPrimitives << L" primitives, " << numMaterials << L" materials, " << text.size() / (1024 * 1024) << L" MB" << std::endl;
+        wstr << L" picojson load " << picoMilliseconds << L" ms" << (picoLoaded ? L"" : L" (failed)") << std::endl;
+        wstr << L" Streaming load " << streamingMilliseconds << L" ms" << (loaded ? L"" : L" (failed)") << (sameScene ? L"" : L" (scenes differ)") << std::endl;
+        wstr << L" Material names through the name table " << tableMilliseconds << L" ms, searching the material list " << searchMilliseconds << L" ms"
+             << ((found == 2 * scene.m_materials.size()) ? L"" : L" (unresolved names)") << std::endl;
+        OutputDebugStringW(wstr.str().c_str());
+    }
+
+    //------------------------------------------------------
+    // LoadGLTFBufferViews
+    //------------------------------------------------------
+    void LoadGLTFBufferViews(tinygltf::Scene& m_gltfScene, std::map<std::string, BufferHolder>& m_gltfBufferHolders)
+    {
+        std::map<std::string, tinygltf::BufferView>::const_iterator it(m_gltfScene.bufferViews.begin());
+        std::map<std::string, tinygltf::BufferView>::const_iterator itEnd(m_gltfScene.bufferViews.end());
+
+        for (; it != itEnd; it++)
+        {
+            const std::string key = it->first;
+            const tinygltf::BufferView &bufferView = it->second;
+
+            if (bufferView.target == 0)
+            {
+                continue; // Unsupported bufferView.
+            }
+
+            const tinygltf::Buffer &buffer = m_gltfScene.buffers.at(bufferView.buffer);
+
+            BufferHolder bufferHolder = {};
+            bufferHolder.m_bufferStart = &buffer.data.front() + bufferView.byteOffset;
+            bufferHolder.m_length = bufferView.byteLength;
+
+            m_gltfBufferHolders.insert(std::make_pair(key, bufferHolder));
+        }
+    }
+
+    //------------------------------------------------------
+    // Mapped binary glTF
+    // Only the parts of the JSON the meshes and their placement use are read, the rest is skipped
+    //------------------------------------------------------
+    int StringToGLTFType(const std::string& type)
+    {
+        static const std::unordered_map<std::string, int> gltfTypes =
+        {
+            { "SCALAR", TINYGLTF_TYPE_SCALAR },
+            { "VEC2", TINYGLTF_TYPE_VEC2 },
+            { "VEC3", TINYGLTF_TYPE_VEC3 },
+            { "VEC4", TINYGLTF_TYPE_VEC4 },
+            { "MAT2", TINYGLTF_TYPE_MAT2 },
+            { "MAT3", TINYGLTF_TYPE_MAT3 },
+            { "MAT4", TINYGLTF_TYPE_MAT4 },
+        };
+        return LookupName(gltfTypes, type, -1);
+    }
+
+    bool ReadJSONSize(PMJSONReader& reader, size_t& value)
+    {
+        double number;
+        if (!reader.ReadNumber(number))
+        {
+            return false;
+        }
+        if (number < 0.0 || number != floor(number))
+        {
+            return reader.SetError("Expected a non negative integer");
+        }
+        value = size_t(number);
+        return true;
+    }
+
+    bool ReadJSONInt(PMJSONReader& reader, int& value)
+    {
+        double number;
+        if (!reader.ReadNumber(number))
+        {
+            return false;
+        }
+        value = int(number);
+        return true;
+    }
+
+    bool ReadGLTFAccessor(PMJSONReader& reader, tinygltf::Accessor& accessor, std::string& scratch)
+    {
+        accessor.byteOffset = 0;
+        accessor.byteStride = 0;
+        accessor.componentType = -1;
+        accessor.count = 0;
+        accessor.type = -1;
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("bufferView"))
+            {
+                read = reader.ReadString(accessor.bufferView);
+            }
+            else if (reader.KeyIs("byteOffset"))
+            {
+                read = ReadJSONSize(reader, accessor.byteOffset);
+            }
+            else if (reader.KeyIs("byteStride"))
+            {
+                read = ReadJSONSize(reader, accessor.byteStride);
+            }
+            else if (reader.KeyIs("componentType"))
+            {
+                read = ReadJSONInt(reader, accessor.componentType);
+            }
+            else if (reader.KeyIs("count"))
+            {
+                read = ReadJSONSize(reader, accessor.count);
+            }
+            else if (reader.KeyIs("type"))
+            {
+                read = reader.ReadString(scratch);
+                accessor.type = StringToGLTFType(scratch);
+            }
+            else if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(accessor.name);
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    bool ReadGLTFBufferView(PMJSONReader& reader, tinygltf::BufferView& bufferView)
+    {
+        bufferView.byteOffset = 0;
+        bufferView.byteLength = 0;
+        bufferView.target = 0;
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("buffer"))
+            {
+                read = reader.ReadString(bufferView.buffer);
+            }
+            else if (reader.KeyIs("byteOffset"))
+            {
+                read = ReadJSONSize(reader, bufferView.byteOffset);
+            }
+            else if (reader.KeyIs("byteLength"))
+            {
+                read = ReadJSONSize(reader, bufferView.byteLength);
+            }
+            else if (reader.KeyIs("target"))
+            {
+                read = ReadJSONInt(reader, bufferView.target);
+            }
+            else if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(bufferView.name);
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    // A buffer is only the binary body when its uri says so, the others are data uris or files of their own
+    bool ReadGLTFBufferIsBody(PMJSONReader& reader, const std::string& id, bool& isBody, std::string& scratch)
+    {
+        isBody = (id == "binary_glTF");
+
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("uri"))
+            {
+                read = reader.ReadString(scratch);
+                isBody = isBody || (scratch == "data:,");
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    bool ReadGLTFMesh(PMJSONReader& reader, tinygltf::Mesh& mesh)
+    {
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(mesh.name);
+            }
+            else if (reader.KeyIs("primitives"))
+            {
+                read = reader.BeginArray();
+                while (read && reader.NextElement())
+                {
+                    mesh.primitives.emplace_back();
+                    tinygltf::Primitive& primitive = mesh.primitives.back();
+                    primitive.mode = TINYGLTF_MODE_TRIANGLES;
+
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        if (reader.KeyIs("attributes"))
+                        {
+                            read = reader.BeginObject();
+                            while (read && reader.NextMember())
+                            {
+                                read = reader.ReadString(primitive.attributes[reader.GetKey()]);
+                            }
+                        }
+                        else if (reader.KeyIs("indices"))
+                        {
+                            read = reader.ReadString(primitive.indices);
+                        }
+                        else if (reader.KeyIs("material"))
+                        {
+                            read = reader.ReadString(primitive.material);
+                        }
+                        else if (reader.KeyIs("mode"))
+                        {
+                            read = ReadJSONInt(reader, primitive.mode);
+                        }
+                        else
+                        {
+                            read = reader.SkipValue();
+                        }
+                    }
+                }
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    bool ReadJSONStrings(PMJSONReader& reader, std::vector<std::string>& values)
+    {
+        bool read = reader.BeginArray();
+        while (read && reader.NextElement())
+        {
+            values.emplace_back();
+            read = reader.ReadString(values.back());
+        }
+        return read && !reader.HasError();
+    }
+
+    bool ReadJSONNumbers(PMJSONReader& reader, std::vector<double>& values)
+    {
+        bool read = reader.BeginArray();
+        while (read && reader.NextElement())
+        {
+            values.emplace_back();
+            read = reader.ReadNumber(values.back());
+        }
+        return read && !reader.HasError();
+    }
+
+    bool ReadGLTFNode(PMJSONReader& reader, tinygltf::Node& node)
+    {
+        if (!reader.BeginObject())
+        {
+            return false;
+        }
+        while (reader.NextMember())
+        {
+            bool read = true;
+            if (reader.KeyIs("name"))
+            {
+                read = reader.ReadString(node.name);
+            }
+            else if (reader.KeyIs("children"))
+            {
+                read = ReadJSONStrings(reader, node.children);
+            }
+            else if (reader.KeyIs("meshes"))
+            {
+                read = ReadJSONStrings(reader, node.meshes);
+            }
+            else if (reader.KeyIs("matrix"))
+            {
+                read = ReadJSONNumbers(reader, node.matrix);
+            }
+            else if (reader.KeyIs("rotation"))
+            {
+                read = ReadJSONNumbers(reader, node.rotation);
+            }
+            else if (reader.KeyIs("scale"))
+            {
+                read = ReadJSONNumbers(reader, node.scale);
+            }
+            else if (reader.KeyIs("translation"))
+            {
+                read = ReadJSONNumbers(reader, node.translation);
+            }
+            else
+            {
+                read = reader.SkipValue();
+            }
+
+            if (!read)
+            {
+                return false;
+            }
+        }
+        return !reader.HasError();
+    }
+
+    //------------------------------------------------------
+    // LoadMappedGLB
+    // Reads the JSON of a mapped binary glTF and points the buffer views straight into the mapping's body.
+    // Fails when the file is not a binary glTF 1.0 whose buffers all live in its body
+    //------------------------------------------------------
+    bool LoadMappedGLB(const PMMappedFile& file, tinygltf::Scene& gltfScene, std::map<std::string, BufferHolder>& bufferHolders, std::string& err)
+    {
+        const UINT8* data = file.GetData();
+        const size_t size = file.GetSize();
+
+        UINT header[5];
+        if (size < sizeof(header))
+        {
+            err = "Too small for a binary glTF";
+            return false;
+        }
+        memcpy(header, data, sizeof(header));
+
+        // magic, version, length, content length, content format. The length is checked against the header
+        // before anything is subtracted from it, so a short length cannot wrap around into a huge one
+        if (memcmp(data, "glTF", 4) != 0 || header[1] != 1 || header[2] < sizeof(header) || header[2] > size || header[4] != 0)
+        {
+            err = "Not a binary glTF 1.0 file";
+            return false;
+        }
+
+        const size_t contentAndBodySize = header[2] - sizeof(header);
+        if (header[3] == 0 || header[3] > contentAndBodySize)
+        {
+            err = "Not a binary glTF 1.0 file";
+            return false;
+        }
+
+        const char* json = reinterpret_cast<const char*>(data + sizeof(header));
+        const UINT8* body = data + sizeof(header) + header[3];
+        const size_t bodySize = contentAndBodySize - header[3];
+
+        PMJSONReader reader(json, json + header[3]);
+        std::string scratch;
+        std::map<std::string, bool> bodyBuffers;
+
+        if (reader.BeginObject())
+        {
+            while (reader.NextMember())
+            {
+                bool read = true;
+                if (reader.KeyIs("accessors"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        read = ReadGLTFAccessor(reader, gltfScene.accessors[reader.GetKey()], scratch);
+                    }
+                }
+                else if (reader.KeyIs("bufferViews"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        read = ReadGLTFBufferView(reader, gltfScene.bufferViews[reader.GetKey()]);
+                    }
+                }
+                else if (reader.KeyIs("buffers"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        const std::string id = reader.GetKey();
+                        read = ReadGLTFBufferIsBody(reader, id, bodyBuffers[id], scratch);
+                    }
+                }
+                else if (reader.KeyIs("meshes"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        read = ReadGLTFMesh(reader, gltfScene.meshes[reader.GetKey()]);
+                    }
+                }
+                else if (reader.KeyIs("nodes"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        read = ReadGLTFNode(reader, gltfScene.nodes[reader.GetKey()]);
+                    }
+                }
+                else if (reader.KeyIs("scenes"))
+                {
+                    read = reader.BeginObject();
+                    while (read && reader.NextMember())
+                    {
+                        std::vector<std::string>& nodes = gltfScene.scenes[reader.GetKey()];
+                        read = reader.BeginObject();
+                        while (read && reader.NextMember())
+                        {
+                            read = reader.KeyIs("nodes") ? ReadJSONStrings(reader, nodes) : reader.SkipValue();
+                        }
+                    }
+                }
+                else if (reader.KeyIs("scene"))
+                {
+                    read = reader.ReadString(gltfScene.defaultScene);
+                }
+                else
+                {
+                    read = reader.SkipValue();
+                }
+
+                if (!read)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (reader.HasError())
+        {
+            err = reader.GetError();
+            return false;
+        }
+
+        for (const auto& buffer : bodyBuffers)
+        {
+            if (!buffer.second)
+            {
+                err = "Buffer " + buffer.first + " is outside the binary body";
+                return false;
+            }
+        }
+
+        for (const auto& bufferView : gltfScene.bufferViews)
+        {
+            const tinygltf::BufferView& view = bufferView.second;
+            if (bodyBuffers.find(view.buffer) == bodyBuffers.end() || view.byteOffset > bodySize || view.byteLength > bodySize - view.byteOffset)
+            {
+                err = "Buffer view " + bufferView.first + " is outside the binary body";
+                return false;
+            }
+
+            BufferHolder bufferHolder = {};
+            bufferHolder.m_bufferStart = body + view.byteOffset;
+            bufferHolder.m_length = view.byteLength;
+            bufferHolders.insert(std::make_pair(bufferView.first, bufferHolder));
+        }
+        return true;
+    }
+
+    //------------------------------------------------------
+    // glTF accessors
+    //------------------------------------------------------
+    size_t GLTFComponentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return 1;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            return 2;
+        case TINYGLTF_COMPONENT_TYPE_INT:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+            return 4;
+        case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    size_t GLTFNumComponents(int type)
+    {
+        switch (type)
+        {
+        case TINYGLTF_TYPE_SCALAR: return 1;
+        case TINYGLTF_TYPE_VEC2: return 2;
+        case TINYGLTF_TYPE_VEC3: return 3;
+        case TINYGLTF_TYPE_VEC4: return 4;
+        default: return 0;
+        }
+    }
+
+    // Component of any type, read through memcpy since buffer views need not be aligned for it
+    template <typename T>
+    inline T ReadGLTFComponent(const UINT8* data, int componentType)
+    {
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_BYTE: { INT8 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: { UINT8 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_SHORT: { INT16 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: { UINT16 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_INT: { INT32 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: { UINT32 v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: { float v; memcpy(&v, data, sizeof(v)); return T(v); }
+        case TINYGLTF_COMPONENT_TYPE_DOUBLE: { double v; memcpy(&v, data, sizeof(v)); return T(v); }
+        default: return T(0);
+        }
+    }
+
+    // Elements of an accessor inside its buffer view
+    struct GLTFAccessorView
+    {
+        const UINT8* m_data;
+        size_t m_stride;
+        size_t m_count;
+        size_t m_numComponents;
+        size_t m_componentSize;
+        int m_componentType;
+
+        const UINT8* Element(size_t i, size_t component) const { return m_data + i * m_stride + component * m_componentSize; }
+    };
+
+    bool GetGLTFAccessorView(const tinygltf::Scene& gltfScene, const std::map<std::string, BufferHolder>& bufferHolders, const std::string& accessorName, size_t minComponents, GLTFAccessorView& view)
+    {
+        auto accessorIt = gltfScene.accessors.find(accessorName);
+        if (accessorIt == gltfScene.accessors.end())
+        {
+            return false;
+        }
+        const tinygltf::Accessor& accessor = accessorIt->second;
+
+        auto holderIt = bufferHolders.find(accessor.bufferView);
+        if (holderIt == bufferHolders.end())
+        {
+            return false;
+        }
+        const BufferHolder& holder = holderIt->second;
+
+        view.m_componentType = accessor.componentType;
+        view.m_componentSize = GLTFComponentSize(accessor.componentType);
+        view.m_numComponents = GLTFNumComponents(accessor.type);
+        view.m_count = accessor.count;
+        view.m_stride = (accessor.byteStride != 0) ? accessor.byteStride : view.m_componentSize * view.m_numComponents;
+        view.m_data = holder.m_bufferStart + accessor.byteOffset;
+
+        // The last element has to end inside the buffer view
+        const size_t elementSize = view.m_componentSize * view.m_numComponents;
+        if (elementSize == 0 || view.m_numComponents < minComponents || accessor.byteOffset > holder.m_length ||
+            (view.m_count > 0 && (view.m_count - 1) * view.m_stride + elementSize > holder.m_length - accessor.byteOffset))
+        {
+            return false;
+        }
+        return true;
+    }
+
+    //------------------------------------------------------
+    // DecodeGLTFMesh
+    // Merges the triangle primitives of a glTF mesh into one geometry
+    //------------------------------------------------------
+    bool DecodeGLTFMesh(const tinygltf::Scene& gltfScene, const std::map<std::string, BufferHolder>& bufferHolders, const tinygltf::Mesh& mesh, Geometry& geometry)
+    {
+        std::vector<UINT> indices;
+
+        for (const tinygltf::Primitive& primitive : mesh.primitives)
+        {
+            if (primitive.mode != TINYGLTF_MODE_TRIANGLES)
+            {
+                continue;
+            }
+
+            auto positionIt = primitive.attributes.find("POSITION");
+            GLTFAccessorView positions;
+            if (positionIt == primitive.attributes.end() || !GetGLTFAccessorView(gltfScene, bufferHolders, positionIt->second, 3, positions))
+            {
+                return false;
+            }
+
+            auto normalIt = primitive.attributes.find("NORMAL");
+            GLTFAccessorView normals;
+            const bool hasNormals = (normalIt != primitive.attributes.end()) &&
+                GetGLTFAccessorView(gltfScene, bufferHolders, normalIt->second, 3, normals) && normals.m_count == positions.m_count;
+
+            const size_t baseVertex = geometry.m_vertices.size();
+            const size_t baseIndex = indices.size();
+            geometry.m_vertices.resize(baseVertex + positions.m_count);
+            for (size_t i = 0; i < positions.m_count; ++i)
+            {
+                Vertex& vertex = geometry.m_vertices[baseVertex + i];
+                vertex.position = XMFLOAT3(ReadGLTFComponent<float>(positions.Element(i, 0), positions.m_componentType),
+                                           ReadGLTFComponent<float>(positions.Element(i, 1), positions.m_componentType),
+                                           ReadGLTFComponent<float>(positions.Element(i, 2), positions.m_componentType));
+                vertex.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+                vertex.normal = hasNormals ? XMFLOAT3(ReadGLTFComponent<float>(normals.Element(i, 0), normals.m_componentType),
+                                                      ReadGLTFComponent<float>(normals.Element(i, 1), normals.m_componentType),
+                                                      ReadGLTFComponent<float>(normals.Element(i, 2), normals.m_componentType))
+                                           : XMFLOAT3(0.0f, 0.0f, 0.0f);
+            }
+
+            // Indexed primitives may use any integer component type, the others are plain triangle lists
+            if (!primitive.indices.empty())
+            {
+                GLTFAccessorView indexView;
+                if (!GetGLTFAccessorView(gltfScene, bufferHolders, primitive.indices, 1, indexView))
+                {
+                    return false;
+                }
+                indices.resize(baseIndex + indexView.m_count);
+                for (size_t i = 0; i < indexView.m_count; ++i)
+                {
+                    UINT index = ReadGLTFComponent<UINT>(indexView.Element(i, 0), indexView.m_componentType);
+                    if (index >= positions.m_count)
+                    {
+                        return false;
+                    }
+                    indices[baseIndex + i] = UINT(baseVertex) + index;
+                }
+            }
+            else
+            {
+                indices.resize(baseIndex + positions.m_count);
+                for (size_t i = 0; i < positions.m_count; ++i)
+                {
+                    indices[baseIndex + i] = UINT(baseVertex + i);
+                }
+            }
+            indices.resize(baseIndex + (indices.size() - baseIndex) / 3 * 3);
+
+            // Area weighted vertex normals where the file has none
+            if (!hasNormals)
+            {
+                for (size_t i = baseIndex; i < indices.size(); i += 3)
+                {
+                    XMVECTOR p0 = XMLoadFloat3(&geometry.m_vertices[indices[i]].position);
+                    XMVECTOR p1 = XMLoadFloat3(&geometry.m_vertices[indices[i + 1]].position);
+                    XMVECTOR p2 = XMLoadFloat3(&geometry.m_vertices[indices[i + 2]].position);
+                    XMVECTOR faceNormal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+                    for (size_t corner = 0; corner < 3; ++corner)
+                    {
+                        XMFLOAT3& normal = geometry.m_vertices[indices[i + corner]].normal;
+                        XMStoreFloat3(&normal, XMVectorAdd(XMLoadFloat3(&normal), faceNormal));
+                    }
+                }
+                for (size_t i = baseVertex; i < geometry.m_vertices.size(); ++i)
+                {
+                    XMFLOAT3& normal = geometry.m_vertices[i].normal;
+                    XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+                }
+            }
+        }
+
+        // 16 bit indices while they can address every vertex, padded to whole 32 bit words for the raw index buffer
+        if (geometry.m_vertices.size() <= 0x10000)
+        {
+            geometry.m_indices.assign(indices.begin(), indices.end());
+            if (geometry.m_indices.size() % 2 != 0)
+            {
+                geometry.m_indices.push_back(0);
+            }
+        }
+        else
+        {
+            geometry.m_wideIndices.swap(indices);
+        }
+        return !geometry.m_vertices.empty();
+    }
+
+    //------------------------------------------------------
+    // GetGLTFNodeMatrix
+    // Local transform of a node, as a row vector matrix
+    //------------------------------------------------------
+    XMMATRIX GetGLTFNodeMatrix(const tinygltf::Node& node)
+    {
+        // glTF matrices are column major for column vectors, which reads as the transposed row vector matrix
+        if (node.matrix.size() == 16)
+        {
+            XMFLOAT4X4 matrix;
+            for (size_t i = 0; i < 16; ++i)
+            {
+                matrix.m[i / 4][i % 4] = float(node.matrix[i]);
+            }
+            return XMLoadFloat4x4(&matrix);
+        }
+
+        XMMATRIX scaleMat = (node.scale.size() == 3) ? XMMatrixScaling(float(node.scale[0]), float(node.scale[1]), float(node.scale[2])) : XMMatrixIdentity();
+        XMMATRIX rotMat = (node.rotation.size() == 4) ? XMMatrixRotationQuaternion(XMVectorSet(float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]), float(node.rotation[3]))) : XMMatrixIdentity();
+        XMMATRIX transMat = (node.translation.size() == 3) ? XMMatrixTranslation(float(node.translation[0]), float(node.translation[1]), float(node.translation[2])) : XMMatrixIdentity();
+        return scaleMat * rotMat * transMat;
+    }
+
+    //------------------------------------------------------
+    // SetPrimitiveTransform
+    // Splits a transform into the scale, roll pitch yaw rotation in degrees and translation the renderers rebuild it
+    // from. Shear from non uniform scales up a hierarchy is lost
+    //------------------------------------------------------
+    void SetPrimitiveTransform(FXMMATRIX transform, Primitive& primitive)
+    {
+        XMVECTOR scale, rotation, translation;
+        if (!XMMatrixDecompose(&scale, &rotation, &translation, transform))
+        {
+            primitive.m_scale = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            primitive.m_rotate = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            XMStoreFloat3(&primitive.m_translate, transform.r[3]);
+            return;
+        }
+        XMStoreFloat3(&primitive.m_scale, scale);
+        XMStoreFloat3(&primitive.m_translate, translation);
+
+        // XMMatrixRotationRollPitchYaw rolls about z, then pitches about x, then yaws about y
+        XMFLOAT3X3 rotMat;
+        XMStoreFloat3x3(&rotMat, XMMatrixRotationQuaternion(rotation));
+        const float pitch = asinf((std::max)(-1.0f, (std::min)(1.0f, -rotMat._32)));
+        const float yaw = atan2f(rotMat._31, rotMat._33);
+        const float roll = atan2f(rotMat._12, rotMat._22);
+        primitive.m_rotate = XMFLOAT3(XMConvertToDegrees(pitch), XMConvertToDegrees(yaw), XMConvertToDegrees(roll));
+    }
+
+    // A mesh placed by a node
+    struct GLTFMeshInstance
+    {
+        UINT m_geometry;
+        std::string m_name;
+        XMFLOAT4X4 m_transform;
+    };
+
+    //------------------------------------------------------
+    // AddGLTFNodeInstances
+    // Walks a node hierarchy, every mesh a node references becomes an instance with the node's world transform
+    //------------------------------------------------------
+    void AddGLTFNodeInstances(const tinygltf::Scene& gltfScene, const std::string& nodeId, FXMMATRIX parentTransform, const std::map<std::string, UINT>& meshGeometries, std::vector<GLTFMeshInstance>& instances, UINT depth)
+    {
+        // Deep enough to be a cycle rather than a hierarchy
+        const UINT MaxNodeDepth = 64;
+        auto nodeIt = gltfScene.nodes.find(nodeId);
+        if (nodeIt == gltfScene.nodes.end() || depth >= MaxNodeDepth)
+        {
+            return;
+        }
+        const tinygltf::Node& node = nodeIt->second;
+        const XMMATRIX transform = GetGLTFNodeMatrix(node) * parentTransform;
+
+        for (const std::string& meshId : node.meshes)
+        {
+            auto geometryIt = meshGeometries.find(meshId);
+            if (geometryIt == meshGeometries.end())
+            {
+                continue;
+            }
+
+            GLTFMeshInstance instance;
+            instance.m_geometry = geometryIt->second;
+            instance.m_name = node.name.empty() ? nodeId : node.name;
+            XMStoreFloat4x4(&instance.m_transform, transform);
+            instances.push_back(instance);
+        }
+
+        for (const std::string& child : node.children)
+        {
+            AddGLTFNodeInstances(gltfScene, child, transform, meshGeometries, instances, depth + 1);
+        }
+    }
+
+    //------------------------------------------------------
+    // ParallelFor
+    // Runs body for every index in [0, count), indices are handed out one at a time to as many threads as
+    // there are cores. The calling thread works too and returns once every index is done
+    //------------------------------------------------------
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body)
+    {
+        std::atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                body(i);
+            }
+        };
+
+        const size_t numThreads = (std::min)(size_t((std::max)(1u, std::thread::hardware_concurrency())), count);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < numThreads; ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    //------------------------------------------------------
+    // LoadGLTFMeshes
+    // Decodes every mesh of the file into geometries, meshes are independent so they are spread over threads.
+    // meshGeometries maps the id of each mesh that decoded to its index in geometries
+    //------------------------------------------------------
+    void LoadGLTFMeshes(const tinygltf::Scene& gltfScene, const std::map<std::string, BufferHolder>& bufferHolders, std::vector<Geometry>& geometries, std::vector<std::string>& meshNames, std::map<std::string, UINT>& meshGeometries)
+    {
+        std::vector<const tinygltf::Mesh*> meshes;
+        for (const auto& mesh : gltfScene.meshes)
+        {
+            meshes.push_back(&mesh.second);
+            meshNames.push_back(mesh.second.name.empty() ? mesh.first : mesh.second.name);
+        }
+
+        std::vector<Geometry> decoded(meshes.size());
+        std::vector<char> succeeded(meshes.size(), 0);
+        ParallelFor(meshes.size(), [&](size_t i)
+        {
+            succeeded[i] = DecodeGLTFMesh(gltfScene, bufferHolders, *meshes[i], decoded[i]) ? 1 : 0;
+        });
+
+        // Keep the meshes that decoded, in file order
+        size_t numKept = 0;
+        auto meshIt = gltfScene.meshes.begin();
+        for (size_t i = 0; i < meshes.size(); ++i, ++meshIt)
+        {
+            if (!succeeded[i])
+            {
+                std::wstringstream wstr;
+                wstr << L"Skipping glTF mesh " << meshNames[i].c_str() << L", no triangles or an accessor out of range" << std::endl;
+                OutputDebugStringW(wstr.str().c_str());
+                continue;
+            }
+            meshGeometries[meshIt->first] = UINT(geometries.size());
+            geometries.push_back(std::move(decoded[i]));
+            meshNames[numKept++] = meshNames[i];
+        }
+        meshNames.resize(numKept);
+    }
+
+
+    //------------------------------------------------------
+    // LoadJSONScene
+    //------------------------------------------------------
+    bool PMScene::LoadJSONScene(const std::string& fileName)
+    {
+        // 1.Read Data from file
+        std::ifstream file(fileName.c_str(), std::ios::binary);
+        if (!file)
+        {
+            OutputDebugString(L"Failed to open file\n");
+            return false;
+        }
+
+        file.seekg(0, file.end);
+        const size_t sz = static_cast<size_t>(file.tellg());
+        std::vector<char> buf(sz);
+
+        if (sz == 0)
+        {
+            OutputDebugString(L"Empty JSON file\n");
             return false;
         }
 
@@ -606,7 +2099,264 @@ namespace DXRPhotonMapper
         file.read(&buf.at(0), static_cast<std::streamsize>(sz));
         file.close();
 
-        return LoadPicoScene(&buf.at(0), static_cast<unsigned int>(buf.size()));
+        return LoadStreamingScene(&buf.at(0), buf.size());
+    }
+
+    //------------------------------------------------------
+    // GetMeshView
+    //------------------------------------------------------
+    MeshView GetMeshView(const Geometry& geometry)
+    {
+        MeshView mesh = { geometry.m_vertices.data(), UINT(geometry.m_vertices.size()), geometry.m_indices.data(), UINT(geometry.m_indices.size()), sizeof(Index) };
+        if (!geometry.m_wideIndices.empty())
+        {
+            mesh.m_indices = geometry.m_wideIndices.data();
+            mesh.m_numIndices = UINT(geometry.m_wideIndices.size());
+            mesh.m_indexSizeInBytes = sizeof(UINT);
+        }
+        else
+        {
+            // Padding to whole 32 bit words is not a triangle
+            mesh.m_numIndices -= mesh.m_numIndices % 3;
+        }
+        return mesh;
+    }
+
+    //------------------------------------------------------
+    // GetPrimitiveMesh
+    //------------------------------------------------------
+    MeshView PMScene::GetPrimitiveMesh(size_t primitiveIndex, Geometry& scratch) const
+    {
+        if (!m_meshViews.empty())
+        {
+            return m_meshViews[m_primitiveMeshes[primitiveIndex]];
+        }
+
+        const Primitive& primitive = m_primitives[primitiveIndex];
+        if (primitive.m_primitiveType == PrimitiveType::Mesh)
+        {
+            return GetMeshView(m_sceneGeoms[m_primitiveMeshes[primitiveIndex]]);
+        }
+
+        GetPrimitiveGeometry(primitive.m_primitiveType, scratch);
+        return GetMeshView(scratch);
+    }
+
+    //------------------------------------------------------
+    // GetMeshInstances
+    //------------------------------------------------------
+    void PMScene::GetMeshInstances(std::vector<size_t>& meshPrimitives, std::vector<UINT>& primitiveInstances) const
+    {
+        meshPrimitives.clear();
+        primitiveInstances.resize(m_primitives.size());
+
+        // Mapped meshes and loaded meshes are told apart by their index, built in shapes by their type
+        std::unordered_map<UINT64, UINT> meshes;
+        for (size_t i = 0; i < m_primitives.size(); ++i)
+        {
+            const PrimitiveType type = m_primitives[i].m_primitiveType;
+            UINT64 key;
+            if (!m_meshViews.empty() || type == PrimitiveType::Mesh)
+            {
+                key = m_primitiveMeshes[i];
+            }
+            else
+            {
+                key = (UINT64(1) << 32) | static_cast<UINT>(type);
+            }
+
+            auto it = meshes.find(key);
+            if (it == meshes.end())
+            {
+                it = meshes.emplace(key, UINT(meshPrimitives.size())).first;
+                meshPrimitives.push_back(i);
+            }
+            primitiveInstances[i] = it->second;
+        }
+    }
+
+    //------------------------------------------------------
+    // GetPrimitiveTransform
+    //------------------------------------------------------
+    XMMATRIX GetPrimitiveTransform(const Primitive& primitive)
+    {
+        XMMATRIX transMat = XMMatrixTranslationFromVector(XMLoadFloat3(&primitive.m_translate));
+        XMMATRIX rotMat = XMMatrixRotationRollPitchYaw(XMConvertToRadians(primitive.m_rotate.x), XMConvertToRadians(primitive.m_rotate.y), XMConvertToRadians(primitive.m_rotate.z));
+        XMMATRIX scaleMat = XMMatrixScaling(primitive.m_scale.x, primitive.m_scale.y, primitive.m_scale.z);
+        return scaleMat * rotMat * transMat;
+    }
+
+    //------------------------------------------------------
+    // GetNormalTransform
+    // Cofactor matrix of the upper 3x3, the inverse transpose scaled by the determinant. Unlike the inverse it
+    // exists for flattened primitives, such as planes scaled to zero along their normal. The shaders normalize
+    // after transforming, only the sign of the determinant is put back so mirrored primitives keep their normals
+    //------------------------------------------------------
+    XMMATRIX GetNormalTransform(FXMMATRIX transform)
+    {
+        const XMVECTOR row0 = transform.r[0];
+        const XMVECTOR row1 = transform.r[1];
+        const XMVECTOR row2 = transform.r[2];
+
+        XMMATRIX normalTransform = XMMatrixIdentity();
+        normalTransform.r[0] = XMVector3Cross(row1, row2);
+        normalTransform.r[1] = XMVector3Cross(row2, row0);
+        normalTransform.r[2] = XMVector3Cross(row0, row1);
+
+        const float determinant = XMVectorGetX(XMVector3Dot(row0, normalTransform.r[0]));
+        if (determinant < 0.0f)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                normalTransform.r[i] = XMVectorNegate(normalTransform.r[i]);
+            }
+        }
+
+        // Keep the w column of the identity, the rows above have a w of 0
+        for (int i = 0; i < 3; ++i)
+        {
+            normalTransform.r[i] = XMVectorSetW(normalTransform.r[i], 0.0f);
+        }
+        return normalTransform;
+    }
+
+    //------------------------------------------------------
+    // Preprocess
+    //------------------------------------------------------
+    void PMScene::Preprocess()
+    {
+        std::vector<size_t> meshPrimitives;
+        std::vector<UINT> primitiveInstances;
+        GetMeshInstances(meshPrimitives, primitiveInstances);
+
+        // 1. Object space bounds of every distinct mesh, instances share them
+        std::vector<XMFLOAT3> meshMin(meshPrimitives.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+        std::vector<XMFLOAT3> meshMax(meshPrimitives.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+        ParallelFor(meshPrimitives.size(), [&](size_t mesh)
+        {
+            Geometry scratch;
+            MeshView view = GetPrimitiveMesh(meshPrimitives[mesh], scratch);
+            if (view.m_numVertices == 0)
+            {
+                return;
+            }
+
+            XMVECTOR minPos = XMLoadFloat3(&view.m_vertices[0].position);
+            XMVECTOR maxPos = minPos;
+            for (UINT i = 1; i < view.m_numVertices; ++i)
+            {
+                XMVECTOR position = XMLoadFloat3(&view.m_vertices[i].position);
+                minPos = XMVectorMin(minPos, position);
+                maxPos = XMVectorMax(maxPos, position);
+            }
+            XMStoreFloat3(&meshMin[mesh], minPos);
+            XMStoreFloat3(&meshMax[mesh], maxPos);
+        });
+
+        // 2. Transforms and world bounds of every primitive
+        m_primitiveWorlds.resize(m_primitives.size());
+        ParallelFor(m_primitives.size(), [&](size_t i)
+        {
+            PrimitiveWorld& world = m_primitiveWorlds[i];
+            const XMMATRIX transform = GetPrimitiveTransform(m_primitives[i]);
+            XMStoreFloat4x4(&world.m_transform, transform);
+            XMStoreFloat4x4(&world.m_normalTransform, GetNormalTransform(transform));
+
+            // Transformed box around the transformed center, each world axis spans the absolute rows
+            const UINT mesh = primitiveInstances[i];
+            const XMVECTOR localMin = XMLoadFloat3(&meshMin[mesh]);
+            const XMVECTOR localMax = XMLoadFloat3(&meshMax[mesh]);
+            const XMVECTOR center = XMVector3TransformCoord(XMVectorScale(XMVectorAdd(localMin, localMax), 0.5f), transform);
+            const XMVECTOR halfExtent = XMVectorScale(XMVectorSubtract(localMax, localMin), 0.5f);
+
+            XMVECTOR worldHalfExtent = XMVectorZero();
+            worldHalfExtent = XMVectorMultiplyAdd(XMVectorSplatX(halfExtent), XMVectorAbs(transform.r[0]), worldHalfExtent);
+            worldHalfExtent = XMVectorMultiplyAdd(XMVectorSplatY(halfExtent), XMVectorAbs(transform.r[1]), worldHalfExtent);
+            worldHalfExtent = XMVectorMultiplyAdd(XMVectorSplatZ(halfExtent), XMVectorAbs(transform.r[2]), worldHalfExtent);
+
+            XMStoreFloat3(&world.m_boundsMin, XMVectorSubtract(center, worldHalfExtent));
+            XMStoreFloat3(&world.m_boundsMax, XMVectorAdd(center, worldHalfExtent));
+        });
+    }
+
+    //------------------------------------------------------
+    // LoadBinaryScene
+    //------------------------------------------------------
+    bool PMScene::LoadBinaryScene(const std::string& fileName)
+    {
+        std::shared_ptr<PMMappedFile> file = std::make_shared<PMMappedFile>();
+        if (!file->Open(fileName))
+        {
+            OutputDebugString(L"Failed to map binary scene file\n");
+            return false;
+        }
+
+        if (!SceneBinary::Read(file, *this))
+        {
+            return false;
+        }
+
+        std::wstringstream wstr;
+        wstr << L"Mapped scene: " << m_primitives.size() << L" primitives, " << m_meshViews.size() << L" meshes, " << m_materials.size() << L" materials, " << m_lights.size() << L" lights" << std::endl;
+        OutputDebugStringW(wstr.str().c_str());
+        return true;
+    }
+
+    //------------------------------------------------------
+    // SaveBinaryScene
+    //------------------------------------------------------
+    bool PMScene::SaveBinaryScene(const std::string& fileName) const
+    {
+        return SceneBinary::Write(*this, fileName);
+    }
+
+    //------------------------------------------------------
+    // RequestTextures
+    //------------------------------------------------------
+    void PMScene::RequestTextures()
+    {
+        const std::string baseDir = tinygltf::GetBaseDir(m_fileName);
+        for (Material& material : m_materials)
+        {
+            const std::string& textureFile = material.m_albedoTextureFile;
+            if (textureFile.empty())
+            {
+                material.m_albedoTexture = NoTexture;
+                continue;
+            }
+
+            const bool absolute = textureFile.find(':') != std::string::npos || textureFile[0] == '/' || textureFile[0] == '\\';
+            material.m_albedoTexture = m_textureCache->Request((absolute || baseDir.empty()) ? textureFile : baseDir + "/" + textureFile);
+        }
+    }
+
+    //------------------------------------------------------
+    // LoadScene
+    //------------------------------------------------------
+    bool PMScene::LoadScene(const std::string& fileName)
+    {
+        std::string ext = getFilePathExtension(fileName);
+        bool loaded;
+        if (ext.compare("pmsb") == 0)
+        {
+            loaded = LoadBinaryScene(fileName);
+        }
+        else if (ext.compare("gltf") == 0 || ext.compare("glb") == 0)
+        {
+            loaded = LoadGLTFScene(fileName);
+        }
+        else
+        {
+            loaded = LoadJSONScene(fileName);
+        }
+
+        if (loaded)
+        {
+            m_fileName = fileName;
+            Preprocess();
+            RequestTextures();
+        }
+        return loaded;
     }
 
     //------------------------------------------------------
@@ -619,10 +2369,32 @@ namespace DXRPhotonMapper
         std::string err;
         std::string ext = getFilePathExtension(fileName);
 
+        // Binary glTF is read in place from a mapping, its pages are only touched as the meshes get decoded
+        PMMappedFile mappedFile;
+        bool mapped = false;
+        if (ext.compare("glb") == 0 && mappedFile.Open(fileName))
+        {
+            mapped = LoadMappedGLB(mappedFile, m_gltfScene, m_gltfBufferHolders, err);
+            if (!mapped)
+            {
+                std::wstringstream wstr;
+                wstr << L"Reading " << fileName.c_str() << L" through the glTF loader: " << err.c_str() << std::endl;
+                OutputDebugStringW(wstr.str().c_str());
+
+                m_gltfScene = tinygltf::Scene();
+                m_gltfBufferHolders.clear();
+                err.clear();
+            }
+        }
+
         // Load the GLTF file
         const bool ret = [&]
         {
-            if (ext.compare("glb") == 0)
+            if (mapped)
+            {
+                return true;
+            }
+            else if (ext.compare("glb") == 0)
             {
                 // assume binary glTF.
                 return loader.LoadBinaryFromFile(&m_gltfScene, &err, fileName.c_str());
@@ -649,10 +2421,86 @@ namespace DXRPhotonMapper
         // Print the scene info to console
         PrintGLTFScene(m_gltfScene);
 
-        // Read all raw buffers
-        LoadGLTFBufferViews(m_gltfScene, m_gltfBufferHolders);
+        // Read all raw buffers, a mapped file has its buffer views already
+        if (!mapped)
+        {
+            LoadGLTFBufferViews(m_gltfScene, m_gltfBufferHolders);
+        }
+
+        std::vector<std::string> meshNames;
+        std::map<std::string, UINT> meshGeometries;
+        const size_t firstMesh = m_sceneGeoms.size();
+        LoadGLTFMeshes(m_gltfScene, m_gltfBufferHolders, m_sceneGeoms, meshNames, meshGeometries);
+
+        // The buffer views point into the parsed or mapped file, which goes away here
+        m_gltfBufferHolders.clear();
+
+        // glTF materials are techniques, draw every mesh with a plain white one
+        MaterialIndexTable materialIndices;
+        BuildMaterialIndexTable(m_materials, materialIndices);
+        int materialID = StringToMaterialIndex("gltfDefault", materialIndices);
+        if (materialID < 0)
+        {
+            Material material = {};
+            material.m_name = "gltfDefault";
+            material.m_materialFlags = MaterialFlag::BSDF_DIFFUSE;
+
+            DiffuseMat diffuseMat = {};
+            diffuseMat.m_albedo = XMFLOAT3(0.8f, 0.8f, 0.8f);
+            diffuseMat.m_matIdentifier = MaterialFlag::BSDF_DIFFUSE;
+            material.m_baseMaterials.push_back(diffuseMat);
+
+            materialID = int(m_materials.size());
+            m_materials.push_back(material);
+        }
+
+        // Every mesh a node of the default scene places is an instance of it, sharing its geometry
+        std::vector<GLTFMeshInstance> instances;
+        auto sceneIt = m_gltfScene.scenes.find(m_gltfScene.defaultScene);
+        if (sceneIt == m_gltfScene.scenes.end())
+        {
+            sceneIt = m_gltfScene.scenes.begin();
+        }
+        if (sceneIt != m_gltfScene.scenes.end())
+        {
+            for (const std::string& nodeId : sceneIt->second)
+            {
+                AddGLTFNodeInstances(m_gltfScene, nodeId, XMMatrixIdentity(), meshGeometries, instances, 0);
+            }
+        }
+
+        // Without a node hierarchy every mesh is placed once, in object space
+        if (instances.empty())
+        {
+            XMFLOAT4X4 identity;
+            XMStoreFloat4x4(&identity, XMMatrixIdentity());
+            for (size_t i = 0; i < meshNames.size(); ++i)
+            {
+                GLTFMeshInstance instance = { UINT(firstMesh + i), meshNames[i], identity };
+                instances.push_back(instance);
+            }
+        }
+
+        m_primitiveMeshes.resize(m_primitives.size(), 0);
+        for (const GLTFMeshInstance& instance : instances)
+        {
+            Primitive primitive = {};
+            primitive.m_name = instance.m_name;
+            primitive.m_primitiveType = PrimitiveType::Mesh;
+            primitive.m_materialID = materialID;
+            SetPrimitiveTransform(XMLoadFloat4x4(&instance.m_transform), primitive);
+
+            SceneBufferDesc sceneBufferDesc = {};
+            sceneBufferDesc.vbIndex = UINT(m_primitives.size());
+            m_sceneBufferDesc.push_back(sceneBufferDesc);
 
-        LoadGLTFMeshes();
+            m_primitives.push_back(primitive);
+            m_primitiveMeshes.push_back(instance.m_geometry);
+        }
+
+        std::wstringstream wstr;
+        wstr << L"Loaded glTF: " << meshNames.size() << L" meshes, " << instances.size() << L" instances" << std::endl;
+        OutputDebugStringW(wstr.str().c_str());
 
         return true;
     }
@@ -2,17 +2,22 @@
 
 #include <array>
 #include <map>
+#include <memory>
 
 #include "RaytracingHlslCompat.h"
+#include "PMTextureCache.h"
 
 namespace DXRPhotonMapper
 {
     typedef unsigned char ByteBuffer;
 
+    // Triangle list with 16 bit indices while every vertex can be addressed with them, 32 bit ones otherwise.
+    // Only one of the index vectors is used, padded to a multiple of 4 bytes for the raw index buffer
     struct Geometry
     {
         std::vector<Vertex> m_vertices;
         std::vector<Index> m_indices;
+        std::vector<UINT> m_wideIndices;
     };
 
     enum class MaterialFlag
@@ -25,6 +30,16 @@ namespace DXRPhotonMapper
         BSDF_ALL = BSDF_DIFFUSE | BSDF_GLOSSY | BSDF_SPECULAR | BSDF_REFLECTION | BSDF_TRANSMISSION
     };
 
+    inline MaterialFlag operator|(MaterialFlag a, MaterialFlag b)
+    {
+        return static_cast<MaterialFlag>(static_cast<int>(a) | static_cast<int>(b));
+    }
+
+    inline bool HasMaterialFlag(MaterialFlag flags, MaterialFlag flag)
+    {
+        return (static_cast<int>(flags) & static_cast<int>(flag)) != 0;
+    }
+
     struct BaseMat
     {
         DirectX::XMFLOAT3 m_albedo;
@@ -55,12 +70,16 @@ namespace DXRPhotonMapper
         std::string m_name;
         MaterialFlag m_materialFlags;
         std::vector<BaseMat> m_baseMaterials;
+        float m_refractiveIndex;    // Only used when BSDF_TRANSMISSION is set
+        std::string m_albedoTextureFile;    // As written in the scene file, relative to it. Empty for a constant albedo
+        TextureHandle m_albedoTexture;      // Filled by LoadScene from m_albedoTextureFile, not sampled by the shaders yet
     };
 
     enum class PrimitiveType
     {
         SquarePlane = 0,
         Cube,
+        Mesh,       // Loaded mesh, see PMScene::m_primitiveMeshes
         Error,
     };
 
@@ -127,6 +146,39 @@ namespace DXRPhotonMapper
         UINT m_height;
     };
 
+    // Vertices and indices of one mesh, owned by whoever loaded the scene.
+    // The index data is padded to a multiple of 4 bytes
+    struct MeshView
+    {
+        const Vertex* m_vertices;
+        UINT m_numVertices;
+        const void* m_indices;
+        UINT m_numIndices;
+        UINT m_indexSizeInBytes;    // 2 or 4
+    };
+
+    // Placement of a primitive in the world, see PMScene::Preprocess
+    struct PrimitiveWorld
+    {
+        DirectX::XMFLOAT4X4 m_transform;        // Object to world, scale then rotation then translation
+        DirectX::XMFLOAT4X4 m_normalTransform;  // Inverse transpose of the transform's 3x3, up to a positive scale
+        DirectX::XMFLOAT3 m_boundsMin;          // World space bounds of the transformed mesh
+        DirectX::XMFLOAT3 m_boundsMax;
+    };
+
+    //------------------------------------------------------
+    // GetPrimitiveGeometry
+    // Vertices and indices of the built in shapes, in object space
+    //------------------------------------------------------
+    void GetPrimitiveGeometry(PrimitiveType type, Geometry& geometry);
+
+    //------------------------------------------------------
+    // GetMeshView
+    //------------------------------------------------------
+    MeshView GetMeshView(const Geometry& geometry);
+
+    class PMMappedFile;
+
     typedef struct
     {
         const ByteBuffer* m_bufferStart;
@@ -148,9 +200,31 @@ namespace DXRPhotonMapper
 
         std::map<std::string, BufferHolder> m_gltfBufferHolders;
 
+        // Prebuilt meshes of a compiled scene, they replace m_sceneGeoms and the built in shapes
+        std::vector<MeshView> m_meshViews;
+
+        // Mesh of each primitive in m_meshViews, or in m_sceneGeoms for Mesh primitives. Empty when
+        // every primitive is a built in shape
+        std::vector<UINT> m_primitiveMeshes;
+        std::shared_ptr<PMMappedFile> m_binarySceneFile;
+
+        // One per primitive, filled by Preprocess once the scene is loaded
+        std::vector<PrimitiveWorld> m_primitiveWorlds;
+
+        // File the scene was loaded from by LoadScene, watched for edits to reload
+        std::string m_fileName;
+
+        // Decodes the textures materials use. Shared with the scenes this one is reloaded into, so textures
+        // already decoded are not decoded again and material texture handles stay the same
+        std::shared_ptr<PMTextureCache> m_textureCache;
+
     private:
 
-        bool LoadPicoScene(const char *str, unsigned int length);
+        // listItems writes every primitive, material and light found to the debug output
+        bool LoadPicoScene(const char *str, unsigned int length, bool listItems = true);
+
+        // Fills the scene in one pass over the text, without building a DOM first
+        bool LoadStreamingScene(const char* str, size_t length);
 
 
 
@@ -174,6 +248,60 @@ namespace DXRPhotonMapper
         // LoadJSONScene
         //------------------------------------------------------
         bool LoadJSONScene(const std::string& fileName);
+
+        //------------------------------------------------------
+        // LoadBinaryScene
+        // Maps a scene compiled by SaveBinaryScene, the meshes are used from the mapping without a copy
+        //------------------------------------------------------
+        bool LoadBinaryScene(const std::string& fileName);
+
+        //------------------------------------------------------
+        // SaveBinaryScene
+        //------------------------------------------------------
+        bool SaveBinaryScene(const std::string& fileName) const;
+
+        //------------------------------------------------------
+        // GetPrimitiveMesh
+        // Mesh a primitive is drawn with. Built in shapes are built into scratch, which has to outlive the view
+        //------------------------------------------------------
+        MeshView GetPrimitiveMesh(size_t primitiveIndex, Geometry& scratch) const;
+
+        //------------------------------------------------------
+        // GetMeshInstances
+        // Groups the primitives drawn with the same mesh, so each distinct mesh is built once and instanced.
+        // meshPrimitives gets the first primitive of every distinct mesh, primitiveInstances the index into
+        // meshPrimitives of each primitive's mesh
+        //------------------------------------------------------
+        void GetMeshInstances(std::vector<size_t>& meshPrimitives, std::vector<UINT>& primitiveInstances) const;
+
+        //------------------------------------------------------
+        // Preprocess
+        // Composes the transform, normal transform and world bounds of every primitive into m_primitiveWorlds.
+        // Meshes are measured once however many primitives instance them, both passes run across threads
+        //------------------------------------------------------
+        void Preprocess();
+
+        //------------------------------------------------------
+        // RequestTextures
+        // Queues the albedo texture of every material on m_textureCache and fills in their handles. Decoding
+        // runs on the cache's threads, nothing waits for it here
+        //------------------------------------------------------
+        void RequestTextures();
+
+        //------------------------------------------------------
+        // LoadScene
+        // Picks the loader from the file extension, .json, .pmsb, .gltf or .glb, then preprocesses the scene and
+        // requests its textures
+        //------------------------------------------------------
+        bool LoadScene(const std::string& fileName);
+
+        //------------------------------------------------------
+        // BenchmarkJSONLoading
+        // Times the picojson loader against the streaming loader on a synthetic scene, both filling in the whole
+        // scene, and material name
+        // resolution through the name table against a search of the material list
+        //------------------------------------------------------
+        static void BenchmarkJSONLoading(size_t numPrimitives, size_t numMaterials);
     };
 
 }
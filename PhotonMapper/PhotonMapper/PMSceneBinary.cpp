@@ -0,0 +1,404 @@
+#include "stdafx.h"
+#include "PMSceneBinary.h"
+#include "PMScene.h"
+
+#include <fstream>
+
+namespace DXRPhotonMapper
+{
+    namespace SceneBinary
+    {
+        namespace
+        {
+            inline UINT64 AlignSection(UINT64 offset)
+            {
+                return (offset + SectionAlignment - 1) & ~UINT64(SectionAlignment - 1);
+            }
+
+            NameRef AddName(std::vector<char>& names, const std::string& name)
+            {
+                NameRef nameRef = { UINT(names.size()), UINT(name.size()) };
+                names.insert(names.end(), name.begin(), name.end());
+                return nameRef;
+            }
+
+            // Section as a typed table, null if it does not lie inside the file
+            template <typename T>
+            const T* GetTable(const PMMappedFile& file, const Section& section)
+            {
+                if (section.offset % SectionAlignment != 0 || section.offset > file.GetSize() ||
+                    section.count > (file.GetSize() - section.offset) / sizeof(T))
+                {
+                    return nullptr;
+                }
+                return reinterpret_cast<const T*>(file.GetData() + section.offset);
+            }
+
+            inline bool InRange(UINT first, UINT count, UINT64 size)
+            {
+                return UINT64(first) + count <= size;
+            }
+        }
+
+        //------------------------------------------------------
+        // Write
+        //------------------------------------------------------
+        bool Write(const PMScene& scene, const std::string& fileName)
+        {
+            Header header = {};
+            header.magic = Magic;
+            header.version = Version;
+            header.camera.eye = scene.m_camera.m_eye;
+            header.camera.ref = scene.m_camera.m_ref;
+            header.camera.up = scene.m_camera.m_up;
+            header.camera.fov = scene.m_camera.m_fov;
+            header.camera.width = scene.m_camera.m_width;
+            header.camera.height = scene.m_camera.m_height;
+
+            std::vector<PrimitiveRecord> primitives(scene.m_primitives.size());
+            std::vector<MaterialRecord> materials(scene.m_materials.size());
+            std::vector<LightRecord> lights(scene.m_lights.size());
+            std::vector<MeshRecord> meshes;
+            std::vector<Vertex> vertices;
+            std::vector<UINT8> indices;
+            std::vector<char> names;
+
+            auto addMesh = [&](const MeshView& meshView)
+            {
+                MeshRecord mesh = { UINT(vertices.size()), meshView.m_numVertices, UINT(indices.size()), meshView.m_numIndices, meshView.m_indexSizeInBytes };
+                vertices.insert(vertices.end(), meshView.m_vertices, meshView.m_vertices + meshView.m_numVertices);
+
+                const UINT8* indexBytes = static_cast<const UINT8*>(meshView.m_indices);
+                indices.insert(indices.end(), indexBytes, indexBytes + meshView.m_numIndices * meshView.m_indexSizeInBytes);
+                indices.resize((indices.size() + 3) & ~size_t(3), 0);
+
+                meshes.push_back(mesh);
+                return UINT(meshes.size() - 1);
+            };
+
+            // Meshes the scene loaded keep their indices, built in shapes get one mesh per shape
+            const bool mapped = !scene.m_meshViews.empty();
+            const size_t numLoadedMeshes = mapped ? scene.m_meshViews.size() : scene.m_sceneGeoms.size();
+            for (size_t i = 0; i < numLoadedMeshes; ++i)
+            {
+                addMesh(mapped ? scene.m_meshViews[i] : GetMeshView(scene.m_sceneGeoms[i]));
+            }
+            std::map<UINT, UINT> shapeMeshes;
+
+            for (size_t i = 0; i < scene.m_primitives.size(); ++i)
+            {
+                const Primitive& primitive = scene.m_primitives[i];
+                PrimitiveRecord& record = primitives[i];
+                record.name = AddName(names, primitive.m_name);
+                record.primitiveType = static_cast<UINT>(primitive.m_primitiveType);
+                record.materialID = primitive.m_materialID;
+                record.translate = primitive.m_translate;
+                record.rotate = primitive.m_rotate;
+                record.scale = primitive.m_scale;
+
+                if (mapped || primitive.m_primitiveType == PrimitiveType::Mesh)
+                {
+                    record.meshIndex = scene.m_primitiveMeshes[i];
+                    continue;
+                }
+
+                auto shapeMesh = shapeMeshes.find(record.primitiveType);
+                if (shapeMesh == shapeMeshes.end())
+                {
+                    Geometry geometry;
+                    UINT meshIndex = addMesh(scene.GetPrimitiveMesh(i, geometry));
+                    shapeMesh = shapeMeshes.insert(std::make_pair(record.primitiveType, meshIndex)).first;
+                }
+                record.meshIndex = shapeMesh->second;
+            }
+
+            for (size_t i = 0; i < scene.m_materials.size(); ++i)
+            {
+                const Material& material = scene.m_materials[i];
+                MaterialRecord& record = materials[i];
+                record.name = AddName(names, material.m_name);
+                record.materialFlags = static_cast<UINT>(material.m_materialFlags);
+                record.albedo = material.m_baseMaterials.empty() ? XMFLOAT3(0.0f, 0.0f, 0.0f) : material.m_baseMaterials[0].m_albedo;
+                record.refractiveIndex = material.m_refractiveIndex;
+                record.albedoTexture = AddName(names, material.m_albedoTextureFile);
+            }
+
+            for (size_t i = 0; i < scene.m_lights.size(); ++i)
+            {
+                const Light& light = scene.m_lights[i];
+                LightRecord& record = lights[i];
+                record.name = AddName(names, light.m_name);
+                record.lightType = static_cast<UINT>(light.m_lightType);
+                record.intensity = light.m_lightIntensity;
+                record.color = light.m_lightColor;
+                record.translate = light.m_translate;
+                record.rotate = light.m_rotate;
+                record.scale = light.m_scale;
+
+                switch (light.m_lightType)
+                {
+                case LightType::PointLight:
+                    record.dropOff = light.LightDesc.pointLight.dropOff;
+                    break;
+                case LightType::AreaLight:
+                    record.twoSided = light.LightDesc.areaLight.isTwoSided ? 1 : 0;
+                    break;
+                case LightType::SpotLight:
+                    record.dropOff = light.LightDesc.spotLight.dropOff;
+                    record.coneAngle = light.LightDesc.spotLight.coneAngle;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            // Lay the sections out after the header
+            const void* sectionData[NumSections] = { primitives.data(), materials.data(), lights.data(), meshes.data(), vertices.data(), indices.data(), names.data() };
+            const size_t sectionCounts[NumSections] = { primitives.size(), materials.size(), lights.size(), meshes.size(), vertices.size(), indices.size(), names.size() };
+            const size_t elementSizes[NumSections] = { sizeof(PrimitiveRecord), sizeof(MaterialRecord), sizeof(LightRecord), sizeof(MeshRecord), sizeof(Vertex), sizeof(UINT8), sizeof(char) };
+
+            UINT64 offset = AlignSection(sizeof(Header));
+            for (UINT i = 0; i < NumSections; ++i)
+            {
+                header.sections[i].offset = offset;
+                header.sections[i].count = sectionCounts[i];
+                offset = AlignSection(offset + sectionCounts[i] * elementSizes[i]);
+            }
+            header.fileSize = offset;
+
+            std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                OutputDebugString(L"Failed to create binary scene file\n");
+                return false;
+            }
+
+            static const char padding[SectionAlignment] = {};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            UINT64 written = sizeof(header);
+            for (UINT i = 0; i < NumSections; ++i)
+            {
+                file.write(padding, std::streamsize(header.sections[i].offset - written));
+                file.write(static_cast<const char*>(sectionData[i]), std::streamsize(sectionCounts[i] * elementSizes[i]));
+                written = header.sections[i].offset + sectionCounts[i] * elementSizes[i];
+            }
+            file.write(padding, std::streamsize(header.fileSize - written));
+
+            if (!file)
+            {
+                OutputDebugString(L"Failed to write binary scene file\n");
+                return false;
+            }
+            return true;
+        }
+
+        //------------------------------------------------------
+        // Read
+        //------------------------------------------------------
+        bool Read(const std::shared_ptr<PMMappedFile>& file, PMScene& scene)
+        {
+            if (file->GetSize() < sizeof(Header))
+            {
+                OutputDebugString(L"Binary scene file is too small\n");
+                return false;
+            }
+
+            const Header& header = *reinterpret_cast<const Header*>(file->GetData());
+            if (header.magic != Magic || header.version != Version || header.fileSize != file->GetSize())
+            {
+                OutputDebugString(L"Not a binary scene file of this version\n");
+                return false;
+            }
+
+            const PrimitiveRecord* primitives = GetTable<PrimitiveRecord>(*file, header.sections[SectionPrimitives]);
+            const MaterialRecord* materials = GetTable<MaterialRecord>(*file, header.sections[SectionMaterials]);
+            const LightRecord* lights = GetTable<LightRecord>(*file, header.sections[SectionLights]);
+            const MeshRecord* meshes = GetTable<MeshRecord>(*file, header.sections[SectionMeshes]);
+            const Vertex* vertices = GetTable<Vertex>(*file, header.sections[SectionVertices]);
+            const UINT8* indices = GetTable<UINT8>(*file, header.sections[SectionIndices]);
+            const char* names = GetTable<char>(*file, header.sections[SectionNames]);
+            if (!primitives || !materials || !lights || !meshes || !vertices || !indices || !names)
+            {
+                OutputDebugString(L"Binary scene section out of range\n");
+                return false;
+            }
+
+            const UINT64 numNames = header.sections[SectionNames].count;
+            const UINT64 numMeshes = header.sections[SectionMeshes].count;
+            const UINT64 numMaterials = header.sections[SectionMaterials].count;
+            auto name = [&](const NameRef& nameRef)
+            {
+                return InRange(nameRef.offset, nameRef.length, numNames) ? std::string(names + nameRef.offset, nameRef.length) : std::string();
+            };
+
+            scene.m_camera.m_eye = header.camera.eye;
+            scene.m_camera.m_ref = header.camera.ref;
+            scene.m_camera.m_up = header.camera.up;
+            scene.m_camera.m_fov = header.camera.fov;
+            scene.m_camera.m_width = header.camera.width;
+            scene.m_camera.m_height = header.camera.height;
+
+            // Meshes point into the mapping
+            scene.m_meshViews.resize(size_t(numMeshes));
+            for (size_t i = 0; i < scene.m_meshViews.size(); ++i)
+            {
+                const MeshRecord& mesh = meshes[i];
+                const UINT64 indexBytes = (UINT64(mesh.numIndices) * mesh.indexSizeInBytes + 3) & ~UINT64(3);
+                if (!InRange(mesh.firstVertex, mesh.numVertices, header.sections[SectionVertices].count) ||
+                    (mesh.indexSizeInBytes != 2 && mesh.indexSizeInBytes != 4) || mesh.indexOffset % 4 != 0 ||
+                    mesh.indexOffset + indexBytes > header.sections[SectionIndices].count)
+                {
+                    OutputDebugString(L"Binary scene mesh out of range\n");
+                    return false;
+                }
+                scene.m_meshViews[i] = { vertices + mesh.firstVertex, mesh.numVertices, indices + mesh.indexOffset, mesh.numIndices, mesh.indexSizeInBytes };
+            }
+
+            const size_t numPrimitives = size_t(header.sections[SectionPrimitives].count);
+            scene.m_primitives.resize(numPrimitives);
+            scene.m_primitiveMeshes.resize(numPrimitives);
+            scene.m_sceneBufferDesc.resize(numPrimitives);
+            for (size_t i = 0; i < numPrimitives; ++i)
+            {
+                const PrimitiveRecord& record = primitives[i];
+                if (record.meshIndex >= numMeshes)
+                {
+                    OutputDebugString(L"Binary scene primitive without a mesh\n");
+                    return false;
+                }
+                if (record.primitiveType >= UINT(PrimitiveType::Error))
+                {
+                    OutputDebugString(L"Binary scene primitive of unknown type\n");
+                    return false;
+                }
+                // -1 is a primitive without a material, as the JSON loader leaves one naming no known material
+                if (record.materialID < -1 || (record.materialID >= 0 && UINT64(record.materialID) >= numMaterials))
+                {
+                    OutputDebugString(L"Binary scene primitive material out of range\n");
+                    return false;
+                }
+
+                Primitive& primitive = scene.m_primitives[i];
+                primitive.m_name = name(record.name);
+                primitive.m_primitiveType = static_cast<PrimitiveType>(record.primitiveType);
+                primitive.m_materialID = record.materialID;
+                primitive.m_translate = record.translate;
+                primitive.m_rotate = record.rotate;
+                primitive.m_scale = record.scale;
+                scene.m_primitiveMeshes[i] = record.meshIndex;
+
+                SceneBufferDesc sceneBufferDesc = {};
+                sceneBufferDesc.vbIndex = UINT(i);
+                scene.m_sceneBufferDesc[i] = sceneBufferDesc;
+            }
+
+            scene.m_materials.resize(size_t(numMaterials));
+            for (size_t i = 0; i < scene.m_materials.size(); ++i)
+            {
+                const MaterialRecord& record = materials[i];
+                Material& material = scene.m_materials[i];
+                material.m_name = name(record.name);
+                material.m_materialFlags = static_cast<MaterialFlag>(record.materialFlags);
+                material.m_refractiveIndex = record.refractiveIndex;
+                material.m_albedoTextureFile = name(record.albedoTexture);
+
+                BaseMat baseMaterial = {};
+                baseMaterial.m_albedo = record.albedo;
+                baseMaterial.m_matIdentifier = material.m_materialFlags;
+                material.m_baseMaterials.assign(1, baseMaterial);
+            }
+
+            const size_t numLights = size_t(header.sections[SectionLights].count);
+            scene.m_lights.resize(numLights);
+            for (size_t i = 0; i < numLights; ++i)
+            {
+                const LightRecord& record = lights[i];
+                Light& light = scene.m_lights[i];
+                light.m_name = name(record.name);
+                light.m_lightType = static_cast<LightType>(record.lightType);
+                light.m_lightIntensity = record.intensity;
+                light.m_lightColor = record.color;
+                light.m_translate = record.translate;
+                light.m_rotate = record.rotate;
+                light.m_scale = record.scale;
+
+                switch (light.m_lightType)
+                {
+                case LightType::PointLight:
+                    light.LightDesc.pointLight.dropOff = record.dropOff;
+                    break;
+                case LightType::AreaLight:
+                    light.LightDesc.areaLight.isTwoSided = record.twoSided != 0;
+                    break;
+                case LightType::SpotLight:
+                    light.LightDesc.spotLight.dropOff = record.dropOff;
+                    light.LightDesc.spotLight.coneAngle = record.coneAngle;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            scene.m_binarySceneFile = file;
+            return true;
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMMappedFile::PMMappedFile() :
+        m_file(INVALID_HANDLE_VALUE),
+        m_mapping(nullptr),
+        m_data(nullptr),
+        m_size(0)
+    {
+    }
+
+    //------------------------------------------------------
+    // Destructor
+    //------------------------------------------------------
+    PMMappedFile::~PMMappedFile()
+    {
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+    }
+
+    //------------------------------------------------------
+    // Open
+    //------------------------------------------------------
+    bool PMMappedFile::Open(const std::string& fileName)
+    {
+        m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        {
+            return false;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping)
+        {
+            return false;
+        }
+
+        m_data = static_cast<const UINT8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        m_size = size_t(size.QuadPart);
+        return m_data != nullptr;
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "RaytracingHlslCompat.h"
+
+namespace DXRPhotonMapper
+{
+    class PMScene;
+    class PMMappedFile;
+
+    // Compiled scene file (.pmsb), laid out to be used straight from a read only mapping of the file.
+    // A header is followed by fixed size tables of primitives, materials, lights and meshes, the vertex
+    // and index blobs of the meshes and a table of names. Every section starts on SectionAlignment.
+    // The index section is counted in bytes, each mesh's 16 or 32 bit indices start on a 4 byte boundary.
+    namespace SceneBinary
+    {
+        const UINT Magic = 0x42534D50;     // "PMSB"
+        const UINT Version = 3;
+        const UINT SectionAlignment = 64;
+
+        enum SectionType
+        {
+            SectionPrimitives = 0,
+            SectionMaterials,
+            SectionLights,
+            SectionMeshes,
+            SectionVertices,
+            SectionIndices,
+            SectionNames,
+            NumSections
+        };
+
+        // Byte offset from the start of the file, and element count
+        struct Section
+        {
+            UINT64 offset;
+            UINT64 count;
+        };
+
+        // Characters in the names section
+        struct NameRef
+        {
+            UINT offset;
+            UINT length;
+        };
+
+        struct CameraRecord
+        {
+            XMFLOAT3 eye;
+            XMFLOAT3 ref;
+            XMFLOAT3 up;
+            float fov;
+            UINT width;
+            UINT height;
+        };
+
+        struct Header
+        {
+            UINT magic;
+            UINT version;
+            UINT64 fileSize;
+            CameraRecord camera;
+            Section sections[NumSections];
+        };
+
+        struct PrimitiveRecord
+        {
+            NameRef name;
+            UINT primitiveType;
+            int materialID;
+            UINT meshIndex;
+            XMFLOAT3 translate;
+            XMFLOAT3 rotate;
+            XMFLOAT3 scale;
+        };
+
+        struct MaterialRecord
+        {
+            NameRef name;
+            UINT materialFlags;
+            XMFLOAT3 albedo;
+            float refractiveIndex;
+            NameRef albedoTexture;
+        };
+
+        struct LightRecord
+        {
+            NameRef name;
+            UINT lightType;
+            float intensity;
+            XMFLOAT3 color;
+            XMFLOAT3 translate;
+            XMFLOAT3 rotate;
+            XMFLOAT3 scale;
+            float dropOff;
+            float coneAngle;
+            UINT twoSided;
+        };
+
+        // Vertex range and index bytes of a mesh
+        struct MeshRecord
+        {
+            UINT firstVertex;
+            UINT numVertices;
+            UINT indexOffset;
+            UINT numIndices;
+            UINT indexSizeInBytes;
+        };
+
+        static_assert(sizeof(Header) == 64 + 16 * NumSections, "Scene binary header layout changed, bump Version");
+        static_assert(sizeof(PrimitiveRecord) == 56, "Scene binary primitive layout changed, bump Version");
+        static_assert(sizeof(MaterialRecord) == 36, "Scene binary material layout changed, bump Version");
+        static_assert(sizeof(LightRecord) == 76, "Scene binary light layout changed, bump Version");
+
+        //------------------------------------------------------
+        // Write
+        // Compiles a loaded scene, whatever it was loaded from. Primitives of the same shape share one mesh
+        //------------------------------------------------------
+        bool Write(const PMScene& scene, const std::string& fileName);
+
+        //------------------------------------------------------
+        // Read
+        // Fills the scene from a mapped file after checking every section lies inside it. The meshes stay in
+        // the mapping, the scene keeps the file mapped for as long as it points into it
+        //------------------------------------------------------
+        bool Read(const std::shared_ptr<PMMappedFile>& file, PMScene& scene);
+    }
+
+    // Read only mapping of a whole file, unmapped when the last scene using it goes away
+    class PMMappedFile
+    {
+    private:
+        HANDLE m_file;
+        HANDLE m_mapping;
+        const UINT8* m_data;
+        size_t m_size;
+
+    public:
+        //------------------------------------------------------
+        // Constructor / Destructor
+        //------------------------------------------------------
+        PMMappedFile();
+        ~PMMappedFile();
+
+        PMMappedFile(const PMMappedFile&) = delete;
+        PMMappedFile& operator=(const PMMappedFile&) = delete;
+
+        //------------------------------------------------------
+        // Open
+        //------------------------------------------------------
+        bool Open(const std::string& fileName);
+
+        const UINT8* GetData() const { return m_data; }
+        size_t GetSize() const { return m_size; }
+    };
+}
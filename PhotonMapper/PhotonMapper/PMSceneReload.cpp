@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "PMSceneReload.h"
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        bool SameFloat3(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            return a.x == b.x && a.y == b.y && a.z == b.z;
+        }
+
+        template <typename T>
+        bool SameElements(const std::vector<T>& a, const std::vector<T>& b)
+        {
+            return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+        }
+
+        bool SameMesh(const MeshView& a, const MeshView& b)
+        {
+            if (a.m_numVertices != b.m_numVertices || a.m_numIndices != b.m_numIndices || a.m_indexSizeInBytes != b.m_indexSizeInBytes)
+            {
+                return false;
+            }
+            return memcmp(a.m_vertices, b.m_vertices, a.m_numVertices * sizeof(Vertex)) == 0 &&
+                memcmp(a.m_indices, b.m_indices, a.m_numIndices * a.m_indexSizeInBytes) == 0;
+        }
+
+        // Primitives, the meshes they are drawn with and the mesh data
+        bool SameTopology(const PMScene& current, const PMScene& reloaded)
+        {
+            if (current.m_primitives.size() != reloaded.m_primitives.size() ||
+                current.m_primitiveMeshes != reloaded.m_primitiveMeshes ||
+                current.m_sceneGeoms.size() != reloaded.m_sceneGeoms.size() ||
+                current.m_meshViews.size() != reloaded.m_meshViews.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < current.m_primitives.size(); ++i)
+            {
+                if (current.m_primitives[i].m_primitiveType != reloaded.m_primitives[i].m_primitiveType)
+                {
+                    return false;
+                }
+            }
+
+            for (size_t i = 0; i < current.m_sceneGeoms.size(); ++i)
+            {
+                const Geometry& a = current.m_sceneGeoms[i];
+                const Geometry& b = reloaded.m_sceneGeoms[i];
+                if (!SameElements(a.m_vertices, b.m_vertices) || !SameElements(a.m_indices, b.m_indices) || !SameElements(a.m_wideIndices, b.m_wideIndices))
+                {
+                    return false;
+                }
+            }
+
+            for (size_t i = 0; i < current.m_meshViews.size(); ++i)
+            {
+                if (!SameMesh(current.m_meshViews[i], reloaded.m_meshViews[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // What the material table is packed from, and the material each primitive uses
+        bool SameMaterials(const PMScene& current, const PMScene& reloaded)
+        {
+            if (current.m_materials.size() != reloaded.m_materials.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < current.m_materials.size(); ++i)
+            {
+                const Material& a = current.m_materials[i];
+                const Material& b = reloaded.m_materials[i];
+                if (a.m_materialFlags != b.m_materialFlags || a.m_refractiveIndex != b.m_refractiveIndex ||
+                    a.m_albedoTexture != b.m_albedoTexture || a.m_baseMaterials.size() != b.m_baseMaterials.size())
+                {
+                    return false;
+                }
+
+                for (size_t j = 0; j < a.m_baseMaterials.size(); ++j)
+                {
+                    if (!SameFloat3(a.m_baseMaterials[j].m_albedo, b.m_baseMaterials[j].m_albedo) ||
+                        a.m_baseMaterials[j].m_matIdentifier != b.m_baseMaterials[j].m_matIdentifier)
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < current.m_primitives.size(); ++i)
+            {
+                if (current.m_primitives[i].m_materialID != reloaded.m_primitives[i].m_materialID)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Only what PackLights puts in the light table counts, type, intensity and color. Light placement and the per
+        // type parameters (drop off, cone angle, two sidedness) do not reach the GPU, so editing them is no change
+        bool SameLights(const PMScene& current, const PMScene& reloaded)
+        {
+            if (current.m_lights.size() != reloaded.m_lights.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < current.m_lights.size(); ++i)
+            {
+                const Light& a = current.m_lights[i];
+                const Light& b = reloaded.m_lights[i];
+                if (a.m_lightType != b.m_lightType || a.m_lightIntensity != b.m_lightIntensity ||
+                    !SameFloat3(a.m_lightColor, b.m_lightColor))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool SameTransforms(const PMScene& current, const PMScene& reloaded)
+        {
+            for (size_t i = 0; i < current.m_primitives.size(); ++i)
+            {
+                const Primitive& a = current.m_primitives[i];
+                const Primitive& b = reloaded.m_primitives[i];
+                if (!SameFloat3(a.m_translate, b.m_translate) || !SameFloat3(a.m_rotate, b.m_rotate) || !SameFloat3(a.m_scale, b.m_scale))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool GetLastWriteTime(const std::string& fileName, UINT64& writeTime)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (!GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &attributes))
+            {
+                return false;
+            }
+            writeTime = (UINT64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+            return true;
+        }
+    }
+
+    //------------------------------------------------------
+    // DiffScenes
+    //------------------------------------------------------
+    SceneChange DiffScenes(const PMScene& current, const PMScene& reloaded)
+    {
+        // The other checks index primitives and meshes of both scenes alike
+        if (!SameTopology(current, reloaded))
+        {
+            return SceneChange::Topology;
+        }
+
+        SceneChange changes = SceneChange::None;
+        if (!SameMaterials(current, reloaded))
+        {
+            changes = changes | SceneChange::Materials;
+        }
+        if (!SameLights(current, reloaded))
+        {
+            changes = changes | SceneChange::Lights;
+        }
+        if (!SameTransforms(current, reloaded))
+        {
+            changes = changes | SceneChange::Transforms;
+        }
+        return changes;
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMFileWatcher::PMFileWatcher() : m_lastWriteTime(0), m_lastPollTime(0)
+    {
+    }
+
+    //------------------------------------------------------
+    // Watch
+    //------------------------------------------------------
+    void PMFileWatcher::Watch(const std::string& fileName)
+    {
+        m_fileName = fileName;
+        m_lastWriteTime = 0;
+        m_lastPollTime = GetTickCount64();
+        if (!m_fileName.empty())
+        {
+            GetLastWriteTime(m_fileName, m_lastWriteTime);
+        }
+    }
+
+    //------------------------------------------------------
+    // HasChanged
+    //------------------------------------------------------
+    bool PMFileWatcher::HasChanged()
+    {
+        const UINT64 now = GetTickCount64();
+        if (m_fileName.empty() || now - m_lastPollTime < PollIntervalMs)
+        {
+            return false;
+        }
+        m_lastPollTime = now;
+
+        // A file being replaced can be missing for a moment, it is picked up once it is back
+        UINT64 writeTime;
+        if (!GetLastWriteTime(m_fileName, writeTime) || writeTime == m_lastWriteTime)
+        {
+            return false;
+        }
+        m_lastWriteTime = writeTime;
+        return true;
+    }
+}
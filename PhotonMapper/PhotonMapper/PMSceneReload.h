@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+
+#include "PMScene.h"
+
+namespace DXRPhotonMapper
+{
+    // What a reloaded scene changed, each kind of change touches its own GPU data:
+    // materials the material and instance tables, lights the light table, transforms the instance table and
+    // the top level acceleration structure. Topology changes (primitives added, removed or drawn with other
+    // meshes) need every scene resource rebuilt. Any change invalidates the photon map.
+    // Light transforms are not compared, the renderers place their light themselves and never read them
+    enum class SceneChange
+    {
+        None = 0,
+        Materials = 1 << 0,
+        Lights = 1 << 1,
+        Transforms = 1 << 2,
+        Topology = 1 << 3,
+    };
+
+    inline SceneChange operator|(SceneChange a, SceneChange b)
+    {
+        return static_cast<SceneChange>(static_cast<int>(a) | static_cast<int>(b));
+    }
+
+    inline bool HasSceneChange(SceneChange changes, SceneChange change)
+    {
+        return (static_cast<int>(changes) & static_cast<int>(change)) != 0;
+    }
+
+    //------------------------------------------------------
+    // DiffScenes
+    // Compares a freshly loaded scene against the one in use. Names are ignored, only what ends up on the GPU counts
+    //------------------------------------------------------
+    SceneChange DiffScenes(const PMScene& current, const PMScene& reloaded);
+
+    // Polls the modification time of a file, so a scene can be reloaded while the app runs
+    class PMFileWatcher
+    {
+    private:
+        std::string m_fileName;
+        UINT64 m_lastWriteTime;
+        UINT64 m_lastPollTime;
+
+    public:
+        // Checking more often only costs file system calls, edits are saved far less often
+        static const UINT64 PollIntervalMs = 250;
+
+        //------------------------------------------------------
+        // Constructor
+        //------------------------------------------------------
+        PMFileWatcher();
+
+        //------------------------------------------------------
+        // Watch
+        // Starts from the file's current modification time, an empty name watches nothing
+        //------------------------------------------------------
+        void Watch(const std::string& fileName);
+
+        //------------------------------------------------------
+        // HasChanged
+        // True once the file was written since the last change was reported
+        //------------------------------------------------------
+        bool HasChanged();
+    };
+}
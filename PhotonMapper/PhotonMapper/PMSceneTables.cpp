@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "PMSceneTables.h"
+#include "PMSelfTest.h"
+
+namespace DXRPhotonMapper
+{
+    namespace SceneTables
+    {
+        namespace
+        {
+            // Every table gets a buffer to view, an empty scene table is one zeroed entry the shaders never index
+            template <typename T>
+            void PadEmptyTable(std::vector<T>& table)
+            {
+                if (table.empty())
+                {
+                    T entry = {};
+                    table.push_back(entry);
+                }
+            }
+        }
+
+        //------------------------------------------------------
+        // PackInstances
+        //------------------------------------------------------
+        void PackInstances(const PMScene& scene, const std::vector<UINT>& primitiveGeometries, const std::vector<UINT>& geometryIndexSizes, std::vector<SceneBufferDesc>& instances)
+        {
+            instances.resize(scene.m_primitives.size());
+            for (size_t i = 0; i < scene.m_primitives.size(); ++i)
+            {
+                const Primitive& primitive = scene.m_primitives[i];
+                SceneBufferDesc& instance = instances[i];
+                instance = {};
+                instance.vbIndex = primitiveGeometries[i];
+                instance.materialIndex = UINT(primitive.m_materialID);
+                instance.indexSizeInBytes = geometryIndexSizes[instance.vbIndex];
+                instance.normalTransformMat = XMLoadFloat4x4(&scene.m_primitiveWorlds[i].m_normalTransform);
+            }
+            PadEmptyTable(instances);
+        }
+
+        //------------------------------------------------------
+        // PackMaterials
+        //------------------------------------------------------
+        void PackMaterials(const PMScene& scene, std::vector<MaterialDesc>& materials)
+        {
+            materials.resize(scene.m_materials.size());
+            for (size_t i = 0; i < scene.m_materials.size(); ++i)
+            {
+                const Material& material = scene.m_materials[i];
+                MaterialDesc& desc = materials[i];
+                desc = {};
+                desc.materialID = UINT(i);
+                desc.albedo = material.m_baseMaterials.empty() ? XMFLOAT3(0.0f, 0.0f, 0.0f) : material.m_baseMaterials[0].m_albedo;
+                desc.materialFlags = static_cast<UINT>(material.m_materialFlags);
+                desc.refractiveIndex = material.m_refractiveIndex;
+            }
+            PadEmptyTable(materials);
+        }
+
+        //------------------------------------------------------
+        // PackLights
+        //------------------------------------------------------
+        void PackLights(const PMScene& scene, std::vector<LightDesc>& lights)
+        {
+            lights.resize(scene.m_lights.size());
+            for (size_t i = 0; i < scene.m_lights.size(); ++i)
+            {
+                const Light& light = scene.m_lights[i];
+                LightDesc& desc = lights[i];
+                desc = {};
+                desc.shapeID = static_cast<UINT>(light.m_lightType);
+                desc.lightIntensity = light.m_lightIntensity;
+                desc.lightColor = light.m_lightColor;
+            }
+            PadEmptyTable(lights);
+        }
+
+        //------------------------------------------------------
+        // SelfTest
+        //------------------------------------------------------
+        bool SelfTest()
+        {
+            SelfTestReport report(L"Scene table");
+
+            // One triangle tilted off the axes, indexed with 32 bit indices, placed twice with different materials and
+            // non uniform scales, so a normal transformed like a position would tilt off the surface
+            PMScene scene(0, 0);
+            Geometry triangle;
+            triangle.m_vertices.resize(3);
+            triangle.m_vertices[0].position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            triangle.m_vertices[1].position = XMFLOAT3(1.0f, 0.0f, 1.0f);
+            triangle.m_vertices[2].position = XMFLOAT3(0.0f, 1.0f, 0.0f);
+            for (Vertex& vertex : triangle.m_vertices)
+            {
+                vertex.normal = XMFLOAT3(-0.70710678f, 0.0f, 0.70710678f);
+            }
+            triangle.m_wideIndices = { 0, 1, 2 };
+            scene.m_sceneGeoms.push_back(triangle);
+
+            Primitive primitive = {};
+            primitive.m_primitiveType = PrimitiveType::Mesh;
+            primitive.m_name = "first";
+            primitive.m_materialID = 1;
+            primitive.m_translate = XMFLOAT3(1.0f, 2.0f, 3.0f);
+            primitive.m_rotate = XMFLOAT3(30.0f, 45.0f, 0.0f);
+            primitive.m_scale = XMFLOAT3(2.0f, 0.5f, 1.0f);
+            scene.m_primitives.push_back(primitive);
+
+            primitive.m_name = "second";
+            primitive.m_materialID = 0;
+            primitive.m_translate = XMFLOAT3(-4.0f, 0.0f, 0.0f);
+            primitive.m_rotate = XMFLOAT3(0.0f, 0.0f, 90.0f);
+            primitive.m_scale = XMFLOAT3(1.0f, 3.0f, 0.25f);
+            scene.m_primitives.push_back(primitive);
+            scene.m_primitiveMeshes = { 0, 0 };
+
+            Material material = {};
+            material.m_name = "white";
+            material.m_materialFlags = MaterialFlag::BSDF_DIFFUSE | MaterialFlag::BSDF_REFLECTION;
+            material.m_baseMaterials.push_back({ XMFLOAT3(0.8f, 0.8f, 0.8f), material.m_materialFlags });
+            scene.m_materials.push_back(material);
+
+            material.m_name = "glass";
+            material.m_materialFlags = MaterialFlag::BSDF_SPECULAR | MaterialFlag::BSDF_TRANSMISSION;
+            material.m_baseMaterials[0] = { XMFLOAT3(0.1f, 0.2f, 0.3f), material.m_materialFlags };
+            material.m_refractiveIndex = 1.5f;
+            scene.m_materials.push_back(material);
+
+            Light light = {};
+            light.m_name = "light";
+            light.m_lightType = LightType::PointLight;
+            light.m_lightIntensity = 5.0f;
+            light.m_lightColor = XMFLOAT3(1.0f, 0.9f, 0.8f);
+            scene.m_lights.push_back(light);
+
+            scene.Preprocess();
+
+            // Geometry and index sizes found the way the renderer finds them
+            std::vector<size_t> geometryPrimitives;
+            std::vector<UINT> primitiveGeometries;
+            scene.GetMeshInstances(geometryPrimitives, primitiveGeometries);
+            report.Check(L"both instances share one geometry", geometryPrimitives.size() == 1 && primitiveGeometries[0] == 0 && primitiveGeometries[1] == 0);
+
+            std::vector<UINT> geometryIndexSizes;
+            for (size_t primitiveIndex : geometryPrimitives)
+            {
+                Geometry scratch;
+                geometryIndexSizes.push_back(scene.GetPrimitiveMesh(primitiveIndex, scratch).m_indexSizeInBytes);
+            }
+
+            std::vector<SceneBufferDesc> instances;
+            PackInstances(scene, primitiveGeometries, geometryIndexSizes, instances);
+            report.Check(L"one instance entry per primitive", instances.size() == 2);
+
+            for (size_t i = 0; i < instances.size() && i < scene.m_primitives.size(); ++i)
+            {
+                const SceneBufferDesc& instance = instances[i];
+                const Primitive& placed = scene.m_primitives[i];
+                report.Log() << L" Instance " << i << L":" << std::endl;
+                report.Check(L"  instances point at the shared vertex buffer", instance.vbIndex == 0);
+                report.Check(L"  material index is the primitive's material", instance.materialIndex == UINT(placed.m_materialID));
+                report.Check(L"  index size is the shared mesh's 32 bit indices", instance.indexSizeInBytes == 4 && instance.pad0 == 0);
+
+                // The transformed normal has to be the normal of the transformed triangle, built here from the
+                // primitive's scale, rotation and translation rather than from the scene's preprocessed transform
+                const XMMATRIX transform = XMMatrixScaling(placed.m_scale.x, placed.m_scale.y, placed.m_scale.z) *
+                    XMMatrixRotationRollPitchYaw(XMConvertToRadians(placed.m_rotate.x), XMConvertToRadians(placed.m_rotate.y), XMConvertToRadians(placed.m_rotate.z)) *
+                    XMMatrixTranslation(placed.m_translate.x, placed.m_translate.y, placed.m_translate.z);
+                const XMVECTOR corner = XMLoadFloat3(&triangle.m_vertices[0].position);
+                const XMVECTOR edge0 = XMVector3TransformNormal(XMVectorSubtract(XMLoadFloat3(&triangle.m_vertices[1].position), corner), transform);
+                const XMVECTOR edge1 = XMVector3TransformNormal(XMVectorSubtract(XMLoadFloat3(&triangle.m_vertices[2].position), corner), transform);
+                const XMVECTOR expected = XMVector3Normalize(XMVector3Cross(edge0, edge1));
+                const XMVECTOR normal = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&triangle.m_vertices[0].normal), instance.normalTransformMat));
+                const float alignment = XMVectorGetX(XMVector3Dot(normal, expected));
+                report.Log() << L"  normal alignment " << alignment << std::endl;
+                report.Check(L"  normal matrix keeps the normal on the transformed surface", alignment > 0.99999f);
+            }
+
+            std::vector<MaterialDesc> materials;
+            PackMaterials(scene, materials);
+            bool materialsMatch = materials.size() == scene.m_materials.size();
+            for (size_t i = 0; materialsMatch && i < materials.size(); ++i)
+            {
+                const Material& source = scene.m_materials[i];
+                const MaterialDesc& desc = materials[i];
+                materialsMatch = desc.materialID == UINT(i) && desc.materialFlags == static_cast<UINT>(source.m_materialFlags) &&
+                    desc.refractiveIndex == source.m_refractiveIndex && desc.albedo.x == source.m_baseMaterials[0].m_albedo.x &&
+                    desc.albedo.y == source.m_baseMaterials[0].m_albedo.y && desc.albedo.z == source.m_baseMaterials[0].m_albedo.z;
+            }
+            report.Check(L"material table matches the scene materials", materialsMatch);
+
+            std::vector<LightDesc> lights;
+            PackLights(scene, lights);
+            report.Check(L"light table matches the scene light", lights.size() == 1 && lights[0].shapeID == static_cast<UINT>(LightType::PointLight) &&
+                lights[0].lightIntensity == light.m_lightIntensity && lights[0].lightColor.x == light.m_lightColor.x &&
+                lights[0].lightColor.y == light.m_lightColor.y && lights[0].lightColor.z == light.m_lightColor.z);
+
+            // An empty scene still gets one entry per table to create its views on
+            PMScene emptyScene(0, 0);
+            PackInstances(emptyScene, std::vector<UINT>(), std::vector<UINT>(), instances);
+            PackMaterials(emptyScene, materials);
+            PackLights(emptyScene, lights);
+            report.Check(L"empty scene tables hold one zeroed entry", instances.size() == 1 && instances[0].vbIndex == 0 && materials.size() == 1 &&
+                materials[0].materialFlags == 0 && lights.size() == 1 && lights[0].lightIntensity == 0.0f);
+
+            return report.Finish();
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "PMScene.h"
+
+namespace DXRPhotonMapper
+{
+    // Per instance, material and light tables, laid out as the shaders read them from one structured buffer each
+    // (c_bufferIndices, c_materials and c_lights). Nothing here touches the GPU, the renderer uploads the tables.
+    // Structured buffers are packed without the 16 byte rules of constant buffers, so the C++ layout is the GPU layout.
+    namespace SceneTables
+    {
+        static_assert(sizeof(SceneBufferDesc) == 80, "SceneBufferDesc must match its HLSL structured buffer layout");
+        static_assert(sizeof(MaterialDesc) == 24, "MaterialDesc must match its HLSL structured buffer layout");
+        static_assert(sizeof(LightDesc) == 20, "LightDesc must match its HLSL structured buffer layout");
+
+        //------------------------------------------------------
+        // PackInstances
+        // One entry per primitive, in InstanceID order, normals use the preprocessed normal transforms.
+        // primitiveGeometries is the vertex and index buffer of each primitive, geometryIndexSizes the index
+        // size of each of those buffers
+        //------------------------------------------------------
+        void PackInstances(const PMScene& scene, const std::vector<UINT>& primitiveGeometries, const std::vector<UINT>& geometryIndexSizes, std::vector<SceneBufferDesc>& instances);
+
+        //------------------------------------------------------
+        // PackMaterials
+        //------------------------------------------------------
+        void PackMaterials(const PMScene& scene, std::vector<MaterialDesc>& materials);
+
+        //------------------------------------------------------
+        // PackLights
+        //------------------------------------------------------
+        void PackLights(const PMScene& scene, std::vector<LightDesc>& lights);
+
+        //------------------------------------------------------
+        // SelfTest
+        // Packs the tables of a small scene, two instances of one mesh with 32 bit indices, and checks every field
+        // the shaders read against the scene. Returns whether all passed, see RunSelfTests
+        //------------------------------------------------------
+        bool SelfTest();
+    }
+}
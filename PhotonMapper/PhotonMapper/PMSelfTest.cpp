@@ -0,0 +1,43 @@
+#include "stdafx.h"
+#include "PMSelfTest.h"
+#include "PMFluxResolve.h"
+#include "PMSceneTables.h"
+
+namespace DXRPhotonMapper
+{
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    SelfTestReport::SelfTestReport(const wchar_t* name) : m_name(name), m_passed(true)
+    {
+    }
+
+    //------------------------------------------------------
+    // Check
+    //------------------------------------------------------
+    void SelfTestReport::Check(const wchar_t* check, bool condition)
+    {
+        m_log << (condition ? L" passed " : L" FAILED ") << check << std::endl;
+        m_passed = m_passed && condition;
+    }
+
+    //------------------------------------------------------
+    // Finish
+    //------------------------------------------------------
+    bool SelfTestReport::Finish()
+    {
+        m_log << m_name << L" self test " << (m_passed ? L"passed" : L"FAILED") << std::endl;
+        OutputDebugStringW(m_log.str().c_str());
+        return m_passed;
+    }
+
+    //------------------------------------------------------
+    // RunSelfTests
+    //------------------------------------------------------
+    bool RunSelfTests()
+    {
+        const bool fluxResolvePassed = PMFluxResolve::SelfTest();
+        const bool sceneTablesPassed = SceneTables::SelfTest();
+        return fluxResolvePassed && sceneTablesPassed;
+    }
+}
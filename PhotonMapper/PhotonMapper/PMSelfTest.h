@@ -0,0 +1,43 @@
+#pragma once
+
+#include <sstream>
+
+namespace DXRPhotonMapper
+{
+    // Checks of one self test, written to the debug output as a single block once the test finishes
+    class SelfTestReport
+    {
+    private:
+        const wchar_t* m_name;
+        std::wstringstream m_log;
+        bool m_passed;
+
+    public:
+        explicit SelfTestReport(const wchar_t* name);
+
+        SelfTestReport(const SelfTestReport&) = delete;
+        SelfTestReport& operator=(const SelfTestReport&) = delete;
+
+        //------------------------------------------------------
+        // Check
+        // Logs the check as passed or FAILED, a failed check fails the test
+        //------------------------------------------------------
+        void Check(const wchar_t* check, bool condition);
+
+        // For measured values worth seeing next to the checks
+        std::wostream& Log() { return m_log; }
+
+        //------------------------------------------------------
+        // Finish
+        // Writes the log with the test's result to the debug output and returns whether every check passed
+        //------------------------------------------------------
+        bool Finish();
+    };
+
+    //------------------------------------------------------
+    // RunSelfTests
+    // Runs every CPU self test on fixed inputs, the flux resolve and the packed scene tables, and returns
+    // whether all of them passed. Every test runs even when an earlier one fails
+    //------------------------------------------------------
+    bool RunSelfTests();
+}
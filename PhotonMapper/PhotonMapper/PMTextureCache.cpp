@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "PMTextureCache.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+
+namespace DXRPhotonMapper
+{
+    namespace
+    {
+        // sRGB bytes to linear by lookup, every texel a level writes sums four texels of the level above
+        struct SRGBToLinearTable
+        {
+            float m_values[256];
+
+            SRGBToLinearTable()
+            {
+                for (int i = 0; i < 256; ++i)
+                {
+                    m_values[i] = XMVectorGetX(XMColorSRGBToRGB(XMVectorReplicate(i / 255.0f)));
+                }
+            }
+        };
+
+        // Sums the four pairs of neighbouring values in eight floats of a plane
+        XMVECTOR SumPairs(const float* values)
+        {
+            const XMVECTOR a = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values));
+            const XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values + 4));
+            return XMVectorAdd(XMVectorPermute<0, 2, 4, 6>(a, b), XMVectorPermute<1, 3, 5, 7>(a, b));
+        }
+
+        // XMColorRGBToSRGB on all four lanes, which here hold one channel of four texels
+        XMVECTOR LinearToSRGB(FXMVECTOR linear)
+        {
+            const XMVECTOR value = XMVectorSaturate(linear);
+            const XMVECTOR low = XMVectorMultiply(value, XMVectorReplicate(12.92f));
+            const XMVECTOR high = XMVectorSubtract(
+                XMVectorMultiply(XMVectorReplicate(1.055f), XMVectorPow(value, XMVectorReplicate(1.0f / 2.4f))),
+                XMVectorReplicate(0.055f));
+            return XMVectorSelect(high, low, XMVectorLess(value, XMVectorReplicate(0.0031308f)));
+        }
+
+        // Each pass filters four output texels: the two source rows are decoded to linear R, G, B and A planes,
+        // neighbouring columns are summed across the lanes and a transpose turns the channels back into texels
+        void DownsampleMip(const TextureMip& source, TextureMip& mip)
+        {
+            static const SRGBToLinearTable toLinear;
+
+            mip.m_width = (std::max)(source.m_width / 2, 1u);
+            mip.m_height = (std::max)(source.m_height / 2, 1u);
+            mip.m_texels.resize(size_t(mip.m_width) * mip.m_height * 4);
+
+            // Two source columns per output texel, padded to whole passes by repeating the last column
+            const UINT numColumns = ((mip.m_width + 3) / 4) * 8;
+            std::vector<float> planes(size_t(numColumns) * 8);
+            float* rowPlanes[2][4];
+            for (UINT plane = 0; plane < 8; ++plane)
+            {
+                rowPlanes[plane / 4][plane % 4] = &planes[size_t(plane) * numColumns];
+            }
+
+            const size_t sourcePitch = size_t(source.m_width) * 4;
+            for (UINT y = 0; y < mip.m_height; ++y)
+            {
+                for (UINT row = 0; row < 2; ++row)
+                {
+                    const UINT8* sourceRow = &source.m_texels[(std::min)(2 * y + row, source.m_height - 1) * sourcePitch];
+                    for (UINT x = 0; x < numColumns; ++x)
+                    {
+                        const UINT8* texel = sourceRow + (std::min)(x, source.m_width - 1) * 4;
+                        rowPlanes[row][0][x] = toLinear.m_values[texel[0]];
+                        rowPlanes[row][1][x] = toLinear.m_values[texel[1]];
+                        rowPlanes[row][2][x] = toLinear.m_values[texel[2]];
+                        rowPlanes[row][3][x] = texel[3] * (1.0f / 255.0f);
+                    }
+                }
+
+                UINT8* texel = &mip.m_texels[size_t(y) * mip.m_width * 4];
+                for (UINT x = 0; x < mip.m_width; x += 4)
+                {
+                    XMVECTOR channels[4];
+                    for (UINT channel = 0; channel < 4; ++channel)
+                    {
+                        const XMVECTOR sum = XMVectorAdd(SumPairs(rowPlanes[0][channel] + 2 * x), SumPairs(rowPlanes[1][channel] + 2 * x));
+                        channels[channel] = XMVectorScale(sum, 0.25f);
+                    }
+
+                    const XMMATRIX texels = XMMatrixTranspose(XMMATRIX(
+                        LinearToSRGB(channels[0]), LinearToSRGB(channels[1]), LinearToSRGB(channels[2]), channels[3]));
+
+                    const UINT count = (std::min)(mip.m_width - x, 4u);
+                    for (UINT i = 0; i < count; ++i, texel += 4)
+                    {
+                        PackedVector::XMUBYTEN4 packed;
+                        PackedVector::XMStoreUByteN4(&packed, texels.r[i]);
+                        memcpy(texel, &packed, 4);
+                    }
+                }
+            }
+        }
+
+        std::shared_ptr<const Texture> DecodeTexture(const std::string& fileName)
+        {
+            int width, height, components;
+            stbi_uc* texels = stbi_load(fileName.c_str(), &width, &height, &components, 4);
+            if (!texels)
+            {
+                return nullptr;
+            }
+
+            std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+            texture->m_mips.resize(1);
+            TextureMip& image = texture->m_mips[0];
+            image.m_width = UINT(width);
+            image.m_height = UINT(height);
+            image.m_texels.assign(texels, texels + size_t(width) * height * 4);
+            stbi_image_free(texels);
+
+            GenerateMips(*texture);
+            return texture;
+        }
+    }
+
+    //------------------------------------------------------
+    // GenerateMips
+    //------------------------------------------------------
+    void GenerateMips(Texture& texture)
+    {
+        texture.m_mips.resize(1);
+        while (texture.m_mips.back().m_width > 1 || texture.m_mips.back().m_height > 1)
+        {
+            TextureMip mip;
+            DownsampleMip(texture.m_mips.back(), mip);
+            texture.m_mips.push_back(std::move(mip));
+        }
+
+        texture.m_sizeInBytes = 0;
+        for (const TextureMip& mip : texture.m_mips)
+        {
+            texture.m_sizeInBytes += mip.m_texels.size();
+        }
+    }
+
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMTextureCache::PMTextureCache(size_t maxSizeInBytes, UINT numThreads) :
+        m_maxSizeInBytes(maxSizeInBytes),
+        m_sizeInBytes(0),
+        m_numThreads((numThreads > 0) ? numThreads : (std::max)(1u, std::thread::hardware_concurrency())),
+        m_numPending(0),
+        m_stopping(false)
+    {
+        Entry noTexture = {};
+        noTexture.m_state = TextureState::Failed;
+        m_entries.push_back(noTexture);
+    }
+
+    //------------------------------------------------------
+    // Destructor
+    //------------------------------------------------------
+    PMTextureCache::~PMTextureCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_textureQueued.notify_all();
+
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    //------------------------------------------------------
+    // Request
+    //------------------------------------------------------
+    TextureHandle PMTextureCache::Request(const std::string& fileName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_handles.find(fileName);
+        if (it != m_handles.end())
+        {
+            return it->second;
+        }
+
+        const TextureHandle handle = TextureHandle(m_entries.size());
+        Entry entry = {};
+        entry.m_fileName = fileName;
+        m_entries.push_back(entry);
+        m_handles.emplace(fileName, handle);
+
+        if (m_workers.empty())
+        {
+            for (UINT i = 0; i < m_numThreads; ++i)
+            {
+                m_workers.emplace_back(&PMTextureCache::DecodeTextures, this);
+            }
+        }
+        Queue(handle);
+        return handle;
+    }
+
+    //------------------------------------------------------
+    // Get
+    //------------------------------------------------------
+    std::shared_ptr<const Texture> PMTextureCache::Get(TextureHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (handle >= m_entries.size())
+        {
+            return nullptr;
+        }
+
+        Entry& entry = m_entries[handle];
+        switch (entry.m_state)
+        {
+        case TextureState::Ready:
+            m_lru.splice(m_lru.begin(), m_lru, entry.m_lruPosition);
+            return entry.m_texture;
+        case TextureState::Evicted:
+            Queue(handle);
+            return nullptr;
+        default:
+            return nullptr;
+        }
+    }
+
+    //------------------------------------------------------
+    // WaitForPending
+    //------------------------------------------------------
+    void PMTextureCache::WaitForPending()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_textureDecoded.wait(lock, [this] { return m_numPending == 0; });
+    }
+
+    //------------------------------------------------------
+    // GetSizeInBytes
+    //------------------------------------------------------
+    size_t PMTextureCache::GetSizeInBytes()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sizeInBytes;
+    }
+
+    // Called with m_mutex held
+    void PMTextureCache::Queue(TextureHandle handle)
+    {
+        m_entries[handle].m_state = TextureState::Queued;
+        m_queue.push_back(handle);
+        ++m_numPending;
+        m_textureQueued.notify_one();
+    }
+
+    // Called with m_mutex held. A texture larger than the whole cache still gets in, alone
+    void PMTextureCache::Insert(TextureHandle handle, const std::shared_ptr<const Texture>& texture)
+    {
+        while (!m_lru.empty() && m_sizeInBytes + texture->m_sizeInBytes > m_maxSizeInBytes)
+        {
+            Entry& evicted = m_entries[m_lru.back()];
+            m_sizeInBytes -= evicted.m_texture->m_sizeInBytes;
+            evicted.m_texture.reset();
+            evicted.m_state = TextureState::Evicted;
+            m_lru.pop_back();
+        }
+
+        Entry& entry = m_entries[handle];
+        entry.m_texture = texture;
+        entry.m_state = TextureState::Ready;
+        m_lru.push_front(handle);
+        entry.m_lruPosition = m_lru.begin();
+        m_sizeInBytes += texture->m_sizeInBytes;
+    }
+
+    // Worker thread, files are decoded outside the lock so every worker decodes at once
+    void PMTextureCache::DecodeTextures()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_textureQueued.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            const TextureHandle handle = m_queue.front();
+            m_queue.pop_front();
+            const std::string fileName = m_entries[handle].m_fileName;
+
+            lock.unlock();
+            std::shared_ptr<const Texture> texture = DecodeTexture(fileName);
+            if (!texture)
+            {
+                std::wstringstream wstr;
+                wstr << L"Could not decode texture " << fileName.c_str() << std::endl;
+                OutputDebugStringW(wstr.str().c_str());
+            }
+            lock.lock();
+
+            if (texture)
+            {
+                Insert(handle, texture);
+            }
+            else
+            {
+                m_entries[handle].m_state = TextureState::Failed;
+            }
+            --m_numPending;
+            m_textureDecoded.notify_all();
+        }
+    }
+}
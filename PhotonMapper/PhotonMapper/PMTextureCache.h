@@ -0,0 +1,130 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace DXRPhotonMapper
+{
+    // Texture file in a PMTextureCache, NoTexture for none. A handle stays valid while its texture is
+    // evicted and decoded again, so materials keep theirs for as long as the cache lives
+    typedef UINT TextureHandle;
+    const TextureHandle NoTexture = 0;
+
+    // One level of a mip chain, tightly packed RGBA8 rows
+    struct TextureMip
+    {
+        UINT m_width;
+        UINT m_height;
+        std::vector<UINT8> m_texels;
+    };
+
+    // Decoded texture, level 0 is the image as stored and every level after it halves the one before down to 1x1
+    struct Texture
+    {
+        std::vector<TextureMip> m_mips;
+        size_t m_sizeInBytes;
+    };
+
+    //------------------------------------------------------
+    // GenerateMips
+    // Appends the mip chain to a texture holding only level 0. Levels are box filtered four texels per vector pass,
+    // color is averaged in linear space as the texels are sRGB albedo, alpha as stored. Odd sizes repeat their last
+    // row and column
+    //------------------------------------------------------
+    void GenerateMips(Texture& texture);
+
+    // Decodes texture files with stb_image on worker threads and keeps the decoded mip chains, least recently used
+    // first out once they outgrow the cache size. Requesting a texture only queues it, decoding overlaps with
+    // whatever else the app does until Get or WaitForPending needs it.
+    // Nothing reads the decoded textures yet: materials only keep their handles, no texture is uploaded to the
+    // GPU and the vertex format has no texture coordinates for the shaders to sample with
+    class PMTextureCache
+    {
+    private:
+        enum class TextureState
+        {
+            Queued,
+            Ready,
+            Evicted,
+            Failed,
+        };
+
+        struct Entry
+        {
+            std::string m_fileName;
+            TextureState m_state;
+            std::shared_ptr<const Texture> m_texture;
+            std::list<TextureHandle>::iterator m_lruPosition;
+        };
+
+        size_t m_maxSizeInBytes;
+        size_t m_sizeInBytes;
+        UINT m_numThreads;
+
+        // Entry 0 stands for NoTexture, handles index the rest
+        std::vector<Entry> m_entries;
+        std::unordered_map<std::string, TextureHandle> m_handles;
+
+        // Ready textures, most recently used first
+        std::list<TextureHandle> m_lru;
+
+        std::mutex m_mutex;
+        std::condition_variable m_textureQueued;
+        std::condition_variable m_textureDecoded;
+        std::deque<TextureHandle> m_queue;
+        size_t m_numPending;
+        bool m_stopping;
+        std::vector<std::thread> m_workers;
+
+        void Queue(TextureHandle handle);
+        void Insert(TextureHandle handle, const std::shared_ptr<const Texture>& texture);
+        void DecodeTextures();
+
+    public:
+        // Enough for a few dozen 2K textures with their mips
+        static const size_t DefaultMaxSizeInBytes = size_t(512) << 20;
+
+        //------------------------------------------------------
+        // Constructor / Destructor
+        // No threads start until the first texture is requested, 0 threads uses one per core.
+        // Textures still queued are dropped on destruction
+        //------------------------------------------------------
+        PMTextureCache(size_t maxSizeInBytes = DefaultMaxSizeInBytes, UINT numThreads = 0);
+        ~PMTextureCache();
+
+        PMTextureCache(const PMTextureCache&) = delete;
+        PMTextureCache& operator=(const PMTextureCache&) = delete;
+
+        //------------------------------------------------------
+        // Request
+        // Handle of a texture file, queued for decoding the first time its name is seen
+        //------------------------------------------------------
+        TextureHandle Request(const std::string& fileName);
+
+        //------------------------------------------------------
+        // Get
+        // The decoded texture, null while it is queued, when the file failed to decode or for NoTexture.
+        // An evicted texture is queued again and shows up on a later Get
+        //------------------------------------------------------
+        std::shared_ptr<const Texture> Get(TextureHandle handle);
+
+        //------------------------------------------------------
+        // WaitForPending
+        // Blocks until every queued texture is decoded or failed
+        //------------------------------------------------------
+        void WaitForPending();
+
+        //------------------------------------------------------
+        // GetSizeInBytes
+        // Memory of the textures the cache holds, textures still referenced after eviction are not counted
+        //------------------------------------------------------
+        size_t GetSizeInBytes();
+    };
+}
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include "PMWorkerPool.h"
+
+#include <algorithm>
+
+namespace DXRPhotonMapper
+{
+    //------------------------------------------------------
+    // Constructor
+    //------------------------------------------------------
+    PMWorkerPool::PMWorkerPool(UINT numThreads) :
+        m_numThreads((numThreads > 0) ? numThreads : (std::max)(1u, std::thread::hardware_concurrency())),
+        m_body(nullptr),
+        m_count(0),
+        m_next(0),
+        m_generation(0),
+        m_numBusy(0),
+        m_stopping(false)
+    {
+    }
+
+    //------------------------------------------------------
+    // Destructor
+    //------------------------------------------------------
+    PMWorkerPool::~PMWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobReady.notify_all();
+
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    //------------------------------------------------------
+    // ParallelFor
+    //------------------------------------------------------
+    void PMWorkerPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+    {
+        if (m_numThreads == 1 || count <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                body(i);
+            }
+            return;
+        }
+
+        if (m_workers.empty())
+        {
+            for (UINT i = 1; i < m_numThreads; ++i)
+            {
+                m_workers.emplace_back(&PMWorkerPool::Work, this);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_body = &body;
+            m_count = count;
+            m_next = 0;
+            m_numBusy = UINT(m_workers.size());
+            ++m_generation;
+        }
+        m_jobReady.notify_all();
+
+        RunJob();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobDone.wait(lock, [this] { return m_numBusy == 0; });
+        m_body = nullptr;
+    }
+
+    // Takes indices until none are left, on the workers and the calling thread alike
+    void PMWorkerPool::RunJob()
+    {
+        for (size_t i = m_next++; i < m_count; i = m_next++)
+        {
+            (*m_body)(i);
+        }
+    }
+
+    // Worker thread, sleeps between jobs
+    void PMWorkerPool::Work()
+    {
+        UINT generation = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_jobReady.wait(lock, [&] { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+
+            lock.unlock();
+            RunJob();
+            lock.lock();
+
+            if (--m_numBusy == 0)
+            {
+                m_jobDone.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DXRPhotonMapper
+{
+    // Worker threads kept alive between ParallelFor calls, for work that is split up many times a frame.
+    // The calling thread works along with them, so a pool of n threads starts n - 1
+    class PMWorkerPool
+    {
+    private:
+        UINT m_numThreads;
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_mutex;
+        std::condition_variable m_jobReady;
+        std::condition_variable m_jobDone;
+
+        // Current job, set under m_mutex before the workers are woken
+        const std::function<void(size_t)>* m_body;
+        size_t m_count;
+        std::atomic<size_t> m_next;
+
+        // Bumped for every job, so each worker takes part in each job once
+        UINT m_generation;
+        UINT m_numBusy;
+        bool m_stopping;
+
+        void RunJob();
+        void Work();
+
+    public:
+        //------------------------------------------------------
+        // Constructor / Destructor
+        // 0 threads uses one per core. No thread starts until the first ParallelFor
+        //------------------------------------------------------
+        explicit PMWorkerPool(UINT numThreads = 0);
+        ~PMWorkerPool();
+
+        PMWorkerPool(const PMWorkerPool&) = delete;
+        PMWorkerPool& operator=(const PMWorkerPool&) = delete;
+
+        //------------------------------------------------------
+        // ParallelFor
+        // Calls body for every index below count across the pool and returns once all calls are done.
+        // Only one thread may run a ParallelFor on a pool at a time
+        //------------------------------------------------------
+        void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+        UINT GetNumThreads() const { return m_numThreads; }
+    };
+}
@@ -11,6 +11,8 @@
 
 #include "stdafx.h"
 #include "PhotonBaseRenderer.h"
+#include "PMSceneTables.h"
+#include <chrono>
 
 using namespace Microsoft::WRL;
 using namespace std;
@@ -31,6 +33,8 @@ PhotonBaseRenderer::PhotonBaseRenderer(const DXRPhotonMapper::PMScene& scene, UI
     m_assetsPath = assetsPath;
 
     UpdateForSizeChange(width, height);
+
+    m_sceneWatcher.Watch(m_scene.m_fileName);
 }
 
 PhotonBaseRenderer::~PhotonBaseRenderer()
@@ -92,145 +96,53 @@ void PhotonBaseRenderer::SetWindowBounds(int left, int top, int right, int botto
 }
 
 
-void PhotonBaseRenderer::GetVerticesForPrimitiveType(DXRPhotonMapper::PrimitiveType type, std::vector<Vertex>& vertices)
+UINT PhotonBaseRenderer::GetNumGeometries()
 {
-    switch (type)
-    {
-    case DXRPhotonMapper::PrimitiveType::Cube:
-    {
-        vertices = 
-        {
-            // Top Face
-            { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-            { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-            { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-            { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-
-            // Bottom Face
-            { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-            { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-            { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-            { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-
-            // Left Face
-            { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-
-            // Right Face
-            { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-            { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-
-            // Back Face
-            { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-            { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-            { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-            { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-
-            // Front Face
-            { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-        };
-    }
-    break;
-    case DXRPhotonMapper::PrimitiveType::SquarePlane:
+    if (m_primitiveGeometries.size() != m_scene.m_primitives.size())
     {
-        vertices =
-        {
-            { XMFLOAT3(-0.5f, -0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(0.5f, -0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(0.5f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-            { XMFLOAT3(-0.5f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0) },
-        };
-    }
-    break;
-    case DXRPhotonMapper::PrimitiveType::Error:
-    default:
-        break;
-    }
-}
-
-void PhotonBaseRenderer::GetIndicesForPrimitiveType(DXRPhotonMapper::PrimitiveType type, std::vector<Index>& indices)
-{
-    switch (type)
-    {
-    case DXRPhotonMapper::PrimitiveType::Cube:
-    {
-        indices = {
-            3,1,0,
-            2,1,3,
-
-            6,4,5,
-            7,4,6,
-
-            11,9,8,
-            10,9,11,
-
-            14,12,13,
-            15,12,14,
-
-            19,17,16,
-            18,17,19,
-
-            22,20,21,
-            23,20,22,
-        };
-    }
-    break;
-    case DXRPhotonMapper::PrimitiveType::SquarePlane:
-    {
-        indices =
-        {
-            3,1,0,
-            2,1,3,
-        };
-    }
-    break;
-    case DXRPhotonMapper::PrimitiveType::Error:
-    default:
-        break;
+        m_scene.GetMeshInstances(m_geometryPrimitives, m_primitiveGeometries);
     }
+    return UINT(m_geometryPrimitives.size());
 }
 
 void PhotonBaseRenderer::BuildGeometryBuffers()
 {
     auto device = m_deviceResources->GetD3DDevice();
-    for (int i = 0; i < m_scene.m_primitives.size(); ++i)
-    {
-        DXRPhotonMapper::Primitive prim = m_scene.m_primitives[i];
 
+    // One vertex and index buffer per distinct mesh
+    const UINT numGeometries = GetNumGeometries();
+    for (UINT i = 0; i < numGeometries; ++i)
+    {
         GeometryBuffer geoBuffer = {};
 
-        std::vector<Vertex> vertices;
-        GetVerticesForPrimitiveType(prim.m_primitiveType, vertices);
+        // Mapped or loaded mesh, or the primitive's shape built into geometry
+        DXRPhotonMapper::Geometry geometry;
+        DXRPhotonMapper::MeshView mesh = m_scene.GetPrimitiveMesh(m_geometryPrimitives[i], geometry);
 
-        std::vector<Index> indices;
-        GetIndicesForPrimitiveType(prim.m_primitiveType, indices);
+        // Index data is padded to whole 32 bit words for the raw buffer
+        const UINT indexBufferSize = (mesh.m_numIndices * mesh.m_indexSizeInBytes + 3) & ~3;
+        AllocateUploadBuffer(device, const_cast<void*>(mesh.m_indices), indexBufferSize, &geoBuffer.indexBuffer.resource);
+        AllocateUploadBuffer(device, const_cast<Vertex*>(mesh.m_vertices), mesh.m_numVertices * sizeof(Vertex), &geoBuffer.vertexBuffer.resource);
 
-        AllocateUploadBuffer(device, indices.data(), indices.size() * sizeof(Index), &geoBuffer.indexBuffer.resource);
-        AllocateUploadBuffer(device, vertices.data(), vertices.size() * sizeof(Vertex), &geoBuffer.vertexBuffer.resource);
-
-        geoBuffer.indexNumElements = indices.size() * sizeof(Index) / 4;
+        geoBuffer.indexCount = mesh.m_numIndices;
+        geoBuffer.indexSizeInBytes = mesh.m_indexSizeInBytes;
+        geoBuffer.indexNumElements = indexBufferSize / 4;
         geoBuffer.indexElementSize = 0; // Since we are going to create a raw buffer
 
-        geoBuffer.vertexNumElements = vertices.size();
-        geoBuffer.vertexElementSize = sizeof(vertices[0]);
-
-        const XMVECTOR translationVec = XMLoadFloat3(&prim.m_translate);
-        XMMATRIX transMat = XMMatrixTranslationFromVector(translationVec);
-        XMMATRIX rotMat = XMMatrixRotationRollPitchYaw(XMConvertToRadians(prim.m_rotate.x), XMConvertToRadians(prim.m_rotate.y), XMConvertToRadians(prim.m_rotate.z));
-        XMMATRIX scaleMat = XMMatrixScaling(prim.m_scale.x, prim.m_scale.y, prim.m_scale.z);
+        geoBuffer.vertexNumElements = mesh.m_numVertices;
+        geoBuffer.vertexElementSize = sizeof(Vertex);
 
-        geoBuffer.transformationMatrix = scaleMat * rotMat * transMat;
-        geoBuffer.normalTransform = rotMat;
+        m_geometryBuffers.push_back(geoBuffer);
+    }
 
+    // Every primitive places its mesh's buffers
+    for (size_t i = 0; i < m_scene.m_primitives.size(); ++i)
+    {
+        GeometryInstance instance = {};
+        instance.geometryIndex = m_primitiveGeometries[i];
+        instance.transformationMatrix = XMLoadFloat4x4(&m_scene.m_primitiveWorlds[i].m_transform);
 
-        m_geometryBuffers.push_back(geoBuffer);
+        m_geometryInstances.push_back(instance);
     }
 
     // Create SRVs for Index Buffers
@@ -248,110 +160,145 @@ void PhotonBaseRenderer::BuildGeometryBuffers()
 
 void PhotonBaseRenderer::BuildGeometrySceneBufferDesc()
 {
-    auto device = m_deviceResources->GetD3DDevice();
-    for (size_t i = 0; i < m_scene.m_primitives.size(); ++i)
+    std::vector<UINT> geometryIndexSizes;
+    for (const auto& geoBuffer : m_geometryBuffers)
     {
-        SceneBufferDescHolder sceneBufferDescHolder = {};
-        sceneBufferDescHolder.sceneBufferDesc.vbIndex = UINT(i);
-        sceneBufferDescHolder.sceneBufferDesc.materialIndex = UINT(m_scene.m_primitives[i].m_materialID);
-        sceneBufferDescHolder.sceneBufferDesc.normalTransformMat = m_geometryBuffers[i].normalTransform;
-
-        const size_t bufferSize = (sizeof(SceneBufferDesc) + 255) & ~255;
-        CreateUploadBuffer(device, bufferSize, &sceneBufferDescHolder.sceneBufferDescRes.resource);
-
-        UINT descriptorIndex = AllocateDescriptor(&sceneBufferDescHolder.sceneBufferDescRes.cpuDescriptorHandle);
-        sceneBufferDescHolder.sceneBufferDescRes.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
-
-        // Create a CBV descriptor
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-        cbvDesc.BufferLocation = sceneBufferDescHolder.sceneBufferDescRes.resource->GetGPUVirtualAddress();
-        cbvDesc.SizeInBytes = bufferSize;
-        device->CreateConstantBufferView(&cbvDesc, sceneBufferDescHolder.sceneBufferDescRes.cpuDescriptorHandle);
-
-        CD3DX12_RANGE readRange(0, 0);
-        SceneBufferDesc *mappedConstantData;
-        ThrowIfFailed(sceneBufferDescHolder.sceneBufferDescRes.resource->Map(0, &readRange, reinterpret_cast<void**>(&mappedConstantData)));
-        memcpy(mappedConstantData, &sceneBufferDescHolder.sceneBufferDesc, sizeof(SceneBufferDesc));
-        sceneBufferDescHolder.sceneBufferDescRes.resource->Unmap(0, &readRange);
-
-        m_sceneBufferDescriptors.push_back(sceneBufferDescHolder);
+        geometryIndexSizes.push_back(geoBuffer.indexSizeInBytes);
     }
+
+    std::vector<SceneBufferDesc> sceneBufferDescs;
+    DXRPhotonMapper::SceneTables::PackInstances(m_scene, m_primitiveGeometries, geometryIndexSizes, sceneBufferDescs);
+    BuildStructuredBuffer(sceneBufferDescs.data(), UINT(sceneBufferDescs.size()), sizeof(SceneBufferDesc), &m_sceneBufferDescs, L"SceneBufferDescs");
 }
 
 void PhotonBaseRenderer::BuildMaterialBuffer()
+{
+    std::vector<MaterialDesc> materialDescs;
+    DXRPhotonMapper::SceneTables::PackMaterials(m_scene, materialDescs);
+    BuildStructuredBuffer(materialDescs.data(), UINT(materialDescs.size()), sizeof(MaterialDesc), &m_materialDescs, L"MaterialDescs");
+}
+
+void PhotonBaseRenderer::BuildLightBuffer()
+{
+    std::vector<LightDesc> lightDescs;
+    DXRPhotonMapper::SceneTables::PackLights(m_scene, lightDescs);
+    BuildStructuredBuffer(lightDescs.data(), UINT(lightDescs.size()), sizeof(LightDesc), &m_lightDescs, L"LightDescs");
+}
+
+// Upload a table in one buffer and create its structured buffer SRV.
+// A table that is rebuilt keeps its descriptor, the root descriptor tables point at it.
+void PhotonBaseRenderer::BuildStructuredBuffer(const void* data, UINT numElements, UINT elementSize, D3DBuffer* buffer, LPCWSTR resourceName)
 {
     auto device = m_deviceResources->GetD3DDevice();
-    for (size_t i = 0; i < m_scene.m_materials.size(); ++i)
-    {
-        MaterialDescHolder materialDescHolder = {};
-        materialDescHolder.materialDesc.materialID = UINT(i);
-        materialDescHolder.materialDesc.albedo = m_scene.m_materials[i].m_baseMaterials[0].m_albedo;
 
-        const size_t bufferSize = (sizeof(MaterialDesc) + 255) & ~255;
-        CreateUploadBuffer(device, bufferSize, &materialDescHolder.materialDescRes.resource);
+    UINT descriptorIndex = UINT_MAX;
+    if (buffer->resource)
+    {
+        descriptorIndex = UINT((buffer->cpuDescriptorHandle.ptr - m_descriptorHeap->GetCPUDescriptorHandleForHeapStart().ptr) / m_descriptorSize);
+    }
 
-        UINT descriptorIndex = AllocateDescriptor(&materialDescHolder.materialDescRes.cpuDescriptorHandle);
-        materialDescHolder.materialDescRes.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
+    AllocateUploadBuffer(device, const_cast<void*>(data), numElements * elementSize, &buffer->resource, resourceName);
+    CreateBufferSRV(buffer, numElements, elementSize, descriptorIndex);
+}
 
-        // Create a CBV descriptor
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-        cbvDesc.BufferLocation = materialDescHolder.materialDescRes.resource->GetGPUVirtualAddress();
-        cbvDesc.SizeInBytes = bufferSize;
-        device->CreateConstantBufferView(&cbvDesc, materialDescHolder.materialDescRes.cpuDescriptorHandle);
+// Release the buffers and acceleration structures built from the scene, so they can be built again.
+void PhotonBaseRenderer::ReleaseSceneResources()
+{
+    m_geometryBuffers.clear();
+    m_geometryInstances.clear();
+    m_geometryPrimitives.clear();
+    m_primitiveGeometries.clear();
 
-        CD3DX12_RANGE readRange(0, 0);
-        SceneBufferDesc *mappedConstantData;
-        ThrowIfFailed(materialDescHolder.materialDescRes.resource->Map(0, &readRange, reinterpret_cast<void**>(&mappedConstantData)));
-        memcpy(mappedConstantData, &materialDescHolder.materialDesc, sizeof(MaterialDesc));
-        materialDescHolder.materialDescRes.resource->Unmap(0, &readRange);
+    m_sceneBufferDescs.resource.Reset();
+    m_materialDescs.resource.Reset();
+    m_lightDescs.resource.Reset();
 
-        m_materialDescriptors.push_back(materialDescHolder);
-    }
+    m_topLevelAccelerationStructure.Reset();
 }
 
-void PhotonBaseRenderer::BuildLightBuffer()
+// Reload the scene once its file changed on disk, and update what the changes touch in place:
+// the scene tables they are packed into and, for moved primitives, the instances of the TLAS.
+// Topology changes are only reported, the caller rebuilds every device resource for them.
+DXRPhotonMapper::SceneChange PhotonBaseRenderer::ReloadScene()
 {
-    auto device = m_deviceResources->GetD3DDevice();
-    for (size_t i = 0; i < m_scene.m_lights.size(); ++i)
+    using DXRPhotonMapper::SceneChange;
+
+    if (!m_sceneWatcher.HasChanged())
     {
-        LightDescHolder lightDescHolder = {};
-        lightDescHolder.lightDesc.shapeID = static_cast<UINT>(m_scene.m_lights[i].m_lightType);
-        lightDescHolder.lightDesc.lightIntensity = m_scene.m_lights[i].m_lightIntensity;
-        lightDescHolder.lightDesc.lightColor = m_scene.m_lights[i].m_lightColor;
-
-        const size_t bufferSize = (sizeof(LightDesc) + 255) & ~255;
-        CreateUploadBuffer(device, bufferSize, &lightDescHolder.lightDescRes.resource);
-
-        UINT descriptorIndex = AllocateDescriptor(&lightDescHolder.lightDescRes.cpuDescriptorHandle);
-        lightDescHolder.lightDescRes.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
-
-        // Create a CBV descriptor
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-        cbvDesc.BufferLocation = lightDescHolder.lightDescRes.resource->GetGPUVirtualAddress();
-        cbvDesc.SizeInBytes = bufferSize;
-        device->CreateConstantBufferView(&cbvDesc, lightDescHolder.lightDescRes.cpuDescriptorHandle);
-
-        CD3DX12_RANGE readRange(0, 0);
-        SceneBufferDesc *mappedConstantData;
-        ThrowIfFailed(lightDescHolder.lightDescRes.resource->Map(0, &readRange, reinterpret_cast<void**>(&mappedConstantData)));
-        memcpy(mappedConstantData, &lightDescHolder.lightDesc, sizeof(LightDesc));
-        lightDescHolder.lightDescRes.resource->Unmap(0, &readRange);
-
-        m_lightDescriptors.push_back(lightDescHolder);
+        return SceneChange::None;
     }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // A file caught halfway through being saved fails to load, the next save is picked up again
+    DXRPhotonMapper::PMScene reloaded(m_scene.m_screenSize[0], m_scene.m_screenSize[1]);
+    reloaded.m_textureCache = m_scene.m_textureCache;
+    if (!reloaded.LoadScene(m_scene.m_fileName))
+    {
+        OutputDebugString(L"Scene reload failed, keeping the current scene\n");
+        return SceneChange::None;
+    }
+
+    SceneChange changes = DXRPhotonMapper::DiffScenes(m_scene, reloaded);
+    if (changes == SceneChange::None)
+    {
+        return changes;
+    }
+    m_scene = reloaded;
+
+    if (!DXRPhotonMapper::HasSceneChange(changes, SceneChange::Topology))
+    {
+        // Frames in flight still read the tables and the TLAS
+        m_deviceResources->WaitForGpu();
+
+        if (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Transforms))
+        {
+            for (size_t i = 0; i < m_geometryInstances.size(); ++i)
+            {
+                m_geometryInstances[i].transformationMatrix = XMLoadFloat4x4(&m_scene.m_primitiveWorlds[i].m_transform);
+            }
+
+            auto commandList = m_deviceResources->GetCommandList();
+            commandList->Reset(m_deviceResources->GetCommandAllocator(), nullptr);
+            BuildTopLevelAccelerationStructure();
+        }
+
+        // Instances carry their material index and normal transform
+        if (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Materials) || DXRPhotonMapper::HasSceneChange(changes, SceneChange::Transforms))
+        {
+            BuildGeometrySceneBufferDesc();
+        }
+        if (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Materials))
+        {
+            BuildMaterialBuffer();
+        }
+        if (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Lights))
+        {
+            BuildLightBuffer();
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::wstringstream debugText;
+    debugText << L"Scene reloaded in " << std::chrono::duration<double, std::milli>(end - start).count() << L" ms:"
+        << (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Materials) ? L" materials" : L"")
+        << (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Lights) ? L" lights" : L"")
+        << (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Transforms) ? L" transforms" : L"")
+        << (DXRPhotonMapper::HasSceneChange(changes, SceneChange::Topology) ? L" topology" : L"") << L"\n";
+    OutputDebugString(debugText.str().c_str());
+    return changes;
 }
 
 void PhotonBaseRenderer::BuildGeometryAccelerationStructures()
 {
     auto device = m_deviceResources->GetD3DDevice();
     auto commandList = m_deviceResources->GetCommandList();
-    auto commandQueue = m_deviceResources->GetCommandQueue();
     auto commandAllocator = m_deviceResources->GetCommandAllocator();
 
     // Reset the command list for the acceleration structure construction.
     commandList->Reset(commandAllocator, nullptr);
 
-    // 1. Create a unique Bottom Level Acceleration Structure for each primitive
+    // 1. Create a Bottom Level Acceleration Structure for each distinct mesh, shared by its instances
     for (auto& geoBuffer : m_geometryBuffers)
     {
         // 1a. Get the geometry descriptors
@@ -397,18 +344,67 @@ void PhotonBaseRenderer::BuildGeometryAccelerationStructures()
             initialResourceState = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
         }
         AllocateUAVBuffer(device, geoBuffer.bottomLevelAccStructPreBuildInfo.ResultDataMaxSizeInBytes, &geoBuffer.bottomLevelAccStructure, initialResourceState, L"BottomLevelAccelerationStructure");
+
+        // 1f. BLAS: Assign the scratch and result space
+        geoBuffer.bottomLevelAccStructDesc.ScratchAccelerationStructureData = geoBuffer.bottomLevelScratchRes->GetGPUVirtualAddress();
+        geoBuffer.bottomLevelAccStructDesc.DestAccelerationStructureData = geoBuffer.bottomLevelAccStructure->GetGPUVirtualAddress();
+    }
+
+    // Note on Emulated GPU pointers (AKA Wrapped pointers) requirement in Fallback Layer:
+    // The primary point of divergence between the DXR API and the compute-based Fallback layer is the handling of GPU pointers. 
+    // DXR fundamentally requires that GPUs be able to dynamically read from arbitrary addresses in GPU memory. 
+    // The existing Direct Compute API today is more rigid than DXR and requires apps to explicitly inform the GPU what blocks of memory it will access with SRVs/UAVs.
+    // In order to handle the requirements of DXR, the Fallback Layer uses the concept of Emulated GPU pointers, 
+    // which requires apps to create views around all memory they will access for raytracing, 
+    // but retains the DXR-like flexibility of only needing to bind the top level acceleration structure at DispatchRays.
+    //
+    // The Fallback Layer interface uses WRAPPED_GPU_POINTER to encapsulate the underlying pointer
+    // which will either be an emulated GPU pointer for the compute - based path or a GPU_VIRTUAL_ADDRESS for the DXR path.
+
+    // 2. Build the BLASes, one wrapped pointer per BLAS is shared by the instances of its mesh
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        // Set the descriptor heaps to be used during acceleration structure build for the Fallback Layer.
+        ID3D12DescriptorHeap *pDescriptorHeaps[] = { m_descriptorHeap.Get() };
+        m_fallbackCommandList->SetDescriptorHeaps(ARRAYSIZE(pDescriptorHeaps), pDescriptorHeaps);
+        for (auto& geoBuffer : m_geometryBuffers)
+        {
+            UINT numBufferElements = static_cast<UINT>(geoBuffer.bottomLevelAccStructPreBuildInfo.ResultDataMaxSizeInBytes) / sizeof(UINT32);
+            geoBuffer.bottomLevelPointer = CreateFallbackWrappedPointer(geoBuffer.bottomLevelAccStructure.Get(), numBufferElements);
+
+            m_fallbackCommandList->BuildRaytracingAccelerationStructure(&geoBuffer.bottomLevelAccStructDesc, 0, nullptr);
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(geoBuffer.bottomLevelAccStructure.Get()));
+        }
     }
+    else // DirectX Raytracing
+    {
+        for (auto& geoBuffer : m_geometryBuffers)
+        {
+            m_dxrCommandList->BuildRaytracingAccelerationStructure(&geoBuffer.bottomLevelAccStructDesc, 0, nullptr);
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(geoBuffer.bottomLevelAccStructure.Get()));
+        }
+    }
+
+    // 3. The top level acceleration structure goes into the same command list
+    BuildTopLevelAccelerationStructure();
+}
 
-    // 2a. Create a Descriptor for the top Level Inputs
+// Build the TLAS over the instances into the reset command list, then execute it and wait for the GPU.
+// A TLAS that already exists is rebuilt in place, only instance transforms may have changed since.
+void PhotonBaseRenderer::BuildTopLevelAccelerationStructure()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // 1a. Create a Descriptor for the top Level Inputs
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC topLevelBuildDesc = {};
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &topLevelInputs = topLevelBuildDesc.Inputs;
     topLevelInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
     topLevelInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-    topLevelInputs.NumDescs = m_geometryBuffers.size();
+    topLevelInputs.NumDescs = UINT(m_geometryInstances.size());
     topLevelInputs.pGeometryDescs = nullptr;
     topLevelInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 
-    // 2b. Get the Prebuild info - scratch space and result space size for top level acceleration structure
+    // 1b. Get the Prebuild info - scratch space and result space size for top level acceleration structure
     D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO topLevelPrebuildInfo = {};
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
@@ -420,48 +416,45 @@ void PhotonBaseRenderer::BuildGeometryAccelerationStructures()
     }
     ThrowIfFalse(topLevelPrebuildInfo.ResultDataMaxSizeInBytes > 0);
 
-    // 2c. Allocate scratch space for building the top level acc structure
+    // 1c. Allocate scratch space for building the top level acc structure
     ComPtr<ID3D12Resource> topLevelScratchRes;
     AllocateUAVBuffer(device, topLevelPrebuildInfo.ScratchDataSizeInBytes, &topLevelScratchRes, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"TopLevelScratchResource");
 
-    // 2d. Allocate result space for the top level acc structure
-    D3D12_RESOURCE_STATES initialResourceState;
-    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    // 1d. Allocate result space for the top level acc structure, and wrap it for the fallback layer
+    if (!m_topLevelAccelerationStructure)
     {
-        initialResourceState = m_fallbackDevice->GetAccelerationStructureResourceState();
-    }
-    else // DirectX Raytracing
-    {
-        initialResourceState = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
-    }
-    AllocateUAVBuffer(device, topLevelPrebuildInfo.ResultDataMaxSizeInBytes, &m_topLevelAccelerationStructure, initialResourceState, L"TopLevelAccelerationStructure");
+        D3D12_RESOURCE_STATES initialResourceState;
+        if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+        {
+            initialResourceState = m_fallbackDevice->GetAccelerationStructureResourceState();
+        }
+        else // DirectX Raytracing
+        {
+            initialResourceState = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
+        }
+        AllocateUAVBuffer(device, topLevelPrebuildInfo.ResultDataMaxSizeInBytes, &m_topLevelAccelerationStructure, initialResourceState, L"TopLevelAccelerationStructure");
 
-    // Note on Emulated GPU pointers (AKA Wrapped pointers) requirement in Fallback Layer:
-    // The primary point of divergence between the DXR API and the compute-based Fallback layer is the handling of GPU pointers. 
-    // DXR fundamentally requires that GPUs be able to dynamically read from arbitrary addresses in GPU memory. 
-    // The existing Direct Compute API today is more rigid than DXR and requires apps to explicitly inform the GPU what blocks of memory it will access with SRVs/UAVs.
-    // In order to handle the requirements of DXR, the Fallback Layer uses the concept of Emulated GPU pointers, 
-    // which requires apps to create views around all memory they will access for raytracing, 
-    // but retains the DXR-like flexibility of only needing to bind the top level acceleration structure at DispatchRays.
-    //
-    // The Fallback Layer interface uses WRAPPED_GPU_POINTER to encapsulate the underlying pointer
-    // which will either be an emulated GPU pointer for the compute - based path or a GPU_VIRTUAL_ADDRESS for the DXR path.
+        if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+        {
+            UINT numBufferElements = static_cast<UINT>(topLevelPrebuildInfo.ResultDataMaxSizeInBytes) / sizeof(UINT32);
+            m_fallBackPrimitiveTLAS = CreateFallbackWrappedPointer(m_topLevelAccelerationStructure.Get(), numBufferElements);
+        }
+    }
 
-    // 3. Create an instance desc for each of the bottom-level acceleration structure.    
+    // 2. Create an instance desc for each primitive, pointing at the BLAS of its mesh
     ComPtr<ID3D12Resource> instanceDescs;
     std::vector<D3D12_RAYTRACING_FALLBACK_INSTANCE_DESC> fallbackInstanceDescriptions;
     std::vector<D3D12_RAYTRACING_INSTANCE_DESC> dxrInstanceDescriptions;
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
         UINT instanceId = 0;
-        for (auto& geoBuffer : m_geometryBuffers)
+        for (const auto& instance : m_geometryInstances)
         {
             D3D12_RAYTRACING_FALLBACK_INSTANCE_DESC instanceDesc = {};
-            XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4*>(instanceDesc.Transform), geoBuffer.transformationMatrix);
+            XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4*>(instanceDesc.Transform), instance.transformationMatrix);
             instanceDesc.InstanceMask = 1;
             instanceDesc.InstanceID = instanceId++;
-            UINT numBufferElements = static_cast<UINT>(geoBuffer.bottomLevelAccStructPreBuildInfo.ResultDataMaxSizeInBytes) / sizeof(UINT32);
-            instanceDesc.AccelerationStructure = CreateFallbackWrappedPointer(geoBuffer.bottomLevelAccStructure.Get(), numBufferElements);
+            instanceDesc.AccelerationStructure = m_geometryBuffers[instance.geometryIndex].bottomLevelPointer;
             fallbackInstanceDescriptions.push_back(instanceDesc);
         }
         AllocateUploadBuffer(device, fallbackInstanceDescriptions.data(), fallbackInstanceDescriptions.size() * sizeof(D3D12_RAYTRACING_FALLBACK_INSTANCE_DESC), &instanceDescs, L"InstanceDescs");
@@ -469,10 +462,11 @@ void PhotonBaseRenderer::BuildGeometryAccelerationStructures()
     else // DirectX Raytracing
     {
         UINT instanceId = 0;
-        for (auto& geoBuffer : m_geometryBuffers)
+        for (const auto& instance : m_geometryInstances)
         {
+            const GeometryBuffer& geoBuffer = m_geometryBuffers[instance.geometryIndex];
             D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-            XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4*>(instanceDesc.Transform), geoBuffer.transformationMatrix);
+            XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4*>(instanceDesc.Transform), instance.transformationMatrix);
             instanceDesc.InstanceMask = 1;
             instanceDesc.InstanceID = instanceId++;
             instanceDesc.AccelerationStructure = geoBuffer.bottomLevelAccStructure->GetGPUVirtualAddress();
@@ -481,54 +475,29 @@ void PhotonBaseRenderer::BuildGeometryAccelerationStructures()
         AllocateUploadBuffer(device, dxrInstanceDescriptions.data(), dxrInstanceDescriptions.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC), &instanceDescs, L"InstanceDescs");
     }
 
-    // 4. Create a wrapped pointer to the acceleration structure.
-    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
-    {
-        UINT numBufferElements = static_cast<UINT>(topLevelPrebuildInfo.ResultDataMaxSizeInBytes) / sizeof(UINT32);
-        m_fallBackPrimitiveTLAS = CreateFallbackWrappedPointer(m_topLevelAccelerationStructure.Get(), numBufferElements);
-    }
-
-    // 5. Assign the scratch and result space for the BLAS
-    for (auto& geoBuffer : m_geometryBuffers)
-    {
-        geoBuffer.bottomLevelAccStructDesc.ScratchAccelerationStructureData = geoBuffer.bottomLevelScratchRes->GetGPUVirtualAddress();
-        geoBuffer.bottomLevelAccStructDesc.DestAccelerationStructureData = geoBuffer.bottomLevelAccStructure->GetGPUVirtualAddress();
-    }
-
-    // 6. Assign Top Level Acceleration Structure desc
+    // 3. Assign Top Level Acceleration Structure desc
     {
         topLevelBuildDesc.DestAccelerationStructureData = m_topLevelAccelerationStructure->GetGPUVirtualAddress();
         topLevelBuildDesc.ScratchAccelerationStructureData = topLevelScratchRes->GetGPUVirtualAddress();
         topLevelBuildDesc.Inputs.InstanceDescs = instanceDescs->GetGPUVirtualAddress();
     }
 
-    // 7. Build acceleration structure.
+    // 4. Build acceleration structure.
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        // Set the descriptor heaps to be used during acceleration structure build for the Fallback Layer.
         ID3D12DescriptorHeap *pDescriptorHeaps[] = { m_descriptorHeap.Get() };
         m_fallbackCommandList->SetDescriptorHeaps(ARRAYSIZE(pDescriptorHeaps), pDescriptorHeaps);
-        for (auto& geoBuffer : m_geometryBuffers)
-        {
-            m_fallbackCommandList->BuildRaytracingAccelerationStructure(&geoBuffer.bottomLevelAccStructDesc, 0, nullptr);
-            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(geoBuffer.bottomLevelAccStructure.Get()));
-        }
         m_fallbackCommandList->BuildRaytracingAccelerationStructure(&topLevelBuildDesc, 0, nullptr);
     }
     else // DirectX Raytracing
     {
-        for (auto& geoBuffer : m_geometryBuffers)
-        {
-            m_dxrCommandList->BuildRaytracingAccelerationStructure(&geoBuffer.bottomLevelAccStructDesc, 0, nullptr);
-            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(geoBuffer.bottomLevelAccStructure.Get()));
-        }
         m_dxrCommandList->BuildRaytracingAccelerationStructure(&topLevelBuildDesc, 0, nullptr);
     }
 
-    // 8. Kick off acceleration structure construction.
+    // 5. Kick off acceleration structure construction.
     m_deviceResources->ExecuteCommandList();
 
-    // 9. Wait for GPU to finish as the locally created temporary GPU resources will get released once we go out of scope.
+    // 6. Wait for GPU to finish as the locally created temporary GPU resources will get released once we go out of scope.
     m_deviceResources->WaitForGpu();
 }
 
@@ -546,7 +515,8 @@ UINT PhotonBaseRenderer::AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDesc
 }
 
 // Create SRV for a buffer.
-UINT PhotonBaseRenderer::CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize)
+// If the passed descriptorIndexToUse is valid, the view is written there instead of a newly allocated descriptor.
+UINT PhotonBaseRenderer::CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize, UINT descriptorIndexToUse)
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -567,7 +537,7 @@ UINT PhotonBaseRenderer::CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UI
         srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
         srvDesc.Buffer.StructureByteStride = elementSize;
     }
-    UINT descriptorIndex = AllocateDescriptor(&buffer->cpuDescriptorHandle);
+    UINT descriptorIndex = AllocateDescriptor(&buffer->cpuDescriptorHandle, descriptorIndexToUse);
     device->CreateShaderResourceView(buffer->resource.Get(), &srvDesc, buffer->cpuDescriptorHandle);
     buffer->gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
     return descriptorIndex;
@@ -601,8 +571,8 @@ D3D12_RAYTRACING_GEOMETRY_DESC PhotonBaseRenderer::GetRayTracingGeometryDescript
     D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
     geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
     geometryDesc.Triangles.IndexBuffer = geoBuffer.indexBuffer.resource->GetGPUVirtualAddress();
-    geometryDesc.Triangles.IndexCount = static_cast<UINT>(geoBuffer.indexBuffer.resource->GetDesc().Width) / sizeof(Index);
-    geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+    geometryDesc.Triangles.IndexCount = geoBuffer.indexCount;
+    geometryDesc.Triangles.IndexFormat = (geoBuffer.indexSizeInBytes == 4) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
     geometryDesc.Triangles.Transform3x4 = 0;
     geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
     geometryDesc.Triangles.VertexCount = static_cast<UINT>(geoBuffer.vertexBuffer.resource->GetDesc().Width) / sizeof(Vertex);
@@ -616,20 +586,20 @@ D3D12_RAYTRACING_GEOMETRY_DESC PhotonBaseRenderer::GetRayTracingGeometryDescript
 UINT PhotonBaseRenderer::GetNumDescriptorsForScene()
 {
     // Allocate a heap for descriptors:
-    // n - vertex SRVs
-    // n - index SRVs
-    // n - constant buffer views for scene buffer info
-    // n - constant buffer views for materials
-    // n - constant buffer views for lights
-    // n - bottom level acceleration structure fallback wrapped pointer UAVs
+    // m - vertex SRVs, one per distinct mesh
+    // m - index SRVs, one per distinct mesh
+    // 1 - structured buffer SRV for the scene buffer info of every instance
+    // 1 - structured buffer SRV for the materials
+    // 1 - structured buffer SRV for the lights
+    // m - bottom level acceleration structure fallback wrapped pointer UAVs
     // n - top level acceleration structure fallback wrapped pointer UAVs
-    const UINT numVertexSRVDescs = UINT(m_scene.m_primitives.size());
-    const UINT numIndexSRVDescs = UINT(m_scene.m_primitives.size());
-    const UINT numSceneCBVDescs = UINT(m_scene.m_primitives.size());
-    const UINT numMaterialCBVDescs = UINT(m_scene.m_materials.size());
-    const UINT numLightCBVDescs = UINT(m_scene.m_lights.size());
-    const UINT numBLASDescs = UINT(m_scene.m_primitives.size());
+    const UINT numVertexSRVDescs = GetNumGeometries();
+    const UINT numIndexSRVDescs = GetNumGeometries();
+    const UINT numSceneSRVDescs = 1;
+    const UINT numMaterialSRVDescs = 1;
+    const UINT numLightSRVDescs = 1;
+    const UINT numBLASDescs = GetNumGeometries();
     const UINT numTLASDescs = UINT(m_scene.m_primitives.size());
 
-    return (numVertexSRVDescs + numIndexSRVDescs + numSceneCBVDescs + numMaterialCBVDescs + numLightCBVDescs + numBLASDescs + numTLASDescs);
+    return (numVertexSRVDescs + numIndexSRVDescs + numSceneSRVDescs + numMaterialSRVDescs + numLightSRVDescs + numBLASDescs + numTLASDescs);
 }
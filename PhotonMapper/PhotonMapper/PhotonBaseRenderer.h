@@ -15,6 +15,7 @@
 #include "Win32Application.h"
 #include "DeviceResources.h"
 #include "PMScene.h"
+#include "PMSceneReload.h"
 #include "DirectXRaytracingHelper.h"
 
 class PhotonBaseRenderer : public DX::IDeviceNotify
@@ -75,6 +76,7 @@ public:
 protected:
 
     DXRPhotonMapper::PMScene m_scene;
+    DXRPhotonMapper::PMFileWatcher m_sceneWatcher;
 
     void SetCustomWindowText(LPCWSTR text);
 
@@ -135,9 +137,12 @@ protected:
         UINT uavDescriptorHeapIndex;
     };
 
-    // Geometry buffer holder for building acceleration structure
+    // Geometry buffer holder for building acceleration structure, one per distinct mesh
     struct GeometryBuffer
     {
+        UINT indexCount;
+        UINT indexSizeInBytes;      // 2 or 4
+
         UINT indexNumElements;
         UINT indexElementSize;
 
@@ -147,59 +152,60 @@ protected:
         D3DBuffer indexBuffer;
         D3DBuffer vertexBuffer;
 
-        // 3 X 4 transform matrix
-        XMMATRIX transformationMatrix;
-        XMMATRIX normalTransform;
-
         std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs;
 
         D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC bottomLevelAccStructDesc;
         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO bottomLevelAccStructPreBuildInfo;
         ComPtr<ID3D12Resource> bottomLevelScratchRes;
         ComPtr<ID3D12Resource> bottomLevelAccStructure;
+        WRAPPED_GPU_POINTER bottomLevelPointer;    // Fallback Layer only
     };
 
-    struct SceneBufferDescHolder
+    // Placement of a geometry buffer for one primitive, primitives of the same mesh share the buffer and its BLAS
+    struct GeometryInstance
     {
-        SceneBufferDesc sceneBufferDesc;
-        D3DBuffer sceneBufferDescRes;
-    };
-    std::vector<SceneBufferDescHolder> m_sceneBufferDescriptors;
+        UINT geometryIndex;
 
-    struct MaterialDescHolder
-    {
-        MaterialDesc materialDesc;
-        D3DBuffer materialDescRes;
+        // 3 X 4 transform matrix
+        XMMATRIX transformationMatrix;
     };
-    std::vector<MaterialDescHolder> m_materialDescriptors;
 
-    struct LightDescHolder
-    {
-        LightDesc lightDesc;
-        D3DBuffer lightDescRes;
-    };
-    std::vector<LightDescHolder> m_lightDescriptors;
+    // One structured buffer per table, indexed by InstanceID, material ID and light index in the shaders
+    D3DBuffer m_sceneBufferDescs;
+    D3DBuffer m_materialDescs;
+    D3DBuffer m_lightDescs;
 
     // Acceleration structure for the entire scene
     ComPtr<ID3D12Resource> m_topLevelAccelerationStructure;
 
     WRAPPED_GPU_POINTER m_fallBackPrimitiveTLAS;
     std::vector<GeometryBuffer> m_geometryBuffers;
+    std::vector<GeometryInstance> m_geometryInstances;
+
+    // First primitive of each geometry buffer's mesh, and the geometry buffer of each primitive
+    std::vector<size_t> m_geometryPrimitives;
+    std::vector<UINT> m_primitiveGeometries;
 
     // Construction of Scene information
-    void GetVerticesForPrimitiveType(DXRPhotonMapper::PrimitiveType type, std::vector<Vertex>& vertices);
-    void GetIndicesForPrimitiveType(DXRPhotonMapper::PrimitiveType type, std::vector<Index>& indices);
     void BuildGeometryBuffers();
     void BuildGeometrySceneBufferDesc();
     void BuildMaterialBuffer();
     void BuildLightBuffer();
+    void BuildStructuredBuffer(const void* data, UINT numElements, UINT elementSize, D3DBuffer* buffer, LPCWSTR resourceName);
     void BuildGeometryAccelerationStructures();
+    void BuildTopLevelAccelerationStructure();
+    void ReleaseSceneResources();
+
+    // Scene hot reload
+    DXRPhotonMapper::SceneChange ReloadScene();
 
     UINT AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse = UINT_MAX);
-    UINT CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize);
+    UINT CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize, UINT descriptorIndexToUse = UINT_MAX);
     WRAPPED_GPU_POINTER CreateFallbackWrappedPointer(ID3D12Resource* resource, UINT bufferNumElements);
     D3D12_RAYTRACING_GEOMETRY_DESC GetRayTracingGeometryDescriptor(const GeometryBuffer& geoBuffer);
 
+    // Distinct meshes of the scene, the size of the vertex and index buffer arrays
+    UINT GetNumGeometries();
     UINT GetNumDescriptorsForScene();
 
 
@@ -0,0 +1,292 @@
+#ifndef PHOTON_MAJOR_CAUSTIC_PASS
+#define PHOTON_MAJOR_CAUSTIC_PASS
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "FluxAccumulation.hlsli"
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// G-Buffers
+RWTexture2DArray<float4> GPhotonPos : register(u5);
+RWTexture2DArray<float4> GPhotonColor : register(u6);
+RWTexture2DArray<float4> GPhotonNorm : register(u7);
+RWTexture2DArray<float4> GPhotonTangent : register(u8);
+
+// Caustic map - one photon per ray, stored at its first diffuse hit after a specular bounce
+RWTexture2D<float4> GCausticPos : register(u9);
+RWTexture2D<float4> GCausticColor : register(u10);
+
+RaytracingAccelerationStructure Scene : register(t0, space0);
+StructuredBuffer<uint> ProjectionMapCells : register(t1, space0);
+ByteAddressBuffer Indices[] : register(t0, space1);
+StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
+
+// Constant buffers
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
+
+
+// Load three 16 bit indices from a byte addressed buffer.
+uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
+{
+    uint3 indices;
+
+    // ByteAdressBuffer loads must be aligned at a 4 byte boundary.
+    // Since we need to read three 16 bit indices: { 0, 1, 2 }
+    // aligned at a 4 byte boundary as: { 0 1 } { 2 0 } { 1 2 } { 0 1 } ...
+    // we will load 8 bytes (~ 4 indices { a b | c d }) to handle two possible index triplet layouts,
+    // based on first index's offsetBytes being aligned at the 4 byte boundary or not:
+    //  Aligned:     { 0 1 | 2 - }
+    //  Not aligned: { - 0 | 1 2 }
+    const uint dwordAlignedOffset = offsetBytes & ~3;
+    const uint2 four16BitIndices = Indices[geomOffset].Load2(dwordAlignedOffset);
+
+    // Aligned: { 0 1 | 2 - } => retrieve first three 16bit indices
+    if (dwordAlignedOffset == offsetBytes)
+    {
+        indices.x = four16BitIndices.x & 0xffff;
+        indices.y = (four16BitIndices.x >> 16) & 0xffff;
+        indices.z = four16BitIndices.y & 0xffff;
+    }
+    else // Not aligned: { - 0 | 1 2 } => retrieve last three 16bit indices
+    {
+        indices.x = (four16BitIndices.x >> 16) & 0xffff;
+        indices.y = four16BitIndices.y & 0xffff;
+        indices.z = (four16BitIndices.y >> 16) & 0xffff;
+    }
+
+    return indices;
+}
+
+// Load the three indices of a triangle, 16 or 32 bit as the instance's mesh stores them.
+uint3 LoadTriangleIndices(uint geomOffset, uint offsetBytes, uint indexSizeInBytes)
+{
+    if (indexSizeInBytes == 4)
+    {
+        return Indices[geomOffset].Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(geomOffset, offsetBytes);
+}
+
+typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+struct RayPayload
+{
+    float4 color;
+    float4 hitPosition;
+    float4 extraInfo; // [0] is shadowHit, [1] is bounce depth, [2] is 1 once the photon has bounced off a specular surface
+    float3 throughput;
+    float3 direction;
+};
+
+// Retrieve hit world position.
+float3 HitWorldPosition()
+{
+    return WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
+}
+
+// Retrieve attribute at a hit position interpolated from vertex attributes using the hit's barycentrics.
+float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttributes attr)
+{
+    return vertexAttribute[0] +
+        attr.barycentrics.x * (vertexAttribute[1] - vertexAttribute[0]) +
+        attr.barycentrics.y * (vertexAttribute[2] - vertexAttribute[0]);
+}
+
+// Sampling functions
+static const float PI = 3.1415926535897932384626422832795028841971f;
+static const float TWO_PI = 6.2831853071795864769252867665590057683943f;
+static const float EPSILON = 0.0001f;
+
+inline float3 SquareToSphereUniform(float2 samplePoint)
+{
+    float radius = 1.f;
+
+    float phi = samplePoint.y * PI;
+    float theta = samplePoint.x * TWO_PI;
+
+    float3 result;
+    result.x = radius * cos(theta) * sin(phi);
+    result.y = radius * cos(phi);
+    result.z = radius * sin(theta) * sin(phi);
+    return result;
+}
+
+// Functions for PRNG
+// http://www.reedbeta.com/blog/quick-and-easy-gpu-random-numbers-in-d3d11/
+static uint rng_state;
+static const float prng_01_convert = (1.0f / 4294967296.0f); // Convert numbers generated by rand_xorshift to be between 0, 1
+float rand_xorshift()
+{
+    // Xorshift algorithm from George Marsaglia's paper
+    rng_state ^= uint(rng_state << 13);
+    rng_state ^= uint(rng_state >> 17);
+    rng_state ^= uint(rng_state << 5);
+    return rng_state * prng_01_convert;
+}
+
+// Wang hash
+uint wang_hash(uint seed)
+{
+    seed = (seed ^ 61) ^ (seed >> 16);
+    seed *= 9;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2d;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+// Generate a photon direction through a random active cell of the projection map
+inline void GenerateCausticPhoton(uint numCells, out float3 origin, out float3 rayDir)
+{
+    origin = g_sceneCB.lightPosition.xyz;
+
+    uint cell = ProjectionMapCells[min(uint(rand_xorshift() * numCells), numCells - 1)];
+    uint thetaIndex = cell % PROJECTION_MAP_THETA_RES;
+    uint phiIndex = cell / PROJECTION_MAP_THETA_RES;
+
+    // Jitter within the cell, in the same sample space the first pass draws from
+    float2 randomSample;
+    randomSample.x = (thetaIndex + rand_xorshift()) / PROJECTION_MAP_THETA_RES;
+    randomSample.y = (phiIndex + rand_xorshift()) / PROJECTION_MAP_PHI_RES;
+    rayDir = SquareToSphereUniform(randomSample);
+}
+
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+    uint2 index = DispatchRaysIndex().xy;
+
+    // Photons that never reach a diffuse surface through a specular one leave their slot empty
+    GCausticPos[index] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    GCausticColor[index] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    uint numCells, stride;
+    ProjectionMapCells.GetDimensions(numCells, stride);
+
+    // Offset the seed so the caustic photons do not follow the first pass photons
+    rng_state = uint(wang_hash((index.x + DispatchRaysDimensions().x * index.y) ^ 0x9e3779b9 ^ wang_hash(g_sceneCB.photonBatch)));
+
+    float3 rayDir;
+    float3 origin;
+    GenerateCausticPhoton(numCells, origin, rayDir);
+
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = rayDir;
+    ray.TMin = 0.001;
+    ray.TMax = 10000.0;
+
+    RayPayload payload =
+    {
+        g_sceneCB.lightDiffuseColor, // Photon's starting color
+        float4(0, 0, 0, 0), // Hit Location
+        float4(1, 0, 0, 0), // Any extra information - Payload has to be 16 byte aligned
+        float3(1, 1, 1), // Throughput
+        rayDir, // Direction
+    };
+
+    // Back faces are not culled here, refracted photons have to leave the object through them
+    TraceRay(Scene, RAY_FLAG_NONE, ~0, 0, 1, 0, ray, payload);
+}
+
+[shader("closesthit")]
+void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
+{
+    int depth = payload.extraInfo.y;
+    if (depth >= MAX_RAY_RECURSION_DEPTH - 1)
+    {
+        return;
+    }
+
+    float3 hitPosition = HitWorldPosition();
+    uint instanceId = InstanceID();
+
+    // Get the base index of the triangle's first index, 16 or 32 bit depending on the mesh.
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
+    uint indicesPerTriangle = 3;
+    uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
+    uint baseIndex = PrimitiveIndex() * triangleIndexStride;
+
+    uint geometryOffset = c_bufferIndices[instanceId].vbIndex;
+    uint materialIndex = c_bufferIndices[instanceId].materialIndex;
+
+    // Load up the 3 indices for the triangle.
+    const uint3 indices = LoadTriangleIndices(geometryOffset, baseIndex, indexSizeInBytes);
+
+    // Retrieve corresponding vertex normals for the triangle vertices.
+    float3 vertexNormals[3] = {
+        Vertices[geometryOffset][indices[0]].normal,
+        Vertices[geometryOffset][indices[1]].normal,
+        Vertices[geometryOffset][indices[2]].normal
+    };
+    float3 triangleNormal = normalize(HitAttribute(vertexNormals, attr));
+
+    MaterialDesc material = c_materials[materialIndex];
+    float3 rayDir = normalize(payload.direction);
+    bool isEntering = dot(rayDir, triangleNormal) < 0.0f;
+
+    if ((material.materialFlags & MATERIAL_FLAG_SPECULAR) == 0)
+    {
+        // Only light focused by a specular bounce is a caustic, direct hits are covered by the first pass
+        bool isCaustic = payload.extraInfo.z > 0.0f;
+        if (isCaustic && isEntering)
+        {
+            // w of the color is the share of the light's directions the projection map lets through
+            uint numCells, stride;
+            ProjectionMapCells.GetDimensions(numCells, stride);
+            float coverage = float(numCells) / PROJECTION_MAP_NUM_CELLS;
+
+            uint2 index = DispatchRaysIndex().xy;
+            // w is the instance offset by one, as in the photon G-Buffers
+            GCausticPos[index] = float4(hitPosition, instanceId + 1);
+            GCausticColor[index] = float4(payload.color.xyz * material.albedo, coverage);
+        }
+        return;
+    }
+
+    float3 wiW;
+    if (material.materialFlags & MATERIAL_FLAG_TRANSMISSION)
+    {
+        float3 normal = isEntering ? triangleNormal : -triangleNormal;
+        float eta = isEntering ? (1.0f / material.refractiveIndex) : material.refractiveIndex;
+        wiW = refract(rayDir, normal, eta);
+
+        // Total internal reflection
+        if (dot(wiW, wiW) < EPSILON)
+        {
+            wiW = reflect(rayDir, normal);
+        }
+    }
+    else
+    {
+        wiW = reflect(rayDir, triangleNormal);
+    }
+
+    depth++;
+    payload.color = float4(payload.color.xyz * material.albedo, 1);
+    payload.hitPosition = float4(hitPosition, 0.0);
+    payload.extraInfo = float4(1.0f, depth, 1.0f, 0);
+    payload.throughput = payload.throughput * material.albedo;
+    payload.direction = normalize(wiW);
+
+    RayDesc ray;
+    ray.Origin = hitPosition;
+    ray.Direction = payload.direction;
+    ray.TMin = 0.001;
+    ray.TMax = 10000.0;
+
+    TraceRay(Scene, RAY_FLAG_NONE, ~0, 0, 1, 0, ray, payload);
+}
+
+[shader("miss")]
+void MyMissShader(inout RayPayload payload)
+{
+}
+
+#endif // PHOTON_MAJOR_CAUSTIC_PASS
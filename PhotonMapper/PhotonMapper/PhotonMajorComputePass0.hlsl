@@ -0,0 +1,46 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_0
+#define PHOTON_MAJOR_COMPUTE_PASS_0
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+
+#define blocksize 128
+
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
+// Count the splats landing in each tile, and give every splat its slot in the tile's bin
+[numthreads(blocksize, 1, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint numSplats = GVisiblePhotonCount[0];
+
+    for (uint splat = DTid.x; splat < numSplats; splat += SPLAT_BIN_GROUPS * blocksize)
+    {
+        uint packedPixel = GSplats[splat].pixel;
+        if (packedPixel == SPLAT_INVALID_PIXEL)
+        {
+            continue;
+        }
+
+        uint tile = SplatTileIndex(UnpackSplatPixel(packedPixel));
+
+        // Lanes binning into the same tile share one atomic, so concentrated light costs one add per wave instead of one per photon
+        for (;;)
+        {
+            if (tile == WaveReadLaneFirst(tile))
+            {
+                uint laneCount = WaveActiveCountBits(true);
+                uint base = 0;
+                if (WaveIsFirstLane())
+                {
+                    InterlockedAdd(GSplatTileCounts[tile], laneCount, base);
+                }
+                GSplatSlots[splat] = WaveReadLaneFirst(base) + WavePrefixCountBits(true);
+                break;
+            }
+        }
+    }
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_0
@@ -0,0 +1,48 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_1
+#define PHOTON_MAJOR_COMPUTE_PASS_1
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+
+groupshared uint g_partialSums[SPLAT_SCAN_THREADS];
+
+// Exclusive scan of the tile counts into bin offsets, in a single group.
+// Each thread sums a contiguous run of tiles, the run totals are scanned in shared memory.
+[numthreads(SPLAT_SCAN_THREADS, 1, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint2 tileDims = SplatTileDims();
+    uint numTiles = tileDims.x * tileDims.y;
+
+    uint tilesPerThread = (numTiles + SPLAT_SCAN_THREADS - 1) / SPLAT_SCAN_THREADS;
+    uint firstTile = min(GI * tilesPerThread, numTiles);
+    uint lastTile = min(firstTile + tilesPerThread, numTiles);
+
+    uint runTotal = 0;
+    for (uint tile = firstTile; tile < lastTile; ++tile)
+    {
+        runTotal += GSplatTileCounts[tile];
+    }
+
+    g_partialSums[GI] = runTotal;
+    GroupMemoryBarrierWithGroupSync();
+
+    // Hillis-Steele inclusive scan of the run totals
+    for (uint stride = 1; stride < SPLAT_SCAN_THREADS; stride <<= 1)
+    {
+        uint addend = (GI >= stride) ? g_partialSums[GI - stride] : 0;
+        GroupMemoryBarrierWithGroupSync();
+        g_partialSums[GI] += addend;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint offset = g_partialSums[GI] - runTotal;
+    for (uint tile = firstTile; tile < lastTile; ++tile)
+    {
+        GSplatTileOffsets[tile] = offset;
+        offset += GSplatTileCounts[tile];
+    }
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_1
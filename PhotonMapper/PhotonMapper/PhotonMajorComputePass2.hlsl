@@ -0,0 +1,31 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_2
+#define PHOTON_MAJOR_COMPUTE_PASS_2
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+
+#define blocksize 128
+
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
+// Scatter the splats into their tile's bin, the slots from the count pass make this atomic free
+[numthreads(blocksize, 1, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint numSplats = GVisiblePhotonCount[0];
+
+    for (uint splat = DTid.x; splat < numSplats; splat += SPLAT_BIN_GROUPS * blocksize)
+    {
+        SplatRecord splatData = GSplats[splat];
+        if (splatData.pixel == SPLAT_INVALID_PIXEL)
+        {
+            continue;
+        }
+
+        uint tile = SplatTileIndex(UnpackSplatPixel(splatData.pixel));
+        GSortedSplats[GSplatTileOffsets[tile] + GSplatSlots[splat]] = splatData;
+    }
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_2
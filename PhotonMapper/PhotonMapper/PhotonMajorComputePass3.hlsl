@@ -0,0 +1,64 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_3
+#define PHOTON_MAJOR_COMPUTE_PASS_3
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+
+#define TILE_PIXELS (SPLAT_TILE_SIZE * SPLAT_TILE_SIZE)
+
+groupshared SplatRecord g_splats[TILE_PIXELS];
+
+// One group per tile, one thread per pixel.
+// The group walks the bins of its tile and the neighbouring tiles in chunks staged through shared memory,
+// every thread keeps the kernel weighted sum for its own pixel in registers and writes it out once,
+// so bright pixels never contend.
+[numthreads(SPLAT_TILE_SIZE, SPLAT_TILE_SIZE, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    int2 tileDims = int2(SplatTileDims());
+
+    float4 accum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            // Uniform over the group, so the barriers below stay in uniform control flow
+            int2 neighbour = int2(Gid.xy) + int2(x, y);
+            if (any(neighbour < 0) || any(neighbour >= tileDims))
+            {
+                continue;
+            }
+
+            uint tile = neighbour.x + neighbour.y * tileDims.x;
+            uint binStart = GSplatTileOffsets[tile];
+            uint binCount = GSplatTileCounts[tile];
+
+            for (uint chunk = 0; chunk < binCount; chunk += TILE_PIXELS)
+            {
+                uint chunkSize = min(TILE_PIXELS, binCount - chunk);
+                if (GI < chunkSize)
+                {
+                    g_splats[GI] = GSortedSplats[binStart + chunk + GI];
+                }
+                GroupMemoryBarrierWithGroupSync();
+
+                for (uint i = 0; i < chunkSize; ++i)
+                {
+                    float weight = SplatWeight(g_splats[i], DTid.xy);
+                    accum += weight * float4(g_splats[i].color, 1.0f);
+                }
+                GroupMemoryBarrierWithGroupSync();
+            }
+        }
+    }
+
+    uint width, height;
+    GSplatAccum.GetDimensions(width, height);
+    if (accum.w > 0.0f && DTid.x < width && DTid.y < height)
+    {
+        GSplatAccum[DTid.xy] += accum;
+    }
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_3
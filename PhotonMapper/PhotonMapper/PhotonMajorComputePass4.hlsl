@@ -0,0 +1,67 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_4
+#define PHOTON_MAJOR_COMPUTE_PASS_4
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+
+// Camera depth and surface ID of the new view
+RWTexture2D<float2> GCameraDepth : register(u13);
+
+// The accumulation and camera depth as they were before the camera moved
+RWTexture2D<float4> GSplatHistory : register(u20);
+RWTexture2D<float2> GCameraDepthHistory : register(u21);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<ReprojectionConstantBuffer> g_reprojectionCB : register(b1);
+
+// Reproject the binned accumulation into the new view.
+// Each pixel rebuilds the surface point it sees from the depth pass, looks it up in the previous view,
+// and keeps the history there only if the previous view saw the same surface at the same distance.
+[numthreads(SPLAT_TILE_SIZE, SPLAT_TILE_SIZE, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint width, height;
+    GSplatAccum.GetDimensions(width, height);
+    if (DTid.x >= width || DTid.y >= height)
+    {
+        return;
+    }
+
+    float2 screenDims = float2(width, height);
+    float4 reprojected = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    float2 cameraDepth = GCameraDepth[DTid.xy];
+    if (cameraDepth.y != 0.0f)
+    {
+        // Same ray as the depth pass
+        float2 screenPos = (DTid.xy + 0.5f) / screenDims * 2.0 - 1.0;
+        screenPos.y = -screenPos.y;
+        float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
+        world.xyz /= world.w;
+        float3 rayDir = normalize(world.xyz - g_sceneCB.cameraPosition.xyz);
+        float3 position = g_sceneCB.cameraPosition.xyz + cameraDepth.x * rayDir;
+
+        float4 clippingCoord = mul(float4(position, 1), g_reprojectionCB.prevViewProj);
+        clippingCoord.xy /= clippingCoord.w;
+
+        if (clippingCoord.w > 0.0f && all(abs(clippingCoord.xy) < 1.0f))
+        {
+            uint2 prevPixel = uint2(float2((clippingCoord.x + 1.0) * 0.5f, (1.0 - clippingCoord.y) * 0.5f) * screenDims);
+            prevPixel = min(prevPixel, uint2(width, height) - 1);
+
+            // Disocclusion: the previous view saw a different surface, or the same one at another depth
+            float2 prevDepth = GCameraDepthHistory[prevPixel];
+            float expectedDepth = length(position - g_reprojectionCB.prevCameraPosition.xyz);
+            if (prevDepth.y == cameraDepth.y && abs(prevDepth.x - expectedDepth) <= TEMPORAL_DEPTH_TOLERANCE * expectedDepth)
+            {
+                float4 history = GSplatHistory[prevPixel];
+                reprojected = history * min(1.0f, TEMPORAL_MAX_HISTORY_WEIGHT / max(history.w, 0.0001f));
+            }
+        }
+    }
+
+    GSplatAccum[DTid.xy] = reprojected;
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_4
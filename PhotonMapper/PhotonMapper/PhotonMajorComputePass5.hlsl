@@ -0,0 +1,87 @@
+#ifndef PHOTON_MAJOR_COMPUTE_PASS_5
+#define PHOTON_MAJOR_COMPUTE_PASS_5
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "FluxAccumulation.hlsli"
+
+#define TILE_PIXELS (SPLAT_TILE_SIZE * SPLAT_TILE_SIZE)
+#define APRON_SIZE (SPLAT_TILE_SIZE + 2 * DENSITY_GATHER_RADIUS)
+#define APRON_PIXELS (APRON_SIZE * APRON_SIZE)
+
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// Camera depth and normal, the gather only mixes pixels that see the same surface
+RWTexture2D<float2> GCameraDepth : register(u13);
+RWTexture2D<float4> GCameraNormal : register(u22);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+
+// Staged flux and footprint area, normal and distance, and surface ID of the tile and its apron
+groupshared float4 g_fluxArea[APRON_PIXELS];
+groupshared float4 g_normalDistance[APRON_PIXELS];
+groupshared float g_instance[APRON_PIXELS];
+
+// One group per tile, one thread per pixel.
+// The group decodes the staged flux and works out the footprint of every pixel of the tile and its apron once,
+// then every thread gathers its neighbourhood from shared memory. Pixels outside the screen or seeing nothing have no
+// surface ID, so they never take weight.
+[numthreads(SPLAT_TILE_SIZE, SPLAT_TILE_SIZE, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint width, height;
+    RenderTarget.GetDimensions(width, height);
+    float2 screenDims = float2(width, height);
+
+    int2 apronOrigin = int2(Gid.xy * SPLAT_TILE_SIZE) - DENSITY_GATHER_RADIUS;
+    for (uint i = GI; i < APRON_PIXELS; i += TILE_PIXELS)
+    {
+        int2 pixel = apronOrigin + int2(i % APRON_SIZE, i / APRON_SIZE);
+
+        float4 fluxArea = float4(0.0f, 0.0f, 0.0f, 0.0f);
+        float4 normalDistance = float4(0.0f, 0.0f, 0.0f, 0.0f);
+        float instance = 0.0f;
+        if (all(pixel >= 0) && all(pixel < int2(width, height)))
+        {
+            float2 cameraDepth = GCameraDepth[pixel];
+            instance = cameraDepth.y;
+            if (instance != 0.0f)
+            {
+                normalDistance = float4(GCameraNormal[pixel].xyz, cameraDepth.x);
+                fluxArea.xyz = float3(LoadFixedPoint(StagedRenderTarget_R, pixel), LoadFixedPoint(StagedRenderTarget_G, pixel), LoadFixedPoint(StagedRenderTarget_B, pixel));
+                fluxArea.w = PixelFootprintArea(pixel, screenDims, g_sceneCB.projectionToWorld, g_sceneCB.cameraPosition.xyz, cameraDepth.x, normalDistance.xyz);
+            }
+        }
+
+        g_fluxArea[i] = fluxArea;
+        g_normalDistance[i] = normalDistance;
+        g_instance[i] = instance;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (DTid.x >= width || DTid.y >= height)
+    {
+        return;
+    }
+
+    int center = int(GTid.x + DENSITY_GATHER_RADIUS) + int(GTid.y + DENSITY_GATHER_RADIUS) * APRON_SIZE;
+    float3 radiance = float3(0.0f, 0.0f, 0.0f);
+    if (g_instance[center] != 0.0f)
+    {
+        // The center always has full weight and a footprint, so the area sum is never zero
+        float4 sum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int y = -DENSITY_GATHER_RADIUS; y <= DENSITY_GATHER_RADIUS; ++y)
+        {
+            for (int x = -DENSITY_GATHER_RADIUS; x <= DENSITY_GATHER_RADIUS; ++x)
+            {
+                int tap = center + x + y * APRON_SIZE;
+                sum += DensityGatherWeight(int2(x, y), g_normalDistance[center], g_instance[center], g_normalDistance[tap], g_instance[tap]) * g_fluxArea[tap];
+            }
+        }
+        radiance = sum.xyz * g_sceneCB.fluxToRadiance / sum.w;
+    }
+
+    RenderTarget[DTid.xy] = float4(radiance, 1.0f);
+}
+
+#endif // PHOTON_MAJOR_COMPUTE_PASS_5
@@ -0,0 +1,105 @@
+#ifndef PHOTON_MAJOR_CULL_PASS
+#define PHOTON_MAJOR_CULL_PASS
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+#include "FluxAccumulation.hlsli"
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// G-Buffers
+RWTexture2DArray<float4> GPhotonPos : register(u5);
+RWTexture2DArray<float4> GPhotonColor : register(u6);
+RWTexture2DArray<float4> GPhotonNorm : register(u7);
+RWTexture2DArray<float4> GPhotonTangent : register(u8);
+
+// Caustic map
+RWTexture2D<float4> GCausticPos : register(u9);
+RWTexture2D<float4> GCausticColor : register(u10);
+
+// Photons that survived culling, x is the packed G-Buffer texel and y the layer
+RWStructuredBuffer<uint2> GVisiblePhotons : register(u11);
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
+
+typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+struct RayPayload
+{
+    float4 extraInfo;
+};
+
+// Same clip test as GetPixelPosition in the splat pass
+inline bool IsInFrustum(float3 position)
+{
+    float4 clippingCoord = mul(float4(position, 1), g_sceneCB.viewProj);
+    clippingCoord.xyz /= clippingCoord.w;
+
+    return !(clippingCoord.z < 0.01f || clippingCoord.z > 1 || clippingCoord.x < -1 || clippingCoord.x > 1 || clippingCoord.y < -1 || clippingCoord.y > 1);
+}
+
+// One thread per photon slot, the last layer is the caustic map
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+    uint3 index = DispatchRaysIndex();
+
+    uint width, height, depth;
+    GPhotonPos.GetDimensions(width, height, depth);
+
+    float4 position;
+    float3 normal;
+    if (index.z < depth)
+    {
+        // Rows past the photon budget hold no photons of this frame
+        if (index.y >= g_sceneCB.photonRows)
+        {
+            return;
+        }
+
+        position = GPhotonPos[index];
+        normal = GPhotonNorm[index].xyz;
+    }
+    else
+    {
+        uint causticWidth, causticHeight;
+        GCausticPos.GetDimensions(causticWidth, causticHeight);
+        if (index.x >= causticWidth || index.y >= causticHeight)
+        {
+            return;
+        }
+
+        // Caustic photons don't keep a normal, they are only frustum culled
+        position = GCausticPos[index.xy];
+        normal = g_sceneCB.cameraPosition.xyz - position.xyz;
+    }
+
+    if (position.w <= 0.0f || !IsInFrustum(position.xyz))
+    {
+        return;
+    }
+
+    // Photons sit on the side of the surface they arrived from, the camera can't see them from behind
+    if (dot(normal, g_sceneCB.cameraPosition.xyz - position.xyz) <= 0.0f)
+    {
+        return;
+    }
+
+    uint slot;
+    InterlockedAdd(GVisiblePhotonCount[0], 1, slot);
+    GVisiblePhotons[slot] = uint2(index.x | (index.y << 16), index.z);
+}
+
+[shader("closesthit")]
+void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
+{
+}
+
+[shader("miss")]
+void MyMissShader(inout RayPayload payload)
+{
+}
+
+#endif // PHOTON_MAJOR_CULL_PASS
@@ -0,0 +1,145 @@
+#ifndef PHOTON_MAJOR_DEPTH_PASS
+#define PHOTON_MAJOR_DEPTH_PASS
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// Camera depth and surface ID, x is the distance to the camera and y the instance offset by one (0 if the pixel sees nothing)
+RWTexture2D<float2> GCameraDepth : register(u13);
+
+// Denoiser guides, the surface normal and albedo the camera sees (0 if the pixel sees nothing)
+RWTexture2D<float4> GCameraNormal : register(u22);
+RWTexture2D<float4> GCameraAlbedo : register(u23);
+
+RaytracingAccelerationStructure Scene : register(t0, space0);
+ByteAddressBuffer Indices[] : register(t0, space1);
+StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
+
+// Constant buffers
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
+
+typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+struct RayPayload
+{
+    float4 extraInfo; // [0] is the hit distance, [1] is the surface ID
+};
+
+// Load three 16 bit indices from a byte addressed buffer.
+uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
+{
+    uint3 indices;
+
+    // ByteAdressBuffer loads must be aligned at a 4 byte boundary.
+    // Load 8 bytes and pick the triplet depending on whether the first index is aligned.
+    const uint dwordAlignedOffset = offsetBytes & ~3;
+    const uint2 four16BitIndices = Indices[geomOffset].Load2(dwordAlignedOffset);
+
+    if (dwordAlignedOffset == offsetBytes)
+    {
+        indices.x = four16BitIndices.x & 0xffff;
+        indices.y = (four16BitIndices.x >> 16) & 0xffff;
+        indices.z = four16BitIndices.y & 0xffff;
+    }
+    else
+    {
+        indices.x = (four16BitIndices.x >> 16) & 0xffff;
+        indices.y = four16BitIndices.y & 0xffff;
+        indices.z = (four16BitIndices.y >> 16) & 0xffff;
+    }
+
+    return indices;
+}
+
+// Load the three indices of a triangle, 16 or 32 bit as the instance's mesh stores them.
+uint3 LoadTriangleIndices(uint geomOffset, uint offsetBytes, uint indexSizeInBytes)
+{
+    if (indexSizeInBytes == 4)
+    {
+        return Indices[geomOffset].Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(geomOffset, offsetBytes);
+}
+
+// Retrieve attribute at a hit position interpolated from vertex attributes using the hit's barycentrics.
+float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttributes attr)
+{
+    return vertexAttribute[0] +
+        attr.barycentrics.x * (vertexAttribute[1] - vertexAttribute[0]) +
+        attr.barycentrics.y * (vertexAttribute[2] - vertexAttribute[0]);
+}
+
+// Generate a ray in world space for a camera pixel corresponding to an index from the dispatched 2D grid.
+inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction)
+{
+    float2 xy = index + 0.5f; // center in the middle of the pixel.
+    float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0;
+
+    // Invert Y for DirectX-style coordinates.
+    screenPos.y = -screenPos.y;
+
+    // Unproject the pixel coordinate into a ray.
+    float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
+
+    world.xyz /= world.w;
+    origin = g_sceneCB.cameraPosition.xyz;
+    direction = normalize(world.xyz - origin);
+}
+
+// One primary ray per pixel, so the splat pass can test photon visibility with a texture fetch
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+    float3 rayDir;
+    float3 origin;
+    GenerateCameraRay(DispatchRaysIndex().xy, origin, rayDir);
+
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = rayDir;
+    ray.TMin = 0.001;
+    ray.TMax = 10000.0;
+
+    RayPayload payload = { float4(CAMERA_DEPTH_MISS, 0, 0, 0) };
+    TraceRay(Scene, RAY_FLAG_FORCE_OPAQUE, ~0, 0, 1, 0, ray, payload);
+
+    GCameraDepth[DispatchRaysIndex().xy] = payload.extraInfo.xy;
+}
+
+[shader("closesthit")]
+void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
+{
+    // The ray direction is normalized, so t is the distance to the camera
+    payload.extraInfo = float4(RayTCurrent(), InstanceID() + 1, 0, 0);
+
+    uint instanceId = InstanceID();
+    uint geometryOffset = c_bufferIndices[instanceId].vbIndex;
+    uint materialIndex = c_bufferIndices[instanceId].materialIndex;
+
+    // 3 indices per triangle, 16 or 32 bit
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
+    const uint3 indices = LoadTriangleIndices(geometryOffset, PrimitiveIndex() * 3 * indexSizeInBytes, indexSizeInBytes);
+    float3 vertexNormals[3] = {
+        Vertices[geometryOffset][indices[0]].normal,
+        Vertices[geometryOffset][indices[1]].normal,
+        Vertices[geometryOffset][indices[2]].normal
+    };
+
+    GCameraNormal[DispatchRaysIndex().xy] = float4(normalize(HitAttribute(vertexNormals, attr)), 0);
+    GCameraAlbedo[DispatchRaysIndex().xy] = float4(c_materials[materialIndex].albedo, 1);
+}
+
+[shader("miss")]
+void MyMissShader(inout RayPayload payload)
+{
+    GCameraNormal[DispatchRaysIndex().xy] = float4(0, 0, 0, 0);
+    GCameraAlbedo[DispatchRaysIndex().xy] = float4(0, 0, 0, 0);
+}
+
+#endif // PHOTON_MAJOR_DEPTH_PASS
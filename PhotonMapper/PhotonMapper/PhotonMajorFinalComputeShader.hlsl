@@ -3,30 +3,26 @@
 
 #define HLSL
 #include "RaytracingHlslCompat.h"
+#include "FluxAccumulation.hlsli"
 
 #define blocksize 128
 
 // Render Target for visualizing the photons - can be removed later on
 RWTexture2D<float4> RenderTarget : register(u0);
 
-RWTexture2D<uint> StagedRenderTarget_R : register(u1);
-RWTexture2D<uint> StagedRenderTarget_G : register(u2);
-RWTexture2D<uint> StagedRenderTarget_B : register(u3);
-RWTexture2D<uint> StagedRenderTarget_A : register(u4);
-
 [numthreads(blocksize, 1, 1)]
 void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
 {
     uint2 index = uint2(DTid.xy);
 
-    float channel_r = StagedRenderTarget_R[index];
-    float channel_g = StagedRenderTarget_G[index];
-    float channel_b = StagedRenderTarget_B[index];
-    uint channel_a = StagedRenderTarget_A[index];
+    float channel_r = LoadFixedPoint(StagedRenderTarget_R, index);
+    float channel_g = LoadFixedPoint(StagedRenderTarget_G, index);
+    float channel_b = LoadFixedPoint(StagedRenderTarget_B, index);
+    uint channel_a = StagedRenderTarget_A[uint3(index, 0)];
 
     if (channel_a > 0)
     {
-        float3 avgColor = float3(channel_r, channel_g, channel_b) / (channel_a * 255.f);
+        float3 avgColor = float3(channel_r, channel_g, channel_b) / channel_a;
         RenderTarget[index] = float4(avgColor, 1.0);
     }
     else
@@ -3,15 +3,11 @@
 
 #define HLSL
 #include "RaytracingHlslCompat.h"
+#include "FluxAccumulation.hlsli"
 
 // Render Target for visualizing the photons - can be removed later on
 RWTexture2D<float4> RenderTarget : register(u0);
 
-RWTexture2D<uint> StagedRenderTarget_R : register(u1);
-RWTexture2D<uint> StagedRenderTarget_G : register(u2);
-RWTexture2D<uint> StagedRenderTarget_B : register(u3);
-RWTexture2D<uint> StagedRenderTarget_A : register(u4);
-
 // G-Buffers
 RWTexture2DArray<float4> GPhotonPos : register(u5);
 RWTexture2DArray<float4> GPhotonColor : register(u6);
@@ -23,9 +19,9 @@ ByteAddressBuffer Indices[] : register(t0, space1);
 StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
@@ -63,6 +59,16 @@ uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
     return indices;
 }
 
+// Load the three indices of a triangle, 16 or 32 bit as the instance's mesh stores them.
+uint3 LoadTriangleIndices(uint geomOffset, uint offsetBytes, uint indexSizeInBytes)
+{
+    if (indexSizeInBytes == 4)
+    {
+        return Indices[geomOffset].Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(geomOffset, offsetBytes);
+}
+
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
 struct RayPayload
 {
@@ -326,7 +332,15 @@ void MyRaygenShader()
     float2 screenDims = float2(width, height);
 
     // Set seed for PRNG
-    rng_state = uint(wang_hash(samplePoint.x + DispatchRaysDimensions().x * samplePoint.y));
+    rng_state = uint(wang_hash((samplePoint.x + DispatchRaysDimensions().x * samplePoint.y) ^ wang_hash(g_sceneCB.photonBatch)));
+
+    // Layers past the bounce this photon dies at must not keep the previous batch's photons
+    uint gBufferWidth, gBufferHeight, gBufferDepth;
+    GPhotonPos.GetDimensions(gBufferWidth, gBufferHeight, gBufferDepth);
+    for (uint layer = 0; layer < gBufferDepth; ++layer)
+    {
+        GPhotonPos[uint3(samplePoint, layer)] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
 
     // Photon Generation
     float3 rayDir;
@@ -425,8 +439,8 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     float3 hitPosition = HitWorldPosition();
     uint instanceId = InstanceID();
 
-    // Get the base index of the triangle's first 16 bit index.
-    uint indexSizeInBytes = 2;
+    // Get the base index of the triangle's first index, 16 or 32 bit depending on the mesh.
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
     uint indicesPerTriangle = 3;
     uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
     uint baseIndex = PrimitiveIndex() * triangleIndexStride;
@@ -434,8 +448,8 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     uint geometryOffset = c_bufferIndices[instanceId].vbIndex;
     uint materialIndex = c_bufferIndices[instanceId].materialIndex;
 
-    // Load up 3 16 bit indices for the triangle.
-    const uint3 indices = Load3x16BitIndices(geometryOffset, baseIndex);
+    // Load up the 3 indices for the triangle.
+    const uint3 indices = LoadTriangleIndices(geometryOffset, baseIndex, indexSizeInBytes);
 
     // Retrieve corresponding vertex normals for the triangle vertices.
     float3 vertexNormals[3] = {
@@ -502,7 +516,10 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     uint3 g_index = uint3(DispatchRaysIndex().xy, depth - 1);
     GPhotonPos[g_index] = float4(hitPosition, 1);
     GPhotonColor[g_index] = payload.color;
-    GPhotonNorm[g_index] = float4(triangleNormal, 1.0);
+    // Stored in world space, the cull pass tests it against the camera
+    // w is the instance the photon landed on, offset by one so that 0 stays free for the background
+    float3 worldNormal = normalize(mul(c_bufferIndices[instanceId].normalTransformMat, float4(triangleNormal, 0.0f)).xyz);
+    GPhotonNorm[g_index] = float4(worldNormal, instanceId + 1);
     GPhotonTangent[g_index] = float4(tangent, 1.0);
 
     // Russian Roulette 
@@ -3,30 +3,31 @@
 
 #define HLSL
 #include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+#include "FluxAccumulation.hlsli"
 
 // Render Target for visualizing the photons - can be removed later on
 RWTexture2D<float4> RenderTarget : register(u0);
 
-RWTexture2D<uint> StagedRenderTarget_R : register(u1);
-RWTexture2D<uint> StagedRenderTarget_G : register(u2);
-RWTexture2D<uint> StagedRenderTarget_B : register(u3);
-RWTexture2D<uint> StagedRenderTarget_A : register(u4);
-
 // G-Buffers
 RWTexture2DArray<float4> GPhotonPos : register(u5);
 RWTexture2DArray<float4> GPhotonColor : register(u6);
 RWTexture2DArray<float4> GPhotonNorm : register(u7);
 RWTexture2DArray<float4> GPhotonTangent : register(u8);
 
+// Photons that survived culling, x is the packed G-Buffer texel and y the layer
+RWStructuredBuffer<uint2> GVisiblePhotons : register(u11);
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
 RaytracingAccelerationStructure Scene : register(t0, space0);
 ByteAddressBuffer Indices[] : register(t1, space0);
 StructuredBuffer<Vertex> Vertices[] : register(t2, space0);
 
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
@@ -47,10 +48,19 @@ void MyRaygenShader()
 {
     uint2 index = DispatchRaysIndex().xy;
 
-    StagedRenderTarget_R[index] = 0;
-    StagedRenderTarget_G[index] = 0;
-    StagedRenderTarget_B[index] = 0;
-    StagedRenderTarget_A[index] = 0;
+    ClearFlux(index);
+    GSplatAccum[index] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // One thread per tile empties its bin
+    if (index.x % SPLAT_TILE_SIZE == 0 && index.y % SPLAT_TILE_SIZE == 0)
+    {
+        GSplatTileCounts[SplatTileIndex(index)] = 0;
+    }
+
+    if (index.x == 0 && index.y == 0)
+    {
+        GVisiblePhotonCount[0] = 0;
+    }
 }
 
 
@@ -16,6 +16,9 @@
 #include "CompiledShaders\PhotonMajorFirstPassShader.hlsl.h"
 #include "CompiledShaders\PhotonMajorSecondPassShader.hlsl.h"
 #include "CompiledShaders\PhotonMajorThirdPassShader.hlsl.h"
+#include "CompiledShaders\PhotonMajorCausticPassShader.hlsl.h"
+#include "CompiledShaders\PhotonMajorCullPassShader.hlsl.h"
+#include "CompiledShaders\PhotonMajorDepthPassShader.hlsl.h"
 
 using namespace std;
 using namespace DX;
@@ -24,16 +27,48 @@ const wchar_t* PhotonMajorRenderer::c_hitGroupName = L"MyHitGroup";
 const wchar_t* PhotonMajorRenderer::c_raygenShaderName = L"MyRaygenShader";
 const wchar_t* PhotonMajorRenderer::c_closestHitShaderName = L"MyClosestHitShader";
 const wchar_t* PhotonMajorRenderer::c_missShaderName = L"MyMissShader";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderSplatCount = L"PhotonMajorComputePass0.cso";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderSplatScan = L"PhotonMajorComputePass1.cso";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderSplatScatter = L"PhotonMajorComputePass2.cso";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderSplatResolve = L"PhotonMajorComputePass3.cso";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderReproject = L"PhotonMajorComputePass4.cso";
+const LPCWSTR PhotonMajorRenderer::c_computeShaderDensityGather = L"PhotonMajorComputePass5.cso";
 
 PhotonMajorRenderer::PhotonMajorRenderer(const DXRPhotonMapper::PMScene& scene, UINT width, UINT height, std::wstring name) :
     PhotonBaseRenderer(scene, width, height, name),
     m_raytracingOutputResourceUAVDescriptorHeapIndex(UINT_MAX),
+    m_causticBufferWidth(0),
+    m_causticBufferHeight(0),
     m_curRotationAngleRad(0.0f),
     m_calculatePhotonMap(false),
     m_clearStagingBuffers(false),
+    m_binnedSplatting(true),
+    m_densityGather(true),
+    m_reprojectSplats(false),
+    m_denoise(false),
+    m_progressive(false),
+    m_verifyFluxResolve(false),
+    m_photonBatch(0),
+    m_accumulatedBatches(0),
+    m_splattedPhotons(0),
+    m_tracedPhotonRows(0),
+    m_splatPhotonRows(0),
+    m_timestampFrequency(0),
+    m_denoiseIterations(DENOISE_DEFAULT_ITERATIONS),
     cameraNeedsUpdate(false)
 {
     m_forceComputeFallback = false;
+    for (UINT i = 0; i < FrameCount; ++i)
+    {
+        m_frameTimingPending[i] = false;
+    }
+    m_visiblePhotonList.uavDescriptorHeapIndex = UINT_MAX;
+    m_visiblePhotonCount.uavDescriptorHeapIndex = UINT_MAX;
+    m_cameraDepthBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    for (GBuffer* splatBuffer : { &m_splats, &m_splatSlots, &m_sortedSplats, &m_splatTileCounts, &m_splatTileOffsets, &m_splatAccum, &m_splatHistory, &m_cameraDepthHistory, &m_cameraNormal, &m_cameraAlbedo })
+    {
+        splatBuffer->uavDescriptorHeapIndex = UINT_MAX;
+    }
     SelectRaytracingAPI(RaytracingAPI::FallbackLayer);
     UpdateForSizeChange(width, height);
 }
@@ -96,16 +131,31 @@ void PhotonMajorRenderer::UpdateCameraMatrices()
 {
     auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
 
-    m_sceneCB[frameIndex].cameraPosition = m_eye;
+    // The view the accumulation was built in, for reprojecting it into the new one
+    m_reprojectionCB.prevViewProj = m_sceneCB[frameIndex].viewProj;
+    m_reprojectionCB.prevCameraPosition = m_sceneCB[frameIndex].cameraPosition;
+
     float fovAngleY = 45.0f;
     XMMATRIX view = XMMatrixLookAtLH(m_eye, m_at, m_up);
     XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(fovAngleY), m_aspectRatio, 1.0f, 125.0f);
     XMMATRIX viewProj = view * proj;
 
-    m_sceneCB[frameIndex].projectionToWorld = XMMatrixInverse(nullptr, viewProj);
-    m_sceneCB[frameIndex].viewProj = viewProj;
+    for (auto& sceneCB : m_sceneCB)
+    {
+        sceneCB.cameraPosition = m_eye;
+        sceneCB.projectionToWorld = XMMatrixInverse(nullptr, viewProj);
+        sceneCB.viewProj = viewProj;
+    }
 
-    m_clearStagingBuffers = true;
+    // Binned splats carry over to the new view, the staging buffers have to start over
+    if (m_binnedSplatting)
+    {
+        m_reprojectSplats = true;
+    }
+    else
+    {
+        m_clearStagingBuffers = true;
+    }
 }
 
 // Initialize scene rendering parameters.
@@ -157,6 +207,11 @@ void PhotonMajorRenderer::InitializeScene()
         m_sceneCB[frameIndex].lightDiffuseColor = XMLoadFloat4(&lightDiffuseColor);
     }
 
+    m_sceneCB[frameIndex].renderFlags = GetRenderFlags();
+    m_sceneCB[frameIndex].photonBatch = 0;
+    m_sceneCB[frameIndex].fluxToRadiance = 0.0f;
+    m_sceneCB[frameIndex].photonRows = 0;
+
     // Apply the initial values to all frames' buffer instances.
     for (auto& sceneCB : m_sceneCB)
     {
@@ -191,6 +246,30 @@ void PhotonMajorRenderer::CreateConstantBuffers()
     ThrowIfFailed(m_perFrameConstants->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedConstantData)));
 }
 
+// Create the timestamp queries the photon budget is measured with, one set per frame in flight
+void PhotonMajorRenderer::CreateTimestampQueries()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = FrameCount * NumFrameTimestamps;
+    ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampHeap)));
+    NAME_D3D12_OBJECT(m_timestampHeap);
+
+    auto readbackHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(FrameCount * NumFrameTimestamps * sizeof(UINT64));
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_timestampReadback)));
+    NAME_D3D12_OBJECT(m_timestampReadback);
+
+    ThrowIfFailed(m_deviceResources->GetCommandQueue()->GetTimestampFrequency(&m_timestampFrequency));
+    for (UINT i = 0; i < FrameCount; ++i)
+    {
+        m_frameTimingPending[i] = false;
+    }
+}
+
 // Create resources that depend on the device.
 void PhotonMajorRenderer::CreateDeviceDependentResources()
 {
@@ -204,6 +283,9 @@ void PhotonMajorRenderer::CreateDeviceDependentResources()
     CreateFirstPassRootSignatures();
     CreateSecondPassRootSignatures();
     CreateThirdPassRootSignatures();
+    CreateCausticPassRootSignatures();
+    CreateCullPassRootSignatures();
+    CreateDepthPassRootSignatures();
 
     // Create a raytracing pipeline state object which defines the binding of shaders, state and resources to be used during raytracing.
     // Temporary Testing: Should be put back later on.
@@ -211,6 +293,18 @@ void PhotonMajorRenderer::CreateDeviceDependentResources()
     CreateFirstPassPhotonPipelineStateObject();
     CreateSecondPassPhotonPipelineStateObject();
     CreateThirdPassPhotonPipelineStateObject();
+    CreateCausticPassPhotonPipelineStateObject();
+    CreateCullPassPhotonPipelineStateObject();
+    CreateDepthPassPhotonPipelineStateObject();
+
+    // Binned splatting runs on the compute pipeline
+    CreateComputeRootSignature();
+    CreateComputePipelineStateObject(c_computeShaderSplatCount, m_computeSplatCountPSO);
+    CreateComputePipelineStateObject(c_computeShaderSplatScan, m_computeSplatScanPSO);
+    CreateComputePipelineStateObject(c_computeShaderSplatScatter, m_computeSplatScatterPSO);
+    CreateComputePipelineStateObject(c_computeShaderSplatResolve, m_computeSplatResolvePSO);
+    CreateComputePipelineStateObject(c_computeShaderReproject, m_computeReprojectPSO);
+    CreateComputePipelineStateObject(c_computeShaderDensityGather, m_computeDensityGatherPSO);
 
     // Create a heap for descriptors.
     CreateDescriptorHeap();
@@ -223,17 +317,26 @@ void PhotonMajorRenderer::CreateDeviceDependentResources()
     BuildMaterialBuffer();
     BuildLightBuffer();
 
+    // Find the directions from the light that can produce caustics.
+    BuildProjectionMap();
+
     // Build raytracing acceleration structures from the generated geometry.
     BuildGeometryAccelerationStructures();
 
     // Create constant buffers for the geometry and the scene.
     CreateConstantBuffers();
 
+    // Measure the passes the photon budget adapts to.
+    CreateTimestampQueries();
+
     // Build shader tables, which define shaders and their local root arguments.
     BuildPrePassShaderTables();
     BuildFirstPassShaderTables();
     BuildSecondPassShaderTables();
     BuildThirdPassShaderTables();
+    BuildCausticPassShaderTables();
+    BuildCullPassShaderTables();
+    BuildDepthPassShaderTables();
 
     // Create an output 2D texture to store the raytracing result to.
 
@@ -258,6 +361,42 @@ void PhotonMajorRenderer::SerializeAndCreateRaytracingRootSignature(D3D12_ROOT_S
         ThrowIfFailed(device->CreateRootSignature(1, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(&(*rootSig))));
     }
 }
+
+void PhotonMajorRenderer::CreateComputeRootSignature()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+
+    CD3DX12_ROOT_PARAMETER1 rootParameters[ReprojectionRootSignatureParams::Count];
+    rootParameters[ComputeRootSignatureParams::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+    rootParameters[ComputeRootSignatureParams::ParamConstantBuffer].InitAsConstantBufferView(0);
+    rootParameters[ReprojectionRootSignatureParams::PrevCameraSlot].InitAsConstants(SizeOfInUint32(ReprojectionConstantBuffer), 1);
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC computeRootSignatureDesc;
+    computeRootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr);
+
+    ComPtr<ID3DBlob> signature;
+    ComPtr<ID3DBlob> error;
+    ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&computeRootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+    ThrowIfFailed(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_computeRootSignature)));
+}
+
+void PhotonMajorRenderer::CreateComputePipelineStateObject(const LPCWSTR& compiledShaderName, ComPtr<ID3D12PipelineState>& computePipeline)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    UINT fileSize = 0;
+    UINT8* shader;
+    ThrowIfFailed(ReadDataFromFile(GetAssetFullPath(compiledShaderName).c_str(), &shader, &fileSize));
+
+    // Describe and create the compute pipeline state object (PSO).
+    D3D12_COMPUTE_PIPELINE_STATE_DESC computePsoDesc = {};
+    computePsoDesc.pRootSignature = m_computeRootSignature.Get();
+    computePsoDesc.CS = CD3DX12_SHADER_BYTECODE((void *)shader, fileSize);
+
+    ThrowIfFailed(device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(&computePipeline)));
+}
 void PhotonMajorRenderer::CreatePrePassRootSignatures()
 {
     auto device = m_deviceResources->GetD3DDevice();
@@ -265,17 +404,15 @@ void PhotonMajorRenderer::CreatePrePassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers, 0);
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -309,17 +446,15 @@ void PhotonMajorRenderer::CreateFirstPassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers, 0);
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -353,17 +488,15 @@ void PhotonMajorRenderer::CreateSecondPassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers, 0);
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -397,17 +530,15 @@ void PhotonMajorRenderer::CreateThirdPassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers, 0);
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -434,6 +565,133 @@ void PhotonMajorRenderer::CreateThirdPassRootSignatures()
     }
 }
 
+void PhotonMajorRenderer::CreateCullPassRootSignatures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Global Root Signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    {
+        const UINT numGeometries = GetNumGeometries();
+
+        CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+
+        CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_cullPassGlobalRootSignature);
+    }
+
+    // Local Root Signature
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    {
+        CD3DX12_ROOT_PARAMETER rootParameters[LocalRootSignatureParams::Count];
+        rootParameters[LocalRootSignatureParams::CubeConstantSlot].InitAsConstants(SizeOfInUint32(m_cubeCB), 1);
+        CD3DX12_ROOT_SIGNATURE_DESC localRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        localRootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+        SerializeAndCreateRaytracingRootSignature(localRootSignatureDesc, &m_cullPassLocalRootSignature);
+    }
+}
+
+void PhotonMajorRenderer::CreateDepthPassRootSignatures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Global Root Signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    {
+        const UINT numGeometries = GetNumGeometries();
+
+        CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+
+        CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_depthPassGlobalRootSignature);
+    }
+
+    // Local Root Signature
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    {
+        CD3DX12_ROOT_PARAMETER rootParameters[LocalRootSignatureParams::Count];
+        rootParameters[LocalRootSignatureParams::CubeConstantSlot].InitAsConstants(SizeOfInUint32(m_cubeCB), 1);
+        CD3DX12_ROOT_SIGNATURE_DESC localRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        localRootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+        SerializeAndCreateRaytracingRootSignature(localRootSignatureDesc, &m_depthPassLocalRootSignature);
+    }
+}
+
+void PhotonMajorRenderer::CreateCausticPassRootSignatures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Global Root Signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    {
+        const UINT numGeometries = GetNumGeometries();
+
+        CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumStagingBuffers + NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[CausticRootSignatureParams::Count];
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+        rootParameters[CausticRootSignatureParams::ProjectionMapSlot].InitAsShaderResourceView(1);
+
+        CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_causticPassGlobalRootSignature);
+    }
+
+    // Local Root Signature
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    {
+        CD3DX12_ROOT_PARAMETER rootParameters[LocalRootSignatureParams::Count];
+        rootParameters[LocalRootSignatureParams::CubeConstantSlot].InitAsConstants(SizeOfInUint32(m_cubeCB), 1);
+        CD3DX12_ROOT_SIGNATURE_DESC localRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        localRootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+        SerializeAndCreateRaytracingRootSignature(localRootSignatureDesc, &m_causticPassLocalRootSignature);
+    }
+}
+
 // Create raytracing device and command list.
 void PhotonMajorRenderer::CreateRaytracingInterfaces()
 {
@@ -764,83 +1022,299 @@ void PhotonMajorRenderer::CreateThirdPassPhotonPipelineStateObject()
     }
 }
 
-// Create 2D output texture for raytracing.
-void PhotonMajorRenderer::CreateRaytracingOutputResource()
+// Creates the PSO for culling the photons the camera can't see before they are splatted
+void PhotonMajorRenderer::CreateCullPassPhotonPipelineStateObject()
 {
-    auto device = m_deviceResources->GetD3DDevice();
-    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+    CD3D12_STATE_OBJECT_DESC raytracingPipeline{ D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE };
 
-    // Create the output resource. The dimensions and format should match the swap-chain.
-    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(backbufferFormat, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    // DXIL library
+    // This contains the shaders and their entrypoints for the state object.
+    // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pPhotonMajorCullPassShader, ARRAYSIZE(g_pPhotonMajorCullPassShader));
+    lib->SetDXILLibrary(&libdxil);
+    // Define which shader exports to surface from the library.
+    // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
+    // In this sample, this could be ommited for convenience since the sample uses all shaders in the library. 
+    {
+        lib->DefineExport(c_raygenShaderName);
+        lib->DefineExport(c_closestHitShaderName);
+        lib->DefineExport(c_missShaderName);
+    }
 
-    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    ThrowIfFailed(device->CreateCommittedResource(
-        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_raytracingOutput)));
-    NAME_D3D12_OBJECT(m_raytracingOutput);
+    // Triangle hit group
+    // A hit group specifies closest hit, any hit and intersection shaders to be executed when a ray intersects the geometry's triangle/AABB.
+    // In this sample, we only use triangle geometry with a closest hit shader, so others are not set.
+    auto hitGroup = raytracingPipeline.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    hitGroup->SetClosestHitShaderImport(c_closestHitShaderName);
+    hitGroup->SetHitGroupExport(c_hitGroupName);
+    hitGroup->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
 
-    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
-    m_raytracingOutputResourceUAVDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, m_raytracingOutputResourceUAVDescriptorHeapIndex);
-    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
-    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-    device->CreateUnorderedAccessView(m_raytracingOutput.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
-    m_raytracingOutputResourceUAVGpuDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_raytracingOutputResourceUAVDescriptorHeapIndex, m_descriptorSize);
-}
+    // Shader config
+    // Defines the maximum sizes in bytes for the ray payload and attribute structure.
+    auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    UINT payloadSize = sizeof(XMFLOAT4);    // float4 pixelColor
+    UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
+    shaderConfig->Config(payloadSize, attributeSize);
 
-void PhotonMajorRenderer::CreateStagingRenderTargetResource()
-{
-    // There are 4 staging Buffers defined here. All of them are unordered access views
+    // Local root signature and shader association
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    CreateLocalRootSignatureSubobjects(&raytracingPipeline, &m_cullPassLocalRootSignature);
 
-    auto device = m_deviceResources->GetD3DDevice();
-    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+    // Global root signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    auto globalRootSignature = raytracingPipeline.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    globalRootSignature->SetRootSignature(m_cullPassGlobalRootSignature.Get());
 
-    // Create the output resource. The dimensions and format should match the swap-chain.
-    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    // Pipeline config
+    // Defines the maximum TraceRay() recursion depth.
+    auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    // PERFOMANCE TIP: Set max recursion depth as low as needed 
+    // as drivers may apply optimization strategies for low recursion depths.
+    UINT maxRecursionDepth = 1; // ~ no rays are traced
+    pipelineConfig->Config(maxRecursionDepth);
 
-    m_stagingBuffers.clear();
+#if _DEBUG
+    PrintStateObjectDesc(raytracingPipeline);
+#endif
 
-    for (int i = 0; i < NumStagingBuffers; ++i)
+    // Create the state object.
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GBuffer gBuffer = {};
-
-        ThrowIfFailed(device->CreateCommittedResource(
-            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
-        NAME_D3D12_OBJECT(gBuffer.textureResource);
-
-        gBuffer.uavDescriptorHeapIndex = UINT_MAX;
-
-        D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
-        gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, gBuffer.uavDescriptorHeapIndex);
-        D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
-        UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-        device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
-        gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
-
-        m_stagingBuffers.push_back(gBuffer);
+        ThrowIfFailed(m_fallbackDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_fallbackCullPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+    else // DirectX Raytracing
+    {
+        ThrowIfFailed(m_dxrDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_dxrCullPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
     }
 }
 
-void PhotonMajorRenderer::CreateGBuffers()
+// Creates the PSO for the camera depth and surface ID pre-pass
+void PhotonMajorRenderer::CreateDepthPassPhotonPipelineStateObject()
 {
-    // There are 2 G Buffers defined here. All of them are unordered access views
-    // 1. Photon Position
-    // 2. Photon Color
+    CD3D12_STATE_OBJECT_DESC raytracingPipeline{ D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE };
 
-    int width = sqrt(NumPhotons);
-    int height = width;
-    if (NumPhotons % width != 0)
+    // DXIL library
+    // This contains the shaders and their entrypoints for the state object.
+    // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pPhotonMajorDepthPassShader, ARRAYSIZE(g_pPhotonMajorDepthPassShader));
+    lib->SetDXILLibrary(&libdxil);
+    // Define which shader exports to surface from the library.
+    // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
+    // In this sample, this could be ommited for convenience since the sample uses all shaders in the library. 
     {
-        height++;
+        lib->DefineExport(c_raygenShaderName);
+        lib->DefineExport(c_closestHitShaderName);
+        lib->DefineExport(c_missShaderName);
     }
-    m_gBufferWidth = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, width);
-    m_gBufferHeight = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, height);
-    m_gBufferDepth = MAX_RAY_RECURSION_DEPTH;
 
-    auto device = m_deviceResources->GetD3DDevice();
-    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+    // Triangle hit group
+    // A hit group specifies closest hit, any hit and intersection shaders to be executed when a ray intersects the geometry's triangle/AABB.
+    // In this sample, we only use triangle geometry with a closest hit shader, so others are not set.
+    auto hitGroup = raytracingPipeline.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    hitGroup->SetClosestHitShaderImport(c_closestHitShaderName);
+    hitGroup->SetHitGroupExport(c_hitGroupName);
+    hitGroup->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
 
-    // Create the output resource. The dimensions and format should match the swap-chain.
-    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_gBufferWidth, m_gBufferHeight, m_gBufferDepth, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    // Shader config
+    // Defines the maximum sizes in bytes for the ray payload and attribute structure.
+    auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    UINT payloadSize = sizeof(XMFLOAT4);    // float4 pixelColor
+    UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
+    shaderConfig->Config(payloadSize, attributeSize);
+
+    // Local root signature and shader association
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    CreateLocalRootSignatureSubobjects(&raytracingPipeline, &m_depthPassLocalRootSignature);
+
+    // Global root signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    auto globalRootSignature = raytracingPipeline.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    globalRootSignature->SetRootSignature(m_depthPassGlobalRootSignature.Get());
+
+    // Pipeline config
+    // Defines the maximum TraceRay() recursion depth.
+    auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    // PERFOMANCE TIP: Set max recursion depth as low as needed 
+    // as drivers may apply optimization strategies for low recursion depths.
+    UINT maxRecursionDepth = 1; // ~ primary rays only.
+    pipelineConfig->Config(maxRecursionDepth);
+
+#if _DEBUG
+    PrintStateObjectDesc(raytracingPipeline);
+#endif
+
+    // Create the state object.
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        ThrowIfFailed(m_fallbackDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_fallbackDepthPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+    else // DirectX Raytracing
+    {
+        ThrowIfFailed(m_dxrDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_dxrDepthPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+}
+
+// Creates the PSO for tracing photons through the projection map onto diffuse surfaces
+void PhotonMajorRenderer::CreateCausticPassPhotonPipelineStateObject()
+{
+    // Create 7 subobjects that combine into a RTPSO:
+    // Subobjects need to be associated with DXIL exports (i.e. shaders) either by way of default or explicit associations.
+    // Default association applies to every exported shader entrypoint that doesn't have any of the same type of subobject associated with it.
+    // This simple sample utilizes default shader association except for local root signature subobject
+    // which has an explicit association specified purely for demonstration purposes.
+    // 1 - DXIL library
+    // 1 - Triangle hit group
+    // 1 - Shader config
+    // 2 - Local root signature and association
+    // 1 - Global root signature
+    // 1 - Pipeline config
+    CD3D12_STATE_OBJECT_DESC raytracingPipeline{ D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE };
+
+
+    // DXIL library
+    // This contains the shaders and their entrypoints for the state object.
+    // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pPhotonMajorCausticPassShader, ARRAYSIZE(g_pPhotonMajorCausticPassShader));
+    lib->SetDXILLibrary(&libdxil);
+    // Define which shader exports to surface from the library.
+    // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
+    // In this sample, this could be ommited for convenience since the sample uses all shaders in the library. 
+    {
+        lib->DefineExport(c_raygenShaderName);
+        lib->DefineExport(c_closestHitShaderName);
+        lib->DefineExport(c_missShaderName);
+    }
+
+    // Triangle hit group
+    // A hit group specifies closest hit, any hit and intersection shaders to be executed when a ray intersects the geometry's triangle/AABB.
+    // In this sample, we only use triangle geometry with a closest hit shader, so others are not set.
+    auto hitGroup = raytracingPipeline.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    hitGroup->SetClosestHitShaderImport(c_closestHitShaderName);
+    hitGroup->SetHitGroupExport(c_hitGroupName);
+    hitGroup->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+
+    // Shader config
+    // Defines the maximum sizes in bytes for the ray payload and attribute structure.
+    auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    UINT payloadSize = 3 * sizeof(XMFLOAT4) + 2 * sizeof(XMFLOAT3);    // float4 pixelColor
+    UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
+    shaderConfig->Config(payloadSize, attributeSize);
+
+    // Local root signature and shader association
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    CreateLocalRootSignatureSubobjects(&raytracingPipeline, &m_causticPassLocalRootSignature);
+
+    // Global root signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    auto globalRootSignature = raytracingPipeline.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    globalRootSignature->SetRootSignature(m_causticPassGlobalRootSignature.Get());
+
+    // Pipeline config
+    // Defines the maximum TraceRay() recursion depth.
+    auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    // PERFOMANCE TIP: Set max recursion depth as low as needed 
+    // as drivers may apply optimization strategies for low recursion depths.
+    UINT maxRecursionDepth = MAX_RAY_RECURSION_DEPTH; // ~ primary rays only. // TODO
+    pipelineConfig->Config(maxRecursionDepth);
+
+#if _DEBUG
+    PrintStateObjectDesc(raytracingPipeline);
+#endif
+
+    // Create the state object.
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        ThrowIfFailed(m_fallbackDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_fallbackCausticPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+    else // DirectX Raytracing
+    {
+        ThrowIfFailed(m_dxrDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_dxrCausticPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+}
+
+// Create 2D output texture for raytracing.
+void PhotonMajorRenderer::CreateRaytracingOutputResource()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+
+    // Create the output resource. The dimensions and format should match the swap-chain.
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(backbufferFormat, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_raytracingOutput)));
+    NAME_D3D12_OBJECT(m_raytracingOutput);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    m_raytracingOutputResourceUAVDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, m_raytracingOutputResourceUAVDescriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+    device->CreateUnorderedAccessView(m_raytracingOutput.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    m_raytracingOutputResourceUAVGpuDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_raytracingOutputResourceUAVDescriptorHeapIndex, m_descriptorSize);
+}
+
+void PhotonMajorRenderer::CreateStagingRenderTargetResource()
+{
+    // There are 4 staging Buffers defined here. All of them are unordered access views
+    // Each channel is a 64 bit fixed point sum, slice 0 holds the low word and slice 1 the high word.
+    // Typed atomics only work on single channel 32 bit formats, so the two words live in separate slices.
+
+    auto device = m_deviceResources->GetD3DDevice();
+    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+
+    // Create the output resource. The dimensions should match the swap-chain.
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, m_width, m_height, 2, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    m_stagingBuffers.clear();
+
+    for (int i = 0; i < NumStagingBuffers; ++i)
+    {
+        GBuffer gBuffer = {};
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
+        NAME_D3D12_OBJECT(gBuffer.textureResource);
+
+        gBuffer.uavDescriptorHeapIndex = UINT_MAX;
+
+        D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+        gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, gBuffer.uavDescriptorHeapIndex);
+        D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+        UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+        UAVDesc.Texture2DArray.ArraySize = 2;
+        device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+        gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+
+        m_stagingBuffers.push_back(gBuffer);
+    }
+}
+
+void PhotonMajorRenderer::CreateGBuffers()
+{
+    // There are 2 G Buffers defined here. All of them are unordered access views
+    // 1. Photon Position
+    // 2. Photon Color
+
+    int width = sqrt(NumPhotons);
+    int height = width;
+    if (NumPhotons % width != 0)
+    {
+        height++;
+    }
+    m_gBufferWidth = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, width);
+    m_gBufferHeight = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, height);
+    m_gBufferDepth = MAX_RAY_RECURSION_DEPTH;
+
+    auto device = m_deviceResources->GetD3DDevice();
+    auto backbufferFormat = m_deviceResources->GetBackBufferFormat();
+
+    // Create the output resource. The dimensions and format should match the swap-chain.
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_gBufferWidth, m_gBufferHeight, m_gBufferDepth, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
     auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
 
     m_gBuffers.clear();
@@ -867,6 +1341,204 @@ void PhotonMajorRenderer::CreateGBuffers()
     }
 }
 
+void PhotonMajorRenderer::CreateCausticGBuffers()
+{
+    // There are 2 caustic G Buffers defined here, a single layer each since a caustic photon is stored once
+    // 1. Photon Position
+    // 2. Photon Color
+
+    int width = sqrt(NumCausticPhotons);
+    int height = width;
+    if (NumCausticPhotons % width != 0)
+    {
+        height++;
+    }
+    m_causticBufferWidth = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, width);
+    m_causticBufferHeight = min(D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, height);
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_causticBufferWidth, m_causticBufferHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    m_causticGBuffers.clear();
+
+    for (int i = 0; i < NumCausticGBuffers; ++i)
+    {
+        GBuffer gBuffer = {};
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
+        NAME_D3D12_OBJECT(gBuffer.textureResource);
+
+        gBuffer.uavDescriptorHeapIndex = UINT_MAX;
+
+        D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+        gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, gBuffer.uavDescriptorHeapIndex);
+        D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+        UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+        device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+        gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+
+        m_causticGBuffers.push_back(gBuffer);
+    }
+}
+
+void PhotonMajorRenderer::CreateVisiblePhotonBuffers()
+{
+    // Create the visible photon list and its counter
+    // The list can hold every photon slot and every caustic photon, in case nothing gets culled
+    const UINT capacity = m_gBufferWidth * m_gBufferHeight * m_gBufferDepth + m_causticBufferWidth * m_causticBufferHeight;
+
+    CreateStructuredBuffer(m_visiblePhotonList, capacity, 2 * sizeof(UINT));
+    NAME_D3D12_OBJECT(m_visiblePhotonList.textureResource);
+    CreateStructuredBuffer(m_visiblePhotonCount, 1, sizeof(UINT));
+    NAME_D3D12_OBJECT(m_visiblePhotonCount.textureResource);
+}
+
+void PhotonMajorRenderer::CreateStructuredBuffer(GBuffer& gBuffer, UINT numElements, UINT elementSize)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Buffer(UINT64(numElements) * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+    UINT descriptorHeapIndex = gBuffer.uavDescriptorHeapIndex;
+    gBuffer = {};
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, descriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    UAVDesc.Buffer.NumElements = numElements;
+    UAVDesc.Buffer.StructureByteStride = elementSize;
+    device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+}
+
+void PhotonMajorRenderer::CreateCameraDepthBuffer()
+{
+    // Distance to the camera and instance ID of the closest surface, per screen pixel
+    CreateScreenTexture(m_cameraDepthBuffer, DXGI_FORMAT_R32G32_FLOAT);
+    NAME_D3D12_OBJECT(m_cameraDepthBuffer.textureResource);
+}
+
+void PhotonMajorRenderer::CreateScreenTexture(GBuffer& gBuffer, DXGI_FORMAT format)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    UINT descriptorHeapIndex = gBuffer.uavDescriptorHeapIndex;
+    gBuffer = {};
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, descriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+    device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+}
+
+void PhotonMajorRenderer::CreateSplatBuffers()
+{
+    // Binned splatting, one splat per visible photon slot and one bin per screen tile
+    const UINT capacity = m_gBufferWidth * m_gBufferHeight * m_gBufferDepth + m_causticBufferWidth * m_causticBufferHeight;
+    const UINT numTiles = ((m_width + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE) * ((m_height + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE);
+
+    CreateStructuredBuffer(m_splats, capacity, sizeof(SplatRecord));
+    NAME_D3D12_OBJECT(m_splats.textureResource);
+    CreateStructuredBuffer(m_splatSlots, capacity, sizeof(UINT));
+    NAME_D3D12_OBJECT(m_splatSlots.textureResource);
+    CreateStructuredBuffer(m_sortedSplats, capacity, sizeof(SplatRecord));
+    NAME_D3D12_OBJECT(m_sortedSplats.textureResource);
+    CreateStructuredBuffer(m_splatTileCounts, numTiles, sizeof(UINT));
+    NAME_D3D12_OBJECT(m_splatTileCounts.textureResource);
+    CreateStructuredBuffer(m_splatTileOffsets, numTiles, sizeof(UINT));
+    NAME_D3D12_OBJECT(m_splatTileOffsets.textureResource);
+
+    // Float accumulation target at screen resolution
+    CreateScreenTexture(m_splatAccum, DXGI_FORMAT_R32G32B32A32_FLOAT);
+    NAME_D3D12_OBJECT(m_splatAccum.textureResource);
+}
+
+void PhotonMajorRenderer::CreateTemporalBuffers()
+{
+    // Copies of the accumulation and camera depth from before the camera moved, the reprojection reads them
+    CreateScreenTexture(m_splatHistory, DXGI_FORMAT_R32G32B32A32_FLOAT);
+    NAME_D3D12_OBJECT(m_splatHistory.textureResource);
+    CreateScreenTexture(m_cameraDepthHistory, DXGI_FORMAT_R32G32_FLOAT);
+    NAME_D3D12_OBJECT(m_cameraDepthHistory.textureResource);
+}
+
+void PhotonMajorRenderer::CreateDenoiseBuffers()
+{
+    // Normal and albedo guides, written by the depth pass next to the camera depth
+    CreateScreenTexture(m_cameraNormal, DXGI_FORMAT_R32G32B32A32_FLOAT);
+    NAME_D3D12_OBJECT(m_cameraNormal.textureResource);
+    CreateScreenTexture(m_cameraAlbedo, DXGI_FORMAT_R32G32B32A32_FLOAT);
+    NAME_D3D12_OBJECT(m_cameraAlbedo.textureResource);
+
+    // The output and its guides are read back for the CPU denoiser, the result comes back through an upload buffer
+    CreateCopyBuffer(m_denoiseColorReadback, m_raytracingOutput.Get(), D3D12_HEAP_TYPE_READBACK);
+    NAME_D3D12_OBJECT(m_denoiseColorReadback);
+    CreateCopyBuffer(m_denoiseDepthReadback, m_cameraDepthBuffer.textureResource.Get(), D3D12_HEAP_TYPE_READBACK);
+    NAME_D3D12_OBJECT(m_denoiseDepthReadback);
+    CreateCopyBuffer(m_denoiseNormalReadback, m_cameraNormal.textureResource.Get(), D3D12_HEAP_TYPE_READBACK);
+    NAME_D3D12_OBJECT(m_denoiseNormalReadback);
+    CreateCopyBuffer(m_denoiseAlbedoReadback, m_cameraAlbedo.textureResource.Get(), D3D12_HEAP_TYPE_READBACK);
+    NAME_D3D12_OBJECT(m_denoiseAlbedoReadback);
+    CreateCopyBuffer(m_denoiseUpload, m_raytracingOutput.Get(), D3D12_HEAP_TYPE_UPLOAD);
+    NAME_D3D12_OBJECT(m_denoiseUpload);
+}
+
+// Buffer holding a copy of every array slice of a texture, laid out as GetCopyableFootprints places them
+void PhotonMajorRenderer::CreateCopyBuffer(ComPtr<ID3D12Resource>& buffer, ID3D12Resource* texture, D3D12_HEAP_TYPE heapType)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    D3D12_RESOURCE_DESC textureDesc = texture->GetDesc();
+    UINT64 bufferSize;
+    device->GetCopyableFootprints(&textureDesc, 0, textureDesc.DepthOrArraySize, 0, nullptr, nullptr, nullptr, &bufferSize);
+
+    auto heapProperties = CD3DX12_HEAP_PROPERTIES(heapType);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+    auto initialState = (heapType == D3D12_HEAP_TYPE_READBACK) ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_GENERIC_READ;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, initialState, nullptr, IID_PPV_ARGS(&buffer)));
+}
+
+void PhotonMajorRenderer::BuildProjectionMap()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    // Photons are emitted from the light position in the scene constants, so the map is built around it
+    XMFLOAT3 lightPosition;
+    XMStoreFloat3(&lightPosition, m_sceneCB[frameIndex].lightPosition);
+    m_projectionMap.Build(m_scene, lightPosition);
+
+    const std::vector<UINT>& activeCells = m_projectionMap.GetActiveCells();
+
+    m_projectionMapCells.Reset();
+    if (!activeCells.empty())
+    {
+        AllocateUploadBuffer(device, (void*)activeCells.data(), activeCells.size() * sizeof(UINT), &m_projectionMapCells, L"ProjectionMapCells");
+    }
+
+    wstringstream debugText;
+    debugText << L"Projection map: " << activeCells.size() << L" of " << PROJECTION_MAP_NUM_CELLS
+        << L" cells reach specular geometry (" << setprecision(2) << fixed << (100.0f * m_projectionMap.GetCoverage()) << L"%)\n";
+    OutputDebugString(debugText.str().c_str());
+}
+
 void PhotonMajorRenderer::CreateDescriptorHeap()
 {
     auto device = m_deviceResources->GetD3DDevice();
@@ -875,22 +1547,222 @@ void PhotonMajorRenderer::CreateDescriptorHeap()
     // Allocate a heap for descriptors:
     // n - vertex SRVs
     // n - index SRVs
-    // n - constant buffer views for scene buffer info
-    // n - constant buffer views for materials
-    // n - constant buffer views for lights
+    // 1 - structured buffer SRV for the scene buffer info of every instance
+    // 1 - structured buffer SRV for the materials
+    // 1 - structured buffer SRV for the lights
     // n - bottom level acceleration structure fallback wrapped pointer UAVs
     // n - top level acceleration structure fallback wrapped pointer UAVs
-    descriptorHeapDesc.NumDescriptors = NumGBuffers + NumRenderTargets + NumStagingBuffers + GetNumDescriptorsForScene();
+    descriptorHeapDesc.NumDescriptors = NumGBuffers + NumCausticGBuffers + NumVisiblePhotonBuffers + NumCameraDepthBuffers + NumSplatBuffers + NumTemporalBuffers + NumDenoiseGuideBuffers + NumRenderTargets + NumStagingBuffers + GetNumDescriptorsForScene();
     descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     descriptorHeapDesc.NodeMask = 0;
     device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_descriptorHeap));
     NAME_D3D12_OBJECT(m_descriptorHeap);
 
-    m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void PhotonMajorRenderer::BuildPrePassShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    m_prePassShaderTableRes = {};
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackPrePassStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrPrePassStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+    }
+
+    // Ray gen shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
+        rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
+        m_prePassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+    }
+
+    // Miss shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
+        missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
+        m_prePassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+    }
+
+    // Hit group shader table
+    {
+        struct RootArguments {
+            CubeConstantBuffer cb;
+        } rootArguments;
+        rootArguments.cb = m_cubeCB;
+
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
+        ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
+        hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
+        m_prePassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+    }
+}
+
+// Build shader tables.
+// This encapsulates all shader records - shaders and the arguments for their local root signatures.
+void PhotonMajorRenderer::BuildFirstPassShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    m_firstPassShaderTableRes = {};
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackFirstPassStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrFirstPassStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+    }
+
+    // Ray gen shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
+        rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
+        m_firstPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+    }
+
+    // Miss shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
+        missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
+        m_firstPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+    }
+
+    // Hit group shader table
+    {
+        struct RootArguments {
+            CubeConstantBuffer cb;
+        } rootArguments;
+        rootArguments.cb = m_cubeCB;
+
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
+        ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
+        hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
+        m_firstPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+    }
+}
+
+
+// Build shader tables.
+// This encapsulates all shader records - shaders and the arguments for their local root signatures.
+void PhotonMajorRenderer::BuildSecondPassShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    m_secondPassShaderTableRes = {};
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackSecondPassStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrFirstPassStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+    }
+
+    // Ray gen shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
+        rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
+        m_secondPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+    }
+
+    // Miss shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
+        missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
+        m_secondPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+    }
+
+    // Hit group shader table
+    {
+        struct RootArguments {
+            CubeConstantBuffer cb;
+        } rootArguments;
+        rootArguments.cb = m_cubeCB;
+
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
+        ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
+        hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
+        m_secondPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+    }
 }
 
-void PhotonMajorRenderer::BuildPrePassShaderTables()
+void PhotonMajorRenderer::BuildThirdPassShaderTables()
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -898,7 +1770,7 @@ void PhotonMajorRenderer::BuildPrePassShaderTables()
     void* missShaderIdentifier;
     void* hitGroupShaderIdentifier;
 
-    m_prePassShaderTableRes = {};
+    m_thirdPassShaderTableRes = {};
 
     auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
     {
@@ -911,13 +1783,13 @@ void PhotonMajorRenderer::BuildPrePassShaderTables()
     UINT shaderIdentifierSize;
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GetShaderIdentifiers(m_fallbackPrePassStateObject.Get());
+        GetShaderIdentifiers(m_fallbackThirdPassStateObject.Get());
         shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
     }
     else // DirectX Raytracing
     {
         ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
-        ThrowIfFailed(m_dxrPrePassStateObject.As(&stateObjectProperties));
+        ThrowIfFailed(m_dxrThirdPassStateObject.As(&stateObjectProperties));
         GetShaderIdentifiers(stateObjectProperties.Get());
         shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
     }
@@ -928,7 +1800,7 @@ void PhotonMajorRenderer::BuildPrePassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
         rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
-        m_prePassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+        m_thirdPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
     }
 
     // Miss shader table
@@ -937,7 +1809,7 @@ void PhotonMajorRenderer::BuildPrePassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
         missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
-        m_prePassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+        m_thirdPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
     }
 
     // Hit group shader table
@@ -951,13 +1823,11 @@ void PhotonMajorRenderer::BuildPrePassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
         ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
         hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
-        m_prePassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+        m_thirdPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
     }
 }
 
-// Build shader tables.
-// This encapsulates all shader records - shaders and the arguments for their local root signatures.
-void PhotonMajorRenderer::BuildFirstPassShaderTables()
+void PhotonMajorRenderer::BuildCullPassShaderTables()
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -965,7 +1835,7 @@ void PhotonMajorRenderer::BuildFirstPassShaderTables()
     void* missShaderIdentifier;
     void* hitGroupShaderIdentifier;
 
-    m_firstPassShaderTableRes = {};
+    m_cullPassShaderTableRes = {};
 
     auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
     {
@@ -978,13 +1848,13 @@ void PhotonMajorRenderer::BuildFirstPassShaderTables()
     UINT shaderIdentifierSize;
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GetShaderIdentifiers(m_fallbackFirstPassStateObject.Get());
+        GetShaderIdentifiers(m_fallbackCullPassStateObject.Get());
         shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
     }
     else // DirectX Raytracing
     {
         ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
-        ThrowIfFailed(m_dxrFirstPassStateObject.As(&stateObjectProperties));
+        ThrowIfFailed(m_dxrCullPassStateObject.As(&stateObjectProperties));
         GetShaderIdentifiers(stateObjectProperties.Get());
         shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
     }
@@ -995,7 +1865,7 @@ void PhotonMajorRenderer::BuildFirstPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
         rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
-        m_firstPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+        m_cullPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
     }
 
     // Miss shader table
@@ -1004,7 +1874,7 @@ void PhotonMajorRenderer::BuildFirstPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
         missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
-        m_firstPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+        m_cullPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
     }
 
     // Hit group shader table
@@ -1018,14 +1888,11 @@ void PhotonMajorRenderer::BuildFirstPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
         ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
         hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
-        m_firstPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+        m_cullPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
     }
 }
 
-
-// Build shader tables.
-// This encapsulates all shader records - shaders and the arguments for their local root signatures.
-void PhotonMajorRenderer::BuildSecondPassShaderTables()
+void PhotonMajorRenderer::BuildDepthPassShaderTables()
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -1033,7 +1900,7 @@ void PhotonMajorRenderer::BuildSecondPassShaderTables()
     void* missShaderIdentifier;
     void* hitGroupShaderIdentifier;
 
-    m_secondPassShaderTableRes = {};
+    m_depthPassShaderTableRes = {};
 
     auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
     {
@@ -1046,13 +1913,13 @@ void PhotonMajorRenderer::BuildSecondPassShaderTables()
     UINT shaderIdentifierSize;
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GetShaderIdentifiers(m_fallbackSecondPassStateObject.Get());
+        GetShaderIdentifiers(m_fallbackDepthPassStateObject.Get());
         shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
     }
     else // DirectX Raytracing
     {
         ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
-        ThrowIfFailed(m_dxrFirstPassStateObject.As(&stateObjectProperties));
+        ThrowIfFailed(m_dxrDepthPassStateObject.As(&stateObjectProperties));
         GetShaderIdentifiers(stateObjectProperties.Get());
         shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
     }
@@ -1063,7 +1930,7 @@ void PhotonMajorRenderer::BuildSecondPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
         rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
-        m_secondPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+        m_depthPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
     }
 
     // Miss shader table
@@ -1072,7 +1939,7 @@ void PhotonMajorRenderer::BuildSecondPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
         missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
-        m_secondPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+        m_depthPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
     }
 
     // Hit group shader table
@@ -1086,11 +1953,11 @@ void PhotonMajorRenderer::BuildSecondPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
         ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
         hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
-        m_secondPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+        m_depthPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
     }
 }
 
-void PhotonMajorRenderer::BuildThirdPassShaderTables()
+void PhotonMajorRenderer::BuildCausticPassShaderTables()
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -1098,7 +1965,7 @@ void PhotonMajorRenderer::BuildThirdPassShaderTables()
     void* missShaderIdentifier;
     void* hitGroupShaderIdentifier;
 
-    m_thirdPassShaderTableRes = {};
+    m_causticPassShaderTableRes = {};
 
     auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
     {
@@ -1111,13 +1978,13 @@ void PhotonMajorRenderer::BuildThirdPassShaderTables()
     UINT shaderIdentifierSize;
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GetShaderIdentifiers(m_fallbackThirdPassStateObject.Get());
+        GetShaderIdentifiers(m_fallbackCausticPassStateObject.Get());
         shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
     }
     else // DirectX Raytracing
     {
         ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
-        ThrowIfFailed(m_dxrThirdPassStateObject.As(&stateObjectProperties));
+        ThrowIfFailed(m_dxrCausticPassStateObject.As(&stateObjectProperties));
         GetShaderIdentifiers(stateObjectProperties.Get());
         shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
     }
@@ -1128,7 +1995,7 @@ void PhotonMajorRenderer::BuildThirdPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
         rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
-        m_thirdPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+        m_causticPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
     }
 
     // Miss shader table
@@ -1137,7 +2004,7 @@ void PhotonMajorRenderer::BuildThirdPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize;
         ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
         missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
-        m_thirdPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+        m_causticPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
     }
 
     // Hit group shader table
@@ -1151,7 +2018,7 @@ void PhotonMajorRenderer::BuildThirdPassShaderTables()
         UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
         ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
         hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
-        m_thirdPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+        m_causticPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
     }
 }
 
@@ -1197,6 +2064,47 @@ void PhotonMajorRenderer::OnKeyDown(UINT8 key)
         SelectRaytracingAPI(RaytracingAPI::DirectXRaytracing);
         break;
 
+    case 'B': // Toggle between tile binned float splatting and atomic splatting into the staging buffers
+    {
+        m_binnedSplatting = !m_binnedSplatting;
+        for (auto& sceneCB : m_sceneCB)
+        {
+            sceneCB.renderFlags = GetRenderFlags();
+        }
+
+        // The two paths accumulate into different buffers
+        m_clearStagingBuffers = true;
+    }
+    break;
+
+    case 'H': // Toggle the density gather over neighbouring pixels for the staging buffer resolve
+        m_densityGather = !m_densityGather;
+        for (auto& sceneCB : m_sceneCB)
+        {
+            sceneCB.renderFlags = GetRenderFlags();
+        }
+        break;
+
+    case 'P': // Toggle progressive mode, a new photon batch every frame
+        m_progressive = !m_progressive;
+        break;
+
+    case 'F': // Toggle the CPU a-trous denoiser on the output
+        m_denoise = !m_denoise;
+        break;
+
+    case 'G': // Cycle the number of a-trous iterations
+        m_denoiseIterations = m_denoiseIterations % DENOISE_MAX_ITERATIONS + 1;
+        break;
+
+    case 'T': // Toggle the adaptive photon budget, off traces and splats every photon
+        m_photonBudget.SetEnabled(!m_photonBudget.IsEnabled());
+        break;
+
+    case 'V': // Check the next frame's staging buffer resolve against the CPU reference
+        m_verifyFluxResolve = true;
+        break;
+
         // Camera Movements
     case 'W':
     {
@@ -1360,69 +2268,263 @@ void PhotonMajorRenderer::OnKeyDown(UINT8 key)
     }
 }
 
-void PhotonMajorRenderer::OnKeyUp()
-{
-    m_clearStagingBuffers = true;
-}
-
-// Update frame-based values.
-void PhotonMajorRenderer::OnUpdate()
+void PhotonMajorRenderer::OnKeyUp()
+{
+    // Camera keys are handled by UpdateCameraMatrices, binned splats survive them
+    if (!m_binnedSplatting)
+    {
+        m_clearStagingBuffers = true;
+    }
+}
+
+// Update frame-based values.
+void PhotonMajorRenderer::OnUpdate()
+{
+    m_timer.Tick();
+    CalculateFrameStats();
+    float elapsedTime = static_cast<float>(m_timer.GetElapsedSeconds());
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    auto prevFrameIndex = m_deviceResources->GetPreviousFrameIndex();
+
+    if (cameraNeedsUpdate)
+    {
+        UpdateCameraMatrices();
+        cameraNeedsUpdate = false;
+    }
+
+    // Pick up edits to the scene file, the photons are traced again for any of them
+    DXRPhotonMapper::SceneChange sceneChanges = ReloadScene();
+    if (DXRPhotonMapper::HasSceneChange(sceneChanges, DXRPhotonMapper::SceneChange::Topology))
+    {
+        RecreateD3D();
+        m_calculatePhotonMap = true;
+    }
+    else if (sceneChanges != DXRPhotonMapper::SceneChange::None)
+    {
+        BuildProjectionMap();
+        m_calculatePhotonMap = true;
+    }
+
+    /*
+    // Rotate the camera around Y axis.
+    {
+        float secondsToRotateAround = 24.0f;
+        float angleToRotateBy = 360.0f * (elapsedTime / secondsToRotateAround);
+        XMMATRIX rotate = XMMatrixRotationY(XMConvertToRadians(angleToRotateBy));
+        m_eye = XMVector3Transform(m_eye, rotate);
+        m_up = XMVector3Transform(m_up, rotate);
+        m_at = XMVector3Transform(m_at, rotate);
+        UpdateCameraMatrices();
+    }
+
+    // Rotate the second light around Y axis.
+    {
+        float secondsToRotateAround = 8.0f;
+        float angleToRotateBy = 0.f;//-360.0f * (elapsedTime / secondsToRotateAround);
+        XMMATRIX rotate = XMMatrixRotationY(XMConvertToRadians(angleToRotateBy));
+        const XMVECTOR& prevLightPosition = m_sceneCB[prevFrameIndex].lightPosition;
+        m_sceneCB[frameIndex].lightPosition = XMVector3Transform(prevLightPosition, rotate);
+    }
+    */
+}
+
+
+// Parse supplied command line args.
+void PhotonMajorRenderer::ParseCommandLineArgs(WCHAR* argv[], int argc)
+{
+    PhotonBaseRenderer::ParseCommandLineArgs(argv, argc);
+
+    if (argc > 1)
+    {
+        if (_wcsnicmp(argv[1], L"-FL", wcslen(argv[1])) == 0)
+        {
+            m_forceComputeFallback = true;
+            m_raytracingAPI = RaytracingAPI::FallbackLayer;
+        }
+        else if (_wcsnicmp(argv[1], L"-DXR", wcslen(argv[1])) == 0)
+        {
+            m_raytracingAPI = RaytracingAPI::DirectXRaytracing;
+        }
+    }
+}
+
+void PhotonMajorRenderer::DoPrePassPhotonMapping()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
+    {
+        // Since each shader table has only one shader record, the stride is same as the size.
+        dispatchDesc->HitGroupTable.StartAddress = m_prePassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_prePassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
+        dispatchDesc->MissShaderTable.StartAddress = m_prePassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_prePassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_prePassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_prePassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->Width = m_width;
+        dispatchDesc->Height = m_height;
+        dispatchDesc->Depth = 1;
+        commandList->SetPipelineState1(stateObject);
+        commandList->DispatchRays(dispatchDesc);
+    };
+
+    auto SetCommonPipelineState = [&](auto* descriptorSetCommandList)
+    {
+        descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+        // Set index and successive vertex buffer decriptor tables
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+    };
+
+    commandList->SetComputeRootSignature(m_prePassGlobalRootSignature.Get());
+
+    // Copy the updated scene constant buffer to GPU.
+    memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+
+    // Bind the heaps, acceleration structure and dispatch rays.
+    D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        SetCommonPipelineState(m_fallbackCommandList.Get());
+        m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackPrePassStateObject.Get(), &dispatchDesc);
+    }
+    else // DirectX Raytracing
+    {
+        SetCommonPipelineState(commandList);
+        commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
+        DispatchRays(m_dxrCommandList.Get(), m_dxrPrePassStateObject.Get(), &dispatchDesc);
+    }
+}
+
+void PhotonMajorRenderer::DoFirstPassPhotonMapping()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
+    {
+        // Since each shader table has only one shader record, the stride is same as the size.
+        dispatchDesc->HitGroupTable.StartAddress = m_firstPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_firstPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
+        dispatchDesc->MissShaderTable.StartAddress = m_firstPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_firstPassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_firstPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_firstPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->Width = m_gBufferWidth;
+        dispatchDesc->Height = m_tracedPhotonRows; // The photon budget, the rows past it keep their old photons
+        dispatchDesc->Depth = 1;
+        commandList->SetPipelineState1(stateObject);
+        commandList->DispatchRays(dispatchDesc);
+    };
+
+    auto SetCommonPipelineState = [&](auto* descriptorSetCommandList)
+    {
+        descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+        // Set index and successive vertex buffer decriptor tables
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+    };
+
+    commandList->SetComputeRootSignature(m_firstPassGlobalRootSignature.Get());
+
+    // Copy the updated scene constant buffer to GPU.
+    memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+
+    // Bind the heaps, acceleration structure and dispatch rays.
+    D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        SetCommonPipelineState(m_fallbackCommandList.Get());
+        m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackFirstPassStateObject.Get(), &dispatchDesc);
+    }
+    else // DirectX Raytracing
+    {
+        SetCommonPipelineState(commandList);
+        commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
+        DispatchRays(m_dxrCommandList.Get(), m_dxrFirstPassStateObject.Get(), &dispatchDesc);
+    }
+}
+
+void PhotonMajorRenderer::DoCausticPassPhotonMapping()
 {
-    m_timer.Tick();
-    CalculateFrameStats();
-    float elapsedTime = static_cast<float>(m_timer.GetElapsedSeconds());
+    auto commandList = m_deviceResources->GetCommandList();
     auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
-    auto prevFrameIndex = m_deviceResources->GetPreviousFrameIndex();
-
-    if (cameraNeedsUpdate)
-    {
-        UpdateCameraMatrices();
-    }
 
-    /*
-    // Rotate the camera around Y axis.
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
     {
-        float secondsToRotateAround = 24.0f;
-        float angleToRotateBy = 360.0f * (elapsedTime / secondsToRotateAround);
-        XMMATRIX rotate = XMMatrixRotationY(XMConvertToRadians(angleToRotateBy));
-        m_eye = XMVector3Transform(m_eye, rotate);
-        m_up = XMVector3Transform(m_up, rotate);
-        m_at = XMVector3Transform(m_at, rotate);
-        UpdateCameraMatrices();
-    }
+        // Since each shader table has only one shader record, the stride is same as the size.
+        dispatchDesc->HitGroupTable.StartAddress = m_causticPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_causticPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
+        dispatchDesc->MissShaderTable.StartAddress = m_causticPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_causticPassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_causticPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_causticPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->Width = m_causticBufferWidth;
+        dispatchDesc->Height = m_causticBufferHeight;
+        dispatchDesc->Depth = 1;
+        commandList->SetPipelineState1(stateObject);
+        commandList->DispatchRays(dispatchDesc);
+    };
 
-    // Rotate the second light around Y axis.
+    auto SetCommonPipelineState = [&](auto* descriptorSetCommandList)
     {
-        float secondsToRotateAround = 8.0f;
-        float angleToRotateBy = 0.f;//-360.0f * (elapsedTime / secondsToRotateAround);
-        XMMATRIX rotate = XMMatrixRotationY(XMConvertToRadians(angleToRotateBy));
-        const XMVECTOR& prevLightPosition = m_sceneCB[prevFrameIndex].lightPosition;
-        m_sceneCB[frameIndex].lightPosition = XMVector3Transform(prevLightPosition, rotate);
-    }
-    */
-}
+        descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+        // Set index and successive vertex buffer decriptor tables
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+    };
 
+    commandList->SetComputeRootSignature(m_causticPassGlobalRootSignature.Get());
 
-// Parse supplied command line args.
-void PhotonMajorRenderer::ParseCommandLineArgs(WCHAR* argv[], int argc)
-{
-    PhotonBaseRenderer::ParseCommandLineArgs(argv, argc);
+    // Copy the updated scene constant buffer to GPU.
+    memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+    commandList->SetComputeRootShaderResourceView(CausticRootSignatureParams::ProjectionMapSlot, m_projectionMapCells->GetGPUVirtualAddress());
 
-    if (argc > 1)
+    // Bind the heaps, acceleration structure and dispatch rays.
+    D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        if (_wcsnicmp(argv[1], L"-FL", wcslen(argv[1])) == 0)
-        {
-            m_forceComputeFallback = true;
-            m_raytracingAPI = RaytracingAPI::FallbackLayer;
-        }
-        else if (_wcsnicmp(argv[1], L"-DXR", wcslen(argv[1])) == 0)
-        {
-            m_raytracingAPI = RaytracingAPI::DirectXRaytracing;
-        }
+        SetCommonPipelineState(m_fallbackCommandList.Get());
+        m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackCausticPassStateObject.Get(), &dispatchDesc);
+    }
+    else // DirectX Raytracing
+    {
+        SetCommonPipelineState(commandList);
+        commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
+        DispatchRays(m_dxrCommandList.Get(), m_dxrCausticPassStateObject.Get(), &dispatchDesc);
     }
 }
 
-void PhotonMajorRenderer::DoPrePassPhotonMapping()
+// Traces one camera ray per pixel and keeps the hit distance and instance, so the splat pass can test visibility without a ray
+void PhotonMajorRenderer::DoDepthPassPhotonMapping()
 {
     auto commandList = m_deviceResources->GetCommandList();
     auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
@@ -1430,14 +2532,14 @@ void PhotonMajorRenderer::DoPrePassPhotonMapping()
     auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
     {
         // Since each shader table has only one shader record, the stride is same as the size.
-        dispatchDesc->HitGroupTable.StartAddress = m_prePassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->HitGroupTable.SizeInBytes = m_prePassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StartAddress = m_depthPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_depthPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
         dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
-        dispatchDesc->MissShaderTable.StartAddress = m_prePassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->MissShaderTable.SizeInBytes = m_prePassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StartAddress = m_depthPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_depthPassShaderTableRes.m_missShaderTable->GetDesc().Width;
         dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
-        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_prePassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_prePassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_depthPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_depthPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
         dispatchDesc->Width = m_width;
         dispatchDesc->Height = m_height;
         dispatchDesc->Depth = 1;
@@ -1451,13 +2553,13 @@ void PhotonMajorRenderer::DoPrePassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
-    commandList->SetComputeRootSignature(m_prePassGlobalRootSignature.Get());
+    commandList->SetComputeRootSignature(m_depthPassGlobalRootSignature.Get());
 
     // Copy the updated scene constant buffer to GPU.
     memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
@@ -1470,17 +2572,22 @@ void PhotonMajorRenderer::DoPrePassPhotonMapping()
     {
         SetCommonPipelineState(m_fallbackCommandList.Get());
         m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
-        DispatchRays(m_fallbackCommandList.Get(), m_fallbackPrePassStateObject.Get(), &dispatchDesc);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackDepthPassStateObject.Get(), &dispatchDesc);
     }
     else // DirectX Raytracing
     {
         SetCommonPipelineState(commandList);
         commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
-        DispatchRays(m_dxrCommandList.Get(), m_dxrPrePassStateObject.Get(), &dispatchDesc);
+        DispatchRays(m_dxrCommandList.Get(), m_dxrDepthPassStateObject.Get(), &dispatchDesc);
     }
+
+    // The splat pass reads the depth buffer
+    D3D12_RESOURCE_BARRIER depthBarrier = CD3DX12_RESOURCE_BARRIER::UAV(m_cameraDepthBuffer.textureResource.Get());
+    commandList->ResourceBarrier(1, &depthBarrier);
 }
 
-void PhotonMajorRenderer::DoFirstPassPhotonMapping()
+// Frustum and backface culls the photon map and compacts the survivors into the visible photon list
+void PhotonMajorRenderer::DoCullPassPhotonMapping()
 {
     auto commandList = m_deviceResources->GetCommandList();
     auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
@@ -1488,17 +2595,17 @@ void PhotonMajorRenderer::DoFirstPassPhotonMapping()
     auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
     {
         // Since each shader table has only one shader record, the stride is same as the size.
-        dispatchDesc->HitGroupTable.StartAddress = m_firstPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->HitGroupTable.SizeInBytes = m_firstPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StartAddress = m_cullPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_cullPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
         dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
-        dispatchDesc->MissShaderTable.StartAddress = m_firstPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->MissShaderTable.SizeInBytes = m_firstPassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StartAddress = m_cullPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_cullPassShaderTableRes.m_missShaderTable->GetDesc().Width;
         dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
-        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_firstPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
-        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_firstPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_cullPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_cullPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
         dispatchDesc->Width = m_gBufferWidth;
-        dispatchDesc->Height = m_gBufferHeight;
-        dispatchDesc->Depth = 1;
+        dispatchDesc->Height = max(m_splatPhotonRows, m_causticBufferHeight);
+        dispatchDesc->Depth = m_gBufferDepth + 1; // The last layer is the caustic map
         commandList->SetPipelineState1(stateObject);
         commandList->DispatchRays(dispatchDesc);
     };
@@ -1509,13 +2616,13 @@ void PhotonMajorRenderer::DoFirstPassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
-    commandList->SetComputeRootSignature(m_firstPassGlobalRootSignature.Get());
+    commandList->SetComputeRootSignature(m_cullPassGlobalRootSignature.Get());
 
     // Copy the updated scene constant buffer to GPU.
     memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
@@ -1528,14 +2635,22 @@ void PhotonMajorRenderer::DoFirstPassPhotonMapping()
     {
         SetCommonPipelineState(m_fallbackCommandList.Get());
         m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
-        DispatchRays(m_fallbackCommandList.Get(), m_fallbackFirstPassStateObject.Get(), &dispatchDesc);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackCullPassStateObject.Get(), &dispatchDesc);
     }
     else // DirectX Raytracing
     {
         SetCommonPipelineState(commandList);
         commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
-        DispatchRays(m_dxrCommandList.Get(), m_dxrFirstPassStateObject.Get(), &dispatchDesc);
+        DispatchRays(m_dxrCommandList.Get(), m_dxrCullPassStateObject.Get(), &dispatchDesc);
     }
+
+    // The splat pass reads the list this pass appended to
+    D3D12_RESOURCE_BARRIER visibleBarriers[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::UAV(m_visiblePhotonList.textureResource.Get()),
+        CD3DX12_RESOURCE_BARRIER::UAV(m_visiblePhotonCount.textureResource.Get())
+    };
+    commandList->ResourceBarrier(ARRAYSIZE(visibleBarriers), visibleBarriers);
 }
 
 void PhotonMajorRenderer::DoSecondPassPhotonMapping()
@@ -1567,9 +2682,9 @@ void PhotonMajorRenderer::DoSecondPassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
@@ -1596,6 +2711,287 @@ void PhotonMajorRenderer::DoSecondPassPhotonMapping()
     }
 }
 
+// Counting sorts the splats by screen tile, then resolves each tile in a single group
+void PhotonMajorRenderer::DoBinnedSplatting()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+
+    const UINT tilesX = (m_width + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE;
+    const UINT tilesY = (m_height + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE;
+
+    // Every pass reads what the previous one wrote
+    D3D12_RESOURCE_BARRIER passBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+
+    commandList->ResourceBarrier(1, &passBarrier);
+    DoComputePass(m_computeSplatCountPSO, SPLAT_BIN_GROUPS, 1, 1);
+    commandList->ResourceBarrier(1, &passBarrier);
+    DoComputePass(m_computeSplatScanPSO, 1, 1, 1);
+    commandList->ResourceBarrier(1, &passBarrier);
+    DoComputePass(m_computeSplatScatterPSO, SPLAT_BIN_GROUPS, 1, 1);
+    commandList->ResourceBarrier(1, &passBarrier);
+    DoComputePass(m_computeSplatResolvePSO, tilesX, tilesY, 1);
+    commandList->ResourceBarrier(1, &passBarrier);
+}
+
+// Keeps the accumulation and camera depth of the old view, before the depth pass overwrites them
+void PhotonMajorRenderer::SaveSplatHistory()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+
+    D3D12_RESOURCE_BARRIER preCopyBarriers[4];
+    preCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(m_splatAccum.textureResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    preCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_cameraDepthBuffer.textureResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    preCopyBarriers[2] = CD3DX12_RESOURCE_BARRIER::Transition(m_splatHistory.textureResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+    preCopyBarriers[3] = CD3DX12_RESOURCE_BARRIER::Transition(m_cameraDepthHistory.textureResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList->ResourceBarrier(ARRAYSIZE(preCopyBarriers), preCopyBarriers);
+
+    commandList->CopyResource(m_splatHistory.textureResource.Get(), m_splatAccum.textureResource.Get());
+    commandList->CopyResource(m_cameraDepthHistory.textureResource.Get(), m_cameraDepthBuffer.textureResource.Get());
+
+    D3D12_RESOURCE_BARRIER postCopyBarriers[4];
+    postCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(m_splatAccum.textureResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    postCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_cameraDepthBuffer.textureResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    postCopyBarriers[2] = CD3DX12_RESOURCE_BARRIER::Transition(m_splatHistory.textureResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    postCopyBarriers[3] = CD3DX12_RESOURCE_BARRIER::Transition(m_cameraDepthHistory.textureResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(ARRAYSIZE(postCopyBarriers), postCopyBarriers);
+}
+
+// Copy one subresource of every texture into its readback buffer, wait for the GPU and map the copies.
+// The command list is executed and reset on the way, so everything recorded so far has run when this returns.
+void PhotonMajorRenderer::ReadBackTextures(ReadbackCopy* copies, UINT numCopies)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto commandList = m_deviceResources->GetCommandList();
+    auto commandAllocator = m_deviceResources->GetCommandAllocator();
+
+    // Subresource transitions, so several slices of one texture can be copied at once
+    std::vector<D3D12_RESOURCE_BARRIER> preCopyBarriers(numCopies);
+    std::vector<D3D12_RESOURCE_BARRIER> postCopyBarriers(numCopies);
+    for (UINT i = 0; i < numCopies; ++i)
+    {
+        ReadbackCopy& copy = copies[i];
+        D3D12_RESOURCE_DESC textureDesc = copy.texture->GetDesc();
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(textureDesc.DepthOrArraySize);
+        device->GetCopyableFootprints(&textureDesc, 0, textureDesc.DepthOrArraySize, 0, footprints.data(), nullptr, nullptr, nullptr);
+        copy.footprint = footprints[copy.subresource];
+        preCopyBarriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(copy.texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, copy.subresource);
+        postCopyBarriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(copy.texture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, copy.subresource);
+    }
+
+    commandList->ResourceBarrier(numCopies, preCopyBarriers.data());
+    for (UINT i = 0; i < numCopies; ++i)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION destination(copies[i].readback, copies[i].footprint);
+        CD3DX12_TEXTURE_COPY_LOCATION source(copies[i].texture, copies[i].subresource);
+        commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+    commandList->ResourceBarrier(numCopies, postCopyBarriers.data());
+
+    m_deviceResources->ExecuteCommandList();
+    m_deviceResources->WaitForGpu();
+    commandList->Reset(commandAllocator, nullptr);
+
+    for (UINT i = 0; i < numCopies; ++i)
+    {
+        ReadbackCopy& copy = copies[i];
+        CD3DX12_RANGE readRange(copy.footprint.Offset, copy.footprint.Offset + copy.footprint.Footprint.RowPitch * copy.footprint.Footprint.Height);
+        ThrowIfFailed(copy.readback->Map(0, &readRange, reinterpret_cast<void**>(&copy.data)));
+        copy.data += copy.footprint.Offset;
+    }
+}
+
+void PhotonMajorRenderer::UnmapReadbacks(ReadbackCopy* copies, UINT numCopies)
+{
+    for (UINT i = 0; i < numCopies; ++i)
+    {
+        CD3DX12_RANGE writeRange(0, 0);        // Nothing was written on the CPU.
+        copies[i].readback->Unmap(0, &writeRange);
+    }
+}
+
+// Read the output and its guides back, denoise on the CPU and upload the result over the output.
+// The CPU has to wait for the GPU to finish the frame so far, on top of the filter itself.
+void PhotonMajorRenderer::DenoiseRaytracingOutput()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+
+    ReadbackCopy copies[] = {
+        { m_raytracingOutput.Get(), m_denoiseColorReadback.Get(), 0 },
+        { m_cameraDepthBuffer.textureResource.Get(), m_denoiseDepthReadback.Get(), 0 },
+        { m_cameraNormal.textureResource.Get(), m_denoiseNormalReadback.Get(), 0 },
+        { m_cameraAlbedo.textureResource.Get(), m_denoiseAlbedoReadback.Get(), 0 }
+    };
+    ReadBackTextures(copies, ARRAYSIZE(copies));
+
+    DXRPhotonMapper::PMDenoiser::Input input;
+    input.color = copies[0].data;
+    input.colorRowPitch = copies[0].footprint.Footprint.RowPitch;
+    input.depth = reinterpret_cast<const XMFLOAT2*>(copies[1].data);
+    input.depthRowPitch = copies[1].footprint.Footprint.RowPitch;
+    input.normal = reinterpret_cast<const XMFLOAT4*>(copies[2].data);
+    input.normalRowPitch = copies[2].footprint.Footprint.RowPitch;
+    input.albedo = reinterpret_cast<const XMFLOAT4*>(copies[3].data);
+    input.albedoRowPitch = copies[3].footprint.Footprint.RowPitch;
+
+    // The upload buffer has the same layout as the color readback
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& outputFootprint = copies[0].footprint;
+    UINT8* denoised;
+    CD3DX12_RANGE uploadReadRange(0, 0);        // We do not intend to read from this resource on the CPU.
+    ThrowIfFailed(m_denoiseUpload->Map(0, &uploadReadRange, reinterpret_cast<void**>(&denoised)));
+    m_denoiser.Denoise(input, m_width, m_height, m_denoiseIterations, denoised + outputFootprint.Offset, outputFootprint.Footprint.RowPitch);
+    m_denoiseUpload->Unmap(0, nullptr);
+
+    UnmapReadbacks(copies, ARRAYSIZE(copies));
+
+    D3D12_RESOURCE_BARRIER preUploadBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList->ResourceBarrier(1, &preUploadBarrier);
+
+    CD3DX12_TEXTURE_COPY_LOCATION destination(m_raytracingOutput.Get(), 0);
+    CD3DX12_TEXTURE_COPY_LOCATION source(m_denoiseUpload.Get(), outputFootprint);
+    commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+    D3D12_RESOURCE_BARRIER postUploadBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &postUploadBarrier);
+}
+
+// Resolve the read back staging buffers with the CPU reference and report how far the GPU resolve is from it.
+// Only the atomic splatting path resolves from the staging buffers.
+void PhotonMajorRenderer::VerifyFluxResolve()
+{
+    if (m_binnedSplatting)
+    {
+        OutputDebugString(L"Flux resolve check skipped: binned splatting does not use the staging buffers, press B first\n");
+        return;
+    }
+
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    ComPtr<ID3D12Resource> stagingReadbacks[NumStagingBuffers];
+    for (UINT i = 0; i < NumStagingBuffers; ++i)
+    {
+        CreateCopyBuffer(stagingReadbacks[i], m_stagingBuffers[i].textureResource.Get(), D3D12_HEAP_TYPE_READBACK);
+    }
+
+    // The denoiser readbacks already match the output, depth and normal layouts
+    ReadbackCopy copies[3 + 2 * NumStagingBuffers] = {
+        { m_raytracingOutput.Get(), m_denoiseColorReadback.Get(), 0 },
+        { m_cameraDepthBuffer.textureResource.Get(), m_denoiseDepthReadback.Get(), 0 },
+        { m_cameraNormal.textureResource.Get(), m_denoiseNormalReadback.Get(), 0 }
+    };
+    for (UINT i = 0; i < NumStagingBuffers; ++i)
+    {
+        for (UINT word = 0; word < 2; ++word)
+        {
+            copies[3 + 2 * i + word] = { m_stagingBuffers[i].textureResource.Get(), stagingReadbacks[i].Get(), word };
+        }
+    }
+    ReadBackTextures(copies, ARRAYSIZE(copies));
+
+    DXRPhotonMapper::PMFluxResolve::Input input;
+    for (UINT i = 0; i < NumStagingBuffers; ++i)
+    {
+        input.flux[i][0] = reinterpret_cast<const UINT*>(copies[3 + 2 * i].data);
+        input.flux[i][1] = reinterpret_cast<const UINT*>(copies[3 + 2 * i + 1].data);
+    }
+    input.fluxRowPitch = copies[3].footprint.Footprint.RowPitch;
+    input.depth = reinterpret_cast<const XMFLOAT2*>(copies[1].data);
+    input.depthRowPitch = copies[1].footprint.Footprint.RowPitch;
+    input.normal = reinterpret_cast<const XMFLOAT4*>(copies[2].data);
+    input.normalRowPitch = copies[2].footprint.Footprint.RowPitch;
+
+    const SceneConstantBuffer& sceneCB = m_sceneCB[frameIndex];
+    m_fluxResolve.Resolve(input, m_width, m_height, sceneCB.projectionToWorld, sceneCB.cameraPosition, sceneCB.fluxToRadiance, m_densityGather ? DENSITY_GATHER_RADIUS : 0);
+
+    // One step of slack for the different rounding of the GPU's UNORM conversion
+    UINT mismatchedPixels;
+    UINT maxError = m_fluxResolve.Compare(copies[0].data, copies[0].footprint.Footprint.RowPitch, 1, mismatchedPixels);
+
+    UnmapReadbacks(copies, ARRAYSIZE(copies));
+
+    wstringstream message;
+    message << L"Flux resolve check: max error " << maxError << L"/255, " << mismatchedPixels << L" of " << m_width * m_height << L" pixels off by more than 1\n";
+    OutputDebugString(message.str().c_str());
+}
+
+void PhotonMajorRenderer::WriteTimestamp(FrameTimestamp timestamp)
+{
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    m_deviceResources->GetCommandList()->EndQuery(m_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameIndex * NumFrameTimestamps + timestamp);
+}
+
+// Copy this frame's timestamps into its slot of the readback buffer, they are read when the frame index comes around again
+void PhotonMajorRenderer::ResolveFrameTimestamps()
+{
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    m_deviceResources->GetCommandList()->ResolveQueryData(m_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+        frameIndex * NumFrameTimestamps, NumFrameTimestamps, m_timestampReadback.Get(), frameIndex * NumFrameTimestamps * sizeof(UINT64));
+    m_frameTimingPending[frameIndex] = true;
+}
+
+// Feed the budget the timestamps this frame index recorded FrameCount frames ago, then pick this frame's photon rows.
+// Prepare has already waited for that frame, so the readback is complete.
+void PhotonMajorRenderer::UpdatePhotonBudget(bool tracePhotons)
+{
+    using DXRPhotonMapper::PMPhotonBudget;
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    PMPhotonBudget::FrameTiming& timing = m_frameTimings[frameIndex];
+
+    if (m_frameTimingPending[frameIndex])
+    {
+        const SIZE_T slotOffset = frameIndex * NumFrameTimestamps * sizeof(UINT64);
+        CD3DX12_RANGE readRange(slotOffset, slotOffset + NumFrameTimestamps * sizeof(UINT64));
+        UINT8* mappedTimestamps;
+        ThrowIfFailed(m_timestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&mappedTimestamps)));
+        const UINT64* timestamps = reinterpret_cast<const UINT64*>(mappedTimestamps + slotOffset);
+
+        auto Milliseconds = [&](FrameTimestamp begin, FrameTimestamp end)
+        {
+            return float(double(timestamps[end] - timestamps[begin]) * 1000.0 / double(m_timestampFrequency));
+        };
+        timing.passMilliseconds[PMPhotonBudget::PassEmission] = Milliseconds(TimestampFrameBegin, TimestampEmissionEnd);
+        timing.passMilliseconds[PMPhotonBudget::PassSplat] = Milliseconds(TimestampSplatBegin, TimestampSplatEnd);
+        timing.passMilliseconds[PMPhotonBudget::PassResolve] = Milliseconds(TimestampSplatEnd, TimestampResolveEnd);
+        timing.frameMilliseconds = Milliseconds(TimestampFrameBegin, TimestampFrameEnd);
+
+        CD3DX12_RANGE writeRange(0, 0);        // Nothing was written on the CPU.
+        m_timestampReadback->Unmap(0, &writeRange);
+
+        m_photonBudget.Update(timing, tracePhotons);
+        m_frameTimingPending[frameIndex] = false;
+    }
+
+    // A frame can only splat the rows that were traced
+    UINT rows = m_photonBudget.GetRows();
+    if (tracePhotons)
+    {
+        m_tracedPhotonRows = rows;
+    }
+    m_splatPhotonRows = min(rows, m_tracedPhotonRows);
+
+    timing.tracedRows = tracePhotons ? m_tracedPhotonRows : 0;
+    timing.splattedRows = m_splatPhotonRows;
+    m_sceneCB[frameIndex].photonRows = m_splatPhotonRows;
+}
+
+void PhotonMajorRenderer::DoComputePass(ComPtr<ID3D12PipelineState>& computePSO, UINT xThreads, UINT yThreads, UINT zThreads)
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    commandList->SetPipelineState(computePSO.Get());
+    commandList->SetComputeRootSignature(m_computeRootSignature.Get());
+
+    commandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+    commandList->SetComputeRootDescriptorTable(ComputeRootSignatureParams::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+
+    // The raytracing passes have already copied this frame's scene constants to the GPU
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(ComputeRootSignatureParams::ParamConstantBuffer, cbGpuAddress);
+    commandList->SetComputeRoot32BitConstants(ReprojectionRootSignatureParams::PrevCameraSlot, SizeOfInUint32(m_reprojectionCB), &m_reprojectionCB, 0);
+
+    commandList->Dispatch(xThreads, yThreads, zThreads);
+}
+
 void PhotonMajorRenderer::DoThirdPassPhotonMapping()
 {
     auto commandList = m_deviceResources->GetCommandList();
@@ -1625,9 +3021,9 @@ void PhotonMajorRenderer::DoThirdPassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
@@ -1730,6 +3126,13 @@ void PhotonMajorRenderer::CreateWindowSizeDependentResources()
     CreateRaytracingOutputResource();
     CreateStagingRenderTargetResource();
     CreateGBuffers();
+    m_photonBudget.Reset(m_gBufferHeight, PHOTON_BUDGET_MIN_ROWS);
+    CreateCausticGBuffers();
+    CreateVisiblePhotonBuffers();
+    CreateCameraDepthBuffer();
+    CreateSplatBuffers();
+    CreateTemporalBuffers();
+    CreateDenoiseBuffers();
     UpdateCameraMatrices();
 }
 
@@ -1742,6 +3145,22 @@ void PhotonMajorRenderer::ReleaseWindowSizeDependentResources()
     {
         gBuffer.textureResource.Reset();
     }
+    for (GBuffer gBuffer : m_causticGBuffers)
+    {
+        gBuffer.textureResource.Reset();
+    }
+    m_visiblePhotonList.textureResource.Reset();
+    m_visiblePhotonCount.textureResource.Reset();
+    m_cameraDepthBuffer.textureResource.Reset();
+    for (GBuffer* splatBuffer : { &m_splats, &m_splatSlots, &m_sortedSplats, &m_splatTileCounts, &m_splatTileOffsets, &m_splatAccum, &m_splatHistory, &m_cameraDepthHistory, &m_cameraNormal, &m_cameraAlbedo })
+    {
+        splatBuffer->textureResource.Reset();
+    }
+    m_denoiseColorReadback.Reset();
+    m_denoiseDepthReadback.Reset();
+    m_denoiseNormalReadback.Reset();
+    m_denoiseAlbedoReadback.Reset();
+    m_denoiseUpload.Reset();
 }
 
 // Release all resources that depend on the device.
@@ -1753,6 +3172,9 @@ void PhotonMajorRenderer::ReleaseDeviceDependentResources()
     m_fallbackFirstPassStateObject.Reset();
     m_fallbackSecondPassStateObject.Reset();
     m_fallbackThirdPassStateObject.Reset();
+    m_fallbackCausticPassStateObject.Reset();
+    m_fallbackCullPassStateObject.Reset();
+    m_fallbackDepthPassStateObject.Reset();
 
     m_firstPassGlobalRootSignature.Reset();
     m_firstPassLocalRootSignature.Reset();
@@ -1763,12 +3185,32 @@ void PhotonMajorRenderer::ReleaseDeviceDependentResources()
     m_thirdPassGlobalRootSignature.Reset();
     m_thirdPassLocalRootSignature.Reset();
 
+    m_causticPassGlobalRootSignature.Reset();
+    m_causticPassLocalRootSignature.Reset();
+
+    m_cullPassGlobalRootSignature.Reset();
+    m_cullPassLocalRootSignature.Reset();
+
+    m_depthPassGlobalRootSignature.Reset();
+    m_depthPassLocalRootSignature.Reset();
+
+    m_computeRootSignature.Reset();
+    m_computeSplatCountPSO.Reset();
+    m_computeSplatScanPSO.Reset();
+    m_computeSplatScatterPSO.Reset();
+    m_computeSplatResolvePSO.Reset();
+    m_computeReprojectPSO.Reset();
+    m_computeDensityGatherPSO.Reset();
+
     m_dxrDevice.Reset();
     m_dxrCommandList.Reset();
 
     m_dxrFirstPassStateObject.Reset();
     m_dxrSecondPassStateObject.Reset();
     m_dxrThirdPassStateObject.Reset();
+    m_dxrCausticPassStateObject.Reset();
+    m_dxrCullPassStateObject.Reset();
+    m_dxrDepthPassStateObject.Reset();
 
     m_descriptorHeap.Reset();
     m_descriptorsAllocated = 0;
@@ -1779,11 +3221,25 @@ void PhotonMajorRenderer::ReleaseDeviceDependentResources()
     {
         gBuffer.uavDescriptorHeapIndex = UINT_MAX;
     }
+    for (GBuffer gBuffer : m_causticGBuffers)
+    {
+        gBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    }
+    m_visiblePhotonList.uavDescriptorHeapIndex = UINT_MAX;
+    m_visiblePhotonCount.uavDescriptorHeapIndex = UINT_MAX;
+    m_cameraDepthBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    for (GBuffer* splatBuffer : { &m_splats, &m_splatSlots, &m_sortedSplats, &m_splatTileCounts, &m_splatTileOffsets, &m_splatAccum, &m_splatHistory, &m_cameraDepthHistory, &m_cameraNormal, &m_cameraAlbedo })
+    {
+        splatBuffer->uavDescriptorHeapIndex = UINT_MAX;
+    }
 
-    // TODO: Release Resources for vb, ib, scene, materials and lights
-    // TODO: Release Resources for blas/tlas
+    // Vertex, index and scene table buffers, BLASes and the TLAS
+    ReleaseSceneResources();
 
     m_perFrameConstants.Reset();
+    m_projectionMapCells.Reset();
+    m_timestampHeap.Reset();
+    m_timestampReadback.Reset();
 
     m_firstPassShaderTableRes.m_rayGenShaderTable.Reset();
     m_firstPassShaderTableRes.m_missShaderTable.Reset();
@@ -1797,8 +3253,17 @@ void PhotonMajorRenderer::ReleaseDeviceDependentResources()
     m_thirdPassShaderTableRes.m_missShaderTable.Reset();
     m_thirdPassShaderTableRes.m_hitGroupShaderTable.Reset();
 
-    m_topLevelAccelerationStructure.Reset();
+    m_causticPassShaderTableRes.m_rayGenShaderTable.Reset();
+    m_causticPassShaderTableRes.m_missShaderTable.Reset();
+    m_causticPassShaderTableRes.m_hitGroupShaderTable.Reset();
 
+    m_cullPassShaderTableRes.m_rayGenShaderTable.Reset();
+    m_cullPassShaderTableRes.m_missShaderTable.Reset();
+    m_cullPassShaderTableRes.m_hitGroupShaderTable.Reset();
+
+    m_depthPassShaderTableRes.m_rayGenShaderTable.Reset();
+    m_depthPassShaderTableRes.m_missShaderTable.Reset();
+    m_depthPassShaderTableRes.m_hitGroupShaderTable.Reset();
 }
 
 void PhotonMajorRenderer::RecreateD3D()
@@ -1815,6 +3280,12 @@ void PhotonMajorRenderer::RecreateD3D()
     m_deviceResources->HandleDeviceLost();
 }
 
+// Scene constant render flags for the current application state.
+UINT PhotonMajorRenderer::GetRenderFlags() const
+{
+    return (m_binnedSplatting ? RENDER_FLAG_BINNED_SPLAT : 0) | (m_densityGather ? RENDER_FLAG_DENSITY_GATHER : 0);
+}
+
 // Render the scene.
 void PhotonMajorRenderer::OnRender()
 {
@@ -1824,12 +3295,39 @@ void PhotonMajorRenderer::OnRender()
     }
 
     m_deviceResources->Prepare();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    bool tracePhotons = m_calculatePhotonMap || m_progressive;
+    UpdatePhotonBudget(tracePhotons);
+    WriteTimestamp(TimestampFrameBegin);
+
+    bool clearedAccumulation = m_calculatePhotonMap || m_clearStagingBuffers;
+    if (clearedAccumulation)
+    {
+        m_accumulatedBatches = 0;
+    }
+
+    // Every frame splats into the staging buffers again, on top of what they already hold.
+    // The number of photons splatted so far divides out here, so the resolve is a single multiply.
+    m_splattedPhotons = (clearedAccumulation ? 0 : m_splattedPhotons) + UINT64(m_splatPhotonRows) * m_gBufferWidth;
+    m_sceneCB[frameIndex].fluxToRadiance = DENSITY_EXPOSURE / (XM_PI * float(max(m_splattedPhotons, UINT64(1))));
 
-    if (m_calculatePhotonMap)
+    // Progressive mode traces a new batch of photons every frame and splats it on top of the running accumulation.
+    // Both resolves divide the summed colors by the summed weights, so every photon is weighted equally
+    // and batches of different budgets end up weighted by their photon counts.
+    if (tracePhotons)
     {
+        m_sceneCB[frameIndex].photonBatch = m_photonBatch++;
+        m_accumulatedBatches++;
 
         DoFirstPassPhotonMapping();
 
+        // Caustic photons are only traced when some light direction can reach specular geometry
+        if (m_projectionMapCells)
+        {
+            DoCausticPassPhotonMapping();
+        }
+
         // This is turned off for now, in order to test whether G Buffer was actually getting filled.
         //CopyRaytracingOutputToBackbuffer();
 
@@ -1840,10 +3338,17 @@ void PhotonMajorRenderer::OnRender()
         // This functions essentially prepares the G-Buffer for the second pass
         // CopyGBUfferToBackBuffer(0U);
 
-        DoPrePassPhotonMapping();
+        // The cull and splat passes read the new batch
+        D3D12_RESOURCE_BARRIER batchBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        m_deviceResources->GetCommandList()->ResourceBarrier(1, &batchBarrier);
 
-        m_calculatePhotonMap = false;
+        if (m_calculatePhotonMap)
+        {
+            DoPrePassPhotonMapping();
+            m_calculatePhotonMap = false;
+        }
     }
+    WriteTimestamp(TimestampEmissionEnd);
 
     if (m_clearStagingBuffers)
     {
@@ -1851,13 +3356,58 @@ void PhotonMajorRenderer::OnRender()
         m_clearStagingBuffers = false;
     }
 
+    // Nothing worth reprojecting survives a new photon map or a cleared accumulation
+    bool reprojectSplats = m_reprojectSplats && !clearedAccumulation;
+    m_reprojectSplats = false;
+    if (reprojectSplats)
+    {
+        SaveSplatHistory();
+    }
+
+    DoDepthPassPhotonMapping();
+
+    if (reprojectSplats)
+    {
+        DoComputePass(m_computeReprojectPSO, (m_width + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE, (m_height + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE, 1);
+        D3D12_RESOURCE_BARRIER reprojectBarrier = CD3DX12_RESOURCE_BARRIER::UAV(m_splatAccum.textureResource.Get());
+        m_deviceResources->GetCommandList()->ResourceBarrier(1, &reprojectBarrier);
+    }
+
+    WriteTimestamp(TimestampSplatBegin);
+    DoCullPassPhotonMapping();
     DoSecondPassPhotonMapping();
+    if (m_binnedSplatting)
+    {
+        DoBinnedSplatting();
+    }
+    WriteTimestamp(TimestampSplatEnd);
     DoThirdPassPhotonMapping();
+    if (!m_binnedSplatting && m_densityGather)
+    {
+        DoComputePass(m_computeDensityGatherPSO, (m_width + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE, (m_height + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE, 1);
+        D3D12_RESOURCE_BARRIER gatherBarrier = CD3DX12_RESOURCE_BARRIER::UAV(m_raytracingOutput.Get());
+        m_deviceResources->GetCommandList()->ResourceBarrier(1, &gatherBarrier);
+    }
+    WriteTimestamp(TimestampResolveEnd);
+
+    if (m_verifyFluxResolve)
+    {
+        VerifyFluxResolve();
+        m_verifyFluxResolve = false;
+    }
+
+    if (m_denoise)
+    {
+        DenoiseRaytracingOutput();
+    }
 
     CopyRaytracingOutputToBackbuffer();
     //CopyStagingBufferToBackBuffer();
     //CopyGBUfferToBackBuffer(0U);
 
+    WriteTimestamp(TimestampFrameEnd);
+    ResolveFrameTimestamps();
+
     m_deviceResources->Present(D3D12_RESOURCE_STATE_PRESENT);
 }
 
@@ -1921,7 +3471,24 @@ void PhotonMajorRenderer::CalculateFrameStats()
         windowText << setprecision(2) << fixed
             << L"    fps: " << fps << L"     ~Million Primary Rays/s: " << MRaysPerSecond
             << L"    GPU[" << m_deviceResources->GetAdapterID() << L"]: " << m_deviceResources->GetAdapterDescription()
-            << L"    # Photons " << NumPhotons;
+            << L"    # Photons " << m_splatPhotonRows * m_gBufferWidth
+            << (m_binnedSplatting ? L"    Binned splats" : (m_densityGather ? L"    Density gather" : L""));
+        if (m_photonBudget.IsEnabled())
+        {
+            const DXRPhotonMapper::PMPhotonBudget::FrameTiming& timing = m_photonBudget.GetLastTiming();
+            windowText << L"    Budget ms: emit " << timing.passMilliseconds[DXRPhotonMapper::PMPhotonBudget::PassEmission]
+                << L" splat " << timing.passMilliseconds[DXRPhotonMapper::PMPhotonBudget::PassSplat]
+                << L" resolve " << timing.passMilliseconds[DXRPhotonMapper::PMPhotonBudget::PassResolve]
+                << L" frame " << timing.frameMilliseconds;
+        }
+        if (m_progressive)
+        {
+            windowText << L"    Progressive: " << m_accumulatedBatches << L" batches";
+        }
+        if (m_denoise)
+        {
+            windowText << L"    Denoised: " << m_denoiseIterations << L" iterations, " << m_denoiser.GetLastFilterMilliseconds() << L" ms";
+        }
         SetCustomWindowText(windowText.str().c_str());
     }
 }
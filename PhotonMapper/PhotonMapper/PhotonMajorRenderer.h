@@ -4,6 +4,10 @@
 #include "StepTimer.h"
 #include "RaytracingHlslCompat.h"
 #include "Common.h"
+#include "PMProjectionMap.h"
+#include "PMDenoiser.h"
+#include "PMFluxResolve.h"
+#include "PMPhotonBudget.h"
 
 // The sample supports both Raytracing Fallback Layer and DirectX Raytracing APIs. 
 // This is purely for demonstration purposes to show where the API differences are. 
@@ -39,6 +43,37 @@ private:
     static const UINT NumRenderTargets = 1;
     static const UINT NumPhotons = 1000000;
 
+    // Caustic photons are only emitted through the projection map, so far fewer are needed
+    static const UINT NumCausticGBuffers = 2;
+    static const UINT NumCausticPhotons = 250000;
+
+    // Photons left after frustum and backface culling, and how many there are
+    static const UINT NumVisiblePhotonBuffers = 2;
+
+    // Camera depth and surface ID, used as the photon visibility test
+    static const UINT NumCameraDepthBuffers = 1;
+
+    // Splats, their bin slots, the tile sorted splats, per tile counts and offsets, and the float accumulation target
+    static const UINT NumSplatBuffers = 6;
+
+    // Accumulation and camera depth history for reprojection on camera motion
+    static const UINT NumTemporalBuffers = 2;
+
+    // GPU timestamps around the passes the photon budget measures
+    enum FrameTimestamp
+    {
+        TimestampFrameBegin = 0,
+        TimestampEmissionEnd,
+        TimestampSplatBegin,
+        TimestampSplatEnd,
+        TimestampResolveEnd,
+        TimestampFrameEnd,
+        NumFrameTimestamps
+    };
+
+    // Normal and albedo the camera sees, guiding the denoiser together with the camera depth
+    static const UINT NumDenoiseGuideBuffers = 2;
+
     bool cameraNeedsUpdate = false;
 
     // We'll allocate space for several of these and they will need to be padded for alignment.
@@ -58,12 +93,18 @@ private:
     ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackFirstPassStateObject;
     ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackSecondPassStateObject;
     ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackThirdPassStateObject;
+    ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackCausticPassStateObject;
+    ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackCullPassStateObject;
+    ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackDepthPassStateObject;
 
     // DXR Pipeline State Objects for different passes
     ComPtr<ID3D12StateObject> m_dxrPrePassStateObject;
     ComPtr<ID3D12StateObject> m_dxrFirstPassStateObject;
     ComPtr<ID3D12StateObject> m_dxrSecondPassStateObject;
     ComPtr<ID3D12StateObject> m_dxrThirdPassStateObject;
+    ComPtr<ID3D12StateObject> m_dxrCausticPassStateObject;
+    ComPtr<ID3D12StateObject> m_dxrCullPassStateObject;
+    ComPtr<ID3D12StateObject> m_dxrDepthPassStateObject;
 
     // Root signatures for the pre pass
     ComPtr<ID3D12RootSignature> m_prePassGlobalRootSignature;
@@ -81,6 +122,27 @@ private:
     ComPtr<ID3D12RootSignature> m_thirdPassGlobalRootSignature;
     ComPtr<ID3D12RootSignature> m_thirdPassLocalRootSignature;
 
+    // Root signatures for the caustic pass
+    ComPtr<ID3D12RootSignature> m_causticPassGlobalRootSignature;
+    ComPtr<ID3D12RootSignature> m_causticPassLocalRootSignature;
+
+    // Root signatures for the cull pass
+    ComPtr<ID3D12RootSignature> m_cullPassGlobalRootSignature;
+    ComPtr<ID3D12RootSignature> m_cullPassLocalRootSignature;
+
+    // Root signatures for the depth pass
+    ComPtr<ID3D12RootSignature> m_depthPassGlobalRootSignature;
+    ComPtr<ID3D12RootSignature> m_depthPassLocalRootSignature;
+
+    // Compute pipeline for binned splatting
+    ComPtr<ID3D12RootSignature> m_computeRootSignature;
+    ComPtr<ID3D12PipelineState> m_computeSplatCountPSO;
+    ComPtr<ID3D12PipelineState> m_computeSplatScanPSO;
+    ComPtr<ID3D12PipelineState> m_computeSplatScatterPSO;
+    ComPtr<ID3D12PipelineState> m_computeSplatResolvePSO;
+    ComPtr<ID3D12PipelineState> m_computeReprojectPSO;
+    ComPtr<ID3D12PipelineState> m_computeDensityGatherPSO;
+
     // Raytracing scene
     SceneConstantBuffer m_sceneCB[FrameCount];
     CubeConstantBuffer m_cubeCB;
@@ -91,6 +153,67 @@ private:
 
     std::vector<GBuffer> m_gBuffers;
     std::vector<GBuffer> m_stagingBuffers;
+
+    // Caustic map
+    UINT m_causticBufferWidth;
+    UINT m_causticBufferHeight;
+    std::vector<GBuffer> m_causticGBuffers;
+
+    // Visible photon list
+    GBuffer m_visiblePhotonList;
+    GBuffer m_visiblePhotonCount;
+
+    // Camera depth buffer
+    GBuffer m_cameraDepthBuffer;
+
+    // Binned splatting
+    GBuffer m_splats;
+    GBuffer m_splatSlots;
+    GBuffer m_sortedSplats;
+    GBuffer m_splatTileCounts;
+    GBuffer m_splatTileOffsets;
+    GBuffer m_splatAccum;
+
+    // Temporal reuse
+    GBuffer m_splatHistory;
+    GBuffer m_cameraDepthHistory;
+    ReprojectionConstantBuffer m_reprojectionCB;
+
+    // Denoising
+    GBuffer m_cameraNormal;
+    GBuffer m_cameraAlbedo;
+    ComPtr<ID3D12Resource> m_denoiseColorReadback;
+    ComPtr<ID3D12Resource> m_denoiseDepthReadback;
+    ComPtr<ID3D12Resource> m_denoiseNormalReadback;
+    ComPtr<ID3D12Resource> m_denoiseAlbedoReadback;
+    ComPtr<ID3D12Resource> m_denoiseUpload;
+    DXRPhotonMapper::PMDenoiser m_denoiser;
+
+    // One subresource of a texture copied into a readback buffer
+    struct ReadbackCopy
+    {
+        ID3D12Resource* texture;
+        ID3D12Resource* readback;
+        UINT subresource;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        UINT8* data;
+    };
+
+    // CPU reference of the staging buffer resolve
+    DXRPhotonMapper::PMFluxResolve m_fluxResolve;
+
+    // Adaptive photon budget, fed by one set of timestamps per frame in flight.
+    // A frame's timestamps are read back when its frame index comes around again, so reading them never stalls.
+    ComPtr<ID3D12QueryHeap> m_timestampHeap;
+    ComPtr<ID3D12Resource> m_timestampReadback;
+    UINT64 m_timestampFrequency;
+    DXRPhotonMapper::PMPhotonBudget m_photonBudget;
+    DXRPhotonMapper::PMPhotonBudget::FrameTiming m_frameTimings[FrameCount];
+    bool m_frameTimingPending[FrameCount];
+
+    // Projection map for the light, uploaded as the list of its active cells
+    DXRPhotonMapper::PMProjectionMap m_projectionMap;
+    ComPtr<ID3D12Resource> m_projectionMapCells;
     
     // Raytracing output
     ComPtr<ID3D12Resource> m_raytracingOutput;
@@ -105,6 +228,13 @@ private:
     static const wchar_t* c_closestHitShaderName;
     static const wchar_t* c_missShaderName;
 
+    static const LPCWSTR c_computeShaderSplatCount;
+    static const LPCWSTR c_computeShaderSplatScan;
+    static const LPCWSTR c_computeShaderSplatScatter;
+    static const LPCWSTR c_computeShaderSplatResolve;
+    static const LPCWSTR c_computeShaderReproject;
+    static const LPCWSTR c_computeShaderDensityGather;
+
     struct ShaderTableRes
     {
         ComPtr<ID3D12Resource> m_missShaderTable;
@@ -116,11 +246,26 @@ private:
     ShaderTableRes m_firstPassShaderTableRes;
     ShaderTableRes m_secondPassShaderTableRes;
     ShaderTableRes m_thirdPassShaderTableRes;
+    ShaderTableRes m_causticPassShaderTableRes;
+    ShaderTableRes m_cullPassShaderTableRes;
+    ShaderTableRes m_depthPassShaderTableRes;
 
     // Application state
     bool m_forceComputeFallback;
     bool m_calculatePhotonMap;
     bool m_clearStagingBuffers;
+    bool m_binnedSplatting;
+    bool m_densityGather;
+    bool m_reprojectSplats;
+    bool m_denoise;
+    bool m_progressive;
+    bool m_verifyFluxResolve;
+    UINT m_photonBatch;
+    UINT m_accumulatedBatches;
+    UINT64 m_splattedPhotons;
+    UINT m_tracedPhotonRows;
+    UINT m_splatPhotonRows;
+    UINT m_denoiseIterations;
     StepTimer m_timer;
     float m_curRotationAngleRad;
     XMVECTOR m_eye;
@@ -137,8 +282,22 @@ private:
     void DoFirstPassPhotonMapping();
     void DoSecondPassPhotonMapping();
     void DoThirdPassPhotonMapping();
+    void DoCausticPassPhotonMapping();
+    void DoCullPassPhotonMapping();
+    void DoDepthPassPhotonMapping();
+    void DoBinnedSplatting();
+    void SaveSplatHistory();
+    void DenoiseRaytracingOutput();
+    void VerifyFluxResolve();
+    void ReadBackTextures(ReadbackCopy* copies, UINT numCopies);
+    void UnmapReadbacks(ReadbackCopy* copies, UINT numCopies);
+    void DoComputePass(ComPtr<ID3D12PipelineState>& computePSO, UINT xThreads, UINT yThreads, UINT zThreads);
+    void WriteTimestamp(FrameTimestamp timestamp);
+    void ResolveFrameTimestamps();
+    void UpdatePhotonBudget(bool tracePhotons);
 
     void CreateConstantBuffers();
+    void CreateTimestampQueries();
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
     void ReleaseDeviceDependentResources();
@@ -150,6 +309,9 @@ private:
     void CreateFirstPassRootSignatures();
     void CreateSecondPassRootSignatures();
     void CreateThirdPassRootSignatures();
+    void CreateCausticPassRootSignatures();
+    void CreateCullPassRootSignatures();
+    void CreateDepthPassRootSignatures();
 
     void CreateLocalRootSignatureSubobjects(CD3D12_STATE_OBJECT_DESC* raytracingPipeline, ComPtr<ID3D12RootSignature>* rootSig);
 
@@ -157,6 +319,12 @@ private:
     void CreateFirstPassPhotonPipelineStateObject();
     void CreateSecondPassPhotonPipelineStateObject();
     void CreateThirdPassPhotonPipelineStateObject();
+    void CreateCausticPassPhotonPipelineStateObject();
+    void CreateCullPassPhotonPipelineStateObject();
+    void CreateDepthPassPhotonPipelineStateObject();
+
+    void CreateComputeRootSignature();
+    void CreateComputePipelineStateObject(const LPCWSTR& compiledShaderName, ComPtr<ID3D12PipelineState>& computePipeline);
 
     void CreateDescriptorHeap();
 
@@ -164,12 +332,27 @@ private:
     void CreateRaytracingOutputResource();
     void CreateStagingRenderTargetResource();
     void CreateGBuffers();
+    void CreateCausticGBuffers();
+    void CreateVisiblePhotonBuffers();
+    void CreateCameraDepthBuffer();
+    void CreateSplatBuffers();
+    void CreateTemporalBuffers();
+    void CreateDenoiseBuffers();
+    void CreateCopyBuffer(ComPtr<ID3D12Resource>& buffer, ID3D12Resource* texture, D3D12_HEAP_TYPE heapType);
+    void CreateScreenTexture(GBuffer& gBuffer, DXGI_FORMAT format);
+    void CreateStructuredBuffer(GBuffer& gBuffer, UINT numElements, UINT elementSize);
+
+    // Projection map of the directions from the light that reach specular geometry
+    void BuildProjectionMap();
 
     // Construction of Shader tables
     void BuildPrePassShaderTables();
     void BuildFirstPassShaderTables();
     void BuildSecondPassShaderTables();
     void BuildThirdPassShaderTables();
+    void BuildCausticPassShaderTables();
+    void BuildCullPassShaderTables();
+    void BuildDepthPassShaderTables();
 
     void SelectRaytracingAPI(RaytracingAPI type);
     void UpdateForSizeChange(UINT clientWidth, UINT clientHeight);
@@ -177,4 +360,5 @@ private:
     void CopyStagingBufferToBackBuffer();
     void CopyGBufferToBackBuffer(UINT gbufferIndex);
     void CalculateFrameStats();
+    UINT GetRenderFlags() const;
 };
@@ -3,34 +3,44 @@
 
 #define HLSL
 #include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+#include "FluxAccumulation.hlsli"
 
 // Render Target for visualizing the photons - can be removed later on
 RWTexture2D<float4> RenderTarget : register(u0);
 
-RWTexture2D<uint> StagedRenderTarget_R : register(u1);
-RWTexture2D<uint> StagedRenderTarget_G : register(u2);
-RWTexture2D<uint> StagedRenderTarget_B : register(u3);
-RWTexture2D<uint> StagedRenderTarget_A : register(u4);
-
 // G-Buffers
 RWTexture2DArray<float4> GPhotonPos : register(u5);
 RWTexture2DArray<float4> GPhotonColor : register(u6);
 RWTexture2DArray<float4> GPhotonNorm : register(u7);
 RWTexture2DArray<float4> GPhotonTangent : register(u8);
 
+// Caustic map
+RWTexture2D<float4> GCausticPos : register(u9);
+RWTexture2D<float4> GCausticColor : register(u10);
+
+// Photons that survived culling, x is the packed G-Buffer texel and y the layer
+RWStructuredBuffer<uint2> GVisiblePhotons : register(u11);
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
+// Camera depth and surface ID per pixel, written by the depth pass
+RWTexture2D<float2> GCameraDepth : register(u13);
+
 RaytracingAccelerationStructure Scene : register(t0, space0);
 ByteAddressBuffer Indices[] : register(t0, space1);
 StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
 
 
+static const float PI = 3.1415926535897932384626422832795028841971f;
+
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
 
 struct RayPayload
@@ -55,7 +65,10 @@ inline void GetPixelPosition(float3 rayHitPosition, float2 screenDim, out uint2
 }
 
 
-void TraceRayToCamera(float4 hitPosition, float2 screenDims, out bool didHit, out uint2 pixelHit)
+// The depth pass settles most photons: on the surface the pixel sees and at its depth is visible,
+// behind a different surface is hidden. Only the rest pay for a shadow ray, e.g. a concave mesh
+// folding over itself, two surfaces touching, or a pixel center that misses the photon's surface.
+void TraceRayToCamera(float4 hitPosition, uint surfaceId, float2 screenDims, out bool didHit, out uint2 pixelHit)
 {
     // Find the Screen Space Coord for the photon
     uint2 pixelPos = uint2(500, 500);
@@ -69,6 +82,25 @@ void TraceRayToCamera(float4 hitPosition, float2 screenDims, out bool didHit, ou
         return;
     }
 
+    pixelHit = pixelPos;
+
+    float2 cameraDepth = GCameraDepth[pixelPos];
+    float photonDepth = length(g_sceneCB.cameraPosition.xyz - hitPosition.xyz);
+    float tolerance = CAMERA_DEPTH_TOLERANCE * photonDepth;
+    bool sameSurface = (uint(cameraDepth.y) == surfaceId);
+
+    if (sameSurface && abs(photonDepth - cameraDepth.x) <= tolerance)
+    {
+        didHit = true;
+        return;
+    }
+
+    if (!sameSurface && photonDepth > cameraDepth.x + tolerance)
+    {
+        didHit = false;
+        return;
+    }
+
     // Shadow Ray.
     RayDesc ray;
     ray.Origin = hitPosition;
@@ -88,99 +120,120 @@ void TraceRayToCamera(float4 hitPosition, float2 screenDims, out bool didHit, ou
     int shadowHit = extraInfo[0];
 
     didHit = (shadowHit == 0);
-    pixelHit = pixelPos;
 }
 
 
-inline void VisualizePhoton(float4 hitPosition, float4 photonColor, float4 photonNorm, float4 photonTangent, float2 screenDims)
+// Screen position of a point in pixels, unlike GetPixelPosition it keeps the fraction
+inline float2 ProjectToScreen(float3 position, float2 screenDims)
 {
-    // Base Trace
-    bool didHit = false;
-    uint2 centerPixelPos;
-    TraceRayToCamera(hitPosition, screenDims, didHit, centerPixelPos);
+    float4 clippingCoord = mul(float4(position, 1), g_sceneCB.viewProj);
+    clippingCoord.xy /= clippingCoord.w;
 
-    if (didHit)
-    {
-        // Write the raytraced color to the output texture.
+    return float2((clippingCoord.x + 1.0) * 0.5f, (1.0 - clippingCoord.y) * 0.5f) * screenDims;
+}
 
-        uint3 scaledColor = photonColor.xyz * 255.f;
-        uint4 newColorValue = float4(scaledColor, 1);
+// Projects a disk of PHOTON_SPLAT_RADIUS around the photon, lying in its surface, to a screen space ellipse.
+// No rays are traced, the footprint only follows the surface orientation and the distance to the camera.
+inline SplatRecord MakeSplat(float3 position, float3 normal, float3 color, float2 screenDims)
+{
+    SplatRecord splat;
+    splat.center = ProjectToScreen(position, screenDims);
+    splat.pixel = PackSplatPixel(min(uint2(splat.center), uint2(screenDims) - 1));
+    splat.color = color;
+    splat.padding = 0.0f;
 
-        InterlockedAdd(StagedRenderTarget_R[centerPixelPos], newColorValue[0]);
-        InterlockedAdd(StagedRenderTarget_G[centerPixelPos], newColorValue[1]);
-        InterlockedAdd(StagedRenderTarget_B[centerPixelPos], newColorValue[2]);
-        InterlockedAdd(StagedRenderTarget_A[centerPixelPos], newColorValue[3]);
-    }
+    // Caustic photons keep no normal, their disk faces the camera
+    float3 n = (dot(normal, normal) > 0.0f) ? normalize(normal) : normalize(g_sceneCB.cameraPosition.xyz - position);
 
-    /*
-    // TODO: This is a crude sampling code. Need to see if we can improve it. It is reducing the performing by a factor of 3 though
+    // The disk is round, so any tangent frame in the surface projects to the same ellipse
+    float3 t = normalize(cross(n, (abs(n.y) < 0.99f) ? float3(0, 1, 0) : float3(1, 0, 0)));
+    float3 b = cross(n, t);
 
-    float4 normalizedTangent = float4(normalize(photonTangent).xyz, 1.0);
+    float2 axisT = ProjectToScreen(position + PHOTON_SPLAT_RADIUS * t, screenDims) - splat.center;
+    float2 axisB = ProjectToScreen(position + PHOTON_SPLAT_RADIUS * b, screenDims) - splat.center;
 
-    // Sample 1 Trace
-    bool didHit1 = false;
-    uint2 centerPixelPos1;
-    float4 newHitPos1 = hitPosition + normalizedTangent * SEARCH_RADIUS;
-    TraceRayToCamera(newHitPos1, screenDims, didHit1, centerPixelPos1);
+    // The resolve only looks as far as the neighbouring tiles
+    axisT *= min(1.0f, SPLAT_TILE_SIZE / max(length(axisT), 0.0001f));
+    axisB *= min(1.0f, SPLAT_TILE_SIZE / max(length(axisB), 0.0001f));
 
-    if (didHit1 && didHit)
+    // An ellipse thinner than a pixel could miss every pixel center, it goes to the center pixel instead
+    float det = axisT.x * axisB.y - axisB.x * axisT.y;
+    if (abs(det) < 0.5f * max(length(axisT), length(axisB)))
     {
-        // Write the raytraced color to the output texture.
-
-        uint3 scaledColor1 = photonColor.xyz * 255.f * 0.5f;
-        uint4 newColorValue1 = float4(scaledColor1, 1);
-
-        InterlockedAdd(StagedRenderTarget_R[centerPixelPos1], newColorValue1[0]);
-        InterlockedAdd(StagedRenderTarget_G[centerPixelPos1], newColorValue1[1]);
-        InterlockedAdd(StagedRenderTarget_B[centerPixelPos1], newColorValue1[2]);
-        InterlockedAdd(StagedRenderTarget_A[centerPixelPos1], newColorValue1[3]);
+        splat.footprint = float4(0.0f, 0.0f, 0.0f, 0.0f);
+        splat.normalization = 1.0f;
+        return splat;
     }
 
+    // The kernel (1 - r^2) integrates to pi / 2 over the unit disk, the ellipse scales that by |det|
+    splat.footprint = float4(axisB.y, -axisB.x, -axisT.y, axisT.x) / det;
+    splat.normalization = 2.0f / (PI * abs(det));
+    return splat;
+}
 
-    // Sample 2 Trace
-    bool didHit2 = false;
-    uint2 centerPixelPos2;
-    float4 newHitPos2 = hitPosition - normalizedTangent * SEARCH_RADIUS;
-    TraceRayToCamera(newHitPos2, screenDims, didHit2, centerPixelPos2);
+inline void VisualizePhoton(uint splat, float4 hitPosition, uint surfaceId, float4 photonColor, float4 photonNorm, float fluxWeight, float2 screenDims)
+{
+    // Base Trace
+    bool didHit = false;
+    uint2 centerPixelPos;
+    TraceRayToCamera(hitPosition, surfaceId, screenDims, didHit, centerPixelPos);
 
-    if (didHit2 && didHit)
+    if (g_sceneCB.renderFlags & RENDER_FLAG_BINNED_SPLAT)
     {
-        // Write the raytraced color to the output texture.
-
-        uint3 scaledColor2 = photonColor.xyz * 255.f * 0.5f;
-        uint4 newColorValue2 = float4(scaledColor2, 1);
-
-        InterlockedAdd(StagedRenderTarget_R[centerPixelPos2], newColorValue2[0]);
-        InterlockedAdd(StagedRenderTarget_G[centerPixelPos2], newColorValue2[1]);
-        InterlockedAdd(StagedRenderTarget_B[centerPixelPos2], newColorValue2[2]);
-        InterlockedAdd(StagedRenderTarget_A[centerPixelPos2], newColorValue2[3]);
+        // Every entry is written, the binning passes walk the whole visible photon list
+        SplatRecord splatData = MakeSplat(hitPosition.xyz, photonNorm.xyz, photonColor.xyz, screenDims);
+        if (!didHit)
+        {
+            splatData.pixel = SPLAT_INVALID_PIXEL;
+        }
+        GSplats[splat] = splatData;
+    }
+    else if (didHit)
+    {
+        // The photon's flux, the resolve turns the sum into a density over the pixel's footprint
+        AddFlux(centerPixelPos, photonColor.xyz * fluxWeight);
     }
-
-    */
-
 }
 
 [shader("raygeneration")]
 void MyRaygenShader()
 {
-    for (int i = 0; i < MAX_RAY_RECURSION_DEPTH; ++i)
-    {
-        uint3 g_index = uint3(DispatchRaysIndex().xy, i);
+    uint width, height;
+    RenderTarget.GetDimensions(width, height);
+    float2 screenDims = float2(width, height);
 
-        float4 photonPos = float4(GPhotonPos[g_index].xyz, 1.0);
-        float4 photonCol = GPhotonColor[g_index];
-        float4 photonNorm = GPhotonNorm[g_index];
-        float4 photonTangent = GPhotonTangent[g_index];
+    uint gBufferWidth, gBufferHeight, gBufferDepth;
+    GPhotonPos.GetDimensions(gBufferWidth, gBufferHeight, gBufferDepth);
 
-        bool didPhotonIntersect = GPhotonPos[g_index].w > 0.0f;
+    // Only the photons the cull pass kept, strided over the threads of the dispatch
+    uint numVisiblePhotons = GVisiblePhotonCount[0];
+    uint numThreads = DispatchRaysDimensions().x * DispatchRaysDimensions().y;
+    uint photon = DispatchRaysIndex().x + DispatchRaysIndex().y * DispatchRaysDimensions().x;
 
-        if (didPhotonIntersect)
-        {
-            uint width, height;
-            RenderTarget.GetDimensions(width, height);
-            float2 screenDims = float2(width, height);
+    for (; photon < numVisiblePhotons; photon += numThreads)
+    {
+        uint2 entry = GVisiblePhotons[photon];
+        uint3 g_index = uint3(entry.x & 0xffff, entry.x >> 16, entry.y);
 
-            VisualizePhoton(photonPos, photonCol, photonNorm, photonTangent, screenDims);
+        if (g_index.z < gBufferDepth)
+        {
+            float4 photonPos = float4(GPhotonPos[g_index].xyz, 1.0);
+            float4 photonNorm = GPhotonNorm[g_index];
+            VisualizePhoton(photon, photonPos, uint(photonNorm.w), GPhotonColor[g_index], photonNorm, 1.0f, screenDims);
+        }
+        else
+        {
+            // The caustic map sits behind the last photon layer
+            float4 causticPos = GCausticPos[g_index.xy];
+            uint causticSurface = uint(causticPos.w);
+            causticPos.w = 1.0;
+            float4 causticCol = float4(GCausticColor[g_index.xy].xyz, 1.0);
+
+            // Caustic photons share the projection map's coverage of the light between fewer photons than the budget splats
+            uint causticWidth, causticHeight;
+            GCausticPos.GetDimensions(causticWidth, causticHeight);
+            float causticFluxWeight = GCausticColor[g_index.xy].w * float(gBufferWidth * g_sceneCB.photonRows) / float(causticWidth * causticHeight);
+            VisualizePhoton(photon, causticPos, causticSurface, causticCol, float4(0, 0, 0, 0), causticFluxWeight, screenDims);
         }
     }
 }
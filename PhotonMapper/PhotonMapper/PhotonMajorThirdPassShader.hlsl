@@ -3,29 +3,34 @@
 
 #define HLSL
 #include "RaytracingHlslCompat.h"
+#include "SplatBins.hlsli"
+#include "FluxAccumulation.hlsli"
 
 // Render Target for visualizing the photons - can be removed later on
 RWTexture2D<float4> RenderTarget : register(u0);
 
-RWTexture2D<uint> StagedRenderTarget_R : register(u1);
-RWTexture2D<uint> StagedRenderTarget_G : register(u2);
-RWTexture2D<uint> StagedRenderTarget_B : register(u3);
-RWTexture2D<uint> StagedRenderTarget_A : register(u4);
-
 // G-Buffers
 RWTexture2DArray<float4> GPhotonPos : register(u5);
 RWTexture2DArray<float4> GPhotonColor : register(u6);
 RWTexture2DArray<float4> GPhotonNorm : register(u7);
 RWTexture2DArray<float4> GPhotonTangent : register(u8);
 
+// Photons that survived culling, x is the packed G-Buffer texel and y the layer
+RWStructuredBuffer<uint2> GVisiblePhotons : register(u11);
+RWStructuredBuffer<uint> GVisiblePhotonCount : register(u12);
+
+// Camera depth and normal, the density estimate spreads the staged flux over the surface a pixel sees
+RWTexture2D<float2> GCameraDepth : register(u13);
+RWTexture2D<float4> GCameraNormal : register(u22);
+
 RaytracingAccelerationStructure Scene : register(t0, space0);
 ByteAddressBuffer Indices[] : register(t0, space1);
 StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
@@ -42,15 +47,39 @@ void MyRaygenShader()
 {
     uint2 index = uint2(DispatchRaysIndex().xy);
 
-    float channel_r = StagedRenderTarget_R[index];
-    float channel_g = StagedRenderTarget_G[index];
-    float channel_b = StagedRenderTarget_B[index];
-    uint channel_a = StagedRenderTarget_A[index];
+    // The splat pass has consumed the visible photon list, the next frame's cull pass starts a new one
+    if (index.x == 0 && index.y == 0)
+    {
+        GVisiblePhotonCount[0] = 0;
+    }
+
+    // Resolving a tile reads its neighbours' bins too, so bins are only emptied once every tile is resolved
+    if (index.x % SPLAT_TILE_SIZE == 0 && index.y % SPLAT_TILE_SIZE == 0)
+    {
+        GSplatTileCounts[SplatTileIndex(index)] = 0;
+    }
+
+    if (g_sceneCB.renderFlags & RENDER_FLAG_BINNED_SPLAT)
+    {
+        float4 accum = GSplatAccum[index];
+        RenderTarget[index] = (accum.w > 0.0f) ? float4(accum.xyz / accum.w, 1.0) : float4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // The density gather pass resolves the staged flux of whole tiles instead
+    if (g_sceneCB.renderFlags & RENDER_FLAG_DENSITY_GATHER)
+    {
+        return;
+    }
 
-    if (channel_a > 0)
+    float2 cameraDepth = GCameraDepth[index];
+    if (StagedRenderTarget_A[uint3(index, 0)] > 0 && cameraDepth.y != 0.0f)
     {
-        float3 avgColor = float3(channel_r, channel_g, channel_b) / (channel_a * 255.f);
-        RenderTarget[index] = float4(avgColor, 1.0);
+        uint width, height;
+        RenderTarget.GetDimensions(width, height);
+        float3 radiance = ResolveFlux(index, float2(width, height), g_sceneCB.projectionToWorld, g_sceneCB.cameraPosition.xyz,
+            cameraDepth.x, GCameraNormal[index].xyz, g_sceneCB.fluxToRadiance);
+        RenderTarget[index] = float4(radiance, 1.0);
     }
     else
     {
@@ -19,6 +19,8 @@ RWTexture2DArray<float4> GPhotonColor : register(u5);
 RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
 RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
 
+RWTexture2D<uint> GImportance : register(u8);
+
 ConstantBuffer<PixelMajorComputeConstantBuffer> CKernelParams : register(b0);
 
 // Zero out the initial buffer
@@ -28,6 +30,12 @@ void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid
     GPhotonCount[DTid] = 0;
     GPhotonScan[DTid] = 0;
     GPhotonTempIndex[DTid] = 0;
+
+    // The importance map is a single slice, much smaller than the cell grid
+    if (DTid.z == 0 && DTid.x < PROJECTION_MAP_THETA_RES && DTid.y < PROJECTION_MAP_PHI_RES)
+    {
+        GImportance[DTid.xy] = 0;
+    }
     
     // Debug
 	/*
@@ -0,0 +1,37 @@
+#ifndef COMPUTE_PASS_4
+#define COMPUTE_PASS_4
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+#define blocksize 128
+
+// Irradiance cache, see IrradianceCache.hlsli
+RWStructuredBuffer<IrradianceCacheRecord> IrradianceCacheRecords : register(u9);
+RWStructuredBuffer<uint> IrradianceCacheHeads : register(u10);
+RWStructuredBuffer<uint> IrradianceCacheCounter : register(u11);
+
+ConstantBuffer<PixelMajorComputeConstantBuffer> CKernelParams : register(b0);
+
+// Empty the irradiance cache, records depend on the photon map and are dropped whenever it is rebuilt
+[numthreads(blocksize, 1, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    if (DTid.x < IRRADIANCE_CACHE_HASH_SIZE)
+    {
+        IrradianceCacheHeads[DTid.x] = IRRADIANCE_CACHE_INVALID;
+    }
+
+    if (DTid.x < IRRADIANCE_CACHE_MAX_RECORDS)
+    {
+        IrradianceCacheRecords[DTid.x].next = IRRADIANCE_CACHE_INVALID;
+        IrradianceCacheRecords[DTid.x].passIndex = IRRADIANCE_CACHE_INVALID;
+    }
+
+    if (DTid.x == 0)
+    {
+        IrradianceCacheCounter[0] = 0;
+    }
+}
+
+#endif // COMPUTE_PASS_4
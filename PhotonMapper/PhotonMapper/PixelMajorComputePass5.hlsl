@@ -0,0 +1,87 @@
+#ifndef COMPUTE_PASS_5
+#define COMPUTE_PASS_5
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+#define blocksize 128
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// G-Buffers
+RWTexture2DArray<uint> GPhotonCount : register(u1);
+RWTexture2DArray<uint> GPhotonScan : register(u2);
+RWTexture2DArray<uint> GPhotonTempIndex : register(u3);
+
+RWTexture2DArray<float4> GPhotonPos : register(u4);
+RWTexture2DArray<float4> GPhotonColor : register(u5);
+RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
+RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
+
+#include "RadiancePhotons.hlsli"
+
+ConstantBuffer<PixelMajorComputeConstantBuffer> CKernelParams : register(b0);
+
+static const float PI = 3.1415926535897932384626422832795028841971f;
+
+// Radiance photon pass (Christensen)
+// Runs once the photons are sorted. Each radiance photon gets the density estimate at its own position,
+// so the final pass and the gather rays can read it back instead of summing photons again.
+[numthreads(blocksize, 1, 1)]
+void CSMain(uint3 Gid : SV_GroupID, uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint3 lastCell = uint3(NUM_CELLS_IN_X - 1, NUM_CELLS_IN_Y - 1, NUM_CELLS_IN_Z - 1);
+    uint numStoredPhotons = GPhotonScan[lastCell] + GPhotonCount[lastCell];
+
+    uint photonId = DTid.x * RADIANCE_PHOTON_STRIDE;
+    if (photonId >= numStoredPhotons)
+    {
+        return;
+    }
+
+    uint3 index = RadiancePhotonIndex(photonId);
+    float3 position = GPhotonSortedPos[index].xyz;
+
+    uint cellIdX = floor(POS_TO_CELL_X(position.x));
+    uint cellIdY = floor(POS_TO_CELL_Y(position.y));
+    uint cellIdZ = floor(POS_TO_CELL_Z(position.z));
+    uint3 cellId = uint3(cellIdX, cellIdY, cellIdZ);
+
+    float3 color = float3(0.0, 0.0, 0.0);
+    int radius = ceil(PIXEL_MAJOR_PHOTON_CLOSENESS / CELL_SIZE) + 1;
+
+    for (int z = -radius; z < radius; ++z)
+    {
+        for (int y = -radius; y < radius; ++y)
+        {
+            for (int x = -radius; x < radius; ++x)
+            {
+                uint3 currCell = cellId + uint3(x, y, z);
+                currCell = clamp(currCell, uint3(0, 0, 0), lastCell);
+
+                int photon = GPhotonScan[currCell];
+                uint end = photon + GPhotonCount[currCell];
+                for (photon; photon < end; ++photon)
+                {
+                    uint3 neighbour = RadiancePhotonIndex(photon);
+                    float3 distVec = position - GPhotonSortedPos[neighbour].xyz;
+                    if (dot(distVec, distVec) < PIXEL_MAJOR_PHOTON_CLOSENESS_SQUARED)
+                    {
+                        color += GPhotonSortedCol[neighbour].xyz;
+                    }
+                }
+            }
+        }
+    }
+
+    // Same estimate as GatherIndirectRadiance in the final pass
+    uint width, height, depth;
+    GPhotonPos.GetDimensions(width, height, depth);
+    float numEmittedPhotons = width * height;
+    float3 radiance = color * (4.0f * POINT_LIGHT_INTENSITY) / (numEmittedPhotons * PI * PIXEL_MAJOR_PHOTON_CLOSENESS_SQUARED);
+
+    GRadiancePhotons[index] = float4(radiance, 1.0f);
+}
+
+#endif // COMPUTE_PASS_5
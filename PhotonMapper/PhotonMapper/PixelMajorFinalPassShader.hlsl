@@ -29,91 +29,22 @@ RWTexture2DArray<float4> GPhotonColor : register(u5);
 RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
 RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
 
+#include "IrradianceCache.hlsli"
+#include "RadiancePhotons.hlsli"
+
 RaytracingAccelerationStructure Scene : register(t0, space0);
 ByteAddressBuffer Indices[] : register(t0, space1);
 StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
 
-// Load three 16 bit indices from a byte addressed buffer.
-uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
-{
-	uint3 indices;
-
-	// ByteAdressBuffer loads must be aligned at a 4 byte boundary.
-	// Since we need to read three 16 bit indices: { 0, 1, 2 } 
-	// aligned at a 4 byte boundary as: { 0 1 } { 2 0 } { 1 2 } { 0 1 } ...
-	// we will load 8 bytes (~ 4 indices { a b | c d }) to handle two possible index triplet layouts,
-	// based on first index's offsetBytes being aligned at the 4 byte boundary or not:
-	//  Aligned:     { 0 1 | 2 - }
-	//  Not aligned: { - 0 | 1 2 }
-	const uint dwordAlignedOffset = offsetBytes & ~3;
-	const uint2 four16BitIndices = Indices[geomOffset].Load2(dwordAlignedOffset);
-
-	// Aligned: { 0 1 | 2 - } => retrieve first three 16bit indices
-	if (dwordAlignedOffset == offsetBytes)
-	{
-		indices.x = four16BitIndices.x & 0xffff;
-		indices.y = (four16BitIndices.x >> 16) & 0xffff;
-		indices.z = four16BitIndices.y & 0xffff;
-	}
-	else // Not aligned: { - 0 | 1 2 } => retrieve last three 16bit indices
-	{
-		indices.x = (four16BitIndices.x >> 16) & 0xffff;
-		indices.y = four16BitIndices.y & 0xffff;
-		indices.z = (four16BitIndices.y >> 16) & 0xffff;
-	}
-
-	return indices;
-}
-
-typedef BuiltInTriangleIntersectionAttributes MyAttributes;
-struct RayPayload
-{
-	float4 color;
-	float4 hitPosition;
-	float4 extraInfo; // [0] is shadowHit, [1] is bounce depth
-	float3 throughput;
-	float3 direction;
-};
-
-// Retrieve hit world position.
-float3 HitWorldPosition()
-{
-	return WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
-}
-
-// Retrieve attribute at a hit position interpolated from vertex attributes using the hit's barycentrics.
-float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttributes attr)
-{
-	return vertexAttribute[0] +
-		attr.barycentrics.x * (vertexAttribute[1] - vertexAttribute[0]) +
-		attr.barycentrics.y * (vertexAttribute[2] - vertexAttribute[0]);
-}
-
-// Generate a ray in world space for a camera pixel corresponding to an index from the dispatched 2D grid.
-inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction)
-{
-	float2 xy = index + 0.5f; // center in the middle of the pixel.
-	float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0;
-
-	// Invert Y for DirectX-style coordinates.
-	screenPos.y = -screenPos.y;
-
-	// Unproject the pixel coordinate into a ray.
-	float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
-
-	world.xyz /= world.w;
-	origin = g_sceneCB.cameraPosition.xyz;
-	direction = normalize(world.xyz - origin);
-}
-
+#include "PixelMajorLighting.hlsli"
 
 
 inline void GetPixelPosition(float3 rayHitPosition, float2 screenDim, out uint2 pixelIndex, out bool inRange)
@@ -131,13 +62,6 @@ inline void GetPixelPosition(float3 rayHitPosition, float2 screenDim, out uint2
 	pixelIndex.y = ((1.0 - clippingCoord.y) * 0.5f) * screenDim.y;
 }
 
-// Sampling functions
-static const float PI = 3.1415926535897932384626422832795028841971f;
-static const float INV_PI = 0.318309886f;
-static const float TWO_PI = 6.2831853071795864769252867665590057683943f;
-static const float SQRT_OF_ONE_THIRD = 0.5773502691896257645091487805019574556476f;
-static const float EPSILON = 0.0001f;
-
 inline float3 SquareToSphereUniform(float2 samplePoint)
 {
 	float radius = 1.f;
@@ -227,30 +151,6 @@ inline float maxValue(in float3 w) {
 
 
 
-// Functions for PRNG
-// http://www.reedbeta.com/blog/quick-and-easy-gpu-random-numbers-in-d3d11/
-static uint rng_state;
-static const float prng_01_convert = (1.0f / 4294967296.0f); // Convert numbers generated by rand_xorshift to be between 0, 1
-float rand_xorshift()
-{
-	// Xorshift algorithm from George Marsaglia's paper
-	rng_state ^= uint(rng_state << 13);
-	rng_state ^= uint(rng_state >> 17);
-	rng_state ^= uint(rng_state << 5);
-	return rng_state * prng_01_convert;
-}
-
-// Wang hash
-uint wang_hash(uint seed)
-{
-	seed = (seed ^ 61) ^ (seed >> 16);
-	seed *= 9;
-	seed = seed ^ (seed >> 4);
-	seed *= 0x27d4eb2d;
-	seed = seed ^ (seed >> 15);
-	return seed;
-}
-
 // Generate a photon direction for a given sample point
 inline void GeneratePhoton(float2 samplePoint, float2 sampleSpace, out float3 origin, out float3 rayDir)
 {
@@ -289,7 +189,7 @@ inline void VisualizePhoton(RayPayload payload, float2 screenDims)
 	{
 		float4(0, 0, 0, 0), // Hit Color
 		float4(0, 0, 0, 0), // Hit Location
-		float4(-1, 1, 0, 1), // Any extra information - Payload has to be 16 byte aligned. // TODO Use -1 as flag that this is shadow ray
+		float4(RAY_TYPE_SHADOW, 1, 0, 1), // Any extra information - Payload has to be 16 byte aligned.
 		float3(0, 0, 0), // Throughput
 		float3(0, 0, 0), // Direction
 	};
@@ -355,41 +255,6 @@ void MyRaygenShader()
 }
 
 
-// From hw 3
-inline float3 calculateRandomDirectionInHemisphere(in float3 normal) {
-
-	float up = sqrt(rand_xorshift()); // cos(theta)
-	float over = sqrt(1 - up * up); // sin(theta)
-	float around = rand_xorshift() * TWO_PI;
-
-	// Find a direction that is not the normal based off of whether or not the
-	// normal's components are all equal to sqrt(1/3) or whether or not at
-	// least one component is less than sqrt(1/3). Learned this trick from
-	// Peter Kutz.
-
-	float3 directionNotNormal;
-	if (abs(normal.x) < SQRT_OF_ONE_THIRD) {
-		directionNotNormal = float3(1, 0, 0);
-	}
-	else if (abs(normal.y) < SQRT_OF_ONE_THIRD) {
-		directionNotNormal = float3(0, 1, 0);
-	}
-	else {
-		directionNotNormal = float3(0, 0, 1);
-	}
-
-	// Use not-normal direction to generate two perpendicular directions
-	float3 perpendicularDirection1 =
-		normalize(cross(normal, directionNotNormal));
-	float3 perpendicularDirection2 =
-		normalize(cross(normal, perpendicularDirection1));
-
-	return up * normal
-		+ cos(around) * over * perpendicularDirection1
-		+ sin(around) * over * perpendicularDirection2;
-}
-
-
 inline float3 Lambert_Sample_f(in float3 wo, out float3 wi, in float2 sample, out float pdf, in float3 albedo) {
 	wi = SquareToHemisphereCosine(sample);
 	if (wo.z < 0) wi.z *= -1;
@@ -434,17 +299,6 @@ inline float4 PerformNaiveSearch(float3 intersectionPoint)
 }
 
 
-uint3 Cell1DToPhotonID(uint id)
-{
-	uint width, height, depth;
-	GPhotonPos.GetDimensions(width, height, depth);
-	uint3 temp;
-	temp.x = id % width;
-	temp.y = int(id / width) % height;
-	temp.z = min(id / (width * height), depth - 1);
-	return temp;
-}
-
 inline float4 PerformSorted(float3 intersectionPoint)
 {
 
@@ -597,11 +451,17 @@ inline float4 PerformSorted2(float3 intersectionPoint, float3 intersectionNormal
 [shader("closesthit")]
 void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 {
+    // Shadow rays only need to know that something was hit
+    if (payload.extraInfo.x == RAY_TYPE_SHADOW)
+    {
+        return;
+    }
+
     float3 hitPosition = HitWorldPosition();
     uint instanceId = InstanceID();
 
-    // Get the base index of the triangle's first 16 bit index.
-    uint indexSizeInBytes = 2;
+    // Get the base index of the triangle's first index, 16 or 32 bit depending on the mesh.
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
     uint indicesPerTriangle = 3;
     uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
     uint baseIndex = PrimitiveIndex() * triangleIndexStride;
@@ -610,8 +470,8 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     uint materialIndex = c_bufferIndices[instanceId].materialIndex;
     float4x4 normalTransform = c_bufferIndices[instanceId].normalTransformMat;
 
-    // Load up 3 16 bit indices for the triangle.
-    const uint3 indices = Load3x16BitIndices(geometryOffset, baseIndex);
+    // Load up the 3 indices for the triangle.
+    const uint3 indices = LoadTriangleIndices(geometryOffset, baseIndex, indexSizeInBytes);
 
     // Retrieve corresponding vertex normals for the triangle vertices.
     float3 vertexNormals[3] = { 
@@ -628,6 +488,36 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     // Transform normal from local space to transformed world space
     float3 transformedNormal = normalize(mul(normalTransform, float4(triangleNormal, 0.0f)).xyz);
 
+    if (g_sceneCB.renderFlags & RENDER_FLAG_DIRECT_LIGHTING)
+    {
+        float3 albedo = c_materials[materialIndex].albedo;
+        float3 direct = CalculateDirectLighting(hitPosition, transformedNormal, albedo);
+
+        // Final gathered irradiance from the cache, the photon density estimate covers whatever it misses
+        float3 cachedIrradiance;
+        float3 indirect;
+        if ((g_sceneCB.renderFlags & RENDER_FLAG_FINAL_GATHER) &&
+            LookupIrradiance(hitPosition, transformedNormal, IRRADIANCE_CACHE_INVALID, cachedIrradiance))
+        {
+            indirect = albedo * INV_PI * cachedIrradiance;
+        }
+        else
+        {
+            indirect = GatherIndirectRadiance(hitPosition);
+        }
+        payload.color = float4(direct + indirect, 1.0f);
+        return;
+    }
+
+    // Radiance photons already hold the full density estimate, first bounce photons included
+    if (g_sceneCB.renderFlags & RENDER_FLAG_RADIANCE_PHOTONS)
+    {
+        float3 radiance;
+        LookupRadiancePhoton(hitPosition, radiance);
+        payload.color = float4(radiance, 1.0f);
+        return;
+    }
+
     payload.color = PerformSorted2(hitPosition, transformedNormal);
     float lightIntensity = LambertShader(hitPosition, g_sceneCB.cameraPosition.xyz, transformedNormal);
 
@@ -638,9 +528,7 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 [shader("miss")]
 void MyMissShader(inout RayPayload payload)
 {
-	int isShadow = payload.extraInfo.x;
-
-	if (isShadow == -1) {
+	if (payload.extraInfo.x == RAY_TYPE_SHADOW) {
 		float4 background = float4(1.0f, 1.0f, 1.0f, 1.0f);
 		payload.color = background;
 		payload.hitPosition = float4(0.0, 0.0, 0.0, 0.0);
@@ -29,13 +29,14 @@ RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
 RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
 
 RaytracingAccelerationStructure Scene : register(t0, space0);
+StructuredBuffer<float2> EmissionCDF : register(t1, space0); // x is the cdf up to the cell, y is the pdf of the cell
 ByteAddressBuffer Indices[] : register(t0, space1);
 StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
 
 // Constant buffers
-ConstantBuffer<SceneBufferDesc> c_bufferIndices[] : register(b0, space1);
-ConstantBuffer<MaterialDesc> c_materials[] : register(b0, space2);
-ConstantBuffer<LightDesc> c_lights[] : register(b0, space3);
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
@@ -71,6 +72,16 @@ uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
     return indices;
 }
 
+// Load the three indices of a triangle, 16 or 32 bit as the instance's mesh stores them.
+uint3 LoadTriangleIndices(uint geomOffset, uint offsetBytes, uint indexSizeInBytes)
+{
+    if (indexSizeInBytes == 4)
+    {
+        return Indices[geomOffset].Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(geomOffset, offsetBytes);
+}
+
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
 struct RayPayload
 {
@@ -259,16 +270,49 @@ uint wang_hash(uint seed)
     return seed;
 }
 
+// Pick a projection map cell from the importance driven emission distribution
+inline uint SampleEmissionCell(float u, out float cellPdf)
+{
+    uint low = 0;
+    uint high = PROJECTION_MAP_NUM_CELLS - 1;
+    while (low < high)
+    {
+        uint mid = (low + high) / 2;
+        if (EmissionCDF[mid].x > u)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    cellPdf = EmissionCDF[low].y;
+    return low;
+}
+
 // Generate a photon direction for a given sample point
-inline void GeneratePhoton(float2 samplePoint, float2 sampleSpace, out float3 origin, out float3 rayDir)
+// emissionWeight rescales the photon's power so that steering it towards the camera does not bias the map
+inline void GeneratePhoton(float2 samplePoint, float2 sampleSpace, out float3 origin, out float3 rayDir, out float emissionWeight)
 {
     //float2 normSample = samplePoint / sampleSpace;
     //rayDir = SquareToSphereUniform(normSample);
     origin = g_sceneCB.lightPosition.xyz;
 
-    // Use PRNG to generate ray direction
-    float2 randomSample = float2(rand_xorshift(), rand_xorshift());
+    float cellPdf;
+    uint cell = SampleEmissionCell(rand_xorshift(), cellPdf);
+    uint thetaIndex = cell % PROJECTION_MAP_THETA_RES;
+    uint phiIndex = cell / PROJECTION_MAP_THETA_RES;
+
+    // Use PRNG to jitter the direction within the cell
+    float2 randomSample;
+    randomSample.x = (thetaIndex + rand_xorshift()) / PROJECTION_MAP_THETA_RES;
+    randomSample.y = (phiIndex + rand_xorshift()) / PROJECTION_MAP_PHI_RES;
     rayDir = SquareToSphereUniform(randomSample);
+
+    // Uniform emission picks every cell with the same probability
+    emissionWeight = (1.0f / PROJECTION_MAP_NUM_CELLS) / cellPdf;
 }
 
 inline void VisualizePhoton(RayPayload payload, float2 screenDims)
@@ -341,7 +385,8 @@ void MyRaygenShader()
     // Photon Generation
     float3 rayDir;
     float3 origin;
-    GeneratePhoton(samplePoint, screenDims, origin, rayDir);
+    float emissionWeight;
+    GeneratePhoton(samplePoint, screenDims, origin, rayDir, emissionWeight);
 
     // Trace the ray.
     RayDesc ray;
@@ -352,7 +397,7 @@ void MyRaygenShader()
 
     float numSamples = 1;//DispatchRaysDimensions().x * DispatchRaysDimensions().y;
 
-    float4 lightColor = g_sceneCB.lightDiffuseColor / numSamples;
+    float4 lightColor = g_sceneCB.lightDiffuseColor * emissionWeight / numSamples;
 
     // TODO max depth is 5. Do we want to change that?
     // Initialize the payload
@@ -435,8 +480,8 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     float3 hitPosition = HitWorldPosition();
     uint instanceId = InstanceID();
 
-    // Get the base index of the triangle's first 16 bit index.
-    uint indexSizeInBytes = 2;
+    // Get the base index of the triangle's first index, 16 or 32 bit depending on the mesh.
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
     uint indicesPerTriangle = 3;
     uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
     uint baseIndex = PrimitiveIndex() * triangleIndexStride;
@@ -444,8 +489,8 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     uint geometryOffset = c_bufferIndices[instanceId].vbIndex;
     uint materialIndex = c_bufferIndices[instanceId].materialIndex;
 
-    // Load up 3 16 bit indices for the triangle.
-    const uint3 indices = Load3x16BitIndices(geometryOffset, baseIndex);
+    // Load up the 3 indices for the triangle.
+    const uint3 indices = LoadTriangleIndices(geometryOffset, baseIndex, indexSizeInBytes);
 
     // Retrieve corresponding vertex normals for the triangle vertices.
     float3 vertexNormals[3] = { 
@@ -509,20 +554,29 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
     payload.direction = wiW; // Direction
 
     // Store photon into the photon uav buffer
+    // With direct lighting, the first bounce is covered by shadow rays in the final pass and is not stored
     uint3 g_index = uint3(DispatchRaysIndex().xy, depth - 1);
-    GPhotonPos[g_index] = float4(hitPosition, 1);
-	GPhotonColor[g_index] = payload.color;
-
-    // Calculate the cell in which the hit belongs to 
-    uint cellIdX = floor(POS_TO_CELL_X(hitPosition.x));
-    uint cellIdY = floor(POS_TO_CELL_Y(hitPosition.y));
-    uint cellIdZ = floor(POS_TO_CELL_Z(hitPosition.z));
-
-    // Increment (with synchronization) the photon counter for that particular cell
-    uint3 cellId = uint3(cellIdX, cellIdY, cellIdZ);
-    uint increment = 1;
-    uint outVal;
-	InterlockedAdd(GPhotonCount[cellId], increment, outVal);
+    bool storePhoton = (depth > 1) || ((g_sceneCB.renderFlags & RENDER_FLAG_DIRECT_LIGHTING) == 0);
+    if (storePhoton)
+    {
+        GPhotonPos[g_index] = float4(hitPosition, 1);
+        GPhotonColor[g_index] = payload.color;
+
+        // Calculate the cell in which the hit belongs to 
+        uint cellIdX = floor(POS_TO_CELL_X(hitPosition.x));
+        uint cellIdY = floor(POS_TO_CELL_Y(hitPosition.y));
+        uint cellIdZ = floor(POS_TO_CELL_Z(hitPosition.z));
+
+        // Increment (with synchronization) the photon counter for that particular cell
+        uint3 cellId = uint3(cellIdX, cellIdY, cellIdZ);
+        uint increment = 1;
+        uint outVal;
+        InterlockedAdd(GPhotonCount[cellId], increment, outVal);
+    }
+    else
+    {
+        GPhotonPos[g_index] = float4(0, 0, 0, -1);
+    }
 
     // Russian Roulette 
     float throughput_max = maxValue(n_throughput);
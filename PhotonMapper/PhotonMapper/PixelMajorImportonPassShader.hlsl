@@ -0,0 +1,110 @@
+#ifndef PIXEL_MAJOR_IMPORTON_PASS
+#define PIXEL_MAJOR_IMPORTON_PASS
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// G-Buffers
+RWTexture2DArray<uint> GPhotonCount : register(u1);
+RWTexture2DArray<uint> GPhotonScan : register(u2);
+RWTexture2DArray<uint> GPhotonTempIndex : register(u3);
+
+RWTexture2DArray<float4> GPhotonPos : register(u4);
+RWTexture2DArray<float4> GPhotonColor : register(u5);
+RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
+RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
+
+// Importons per projection map cell, (theta, phi) as seen from the light
+RWTexture2D<uint> GImportance : register(u8);
+
+RaytracingAccelerationStructure Scene : register(t0, space0);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
+
+typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+struct ImportonPayload
+{
+    float4 hitPosition; // w is 1 if the importon hit a surface
+};
+
+static const float PI = 3.1415926535897932384626422832795028841971f;
+static const float TWO_PI = 6.2831853071795864769252867665590057683943f;
+
+// Generate a ray in world space for a camera pixel corresponding to an index from the dispatched 2D grid.
+inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction)
+{
+    float2 xy = index + 0.5f; // center in the middle of the pixel.
+    float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0;
+
+    // Invert Y for DirectX-style coordinates.
+    screenPos.y = -screenPos.y;
+
+    // Unproject the pixel coordinate into a ray.
+    float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
+
+    world.xyz /= world.w;
+    origin = g_sceneCB.cameraPosition.xyz;
+    direction = normalize(world.xyz - origin);
+}
+
+// Inverse of SquareToSphereUniform - the projection map cell a direction leaving the light falls in
+inline uint2 DirectionToCell(float3 direction)
+{
+    float phi = acos(clamp(direction.y, -1.0f, 1.0f));
+    float theta = atan2(direction.z, direction.x);
+    if (theta < 0.0f)
+    {
+        theta += TWO_PI;
+    }
+
+    uint thetaIndex = min(uint(theta / TWO_PI * PROJECTION_MAP_THETA_RES), PROJECTION_MAP_THETA_RES - 1);
+    uint phiIndex = min(uint(phi / PI * PROJECTION_MAP_PHI_RES), PROJECTION_MAP_PHI_RES - 1);
+    return uint2(thetaIndex, phiIndex);
+}
+
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+    float3 rayDir;
+    float3 origin;
+    GenerateCameraRay(DispatchRaysIndex().xy, origin, rayDir);
+
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = rayDir;
+    ray.TMin = 0.001;
+    ray.TMax = 10000.0;
+
+    ImportonPayload payload = { float4(0, 0, 0, 0) };
+    TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, ray, payload);
+
+    if (payload.hitPosition.w == 0.0f)
+    {
+        return;
+    }
+
+    // The light sees the visible surface through this cell, photons emitted into it are likely to matter
+    float3 lightToHit = payload.hitPosition.xyz - g_sceneCB.lightPosition.xyz;
+    if (dot(lightToHit, lightToHit) > 0.0f)
+    {
+        uint outVal;
+        InterlockedAdd(GImportance[DirectionToCell(normalize(lightToHit))], 1, outVal);
+    }
+}
+
+[shader("closesthit")]
+void MyClosestHitShader(inout ImportonPayload payload, in MyAttributes attr)
+{
+    payload.hitPosition = float4(WorldRayOrigin() + RayTCurrent() * WorldRayDirection(), 1.0f);
+}
+
+[shader("miss")]
+void MyMissShader(inout ImportonPayload payload)
+{
+}
+
+#endif // PIXEL_MAJOR_IMPORTON_PASS
@@ -0,0 +1,181 @@
+#ifndef PIXEL_MAJOR_IRRADIANCE_CACHE_PASS
+#define PIXEL_MAJOR_IRRADIANCE_CACHE_PASS
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+// Render Target for visualizing the photons - can be removed later on
+RWTexture2D<float4> RenderTarget : register(u0);
+
+// G-Buffers
+RWTexture2DArray<uint> GPhotonCount : register(u1);
+RWTexture2DArray<uint> GPhotonScan : register(u2);
+RWTexture2DArray<uint> GPhotonTempIndex : register(u3);
+
+RWTexture2DArray<float4> GPhotonPos : register(u4);
+RWTexture2DArray<float4> GPhotonColor : register(u5);
+RWTexture2DArray<float4> GPhotonSortedPos : register(u6);
+RWTexture2DArray<float4> GPhotonSortedCol : register(u7);
+
+#include "IrradianceCache.hlsli"
+#include "RadiancePhotons.hlsli"
+
+RaytracingAccelerationStructure Scene : register(t0, space0);
+ByteAddressBuffer Indices[] : register(t0, space1);
+StructuredBuffer<Vertex> Vertices[] : register(t0, space2);
+
+// Constant buffers
+StructuredBuffer<SceneBufferDesc> c_bufferIndices : register(t0, space3);
+StructuredBuffer<MaterialDesc> c_materials : register(t0, space4);
+StructuredBuffer<LightDesc> c_lights : register(t0, space5);
+
+ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
+ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
+ConstantBuffer<IrradianceCacheConstantBuffer> g_cachePassCB : register(b2);
+
+#include "PixelMajorLighting.hlsli"
+
+// Ray types of this pass next to RAY_TYPE_SHADOW, stored in extraInfo[0]
+static const float RAY_TYPE_PROBE = 0.0f;
+static const float RAY_TYPE_GATHER = 1.0f;
+
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+    uint2 index = DispatchRaysIndex().xy;
+
+    float3 rayDir;
+    float3 origin;
+    GenerateCameraRay(index, origin, rayDir);
+
+    // Find the visible point this cache sample stands for
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = rayDir;
+    ray.TMin = 0.001;
+    ray.TMax = 10000.0;
+
+    RayPayload probe =
+    {
+        float4(0, 0, 0, 0),
+        float4(0, 0, 0, -1),
+        float4(RAY_TYPE_PROBE, 0, 0, 0),
+        float3(0, 0, 0),
+        float3(0, 0, 0),
+    };
+    TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, ray, probe);
+
+    if (probe.hitPosition.w < 0.0f)
+    {
+        return;
+    }
+
+    float3 position = probe.hitPosition.xyz;
+    float3 normal = probe.direction;
+
+    // The geometric error metric decides whether the existing records already cover this point
+    float3 cachedIrradiance;
+    if (LookupIrradiance(position, normal, g_cachePassCB.passIndex, cachedIrradiance))
+    {
+        return;
+    }
+
+    rng_state = uint(wang_hash((index.x + DispatchRaysDimensions().x * index.y) ^ (g_cachePassCB.passIndex * 0x9e3779b9)));
+
+    // Final gather, cosine weighted so the irradiance is PI times the mean radiance
+    float3 radianceSum = float3(0.0f, 0.0f, 0.0f);
+    float inverseDistanceSum = 0.0f;
+    for (uint i = 0; i < IRRADIANCE_CACHE_GATHER_RAYS; ++i)
+    {
+        RayDesc gatherRay;
+        gatherRay.Origin = position;
+        gatherRay.Direction = calculateRandomDirectionInHemisphere(normal);
+        gatherRay.TMin = 0.001;
+        gatherRay.TMax = 10000.0;
+
+        RayPayload gather =
+        {
+            float4(0, 0, 0, 0),
+            float4(0, 0, 0, -1),
+            float4(RAY_TYPE_GATHER, 0, 0, 0),
+            float3(0, 0, 0),
+            float3(0, 0, 0),
+        };
+        TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, gatherRay, gather);
+
+        if (gather.hitPosition.w > 0.0f)
+        {
+            radianceSum += gather.color.xyz;
+            inverseDistanceSum += 1.0f / gather.hitPosition.w;
+        }
+    }
+
+    float3 irradiance = PI * radianceSum / IRRADIANCE_CACHE_GATHER_RAYS;
+
+    // Harmonic mean distance, open surroundings get the largest record
+    float harmonicMeanDistance = (inverseDistanceSum > 0.0f) ? IRRADIANCE_CACHE_GATHER_RAYS / inverseDistanceSum : IRRADIANCE_CACHE_MAX_RADIUS;
+
+    InsertIrradianceRecord(position, normal, harmonicMeanDistance, irradiance, g_cachePassCB.passIndex);
+}
+
+[shader("closesthit")]
+void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
+{
+    // Shadow rays only need to know that something was hit
+    float rayType = payload.extraInfo.x;
+    if (rayType == RAY_TYPE_SHADOW)
+    {
+        return;
+    }
+
+    float3 hitPosition = HitWorldPosition();
+    uint instanceId = InstanceID();
+
+    // Get the base index of the triangle's first index, 16 or 32 bit depending on the mesh.
+    uint indexSizeInBytes = c_bufferIndices[instanceId].indexSizeInBytes;
+    uint indicesPerTriangle = 3;
+    uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
+    uint baseIndex = PrimitiveIndex() * triangleIndexStride;
+
+    uint geometryOffset = c_bufferIndices[instanceId].vbIndex;
+    uint materialIndex = c_bufferIndices[instanceId].materialIndex;
+    float4x4 normalTransform = c_bufferIndices[instanceId].normalTransformMat;
+
+    // Load up the 3 indices for the triangle.
+    const uint3 indices = LoadTriangleIndices(geometryOffset, baseIndex, indexSizeInBytes);
+
+    // Retrieve corresponding vertex normals for the triangle vertices.
+    float3 vertexNormals[3] = {
+        Vertices[geometryOffset][indices[0]].normal,
+        Vertices[geometryOffset][indices[1]].normal,
+        Vertices[geometryOffset][indices[2]].normal
+    };
+    float3 triangleNormal = HitAttribute(vertexNormals, attr);
+
+    // Transform normal from local space to transformed world space
+    float3 transformedNormal = normalize(mul(normalTransform, float4(triangleNormal, 0.0f)).xyz);
+
+    payload.hitPosition = float4(hitPosition, RayTCurrent());
+
+    if (rayType == RAY_TYPE_PROBE)
+    {
+        payload.direction = transformedNormal;
+        return;
+    }
+
+    // Gather rays see the full reflected radiance: direct through a shadow ray, the rest from the photon map
+    float3 albedo = c_materials[materialIndex].albedo;
+    float3 radiance = CalculateDirectLighting(hitPosition, transformedNormal, albedo) + GatherIndirectRadiance(hitPosition);
+    payload.color = float4(radiance, 1.0f);
+}
+
+[shader("miss")]
+void MyMissShader(inout RayPayload payload)
+{
+    if (payload.extraInfo.x == RAY_TYPE_SHADOW)
+    {
+        payload.extraInfo = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+#endif // PIXEL_MAJOR_IRRADIANCE_CACHE_PASS
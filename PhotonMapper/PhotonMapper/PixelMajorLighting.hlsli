@@ -0,0 +1,260 @@
+#ifndef PIXELMAJORLIGHTING_H
+#define PIXELMAJORLIGHTING_H
+
+// Ray payload, hit helpers, sampling and the lighting terms shared by the pixel major final pass and the
+// irradiance cache pass. Uses Scene, Indices, Vertices, g_sceneCB and the photon G-Buffers, which have to be
+// declared before this file is included, after RadiancePhotons.hlsli.
+
+// Load three 16 bit indices from a byte addressed buffer.
+uint3 Load3x16BitIndices(uint geomOffset, uint offsetBytes)
+{
+    uint3 indices;
+
+    // ByteAdressBuffer loads must be aligned at a 4 byte boundary.
+    // Since we need to read three 16 bit indices: { 0, 1, 2 }
+    // aligned at a 4 byte boundary as: { 0 1 } { 2 0 } { 1 2 } { 0 1 } ...
+    // we will load 8 bytes (~ 4 indices { a b | c d }) to handle two possible index triplet layouts,
+    // based on first index's offsetBytes being aligned at the 4 byte boundary or not:
+    //  Aligned:     { 0 1 | 2 - }
+    //  Not aligned: { - 0 | 1 2 }
+    const uint dwordAlignedOffset = offsetBytes & ~3;
+    const uint2 four16BitIndices = Indices[geomOffset].Load2(dwordAlignedOffset);
+
+    // Aligned: { 0 1 | 2 - } => retrieve first three 16bit indices
+    if (dwordAlignedOffset == offsetBytes)
+    {
+        indices.x = four16BitIndices.x & 0xffff;
+        indices.y = (four16BitIndices.x >> 16) & 0xffff;
+        indices.z = four16BitIndices.y & 0xffff;
+    }
+    else // Not aligned: { - 0 | 1 2 } => retrieve last three 16bit indices
+    {
+        indices.x = (four16BitIndices.x >> 16) & 0xffff;
+        indices.y = four16BitIndices.y & 0xffff;
+        indices.z = (four16BitIndices.y >> 16) & 0xffff;
+    }
+
+    return indices;
+}
+
+// Load the three indices of a triangle, 16 or 32 bit as the instance's mesh stores them.
+uint3 LoadTriangleIndices(uint geomOffset, uint offsetBytes, uint indexSizeInBytes)
+{
+    if (indexSizeInBytes == 4)
+    {
+        return Indices[geomOffset].Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(geomOffset, offsetBytes);
+}
+
+typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+struct RayPayload
+{
+    float4 color;
+    float4 hitPosition; // w is the hit distance for the irradiance cache pass, negative on a miss
+    float4 extraInfo; // [0] is the ray type, RAY_TYPE_SHADOW or a value of the pass's own
+    float3 throughput;
+    float3 direction; // World space normal at the hit for irradiance cache probe rays
+};
+
+// Shadow rays end at their first hit, the miss shaders reset extraInfo[0] to 0
+static const float RAY_TYPE_SHADOW = -1.0f;
+
+// Retrieve hit world position.
+float3 HitWorldPosition()
+{
+    return WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
+}
+
+// Retrieve attribute at a hit position interpolated from vertex attributes using the hit's barycentrics.
+float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttributes attr)
+{
+    return vertexAttribute[0] +
+        attr.barycentrics.x * (vertexAttribute[1] - vertexAttribute[0]) +
+        attr.barycentrics.y * (vertexAttribute[2] - vertexAttribute[0]);
+}
+
+// Generate a ray in world space for a camera pixel corresponding to an index from the dispatched 2D grid.
+inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction)
+{
+    float2 xy = index + 0.5f; // center in the middle of the pixel.
+    float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0;
+
+    // Invert Y for DirectX-style coordinates.
+    screenPos.y = -screenPos.y;
+
+    // Unproject the pixel coordinate into a ray.
+    float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
+
+    world.xyz /= world.w;
+    origin = g_sceneCB.cameraPosition.xyz;
+    direction = normalize(world.xyz - origin);
+}
+
+// Sampling functions
+static const float PI = 3.1415926535897932384626422832795028841971f;
+static const float INV_PI = 0.318309886f;
+static const float TWO_PI = 6.2831853071795864769252867665590057683943f;
+static const float SQRT_OF_ONE_THIRD = 0.5773502691896257645091487805019574556476f;
+static const float EPSILON = 0.0001f;
+
+// Functions for PRNG
+// http://www.reedbeta.com/blog/quick-and-easy-gpu-random-numbers-in-d3d11/
+static uint rng_state;
+static const float prng_01_convert = (1.0f / 4294967296.0f); // Convert numbers generated by rand_xorshift to be between 0, 1
+float rand_xorshift()
+{
+    // Xorshift algorithm from George Marsaglia's paper
+    rng_state ^= uint(rng_state << 13);
+    rng_state ^= uint(rng_state >> 17);
+    rng_state ^= uint(rng_state << 5);
+    return rng_state * prng_01_convert;
+}
+
+// Wang hash
+uint wang_hash(uint seed)
+{
+    seed = (seed ^ 61) ^ (seed >> 16);
+    seed *= 9;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2d;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+// From hw 3
+inline float3 calculateRandomDirectionInHemisphere(in float3 normal) {
+
+    float up = sqrt(rand_xorshift()); // cos(theta)
+    float over = sqrt(1 - up * up); // sin(theta)
+    float around = rand_xorshift() * TWO_PI;
+
+    // Find a direction that is not the normal based off of whether or not the
+    // normal's components are all equal to sqrt(1/3) or whether or not at
+    // least one component is less than sqrt(1/3). Learned this trick from
+    // Peter Kutz.
+
+    float3 directionNotNormal;
+    if (abs(normal.x) < SQRT_OF_ONE_THIRD) {
+        directionNotNormal = float3(1, 0, 0);
+    }
+    else if (abs(normal.y) < SQRT_OF_ONE_THIRD) {
+        directionNotNormal = float3(0, 1, 0);
+    }
+    else {
+        directionNotNormal = float3(0, 0, 1);
+    }
+
+    // Use not-normal direction to generate two perpendicular directions
+    float3 perpendicularDirection1 =
+        normalize(cross(normal, directionNotNormal));
+    float3 perpendicularDirection2 =
+        normalize(cross(normal, perpendicularDirection1));
+
+    return up * normal
+        + cos(around) * over * perpendicularDirection1
+        + sin(around) * over * perpendicularDirection2;
+}
+
+uint3 Cell1DToPhotonID(uint id)
+{
+    uint width, height, depth;
+    GPhotonPos.GetDimensions(width, height, depth);
+    uint3 temp;
+    temp.x = id % width;
+    temp.y = int(id / width) % height;
+    temp.z = min(id / (width * height), depth - 1);
+    return temp;
+}
+
+// Next event estimation towards the scene constant light, the same light the photons are emitted from
+inline float3 CalculateDirectLighting(float3 hitPosition, float3 normal, float3 albedo)
+{
+    float3 hitToLight = g_sceneCB.lightPosition.xyz - hitPosition;
+    float distanceSquared = dot(hitToLight, hitToLight);
+    float nDotL = dot(normal, hitToLight);
+    if (nDotL <= 0.0f || distanceSquared < EPSILON)
+    {
+        return float3(0.0f, 0.0f, 0.0f);
+    }
+
+    // Shadow ray, the direction is left unnormalized so the light sits at t = 1
+    RayDesc ray;
+    ray.Origin = hitPosition;
+    ray.Direction = hitToLight;
+    ray.TMin = 0.001;
+    ray.TMax = 0.999;
+
+    RayPayload shadowPayload =
+    {
+        float4(0, 0, 0, 0), // Hit Color
+        float4(0, 0, 0, 0), // Hit Location
+        float4(RAY_TYPE_SHADOW, 0, 0, 1), // The miss shader resets [0] to 0
+        float3(0, 0, 0), // Throughput
+        float3(0, 0, 0), // Direction
+    };
+    TraceRay(Scene, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_FORCE_OPAQUE, ~0, 0, 1, 0, ray, shadowPayload);
+
+    if (shadowPayload.extraInfo.x != 0.0f)
+    {
+        return float3(0.0f, 0.0f, 0.0f);
+    }
+
+    // Lambertian BRDF times the irradiance from a point light
+    float cosTheta = nDotL * rsqrt(distanceSquared);
+    float3 irradiance = g_sceneCB.lightDiffuseColor.xyz * POINT_LIGHT_INTENSITY * cosTheta / distanceSquared;
+    return albedo * INV_PI * irradiance;
+}
+
+// Density estimate over the stored photons, which start at the second bounce when direct lighting is enabled.
+// With radiance photons enabled this is a single lookup of the nearest precomputed estimate.
+inline float3 GatherIndirectRadiance(float3 intersectionPoint)
+{
+    float3 radiancePhoton;
+    if (g_sceneCB.renderFlags & RENDER_FLAG_RADIANCE_PHOTONS)
+    {
+        LookupRadiancePhoton(intersectionPoint, radiancePhoton);
+        return radiancePhoton;
+    }
+
+    uint cellIdX = floor(POS_TO_CELL_X(intersectionPoint.x));
+    uint cellIdY = floor(POS_TO_CELL_Y(intersectionPoint.y));
+    uint cellIdZ = floor(POS_TO_CELL_Z(intersectionPoint.z));
+    uint3 cellId = uint3(cellIdX, cellIdY, cellIdZ);
+
+    float3 color = float3(0.0, 0.0, 0.0);
+    int radius = ceil(PIXEL_MAJOR_PHOTON_CLOSENESS / CELL_SIZE) + 1;
+
+    for (int z = -radius; z < radius; ++z)
+    {
+        for (int y = -radius; y < radius; ++y)
+        {
+            for (int x = -radius; x < radius; ++x)
+            {
+                uint3 currCell = cellId + uint3(x, y, z);
+                currCell = clamp(currCell, uint3(0, 0, 0), uint3(NUM_CELLS_IN_X - 1, NUM_CELLS_IN_Y - 1, NUM_CELLS_IN_Z - 1));
+
+                int photon = GPhotonScan[currCell];
+                uint end = photon + GPhotonCount[currCell];
+                for (photon; photon < end; ++photon)
+                {
+                    uint3 index = Cell1DToPhotonID(photon);
+                    float3 distVec = intersectionPoint - GPhotonSortedPos[index].xyz;
+                    if (dot(distVec, distVec) < PIXEL_MAJOR_PHOTON_CLOSENESS_SQUARED)
+                    {
+                        color += GPhotonSortedCol[index].xyz;
+                    }
+                }
+            }
+        }
+    }
+
+    // Stored colors already hold the surface albedo, each photon carries 4 PI * I / N of the light's power.
+    // Radiance = albedo / PI * (power / (PI * r^2))
+    uint width, height, depth;
+    GPhotonPos.GetDimensions(width, height, depth);
+    float numEmittedPhotons = width * height;
+    return color * (4.0f * POINT_LIGHT_INTENSITY) / (numEmittedPhotons * PI * PIXEL_MAJOR_PHOTON_CLOSENESS_SQUARED);
+}
+
+#endif // PIXELMAJORLIGHTING_H
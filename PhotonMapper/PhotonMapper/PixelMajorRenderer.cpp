@@ -14,6 +14,8 @@
 #include "DirectXRaytracingHelper.h"
 #include "CompiledShaders\PixelMajorFirstPassShader.hlsl.h"
 #include "CompiledShaders\PixelMajorFinalPassShader.hlsl.h"
+#include "CompiledShaders\PixelMajorImportonPassShader.hlsl.h"
+#include "CompiledShaders\PixelMajorIrradianceCacheShader.hlsl.h"
 
 using namespace std;
 using namespace DX;
@@ -24,19 +26,30 @@ const wchar_t* PixelMajorRenderer::c_closestHitShaderName = L"MyClosestHitShader
 const wchar_t* PixelMajorRenderer::c_missShaderName = L"MyMissShader";
 
 const LPCWSTR PixelMajorRenderer::c_computeShaderPass0 = L"PixelMajorComputePass0.cso";
-const LPCWSTR PixelMajorRenderer::c_computeShaderPass01 = L"PixelMajorComputePass0.cso";
+const LPCWSTR PixelMajorRenderer::c_computeShaderPass01 = L"PixelMajorComputePass01.cso";
 const LPCWSTR PixelMajorRenderer::c_computeShaderPass1 = L"PixelMajorComputePass1.cso";
 const LPCWSTR PixelMajorRenderer::c_computeShaderPass2 = L"PixelMajorComputePass2.cso";
 const LPCWSTR PixelMajorRenderer::c_computeShaderPass3 = L"PixelMajorComputePass3.cso";
+const LPCWSTR PixelMajorRenderer::c_computeShaderClearCache = L"PixelMajorComputePass4.cso";
+const LPCWSTR PixelMajorRenderer::c_computeShaderRadiancePhotons = L"PixelMajorComputePass5.cso";
 
 PixelMajorRenderer::PixelMajorRenderer(const DXRPhotonMapper::PMScene& scene, UINT width, UINT height, std::wstring name) :
     PhotonBaseRenderer(scene, width, height, name),
     m_raytracingOutputResourceUAVDescriptorHeapIndex(UINT_MAX),
     m_curRotationAngleRad(0.0f),
     m_calculatePhotonMap(false),
+    m_directLighting(false),
+    m_finalGather(false),
+    m_radiancePhotons(false),
+    m_irradianceCachePass(0),
     m_fenceValue(0)
 {
     m_forceComputeFallback = false;
+    m_importanceBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheRecords.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheHeads.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheCounter.uavDescriptorHeapIndex = UINT_MAX;
+    m_radiancePhotonBuffer.uavDescriptorHeapIndex = UINT_MAX;
     SelectRaytracingAPI(RaytracingAPI::FallbackLayer);
     UpdateForSizeChange(width, height);
 }
@@ -159,6 +172,8 @@ void PixelMajorRenderer::InitializeScene()
         m_sceneCB[frameIndex].lightDiffuseColor = XMLoadFloat4(&lightDiffuseColor);
     }
 
+    m_sceneCB[frameIndex].renderFlags = GetRenderFlags();
+
     // Apply the initial values to all frames' buffer instances.
     for (auto& sceneCB : m_sceneCB)
     {
@@ -230,6 +245,8 @@ void PixelMajorRenderer::CreateDeviceDependentResources()
 
     CreateFirstPassRootSignatures();
     CreateSecondPassRootSignatures();
+    CreateImportonPassRootSignatures();
+    CreateIrradianceCachePassRootSignatures();
 
     CreateComputeFirstPassRootSignature();
 
@@ -237,12 +254,16 @@ void PixelMajorRenderer::CreateDeviceDependentResources()
     // Temporary Testing: Should be put back later on.
     CreateFirstPassPhotonPipelineStateObject();
     CreateSecondPassPhotonPipelineStateObject();
+    CreateImportonPassPipelineStateObject();
+    CreateIrradianceCachePassPipelineStateObject();
 
     CreateComputePipelineStateObject(c_computeShaderPass0, m_computeInitializePSO);
     CreateComputePipelineStateObject(c_computeShaderPass01, m_computeInitializePSO2);
     CreateComputePipelineStateObject(c_computeShaderPass1, m_computeFirstPassPSO);
     CreateComputePipelineStateObject(c_computeShaderPass2, m_computeSecondPassPSO);
     CreateComputePipelineStateObject(c_computeShaderPass3, m_computeThirdPassPSO);
+    CreateComputePipelineStateObject(c_computeShaderClearCache, m_computeClearCachePSO);
+    CreateComputePipelineStateObject(c_computeShaderRadiancePhotons, m_computeRadiancePhotonPSO);
 
     // Create a heap for descriptors.
     CreateDescriptorHeap();
@@ -267,6 +288,8 @@ void PixelMajorRenderer::CreateDeviceDependentResources()
     // Build shader tables, which define shaders and their local root arguments.
     BuildFirstPassShaderTables();
     BuildSecondPassShaderTables();
+    BuildImportonPassShaderTables();
+    BuildIrradianceCachePassShaderTables();
 
     // Create a fence for tracking GPU execution progress.
     auto device = m_deviceResources->GetD3DDevice();
@@ -315,19 +338,17 @@ void PixelMajorRenderer::CreateFirstPassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer, 0);  // 1 output texture + a couple of GBuffers
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
-
-        CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer, 0);  // 1 output texture + a couple of GBuffers
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[ImportanceRootSignatureParams::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
         rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
         rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
@@ -336,6 +357,7 @@ void PixelMajorRenderer::CreateFirstPassRootSignatures()
         rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
         rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
         rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+        rootParameters[ImportanceRootSignatureParams::EmissionCDFSlot].InitAsShaderResourceView(1);
 
         CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
         SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_firstPassGlobalRootSignature);
@@ -359,17 +381,15 @@ void PixelMajorRenderer::CreateSecondPassRootSignatures()
     // Global Root Signature
     // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
     {
-        const UINT numPrimitives = UINT(m_scene.m_primitives.size());
-        const UINT numMaterials = UINT(m_scene.m_materials.size());
-        const UINT numLights = UINT(m_scene.m_lights.size());
+        const UINT numGeometries = GetNumGeometries();
 
         CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer, 0);  // 1 output texture + a couple of GBuffers
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 1);  // index buffer array
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numPrimitives, 0, 2);  // vertex buffer array
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numPrimitives, 0, 1);  // CBV - scene buffer array
-        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numMaterials, 0, 2);  // CBV - material buffer array
-        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, numLights, 0, 3);  // CBV - light buffer array
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer, 0);  // 1 output texture + a couple of GBuffers
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
         rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -396,11 +416,96 @@ void PixelMajorRenderer::CreateSecondPassRootSignatures()
     }
 }
 
+void PixelMajorRenderer::CreateImportonPassRootSignatures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Global Root Signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    {
+        const UINT numGeometries = GetNumGeometries();
+
+        CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer, 0);  // 1 output texture + a couple of GBuffers
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParamsWithPrimitives::Count];
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+
+        CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_importonPassGlobalRootSignature);
+    }
+
+    // Local Root Signature
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    {
+        CD3DX12_ROOT_PARAMETER rootParameters[LocalRootSignatureParams::Count];
+        rootParameters[LocalRootSignatureParams::CubeConstantSlot].InitAsConstants(SizeOfInUint32(m_cubeCB), 1);
+        CD3DX12_ROOT_SIGNATURE_DESC localRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        localRootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+        SerializeAndCreateRaytracingRootSignature(localRootSignatureDesc, &m_importonPassLocalRootSignature);
+    }
+}
+
+void PixelMajorRenderer::CreateIrradianceCachePassRootSignatures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Global Root Signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    {
+        const UINT numGeometries = GetNumGeometries();
+
+        CD3DX12_DESCRIPTOR_RANGE ranges[6]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer, 0);  // 1 output texture + a couple of GBuffers
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 1);  // index buffer array
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, numGeometries, 0, 2);  // vertex buffer array
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 3);  // scene buffer table
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 4);  // material table
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 5);  // light table
+
+        CD3DX12_ROOT_PARAMETER rootParameters[IrradianceCacheRootSignatureParams::Count];
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot].InitAsShaderResourceView(0);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::MaterialSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::LightSlot].InitAsDescriptorTable(1, &ranges[5]);
+        rootParameters[GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot].InitAsConstantBufferView(0);
+        rootParameters[IrradianceCacheRootSignatureParams::PassConstantSlot].InitAsConstants(SizeOfInUint32(IrradianceCacheConstantBuffer), 2);
+
+        CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_irradianceCachePassGlobalRootSignature);
+    }
+
+    // Local Root Signature
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    {
+        CD3DX12_ROOT_PARAMETER rootParameters[LocalRootSignatureParams::Count];
+        rootParameters[LocalRootSignatureParams::CubeConstantSlot].InitAsConstants(SizeOfInUint32(m_cubeCB), 1);
+        CD3DX12_ROOT_SIGNATURE_DESC localRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+        localRootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+        SerializeAndCreateRaytracingRootSignature(localRootSignatureDesc, &m_irradianceCachePassLocalRootSignature);
+    }
+}
+
 void PixelMajorRenderer::CreateComputeFirstPassRootSignature()
 {
     auto device = m_deviceResources->GetD3DDevice();
     CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer, 0);
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer, 0);
 
     CD3DX12_ROOT_PARAMETER1 rootParameters[ComputeRootSignatureParams::Count];
     rootParameters[ComputeRootSignatureParams::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
@@ -583,7 +688,7 @@ void PixelMajorRenderer::CreateSecondPassPhotonPipelineStateObject()
     auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
     // PERFOMANCE TIP: Set max recursion depth as low as needed 
     // as drivers may apply optimization strategies for low recursion depths.
-    UINT maxRecursionDepth = 1; // ~ primary rays only. // TODO
+    UINT maxRecursionDepth = 2; // ~ primary rays and the shadow rays for direct lighting
     pipelineConfig->Config(maxRecursionDepth);
 
 #if _DEBUG
@@ -601,6 +706,140 @@ void PixelMajorRenderer::CreateSecondPassPhotonPipelineStateObject()
     }
 }
 
+// Creates the PSO for tracing importons from the camera
+void PixelMajorRenderer::CreateImportonPassPipelineStateObject()
+{
+    CD3D12_STATE_OBJECT_DESC raytracingPipeline{ D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE };
+
+    // DXIL library
+    // This contains the shaders and their entrypoints for the state object.
+    // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pPixelMajorImportonPassShader, ARRAYSIZE(g_pPixelMajorImportonPassShader));
+    lib->SetDXILLibrary(&libdxil);
+    // Define which shader exports to surface from the library.
+    // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
+    // In this sample, this could be ommited for convenience since the sample uses all shaders in the library. 
+    {
+        lib->DefineExport(c_raygenShaderName);
+        lib->DefineExport(c_closestHitShaderName);
+        lib->DefineExport(c_missShaderName);
+    }
+
+    // Triangle hit group
+    // A hit group specifies closest hit, any hit and intersection shaders to be executed when a ray intersects the geometry's triangle/AABB.
+    // In this sample, we only use triangle geometry with a closest hit shader, so others are not set.
+    auto hitGroup = raytracingPipeline.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    hitGroup->SetClosestHitShaderImport(c_closestHitShaderName);
+    hitGroup->SetHitGroupExport(c_hitGroupName);
+    hitGroup->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+
+    // Shader config
+    // Defines the maximum sizes in bytes for the ray payload and attribute structure.
+    auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    UINT payloadSize = sizeof(XMFLOAT4);    // float4 hitPosition
+    UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
+    shaderConfig->Config(payloadSize, attributeSize);
+
+    // Local root signature and shader association
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    CreateLocalRootSignatureSubobjects(&raytracingPipeline, &m_importonPassLocalRootSignature);
+
+    // Global root signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    auto globalRootSignature = raytracingPipeline.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    globalRootSignature->SetRootSignature(m_importonPassGlobalRootSignature.Get());
+
+    // Pipeline config
+    // Defines the maximum TraceRay() recursion depth.
+    auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    // PERFOMANCE TIP: Set max recursion depth as low as needed 
+    // as drivers may apply optimization strategies for low recursion depths.
+    UINT maxRecursionDepth = 1; // ~ primary rays only. // TODO
+    pipelineConfig->Config(maxRecursionDepth);
+
+#if _DEBUG
+    PrintStateObjectDesc(raytracingPipeline);
+#endif
+
+    // Create the state object.
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        ThrowIfFailed(m_fallbackDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_fallbackImportonPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+    else // DirectX Raytracing
+    {
+        ThrowIfFailed(m_dxrDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_dxrImportonPassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+}
+
+// Creates the PSO for populating the irradiance cache
+void PixelMajorRenderer::CreateIrradianceCachePassPipelineStateObject()
+{
+    CD3D12_STATE_OBJECT_DESC raytracingPipeline{ D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE };
+
+    // DXIL library
+    // This contains the shaders and their entrypoints for the state object.
+    // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
+    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pPixelMajorIrradianceCacheShader, ARRAYSIZE(g_pPixelMajorIrradianceCacheShader));
+    lib->SetDXILLibrary(&libdxil);
+    // Define which shader exports to surface from the library.
+    // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
+    // In this sample, this could be ommited for convenience since the sample uses all shaders in the library. 
+    {
+        lib->DefineExport(c_raygenShaderName);
+        lib->DefineExport(c_closestHitShaderName);
+        lib->DefineExport(c_missShaderName);
+    }
+
+    // Triangle hit group
+    // A hit group specifies closest hit, any hit and intersection shaders to be executed when a ray intersects the geometry's triangle/AABB.
+    // In this sample, we only use triangle geometry with a closest hit shader, so others are not set.
+    auto hitGroup = raytracingPipeline.CreateSubobject<CD3D12_HIT_GROUP_SUBOBJECT>();
+    hitGroup->SetClosestHitShaderImport(c_closestHitShaderName);
+    hitGroup->SetHitGroupExport(c_hitGroupName);
+    hitGroup->SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+
+    // Shader config
+    // Defines the maximum sizes in bytes for the ray payload and attribute structure.
+    auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
+    UINT payloadSize = 3 * sizeof(XMFLOAT4) + 2 * sizeof(XMFLOAT3);    // same payload as the final pass
+    UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
+    shaderConfig->Config(payloadSize, attributeSize);
+
+    // Local root signature and shader association
+    // This is a root signature that enables a shader to have unique arguments that come from shader tables.
+    CreateLocalRootSignatureSubobjects(&raytracingPipeline, &m_irradianceCachePassLocalRootSignature);
+
+    // Global root signature
+    // This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
+    auto globalRootSignature = raytracingPipeline.CreateSubobject<CD3D12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+    globalRootSignature->SetRootSignature(m_irradianceCachePassGlobalRootSignature.Get());
+
+    // Pipeline config
+    // Defines the maximum TraceRay() recursion depth.
+    auto pipelineConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT>();
+    // PERFOMANCE TIP: Set max recursion depth as low as needed 
+    // as drivers may apply optimization strategies for low recursion depths.
+    UINT maxRecursionDepth = 2; // ~ gather rays and the shadow rays at their hits
+    pipelineConfig->Config(maxRecursionDepth);
+
+#if _DEBUG
+    PrintStateObjectDesc(raytracingPipeline);
+#endif
+
+    // Create the state object.
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        ThrowIfFailed(m_fallbackDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_fallbackIrradianceCachePassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+    else // DirectX Raytracing
+    {
+        ThrowIfFailed(m_dxrDevice->CreateStateObject(raytracingPipeline, IID_PPV_ARGS(&m_dxrIrradianceCachePassStateObject)), L"Couldn't create DirectX Raytracing state object.\n");
+    }
+}
+
 void PixelMajorRenderer::CreateComputePipelineStateObject(const LPCWSTR& compiledShaderName, ComPtr<ID3D12PipelineState>& computePipeline)
 {
     auto device = m_deviceResources->GetD3DDevice();
@@ -720,6 +959,137 @@ void PixelMajorRenderer::CreatePhotonCountBuffer(GBuffer& gBuffer)
     gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
 }
 
+void PixelMajorRenderer::CreateImportanceBuffer()
+{
+    // Create a buffer for the importon counts
+    // One texel per projection map cell, so the light's sphere of directions is binned the same way as for caustics
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, PROJECTION_MAP_THETA_RES, PROJECTION_MAP_PHI_RES, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    UINT descriptorHeapIndex = m_importanceBuffer.uavDescriptorHeapIndex;
+    m_importanceBuffer = {};
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_importanceBuffer.textureResource)));
+    NAME_D3D12_OBJECT(m_importanceBuffer.textureResource);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    m_importanceBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, descriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+    device->CreateUnorderedAccessView(m_importanceBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    m_importanceBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_importanceBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+
+    // Readback buffer the counts are copied into before the emission distribution is built on the CPU
+    UINT64 readbackSize;
+    device->GetCopyableFootprints(&uavDesc, 0, 1, 0, nullptr, nullptr, nullptr, &readbackSize);
+
+    auto readbackHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(readbackSize);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeapProperties, D3D12_HEAP_FLAG_NONE, &readbackDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_importanceReadback)));
+    NAME_D3D12_OBJECT(m_importanceReadback);
+}
+
+// Read back the importon counts and upload the emission distribution the first pass samples photon directions from.
+void PixelMajorRenderer::BuildEmissionCDF()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto commandList = m_deviceResources->GetCommandList();
+    auto commandAllocator = m_deviceResources->GetCommandAllocator();
+
+    D3D12_RESOURCE_DESC importanceDesc = m_importanceBuffer.textureResource->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    device->GetCopyableFootprints(&importanceDesc, 0, 1, 0, &footprint, nullptr, nullptr, nullptr);
+
+    D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_importanceBuffer.textureResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    commandList->ResourceBarrier(1, &preCopyBarrier);
+
+    CD3DX12_TEXTURE_COPY_LOCATION destination(m_importanceReadback.Get(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION source(m_importanceBuffer.textureResource.Get(), 0);
+    commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+    D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_importanceBuffer.textureResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &postCopyBarrier);
+
+    m_deviceResources->ExecuteCommandList();
+    m_deviceResources->WaitForGpu();
+    commandList->Reset(commandAllocator, nullptr);
+
+    UINT8* importonCounts;
+    CD3DX12_RANGE readRange(0, footprint.Footprint.RowPitch * PROJECTION_MAP_PHI_RES);
+    ThrowIfFailed(m_importanceReadback->Map(0, &readRange, reinterpret_cast<void**>(&importonCounts)));
+    m_importanceMap.Build(reinterpret_cast<const UINT*>(importonCounts + footprint.Offset), footprint.Footprint.RowPitch / sizeof(UINT), IMPORTANCE_UNIFORM_MIX);
+    CD3DX12_RANGE writeRange(0, 0);        // Nothing was written on the CPU.
+    m_importanceReadback->Unmap(0, &writeRange);
+
+    const std::vector<XMFLOAT2>& emissionCDF = m_importanceMap.GetEmissionCDF();
+    m_emissionCDF.Reset();
+    AllocateUploadBuffer(device, (void*)emissionCDF.data(), emissionCDF.size() * sizeof(XMFLOAT2), &m_emissionCDF, L"EmissionCDF");
+
+    wstringstream debugText;
+    debugText << L"Importance map: " << m_importanceMap.GetTotalImportons() << L" importons landed in "
+        << m_importanceMap.GetVisibleCells() << L" of " << PROJECTION_MAP_NUM_CELLS << L" cells, "
+        << setprecision(2) << fixed << (100.0f * m_importanceMap.GetSteeredShare()) << L"% of the photons are steered into them\n";
+    OutputDebugString(debugText.str().c_str());
+}
+
+void PixelMajorRenderer::CreateIrradianceCacheBuffer(GBuffer& gBuffer, UINT numElements, UINT elementSize)
+{
+    // Create a structured buffer for the irradiance cache
+    // The cache keeps its records across frames, so it is only emptied when the photon map is rebuilt
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Buffer(UINT64(numElements) * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    UINT descriptorHeapIndex = gBuffer.uavDescriptorHeapIndex;
+    gBuffer = {};
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&gBuffer.textureResource)));
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    gBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, descriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    UAVDesc.Buffer.NumElements = numElements;
+    UAVDesc.Buffer.StructureByteStride = elementSize;
+    device->CreateUnorderedAccessView(gBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    gBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), gBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+}
+
+void PixelMajorRenderer::CreateRadiancePhotonBuffer()
+{
+    // Create a buffer for the radiance photons
+    // Laid out like the sorted photon G-Buffers, the estimate for a sorted photon sits at the same index
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_gBufferWidth, m_gBufferHeight, m_gBufferDepth, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+    UINT descriptorHeapIndex = m_radiancePhotonBuffer.uavDescriptorHeapIndex;
+    m_radiancePhotonBuffer = {};
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_radiancePhotonBuffer.textureResource)));
+    NAME_D3D12_OBJECT(m_radiancePhotonBuffer.textureResource);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
+    m_radiancePhotonBuffer.uavDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, descriptorHeapIndex);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+    UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+    UAVDesc.Texture2DArray.ArraySize = m_gBufferDepth;
+    device->CreateUnorderedAccessView(m_radiancePhotonBuffer.textureResource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    m_radiancePhotonBuffer.uavGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_radiancePhotonBuffer.uavDescriptorHeapIndex, m_descriptorSize);
+}
+
 void PixelMajorRenderer::CreateDescriptorHeap()
 {
     auto device = m_deviceResources->GetD3DDevice();
@@ -728,12 +1098,12 @@ void PixelMajorRenderer::CreateDescriptorHeap()
     // Allocate a heap for descriptors:
     // n - vertex SRVs
     // n - index SRVs
-    // n - constant buffer views for scene buffer info
-    // n - constant buffer views for materials
-    // n - constant buffer views for lights
+    // 1 - structured buffer SRV for the scene buffer info of every instance
+    // 1 - structured buffer SRV for the materials
+    // 1 - structured buffer SRV for the lights
     // n - bottom level acceleration structure fallback wrapped pointer UAVs
     // n - top level acceleration structure fallback wrapped pointer UAVs
-    descriptorHeapDesc.NumDescriptors = NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + GetNumDescriptorsForScene();
+    descriptorHeapDesc.NumDescriptors = NumRenderTargets + NumGBuffers + NumPhotonCountBuffer + NumPhotonScanBuffer + NumPhotonTempIndexBuffer + NumImportanceBuffer + NumIrradianceCacheBuffers + NumRadiancePhotonBuffer + GetNumDescriptorsForScene();
     descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     descriptorHeapDesc.NodeMask = 0;
@@ -878,6 +1248,138 @@ void PixelMajorRenderer::BuildSecondPassShaderTables()
     }
 }
 
+// Build shader tables.
+// This encapsulates all shader records - shaders and the arguments for their local root signatures.
+void PixelMajorRenderer::BuildImportonPassShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    m_importonPassShaderTableRes = {};
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackImportonPassStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrImportonPassStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+    }
+
+    // Ray gen shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
+        rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
+        m_importonPassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+    }
+
+    // Miss shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
+        missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
+        m_importonPassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+    }
+
+    // Hit group shader table
+    {
+        struct RootArguments {
+            CubeConstantBuffer cb;
+        } rootArguments;
+        rootArguments.cb = m_cubeCB;
+
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
+        ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
+        hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
+        m_importonPassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+    }
+}
+
+void PixelMajorRenderer::BuildIrradianceCachePassShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    m_irradianceCachePassShaderTableRes = {};
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackIrradianceCachePassStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrIrradianceCachePassStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+    }
+
+    // Ray gen shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable rayGenShaderTable(device, numShaderRecords, shaderRecordSize, L"RayGenShaderTable");
+        rayGenShaderTable.push_back(ShaderRecord(rayGenShaderIdentifier, shaderIdentifierSize));
+        m_irradianceCachePassShaderTableRes.m_rayGenShaderTable = rayGenShaderTable.GetResource();
+    }
+
+    // Miss shader table
+    {
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize;
+        ShaderTable missShaderTable(device, numShaderRecords, shaderRecordSize, L"MissShaderTable");
+        missShaderTable.push_back(ShaderRecord(missShaderIdentifier, shaderIdentifierSize));
+        m_irradianceCachePassShaderTableRes.m_missShaderTable = missShaderTable.GetResource();
+    }
+
+    // Hit group shader table
+    {
+        struct RootArguments {
+            CubeConstantBuffer cb;
+        } rootArguments;
+        rootArguments.cb = m_cubeCB;
+
+        UINT numShaderRecords = 1;
+        UINT shaderRecordSize = shaderIdentifierSize + sizeof(rootArguments);
+        ShaderTable hitGroupShaderTable(device, numShaderRecords, shaderRecordSize, L"HitGroupShaderTable");
+        hitGroupShaderTable.push_back(ShaderRecord(hitGroupShaderIdentifier, shaderIdentifierSize, &rootArguments, sizeof(rootArguments)));
+        m_irradianceCachePassShaderTableRes.m_hitGroupShaderTable = hitGroupShaderTable.GetResource();
+    }
+}
+
 void PixelMajorRenderer::SelectRaytracingAPI(RaytracingAPI type)
 {
     if (type == RaytracingAPI::FallbackLayer)
@@ -920,6 +1422,47 @@ void PixelMajorRenderer::OnKeyDown(UINT8 key)
         SelectRaytracingAPI(RaytracingAPI::DirectXRaytracing);
         break;
 
+    case 'L': // Toggle direct lighting with shadow rays, photons only for indirect
+    {
+        m_directLighting = !m_directLighting;
+        m_finalGather = m_finalGather && m_directLighting;
+        for (auto& sceneCB : m_sceneCB)
+        {
+            sceneCB.renderFlags = GetRenderFlags();
+        }
+
+        // The photon map changes, first bounce photons are only stored without direct lighting
+        m_calculatePhotonMap = true;
+    }
+    break;
+
+    case 'G': // Toggle final gathering through the irradiance cache, needs direct lighting
+    {
+        m_finalGather = !m_finalGather;
+        m_directLighting = m_directLighting || m_finalGather;
+        for (auto& sceneCB : m_sceneCB)
+        {
+            sceneCB.renderFlags = GetRenderFlags();
+        }
+
+        // Rebuilding the photon map also empties the cache
+        m_calculatePhotonMap = true;
+    }
+    break;
+
+    case 'P': // Toggle radiance photon lookups for the photon map
+    {
+        m_radiancePhotons = !m_radiancePhotons;
+        for (auto& sceneCB : m_sceneCB)
+        {
+            sceneCB.renderFlags = GetRenderFlags();
+        }
+
+        // Cached irradiance was gathered with the other estimate
+        m_calculatePhotonMap = m_calculatePhotonMap || m_finalGather;
+    }
+    break;
+
         // Camera Movements
     case 'W':
     {
@@ -1145,6 +1688,17 @@ void PixelMajorRenderer::OnUpdate()
 		UpdateCameraMatrices();
 	}
 
+    // Pick up edits to the scene file, the photon map is rebuilt for any of them
+    DXRPhotonMapper::SceneChange sceneChanges = ReloadScene();
+    if (DXRPhotonMapper::HasSceneChange(sceneChanges, DXRPhotonMapper::SceneChange::Topology))
+    {
+        RecreateD3D();
+    }
+    if (sceneChanges != DXRPhotonMapper::SceneChange::None)
+    {
+        m_calculatePhotonMap = true;
+    }
+
     /*
     // Rotate the camera around Y axis.
     {
@@ -1188,6 +1742,64 @@ void PixelMajorRenderer::ParseCommandLineArgs(WCHAR* argv[], int argc)
     }
 }
 
+void PixelMajorRenderer::DoImportonPass()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
+    {
+        // Since each shader table has only one shader record, the stride is same as the size.
+        dispatchDesc->HitGroupTable.StartAddress = m_importonPassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_importonPassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
+        dispatchDesc->MissShaderTable.StartAddress = m_importonPassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_importonPassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_importonPassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_importonPassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->Width = max(1U, m_width / IMPORTON_STRIDE);
+        dispatchDesc->Height = max(1U, m_height / IMPORTON_STRIDE);
+        dispatchDesc->Depth = 1;
+        commandList->SetPipelineState1(stateObject);
+        commandList->DispatchRays(dispatchDesc);
+    };
+
+    auto SetCommonPipelineState = [&](auto* descriptorSetCommandList)
+    {
+        descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+        // Set index and successive vertex buffer decriptor tables
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+    };
+
+    commandList->SetComputeRootSignature(m_importonPassGlobalRootSignature.Get());
+
+    // Copy the updated scene constant buffer to GPU.
+    memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+
+    // Bind the heaps, acceleration structure and dispatch rays.
+    D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        SetCommonPipelineState(m_fallbackCommandList.Get());
+        m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackImportonPassStateObject.Get(), &dispatchDesc);
+    }
+    else // DirectX Raytracing
+    {
+        SetCommonPipelineState(commandList);
+        commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
+        DispatchRays(m_dxrCommandList.Get(), m_dxrImportonPassStateObject.Get(), &dispatchDesc);
+    }
+}
+
 void PixelMajorRenderer::DoFirstPassPhotonMapping()
 {
     auto commandList = m_deviceResources->GetCommandList();
@@ -1217,9 +1829,9 @@ void PixelMajorRenderer::DoFirstPassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
@@ -1229,6 +1841,7 @@ void PixelMajorRenderer::DoFirstPassPhotonMapping()
     memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
     auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
     commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+    commandList->SetComputeRootShaderResourceView(ImportanceRootSignatureParams::EmissionCDFSlot, m_emissionCDF->GetGPUVirtualAddress());
 
     // Bind the heaps, acceleration structure and dispatch rays.
     D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
@@ -1275,9 +1888,9 @@ void PixelMajorRenderer::DoSecondPassPhotonMapping()
         // Set index and successive vertex buffer decriptor tables
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescriptors[0].sceneBufferDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescriptors[0].materialDescRes.gpuDescriptorHandle);
-        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescriptors[0].lightDescRes.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
         commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
     };
 
@@ -1304,6 +1917,77 @@ void PixelMajorRenderer::DoSecondPassPhotonMapping()
     }
 }
 
+// Populates the irradiance cache from a camera grid with the given pixel stride.
+void PixelMajorRenderer::DoIrradianceCachePass(UINT stride)
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
+    {
+        // Since each shader table has only one shader record, the stride is same as the size.
+        dispatchDesc->HitGroupTable.StartAddress = m_irradianceCachePassShaderTableRes.m_hitGroupShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->HitGroupTable.SizeInBytes = m_irradianceCachePassShaderTableRes.m_hitGroupShaderTable->GetDesc().Width;
+        dispatchDesc->HitGroupTable.StrideInBytes = dispatchDesc->HitGroupTable.SizeInBytes;
+        dispatchDesc->MissShaderTable.StartAddress = m_irradianceCachePassShaderTableRes.m_missShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->MissShaderTable.SizeInBytes = m_irradianceCachePassShaderTableRes.m_missShaderTable->GetDesc().Width;
+        dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
+        dispatchDesc->RayGenerationShaderRecord.StartAddress = m_irradianceCachePassShaderTableRes.m_rayGenShaderTable->GetGPUVirtualAddress();
+        dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_irradianceCachePassShaderTableRes.m_rayGenShaderTable->GetDesc().Width;
+        dispatchDesc->Width = max(1U, m_width / stride);
+        dispatchDesc->Height = max(1U, m_height / stride);
+        dispatchDesc->Depth = 1;
+        commandList->SetPipelineState1(stateObject);
+        commandList->DispatchRays(dispatchDesc);
+    };
+
+    auto SetCommonPipelineState = [&](auto* descriptorSetCommandList)
+    {
+        descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+        // Set index and successive vertex buffer decriptor tables
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::IndexBuffersSlot, m_geometryBuffers[0].indexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::VertexBuffersSlot, m_geometryBuffers[0].vertexBuffer.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::GeomIndexSlot, m_sceneBufferDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::MaterialSlot, m_materialDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::LightSlot, m_lightDescs.gpuDescriptorHandle);
+        commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParamsWithPrimitives::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+    };
+
+    commandList->SetComputeRootSignature(m_irradianceCachePassGlobalRootSignature.Get());
+
+    // Copy the updated scene constant buffer to GPU.
+    memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
+    commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParamsWithPrimitives::SceneConstantSlot, cbGpuAddress);
+
+    // Each pass only interpolates records from earlier passes, its own records are still being written
+    commandList->SetComputeRoot32BitConstant(IrradianceCacheRootSignatureParams::PassConstantSlot, m_irradianceCachePass++, 0);
+
+    // Bind the heaps, acceleration structure and dispatch rays.
+    D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        SetCommonPipelineState(m_fallbackCommandList.Get());
+        m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_fallBackPrimitiveTLAS);
+        DispatchRays(m_fallbackCommandList.Get(), m_fallbackIrradianceCachePassStateObject.Get(), &dispatchDesc);
+    }
+    else // DirectX Raytracing
+    {
+        SetCommonPipelineState(commandList);
+        commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParamsWithPrimitives::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
+        DispatchRays(m_dxrCommandList.Get(), m_dxrIrradianceCachePassStateObject.Get(), &dispatchDesc);
+    }
+
+    // The next, finer pass looks up the records this one inserted
+    D3D12_RESOURCE_BARRIER cacheBarriers[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::UAV(m_irradianceCacheRecords.textureResource.Get()),
+        CD3DX12_RESOURCE_BARRIER::UAV(m_irradianceCacheHeads.textureResource.Get()),
+        CD3DX12_RESOURCE_BARRIER::UAV(m_irradianceCacheCounter.textureResource.Get())
+    };
+    commandList->ResourceBarrier(ARRAYSIZE(cacheBarriers), cacheBarriers);
+}
+
 void PixelMajorRenderer::DoComputePass(ComPtr<ID3D12PipelineState>& computePSO, UINT xThreads, UINT yThreads, UINT zThreads)
 {
     auto commandList = m_deviceResources->GetCommandList();
@@ -1401,6 +2085,11 @@ void PixelMajorRenderer::CreateWindowSizeDependentResources()
     CreatePhotonCountBuffer(m_photonScanBuffer);
     CreatePhotonCountBuffer(m_photonTempIndexBuffer);
     CreateGBuffers(); // TODO is this right?
+    CreateImportanceBuffer();
+    CreateIrradianceCacheBuffer(m_irradianceCacheRecords, IRRADIANCE_CACHE_MAX_RECORDS, sizeof(IrradianceCacheRecord));
+    CreateIrradianceCacheBuffer(m_irradianceCacheHeads, IRRADIANCE_CACHE_HASH_SIZE, sizeof(UINT));
+    CreateIrradianceCacheBuffer(m_irradianceCacheCounter, 1, sizeof(UINT));
+    CreateRadiancePhotonBuffer();
     UpdateCameraMatrices();
 }
 
@@ -1413,6 +2102,14 @@ void PixelMajorRenderer::ReleaseWindowSizeDependentResources()
     {
         gBuffer.textureResource.Reset();
     }
+
+    m_importanceBuffer.textureResource.Reset();
+    m_importanceReadback.Reset();
+
+    m_irradianceCacheRecords.textureResource.Reset();
+    m_irradianceCacheHeads.textureResource.Reset();
+    m_irradianceCacheCounter.textureResource.Reset();
+    m_radiancePhotonBuffer.textureResource.Reset();
 }
 
 // Release all resources that depend on the device.
@@ -1426,13 +2123,25 @@ void PixelMajorRenderer::ReleaseDeviceDependentResources()
 
     m_computeRootSignature.Reset();
 
+    m_fallbackImportonPassStateObject.Reset();
+    m_importonPassGlobalRootSignature.Reset();
+    m_importonPassLocalRootSignature.Reset();
+
+    m_fallbackIrradianceCachePassStateObject.Reset();
+    m_irradianceCachePassGlobalRootSignature.Reset();
+    m_irradianceCachePassLocalRootSignature.Reset();
+
     m_dxrDevice.Reset();
     m_dxrCommandList.Reset();
     m_dxrFirstPassStateObject.Reset();
+    m_dxrImportonPassStateObject.Reset();
+    m_dxrIrradianceCachePassStateObject.Reset();
 
     m_computeFirstPassPSO.Reset();
     m_computeSecondPassPSO.Reset();
     m_computeThirdPassPSO.Reset();
+    m_computeClearCachePSO.Reset();
+    m_computeRadiancePhotonPSO.Reset();
 
     m_descriptorHeap.Reset();
     m_descriptorsAllocated = 0;
@@ -1446,6 +2155,13 @@ void PixelMajorRenderer::ReleaseDeviceDependentResources()
     m_photonCountBuffer.uavDescriptorHeapIndex = UINT_MAX;
     m_photonScanBuffer.uavDescriptorHeapIndex = UINT_MAX;
     m_photonTempIndexBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    m_importanceBuffer.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheRecords.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheHeads.uavDescriptorHeapIndex = UINT_MAX;
+    m_irradianceCacheCounter.uavDescriptorHeapIndex = UINT_MAX;
+    m_radiancePhotonBuffer.uavDescriptorHeapIndex = UINT_MAX;
+
+    m_emissionCDF.Reset();
 
     m_perFrameConstants.Reset();
 
@@ -1459,7 +2175,16 @@ void PixelMajorRenderer::ReleaseDeviceDependentResources()
     m_secondPassShaderTableRes.m_missShaderTable.Reset();
     m_secondPassShaderTableRes.m_hitGroupShaderTable.Reset();
 
-    m_topLevelAccelerationStructure.Reset();
+    m_importonPassShaderTableRes.m_rayGenShaderTable.Reset();
+    m_importonPassShaderTableRes.m_missShaderTable.Reset();
+    m_importonPassShaderTableRes.m_hitGroupShaderTable.Reset();
+
+    m_irradianceCachePassShaderTableRes.m_rayGenShaderTable.Reset();
+    m_irradianceCachePassShaderTableRes.m_missShaderTable.Reset();
+    m_irradianceCachePassShaderTableRes.m_hitGroupShaderTable.Reset();
+
+    // Vertex, index and scene table buffers, BLASes and the TLAS
+    ReleaseSceneResources();
 
     m_fence.Reset();
 
@@ -1479,6 +2204,13 @@ void PixelMajorRenderer::RecreateD3D()
     m_deviceResources->HandleDeviceLost();
 }
 
+// Scene constant render flags for the current application state.
+UINT PixelMajorRenderer::GetRenderFlags() const
+{
+    return (m_directLighting ? RENDER_FLAG_DIRECT_LIGHTING : 0) | (m_finalGather ? RENDER_FLAG_FINAL_GATHER : 0) |
+        (m_radiancePhotons ? RENDER_FLAG_RADIANCE_PHOTONS : 0);
+}
+
 // Render the scene.
 void PixelMajorRenderer::OnRender()
 {
@@ -1505,10 +2237,18 @@ void PixelMajorRenderer::OnRender()
 
         DoComputePass(m_computeInitializePSO2, m_gBufferWidth, m_gBufferHeight, m_gBufferDepth);
 
+        // Cached irradiance was gathered from the old photon map
+        DoComputePass(m_computeClearCachePSO, (max(IRRADIANCE_CACHE_MAX_RECORDS, IRRADIANCE_CACHE_HASH_SIZE) + 127) / 128, 1, 1);
+        m_irradianceCachePass = 0;
+
         m_deviceResources->ExecuteCommandList();
         m_deviceResources->WaitForGpu();
         commandList->Reset(commandAllocator, nullptr);
 
+        // Trace importons from the camera and steer the photon emission towards what they see
+        DoImportonPass();
+        BuildEmissionCDF();
+
         // Performs:
         // 1. Photon Generation
         // 2. Photon Traversal
@@ -1570,6 +2310,22 @@ void PixelMajorRenderer::OnRender()
         m_deviceResources->WaitForGpu();
         commandList->Reset(commandAllocator, nullptr);
 
+        // Precompute the radiance photons from their sorted neighbours
+        const UINT numRadiancePhotons = (m_gBufferWidth * m_gBufferHeight * m_gBufferDepth + RADIANCE_PHOTON_STRIDE - 1) / RADIANCE_PHOTON_STRIDE;
+        DoComputePass(m_computeRadiancePhotonPSO, (numRadiancePhotons + 127) / 128, 1, 1);
+
+        m_deviceResources->ExecuteCommandList();
+        m_deviceResources->WaitForGpu();
+        commandList->Reset(commandAllocator, nullptr);
+
+    }
+
+    // Fill in the irradiance cache coarse to fine, finer passes only gather where coarser records don't reach
+    if (m_finalGather)
+    {
+        DoIrradianceCachePass(16);
+        DoIrradianceCachePass(8);
+        DoIrradianceCachePass(4);
     }
 
     DoSecondPassPhotonMapping();
@@ -1639,7 +2395,10 @@ void PixelMajorRenderer::CalculateFrameStats()
         windowText << setprecision(2) << fixed
             << L"    fps: " << fps << L"     ~Million Primary Rays/s: " << MRaysPerSecond
             << L"    GPU[" << m_deviceResources->GetAdapterID() << L"]: " << m_deviceResources->GetAdapterDescription()
-            << L"    # Photons " << NumPhotons;
+            << L"    # Photons " << NumPhotons
+            << (m_directLighting ? L"    Direct: Shadow Rays" : L"    Direct: Photons")
+            << (m_finalGather ? L"    Indirect: Irradiance Cache" : L"")
+            << (m_radiancePhotons ? L"    Radiance Photons" : L"");
         SetCustomWindowText(windowText.str().c_str());
     }
 }
@@ -5,6 +5,7 @@
 #include "RaytracingHlslCompat.h"
 #include "Common.h"
 #include "DirectXRaytracingHelper.h"
+#include "PMImportanceMap.h"
 
 // The sample supports both Raytracing Fallback Layer and DirectX Raytracing APIs. 
 // This is purely for demonstration purposes to show where the API differences are. 
@@ -38,6 +39,9 @@ private:
     static const UINT NumPhotonCountBuffer = 1;
     static const UINT NumPhotonScanBuffer = 1;
     static const UINT NumPhotonTempIndexBuffer = 1;
+    static const UINT NumImportanceBuffer = 1;
+    static const UINT NumIrradianceCacheBuffers = 3;
+    static const UINT NumRadiancePhotonBuffer = 1;
     static const UINT NumPhotons = 100000;
 
 	bool cameraNeedsUpdate = false;
@@ -65,9 +69,13 @@ private:
 
     ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackFirstPassStateObject;
     ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackSecondPassStateObject;
+    ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackImportonPassStateObject;
+    ComPtr<ID3D12RaytracingFallbackStateObject> m_fallbackIrradianceCachePassStateObject;
 
     ComPtr<ID3D12StateObject> m_dxrFirstPassStateObject;
     ComPtr<ID3D12StateObject> m_dxrSecondPassStateObject;
+    ComPtr<ID3D12StateObject> m_dxrImportonPassStateObject;
+    ComPtr<ID3D12StateObject> m_dxrIrradianceCachePassStateObject;
 
 	// Compute Stage attributes
 	ComPtr<ID3D12PipelineState> m_computeInitializePSO;
@@ -75,6 +83,8 @@ private:
 	ComPtr<ID3D12PipelineState> m_computeFirstPassPSO;
 	ComPtr<ID3D12PipelineState> m_computeSecondPassPSO;
 	ComPtr<ID3D12PipelineState> m_computeThirdPassPSO;
+	ComPtr<ID3D12PipelineState> m_computeClearCachePSO;
+	ComPtr<ID3D12PipelineState> m_computeRadiancePhotonPSO;
 
     // Root signatures for the first pass
     ComPtr<ID3D12RootSignature> m_firstPassGlobalRootSignature;
@@ -84,6 +94,14 @@ private:
 	ComPtr<ID3D12RootSignature> m_secondPassGlobalRootSignature;
     ComPtr<ID3D12RootSignature> m_secondPassLocalRootSignature;
 
+    // Root signatures for the importon pass
+    ComPtr<ID3D12RootSignature> m_importonPassGlobalRootSignature;
+    ComPtr<ID3D12RootSignature> m_importonPassLocalRootSignature;
+
+    // Root signatures for the irradiance cache pass
+    ComPtr<ID3D12RootSignature> m_irradianceCachePassGlobalRootSignature;
+    ComPtr<ID3D12RootSignature> m_irradianceCachePassLocalRootSignature;
+
 	// Root signature for the compute pass
     ComPtr<ID3D12RootSignature> m_computeRootSignature;
 
@@ -103,6 +121,20 @@ private:
 	GBuffer m_photonScanBuffer;
 	GBuffer m_photonTempIndexBuffer;
 
+    // Importance driven emission
+    GBuffer m_importanceBuffer;
+    ComPtr<ID3D12Resource> m_importanceReadback;
+    ComPtr<ID3D12Resource> m_emissionCDF;
+    DXRPhotonMapper::PMImportanceMap m_importanceMap;
+
+    // Irradiance cache for final gathering, records are bucketed by a spatial hash
+    GBuffer m_irradianceCacheRecords;
+    GBuffer m_irradianceCacheHeads;
+    GBuffer m_irradianceCacheCounter;
+    UINT m_irradianceCachePass;
+
+    // Precomputed radiance estimates at a subset of the sorted photons
+    GBuffer m_radiancePhotonBuffer;
 
     // Raytracing output
     ComPtr<ID3D12Resource> m_raytracingOutput;
@@ -120,6 +152,8 @@ private:
     static const LPCWSTR c_computeShaderPass1;
     static const LPCWSTR c_computeShaderPass2;
 	static const LPCWSTR c_computeShaderPass3;
+    static const LPCWSTR c_computeShaderClearCache;
+    static const LPCWSTR c_computeShaderRadiancePhotons;
 
 	struct ShaderTableRes
 	{
@@ -130,11 +164,16 @@ private:
 
 	ShaderTableRes m_firstPassShaderTableRes;
 	ShaderTableRes m_secondPassShaderTableRes;
+	ShaderTableRes m_importonPassShaderTableRes;
+	ShaderTableRes m_irradianceCachePassShaderTableRes;
 
 
     // Application state
     bool m_forceComputeFallback;
 	bool m_calculatePhotonMap;
+    bool m_directLighting;
+    bool m_finalGather;
+    bool m_radiancePhotons;
     StepTimer m_timer;
     float m_curRotationAngleRad;
     XMVECTOR m_eye;
@@ -146,9 +185,12 @@ private:
     void UpdateCameraMatrices();
     void InitializeScene();
     void RecreateD3D();
+    UINT GetRenderFlags() const;
 
+    void DoImportonPass();
     void DoFirstPassPhotonMapping();
     void DoSecondPassPhotonMapping();
+    void DoIrradianceCachePass(UINT stride);
 	void DoComputePass(ComPtr<ID3D12PipelineState>& computePSO, UINT xThreads, UINT yThreads, UINT zThreads);
 
     void CreateConstantBuffers();
@@ -163,20 +205,30 @@ private:
 
     void CreateFirstPassRootSignatures();
     void CreateSecondPassRootSignatures();
+    void CreateImportonPassRootSignatures();
+    void CreateIrradianceCachePassRootSignatures();
 	void CreateComputeFirstPassRootSignature();
 
 
     void CreateLocalRootSignatureSubobjects(CD3D12_STATE_OBJECT_DESC* raytracingPipeline, ComPtr<ID3D12RootSignature>* rootSig);
     void CreateFirstPassPhotonPipelineStateObject();
     void CreateSecondPassPhotonPipelineStateObject();
+    void CreateImportonPassPipelineStateObject();
+    void CreateIrradianceCachePassPipelineStateObject();
 	void CreateComputePipelineStateObject(const LPCWSTR& compiledShaderName, ComPtr<ID3D12PipelineState>& computePipeline);
     void CreateDescriptorHeap();
     void CreateRaytracingOutputResource();
     void CreateGBuffers();
 	void CreatePhotonCountBuffer(GBuffer& gBuffer);
+    void CreateImportanceBuffer();
+    void BuildEmissionCDF();
+    void CreateIrradianceCacheBuffer(GBuffer& gBuffer, UINT numElements, UINT elementSize);
+    void CreateRadiancePhotonBuffer();
 
     void BuildFirstPassShaderTables();
     void BuildSecondPassShaderTables();
+    void BuildImportonPassShaderTables();
+    void BuildIrradianceCachePassShaderTables();
     void SelectRaytracingAPI(RaytracingAPI type);
     void UpdateForSizeChange(UINT clientWidth, UINT clientHeight);
     void CopyRaytracingOutputToBackbuffer();
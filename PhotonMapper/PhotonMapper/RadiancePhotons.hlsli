@@ -0,0 +1,65 @@
+#ifndef RADIANCEPHOTONS_H
+#define RADIANCEPHOTONS_H
+
+// Precomputed radiance at every RADIANCE_PHOTON_STRIDE-th sorted photon, filled in by PixelMajorComputePass5.
+// Uses GPhotonCount, GPhotonScan and GPhotonSortedPos, which have to be declared before this file is included.
+RWTexture2DArray<float4> GRadiancePhotons : register(u12);
+
+inline uint3 RadiancePhotonIndex(uint id)
+{
+    uint width, height, depth;
+    GRadiancePhotons.GetDimensions(width, height, depth);
+    return uint3(id % width, (id / width) % height, min(id / (width * height), depth - 1));
+}
+
+// Nearest radiance photon within PIXEL_MAJOR_PHOTON_CLOSENESS, a single lookup instead of a density estimate
+inline bool LookupRadiancePhoton(float3 position, out float3 radiance)
+{
+    int3 cellId = int3(floor(POS_TO_CELL_X(position.x)), floor(POS_TO_CELL_Y(position.y)), floor(POS_TO_CELL_Z(position.z)));
+
+    float nearestDistanceSquared = PIXEL_MAJOR_PHOTON_CLOSENESS_SQUARED;
+    uint nearest = 0xffffffff;
+
+    // CELL_SIZE is at least the search radius, so the neighbouring cells cover it
+    for (int z = -1; z <= 1; ++z)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                int3 currCell = cellId + int3(x, y, z);
+                if (any(currCell < 0) || any(currCell >= int3(NUM_CELLS_IN_X, NUM_CELLS_IN_Y, NUM_CELLS_IN_Z)))
+                {
+                    continue;
+                }
+
+                uint start = GPhotonScan[currCell];
+                uint end = start + GPhotonCount[currCell];
+
+                // Only photons on the stride carry an estimate
+                uint photon = ((start + RADIANCE_PHOTON_STRIDE - 1) / RADIANCE_PHOTON_STRIDE) * RADIANCE_PHOTON_STRIDE;
+                for (; photon < end; photon += RADIANCE_PHOTON_STRIDE)
+                {
+                    float3 distVec = position - GPhotonSortedPos[RadiancePhotonIndex(photon)].xyz;
+                    float distanceSquared = dot(distVec, distVec);
+                    if (distanceSquared < nearestDistanceSquared)
+                    {
+                        nearestDistanceSquared = distanceSquared;
+                        nearest = photon;
+                    }
+                }
+            }
+        }
+    }
+
+    radiance = float3(0.0f, 0.0f, 0.0f);
+    if (nearest == 0xffffffff)
+    {
+        return false;
+    }
+
+    radiance = GRadiancePhotons[RadiancePhotonIndex(nearest)].xyz;
+    return true;
+}
+
+#endif // RADIANCEPHOTONS_H
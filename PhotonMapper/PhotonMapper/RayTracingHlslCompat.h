@@ -56,6 +56,127 @@ typedef UINT16 Index;
 // Material Constants
 #define AMBIENT_LIGHT 0.2f
 
+// Render flags, set in SceneConstantBuffer::renderFlags
+// Direct lighting is computed with shadow rays to the light and the photon map only holds photons from the second bounce on
+#define RENDER_FLAG_DIRECT_LIGHTING (1 << 0)
+// Indirect lighting at the visible points comes from the irradiance cache instead of the photon density estimate
+#define RENDER_FLAG_FINAL_GATHER (1 << 1)
+// Photon map lookups read the nearest precomputed radiance photon instead of summing the photons around the point
+#define RENDER_FLAG_RADIANCE_PHOTONS (1 << 2)
+// Photon Major splats are binned by screen tile and accumulated in float, instead of atomically added to the staging buffers
+#define RENDER_FLAG_BINNED_SPLAT (1 << 3)
+// Photon Major staged flux is resolved by a screen space gather over the neighbouring pixels on the same surface
+#define RENDER_FLAG_DENSITY_GATHER (1 << 4)
+
+// Radiant intensity the scene constant light's diffuse color is scaled by when direct lighting is enabled
+#define POINT_LIGHT_INTENSITY 40.0f
+
+// Mirrors DXRPhotonMapper::MaterialFlag so that shaders can branch on the material type
+#define MATERIAL_FLAG_REFLECTION    (1 << 0)
+#define MATERIAL_FLAG_TRANSMISSION  (1 << 1)
+#define MATERIAL_FLAG_DIFFUSE       (1 << 2)
+#define MATERIAL_FLAG_GLOSSY        (1 << 3)
+#define MATERIAL_FLAG_SPECULAR      (1 << 4)
+
+// Caustics - Projection Map
+// The sphere of directions around the light is split into cells using the same (theta, phi) mapping as SquareToSphereUniform.
+// A cell is flagged if any direction inside it can reach a specular primitive.
+#define PROJECTION_MAP_THETA_RES 128
+#define PROJECTION_MAP_PHI_RES 64
+#define PROJECTION_MAP_NUM_CELLS (PROJECTION_MAP_THETA_RES * PROJECTION_MAP_PHI_RES)
+
+// Importance driven emission (Pixel Major)
+// Importons are traced from the camera on a grid IMPORTON_STRIDE times coarser than the screen along each axis.
+// Every importon that lands on a surface votes for the projection map cell the light sees that surface through.
+#define IMPORTON_STRIDE 4
+// Share of the emission pdf that stays uniform over the sphere, so that no direction loses all its photons
+#define IMPORTANCE_UNIFORM_MIX 0.1f
+
+// Photon Major camera visibility
+// A photon is visible when its distance to the camera is within this fraction of the depth the camera sees at its pixel,
+// and it lies on the same instance. Anything the depth buffer can't settle falls back to a shadow ray.
+#define CAMERA_DEPTH_TOLERANCE 0.01f
+#define CAMERA_DEPTH_MISS 1.0e30f
+
+// Photon Major binned splatting
+// Visible photons are counting sorted by the SPLAT_TILE_SIZE x SPLAT_TILE_SIZE screen tile they land in,
+// then one thread group per tile sums its photons in registers and writes every pixel once.
+// Each photon is splatted as a disk of PHOTON_SPLAT_RADIUS lying in its surface, projected to a screen space ellipse.
+// Footprints are clamped to SPLAT_TILE_SIZE pixels so a tile only gathers from its neighbouring tiles' bins.
+#define PHOTON_SPLAT_RADIUS 0.02f
+#define SPLAT_TILE_SIZE 16
+#define SPLAT_SCAN_THREADS 1024
+// The binning passes stride over the visible photons with this many groups of 128 threads, the count is only known on the GPU
+#define SPLAT_BIN_GROUPS 1024
+#define SPLAT_INVALID_PIXEL 0xffffffff
+
+// Photon Major temporal reuse
+// On camera motion the binned accumulation is reprojected into the new view instead of cleared.
+// History is kept where the reprojected surface matches the previous depth and ID within TEMPORAL_DEPTH_TOLERANCE,
+// and its summed kernel weight is capped at TEMPORAL_MAX_HISTORY_WEIGHT so the new view's splats take over quickly.
+#define TEMPORAL_DEPTH_TOLERANCE 0.02f
+#define TEMPORAL_MAX_HISTORY_WEIGHT 64.0f
+
+// Photon Major denoising
+// Edge avoiding a-trous wavelet filter, run on the CPU over the read back output.
+// Iteration i spreads the 5x5 B3 spline kernel over taps 2^i pixels apart, so n iterations reach 2^(n+1) - 2 pixels out.
+// Taps are weighted down across normals (cos^DENOISE_NORMAL_POWER, a power of two), relative depth and luminance steps.
+// The color sigma is halved every iteration, as coarser levels have already smoothed away the noise.
+#define DENOISE_DEFAULT_ITERATIONS 5
+#define DENOISE_MAX_ITERATIONS 6
+#define DENOISE_NORMAL_POWER 128
+#define DENOISE_SIGMA_DEPTH 0.05f
+#define DENOISE_SIGMA_LUMINANCE 0.5f
+// Lighting is filtered with the albedo divided out, so texture and material edges are not blurred
+#define DENOISE_MIN_ALBEDO 0.01f
+
+// Photon Major flux accumulation (atomic splatting path)
+// Photon flux is summed per pixel in 64 bit fixed point, FLUX_FIXED_POINT_SCALE steps per unit, so neither
+// bright HDR photons nor dim late bounces are lost, and 2^44 units of flux fit before a pixel overflows.
+// A single photon carries at most FLUX_MAX_PHOTON, so its fixed point value fits the 32 bit add.
+// The resolve divides the sum by the photons emitted, pi and the pixel's footprint on the surface,
+// which is tilted by at most 1 / DENSITY_MIN_COSINE. The light's unit power is scaled by DENSITY_EXPOSURE for display.
+#define FLUX_FIXED_POINT_SCALE 1048576.0f
+#define FLUX_MAX_PHOTON 4095.0f
+#define DENSITY_MIN_COSINE 0.1f
+#define DENSITY_EXPOSURE 400.0f
+
+// Photon Major density gather
+// Each pixel sums the staged flux and the footprint areas of the pixels within DENSITY_GATHER_RADIUS that see the same
+// surface, weighted by an Epanechnikov kernel, the relative depth step and the normal agreement, and divides the two.
+// The estimate stays a density over the surface, so brightness does not depend on the resolution,
+// and a radius of 0 is the plain per pixel resolve.
+#define DENSITY_GATHER_RADIUS 3
+#define DENSITY_GATHER_SIGMA_DEPTH 0.02f
+#define DENSITY_GATHER_NORMAL_POWER 16
+
+// Photon Major adaptive photon budget
+// The photon G buffer is allocated for NumPhotons once, the budget only picks how many of its rows are traced and splatted,
+// so it can grow and shrink every frame without touching any allocation. Photon directions are random, so any rows are
+// an unbiased subset. The GPU frame is aimed at PHOTON_BUDGET_HEADROOM of the refresh interval, because on a fixed
+// refresh display a dropped frame is worse than a noisier one: rows are cut at once and grow back by PHOTON_BUDGET_GROWTH.
+#define PHOTON_BUDGET_TARGET_MS (1000.0f / 60.0f)
+#define PHOTON_BUDGET_HEADROOM 0.85f
+#define PHOTON_BUDGET_GROWTH 1.05f
+#define PHOTON_BUDGET_SMOOTHING 0.2f
+#define PHOTON_BUDGET_MIN_ROWS 8
+
+// Every RADIANCE_PHOTON_STRIDE-th sorted photon gets a precomputed radiance estimate
+#define RADIANCE_PHOTON_STRIDE 4
+
+// Irradiance cache (Pixel Major final gather)
+// Ward style cache: hemisphere gather rays are only shot at sparse records, every other point interpolates them.
+// Records are hashed by the IRRADIANCE_CACHE_CELL_SIZE cell they sit in, each bucket is a lock free linked list.
+#define IRRADIANCE_CACHE_MAX_RECORDS (1 << 16)
+#define IRRADIANCE_CACHE_HASH_SIZE (1 << 16)
+#define IRRADIANCE_CACHE_CELL_SIZE 0.5f
+#define IRRADIANCE_CACHE_ERROR 0.25f // Ward's a, a record is used where its weight is above 1 / a
+#define IRRADIANCE_CACHE_MIN_RADIUS 0.3f
+#define IRRADIANCE_CACHE_MAX_RADIUS (IRRADIANCE_CACHE_CELL_SIZE / IRRADIANCE_CACHE_ERROR) // A record never reaches past the neighbouring cells
+#define IRRADIANCE_CACHE_GATHER_RAYS 64
+#define IRRADIANCE_CACHE_MAX_BUCKET_WALK 64
+#define IRRADIANCE_CACHE_INVALID 0xffffffff
+
 
 struct SceneConstantBuffer
 {
@@ -65,6 +186,41 @@ struct SceneConstantBuffer
     XMVECTOR lightPosition;
     XMVECTOR lightAmbientColor;
     XMVECTOR lightDiffuseColor;
+    UINT renderFlags;
+    UINT photonBatch; // Mixed into the photon tracing seeds, so every progressive batch traces new paths
+    float fluxToRadiance; // Scales the staged flux sum to radiance, see DENSITY_EXPOSURE
+    UINT photonRows; // Rows of the photon G buffer splatted this frame, see PHOTON_BUDGET_TARGET_MS
+};
+
+struct ReprojectionConstantBuffer
+{
+    XMMATRIX prevViewProj;
+    XMVECTOR prevCameraPosition;
+};
+
+struct SplatRecord
+{
+    XMFLOAT4 footprint; // Inverse of the ellipse's screen space axes, row major 2x2. Zero when it is smaller than a pixel
+    XMFLOAT3 color;
+    float normalization; // Scales the kernel to integrate to one over the footprint
+    XMFLOAT2 center; // Projected photon position, in pixels
+    UINT pixel; // Packed pixel of the center, SPLAT_INVALID_PIXEL if the photon is hidden
+    float padding;
+};
+
+struct IrradianceCacheRecord
+{
+    XMFLOAT3 position;
+    float radius; // Harmonic mean distance to the surfaces the gather rays hit
+    XMFLOAT3 normal;
+    UINT next; // Next record in the same hash bucket
+    XMFLOAT3 irradiance;
+    UINT passIndex; // Population pass that created the record
+};
+
+struct IrradianceCacheConstantBuffer
+{
+    UINT passIndex;
 };
 
 struct PixelMajorComputeConstantBuffer
@@ -89,6 +245,8 @@ struct SceneBufferDesc
 {
     UINT vbIndex;
     UINT materialIndex;
+    UINT indexSizeInBytes;  // 2 or 4, meshes with more vertices than 16 bits address use 32 bit indices
+    UINT pad0;              // Structured buffers are packed tightly, the matrix starts at 16 bytes on both sides
     XMMATRIX normalTransformMat;
 };
 
@@ -96,6 +254,8 @@ struct MaterialDesc
 {
     UINT materialID;
     XMFLOAT3 albedo;
+    UINT materialFlags;
+    float refractiveIndex;
 };
 
 struct LightDesc
@@ -0,0 +1,53 @@
+#ifndef SPLATBINS_H
+#define SPLATBINS_H
+
+// Binned splatting buffers, shared by the splat pass, the binning compute passes and the resolve
+// Splats in visible photon list order
+RWStructuredBuffer<SplatRecord> GSplats : register(u14);
+// Position of each splat within its tile's bin
+RWStructuredBuffer<uint> GSplatSlots : register(u15);
+// Splats counting sorted by tile
+RWStructuredBuffer<SplatRecord> GSortedSplats : register(u16);
+RWStructuredBuffer<uint> GSplatTileCounts : register(u17);
+RWStructuredBuffer<uint> GSplatTileOffsets : register(u18);
+// Float accumulation, rgb is the kernel weighted color and a the summed kernel weight
+RWTexture2D<float4> GSplatAccum : register(u19);
+
+inline uint PackSplatPixel(uint2 pixel)
+{
+    return pixel.x | (pixel.y << 16);
+}
+
+inline uint2 UnpackSplatPixel(uint packedPixel)
+{
+    return uint2(packedPixel & 0xffff, packedPixel >> 16);
+}
+
+inline uint2 SplatTileDims()
+{
+    uint width, height;
+    GSplatAccum.GetDimensions(width, height);
+    return (uint2(width, height) + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE;
+}
+
+inline uint SplatTileIndex(uint2 pixel)
+{
+    uint2 tile = pixel / SPLAT_TILE_SIZE;
+    return tile.x + tile.y * SplatTileDims().x;
+}
+
+// Epanechnikov kernel over the splat's ellipse, evaluated at a pixel center
+inline float SplatWeight(SplatRecord splat, uint2 pixel)
+{
+    if (all(splat.footprint == 0.0f))
+    {
+        return all(pixel == UnpackSplatPixel(splat.pixel)) ? 1.0f : 0.0f;
+    }
+
+    float2 offset = (pixel + 0.5f) - splat.center;
+    float2 uv = float2(dot(splat.footprint.xy, offset), dot(splat.footprint.zw, offset));
+    float radiusSquared = dot(uv, uv);
+    return (radiusSquared < 1.0f) ? (1.0f - radiusSquared) * splat.normalization : 0.0f;
+}
+
+#endif // SPLATBINS_H